@@ -30,7 +30,27 @@
  * |[
  * gst-launch-1.0 filesrc location=abc.ac3 ! ac3parse ! a52dec ! audioconvert ! audioresample ! autoaudiosink
  * ]| Decode and play a stand alone AC-3 file.
+ * |[
+ * gst-launch-1.0 dvdreadsrc title=1 ! mpegpsdemux ! a52dec custom-downmix=true lfe-mix-level=0.5 ! audio/x-raw,format=S16LE,channels=2 ! wavenc ! filesink location=abc.wav
+ * ]| Downmix the audio part of a dvd title to dithered 16-bit stereo, with
+ * the LFE channel mixed in, without a separate audioconvert.
  * </refsect2>
+ *
+ * When #GstA52Dec:custom-downmix is enabled and the output is stereo, the
+ * channels of the stream are mixed down with the #GstA52Dec:center-mix-level,
+ * #GstA52Dec:surround-mix-level and #GstA52Dec:lfe-mix-level gains instead of
+ * the ones liba52 takes from the stream. Unless #GstA52Dec:normalize is
+ * disabled, the gains of each stereo channel are scaled down so that they
+ * sum up to 1 and a full scale stream can't clip. The mixing is done in the
+ * same pass that interleaves the decoded samples, as is the conversion to
+ * 16-bit samples when downstream asks for those.
+ *
+ * With #GstA52Dec:passthrough, the frames are not decoded at all but wrapped
+ * into IEC 61937 bursts, output as 16-bit stereo samples, for an S/PDIF or
+ * HDMI output that passes them on unchanged to an AV receiver:
+ * |[
+ * gst-launch-1.0 filesrc location=abc.ac3 ! ac3parse ! a52dec passthrough=true ! alsasink device=iec958
+ * ]|
  */
 
 #ifdef HAVE_CONFIG_H
@@ -44,6 +64,7 @@
 #endif
 
 #include <gst/gst.h>
+#include <gst/audio/gstaudioiec61937.h>
 
 #include <a52dec/a52.h>
 #if !defined(A52_ACCEL_DETECT)
@@ -75,8 +96,18 @@ enum
   ARG_DRC,
   ARG_MODE,
   ARG_LFE,
+  ARG_CUSTOM_DOWNMIX,
+  ARG_CENTER_MIX_LEVEL,
+  ARG_SURROUND_MIX_LEVEL,
+  ARG_LFE_MIX_LEVEL,
+  ARG_NORMALIZE,
+  ARG_DITHER,
+  ARG_PASSTHROUGH
 };
 
+/* -3 dB */
+#define DEFAULT_MIX_LEVEL 0.70710678
+
 static GstStaticPadTemplate sink_factory = GST_STATIC_PAD_TEMPLATE ("sink",
     GST_PAD_SINK,
     GST_PAD_ALWAYS,
@@ -87,7 +118,7 @@ static GstStaticPadTemplate src_factory = GST_STATIC_PAD_TEMPLATE ("src",
     GST_PAD_SRC,
     GST_PAD_ALWAYS,
     GST_STATIC_CAPS ("audio/x-raw, "
-        "format = (string) " SAMPLE_FORMAT ", "
+        "format = (string) { " SAMPLE_FORMAT ", " GST_AUDIO_NE (S16) " }, "
         "layout = (string) interleaved, "
         "rate = (int) [ 4000, 96000 ], " "channels = (int) [ 1, 6 ]")
     );
@@ -185,6 +216,77 @@ gst_a52dec_class_init (GstA52DecClass * klass)
   g_object_class_install_property (G_OBJECT_CLASS (klass), ARG_LFE,
       g_param_spec_boolean ("lfe", "LFE", "LFE", TRUE,
           G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS));
+  /**
+   * GstA52Dec::custom-downmix
+   *
+   * Mix multichannel streams down to stereo with the center, surround and
+   * LFE mix levels set on the element, instead of the levels in the stream.
+   */
+  g_object_class_install_property (G_OBJECT_CLASS (klass), ARG_CUSTOM_DOWNMIX,
+      g_param_spec_boolean ("custom-downmix", "Custom downmix",
+          "Downmix to stereo with the configured mix levels", FALSE,
+          G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS));
+  /**
+   * GstA52Dec::center-mix-level
+   *
+   * Gain of the center channel in both stereo channels of a custom downmix.
+   */
+  g_object_class_install_property (G_OBJECT_CLASS (klass),
+      ARG_CENTER_MIX_LEVEL, g_param_spec_double ("center-mix-level",
+          "Center mix level", "Gain of the center channel in a custom downmix",
+          0.0, 2.0, DEFAULT_MIX_LEVEL,
+          G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS));
+  /**
+   * GstA52Dec::surround-mix-level
+   *
+   * Gain of the surround channels in a custom downmix. A rear center
+   * channel goes to both stereo channels.
+   */
+  g_object_class_install_property (G_OBJECT_CLASS (klass),
+      ARG_SURROUND_MIX_LEVEL, g_param_spec_double ("surround-mix-level",
+          "Surround mix level",
+          "Gain of the surround channels in a custom downmix", 0.0, 2.0,
+          DEFAULT_MIX_LEVEL, G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS));
+  /**
+   * GstA52Dec::lfe-mix-level
+   *
+   * Gain of the LFE channel in both stereo channels of a custom downmix.
+   * The default of 0 leaves it out.
+   */
+  g_object_class_install_property (G_OBJECT_CLASS (klass), ARG_LFE_MIX_LEVEL,
+      g_param_spec_double ("lfe-mix-level", "LFE mix level",
+          "Gain of the LFE channel in a custom downmix", 0.0, 2.0, 0.0,
+          G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS));
+  /**
+   * GstA52Dec::normalize
+   *
+   * Scale the gains of each stereo channel of a custom downmix so that they
+   * sum up to 1, which keeps the mix of full scale channels from clipping.
+   */
+  g_object_class_install_property (G_OBJECT_CLASS (klass), ARG_NORMALIZE,
+      g_param_spec_boolean ("normalize", "Normalize",
+          "Keep the gains of a custom downmix from adding up above 1", TRUE,
+          G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS));
+  /**
+   * GstA52Dec::dither
+   *
+   * Apply triangular dither when converting to 16-bit samples.
+   */
+  g_object_class_install_property (G_OBJECT_CLASS (klass), ARG_DITHER,
+      g_param_spec_boolean ("dither", "Dither",
+          "Dither when converting to 16-bit samples", TRUE,
+          G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS));
+  /**
+   * GstA52Dec::passthrough
+   *
+   * Don't decode, but wrap every frame into an IEC 61937 burst for a
+   * digital output that takes those as 16-bit stereo samples.
+   */
+  g_object_class_install_property (G_OBJECT_CLASS (klass), ARG_PASSTHROUGH,
+      g_param_spec_boolean ("passthrough", "Passthrough",
+          "Output IEC 61937 bursts instead of decoding", FALSE,
+          G_PARAM_READWRITE | GST_PARAM_MUTABLE_READY |
+          G_PARAM_STATIC_STRINGS));
 
   gst_element_class_add_static_pad_template (gstelement_class, &sink_factory);
   gst_element_class_add_static_pad_template (gstelement_class, &src_factory);
@@ -224,6 +326,13 @@ gst_a52dec_init (GstA52Dec * a52dec)
 {
   a52dec->request_channels = A52_CHANNEL;
   a52dec->dynamic_range_compression = FALSE;
+  a52dec->custom_downmix = FALSE;
+  a52dec->center_mix_level = DEFAULT_MIX_LEVEL;
+  a52dec->surround_mix_level = DEFAULT_MIX_LEVEL;
+  a52dec->lfe_mix_level = 0.0;
+  a52dec->normalize = TRUE;
+  a52dec->dither = TRUE;
+  a52dec->passthrough_prop = FALSE;
 
   a52dec->state = NULL;
   a52dec->samples = NULL;
@@ -274,6 +383,13 @@ gst_a52dec_start (GstAudioDecoder * dec)
   a52dec->level = 1;
   a52dec->bias = 0;
   a52dec->flag_update = TRUE;
+  a52dec->format = SAMPLE_TYPE;
+  a52dec->downmix = FALSE;
+  a52dec->dither_seed = 1;
+
+  GST_OBJECT_LOCK (a52dec);
+  a52dec->passthrough = a52dec->passthrough_prop;
+  GST_OBJECT_UNLOCK (a52dec);
 
   /* call upon legacy upstream byte support (e.g. seeking) */
   gst_audio_decoder_set_estimate_rate (dec, TRUE);
@@ -421,6 +537,33 @@ gst_a52dec_channels (int flags, GstAudioChannelPosition * pos)
   return chans;
 }
 
+/* float output is preferred, 16-bit samples only if downstream wants those */
+static GstAudioFormat
+gst_a52dec_output_format (GstA52Dec * a52dec)
+{
+  GstAudioFormat format = SAMPLE_TYPE;
+  GstCaps *caps;
+
+  caps = gst_pad_get_allowed_caps (GST_AUDIO_DECODER_SRC_PAD (a52dec));
+  if (caps && gst_caps_get_size (caps) > 0) {
+    GstCaps *copy = gst_caps_copy_nth (caps, 0);
+    GstStructure *structure = gst_caps_get_structure (copy, 0);
+    const gchar *fmt;
+
+    gst_structure_fixate_field_string (structure, "format", SAMPLE_FORMAT);
+    fmt = gst_structure_get_string (structure, "format");
+    if (fmt && gst_audio_format_from_string (fmt) == GST_AUDIO_FORMAT_S16)
+      format = GST_AUDIO_FORMAT_S16;
+
+    gst_caps_unref (copy);
+  }
+
+  if (caps)
+    gst_caps_unref (caps);
+
+  return format;
+}
+
 static gboolean
 gst_a52dec_reneg (GstA52Dec * a52dec)
 {
@@ -429,11 +572,19 @@ gst_a52dec_reneg (GstA52Dec * a52dec)
   GstAudioChannelPosition from[6], to[6];
   GstAudioInfo info;
 
-  channels = gst_a52dec_channels (a52dec->using_channels, from);
+  if (a52dec->downmix || a52dec->passthrough)
+    channels = gst_a52dec_channels (A52_STEREO, from);
+  else
+    channels = gst_a52dec_channels (a52dec->using_channels, from);
 
   if (!channels)
     goto done;
 
+  if (a52dec->passthrough)
+    a52dec->format = GST_AUDIO_FORMAT_S16;
+  else
+    a52dec->format = gst_a52dec_output_format (a52dec);
+
   GST_INFO_OBJECT (a52dec, "reneg channels:%d rate:%d",
       channels, a52dec->sample_rate);
 
@@ -444,7 +595,7 @@ gst_a52dec_reneg (GstA52Dec * a52dec)
 
   gst_audio_info_init (&info);
   gst_audio_info_set_format (&info,
-      SAMPLE_TYPE, a52dec->sample_rate, channels, (channels > 1 ? to : NULL));
+      a52dec->format, a52dec->sample_rate, channels, (channels > 1 ? to : NULL));
 
   if (!gst_audio_decoder_set_output_format (GST_AUDIO_DECODER (a52dec), &info))
     goto done;
@@ -469,13 +620,183 @@ gst_a52dec_update_streaminfo (GstA52Dec * a52dec)
   gst_tag_list_unref (taglist);
 }
 
+/* builds the stereo downmix of the channels in @flags */
+static void
+gst_a52dec_update_mix (GstA52Dec * a52dec, int flags)
+{
+  GstAudioChannelPosition pos[6];
+  sample_t clev, slev, lfelev;
+  gboolean normalize;
+  gint chans, c, o;
+
+  GST_OBJECT_LOCK (a52dec);
+  clev = a52dec->center_mix_level;
+  slev = a52dec->surround_mix_level;
+  lfelev = a52dec->lfe_mix_level;
+  normalize = a52dec->normalize;
+  GST_OBJECT_UNLOCK (a52dec);
+
+  chans = gst_a52dec_channels (flags, pos);
+  for (c = 0; c < chans; c++) {
+    sample_t *left = &a52dec->mix[0][c], *right = &a52dec->mix[1][c];
+
+    switch (pos[c]) {
+      case GST_AUDIO_CHANNEL_POSITION_FRONT_LEFT:
+        *left = 1;
+        *right = 0;
+        break;
+      case GST_AUDIO_CHANNEL_POSITION_FRONT_RIGHT:
+        *left = 0;
+        *right = 1;
+        break;
+      case GST_AUDIO_CHANNEL_POSITION_FRONT_CENTER:
+        *left = *right = clev;
+        break;
+      case GST_AUDIO_CHANNEL_POSITION_REAR_LEFT:
+        *left = slev;
+        *right = 0;
+        break;
+      case GST_AUDIO_CHANNEL_POSITION_REAR_RIGHT:
+        *left = 0;
+        *right = slev;
+        break;
+      case GST_AUDIO_CHANNEL_POSITION_REAR_CENTER:
+        *left = *right = slev;
+        break;
+      case GST_AUDIO_CHANNEL_POSITION_LFE1:
+        *left = *right = lfelev;
+        break;
+      default:
+        *left = *right = 1;
+        break;
+    }
+  }
+
+  if (!normalize)
+    return;
+
+  /* each row adds up to at most 1, so full scale inputs can't clip */
+  for (o = 0; o < 2; o++) {
+    sample_t sum = 0;
+
+    for (c = 0; c < chans; c++)
+      sum += a52dec->mix[o][c];
+    if (sum > 1) {
+      for (c = 0; c < chans; c++)
+        a52dec->mix[o][c] /= sum;
+    }
+  }
+}
+
+static inline gint16
+gst_a52dec_to_s16 (GstA52Dec * a52dec, sample_t sample, gboolean dither)
+{
+  sample_t v = sample * 32767;
+
+  /* triangular dither of +-1 LSB from the sum of two uniform values */
+  if (dither) {
+    guint32 r1, r2;
+
+    r1 = a52dec->dither_seed = a52dec->dither_seed * 1664525 + 1013904223;
+    r2 = a52dec->dither_seed = a52dec->dither_seed * 1664525 + 1013904223;
+    v += ((sample_t) (r1 >> 16) + (sample_t) (r2 >> 16)) / 65536 - 1;
+  }
+
+  v = v < 0 ? v - 0.5 : v + 0.5;
+  if (v > 32767)
+    return 32767;
+  if (v < -32768)
+    return -32768;
+  return (gint16) v;
+}
+
+/* Mixes or reorders the planar samples of one block of the @chans decoded
+ * channels and interleaves them into @out in the negotiated format, all in
+ * one pass over the samples */
+static void
+gst_a52dec_output_block (GstA52Dec * a52dec, gint chans, guint8 * out,
+    gboolean dither)
+{
+  const sample_t *samples = a52dec->samples;
+  const gint *reorder_map = a52dec->channel_reorder_map;
+  gint out_chans = a52dec->downmix ? 2 : chans;
+  gint n, c, o;
+
+  for (n = 0; n < 256; n++) {
+    sample_t frame[6];
+
+    if (a52dec->downmix) {
+      for (o = 0; o < 2; o++) {
+        sample_t v = 0;
+
+        for (c = 0; c < chans; c++)
+          v += a52dec->mix[o][c] * samples[c * 256 + n];
+        frame[o] = v;
+      }
+    } else {
+      for (c = 0; c < chans; c++)
+        frame[reorder_map[c]] = samples[c * 256 + n];
+    }
+
+    if (a52dec->format == GST_AUDIO_FORMAT_S16) {
+      gint16 *dest = (gint16 *) out + n * out_chans;
+
+      for (o = 0; o < out_chans; o++)
+        dest[o] = gst_a52dec_to_s16 (a52dec, frame[o], dither);
+    } else {
+      sample_t *dest = (sample_t *) out + n * out_chans;
+
+      for (o = 0; o < out_chans; o++)
+        dest[o] = frame[o];
+    }
+  }
+}
+
+/* wraps a frame into an IEC 61937 burst of 1536 stereo samples */
+static GstFlowReturn
+gst_a52dec_passthrough (GstA52Dec * a52dec, const guint8 * data, gsize size)
+{
+  GstAudioRingBufferSpec spec;
+  GstBuffer *outbuf;
+  GstMapInfo map;
+  guint burst_size;
+  gboolean res;
+
+  memset (&spec, 0, sizeof (spec));
+  spec.type = GST_AUDIO_RING_BUFFER_FORMAT_TYPE_AC3;
+  gst_audio_info_set_format (&spec.info, GST_AUDIO_FORMAT_S16,
+      a52dec->sample_rate, 2, NULL);
+
+  burst_size = gst_audio_iec61937_frame_size (&spec);
+  outbuf = gst_buffer_new_and_alloc (burst_size);
+
+  gst_buffer_map (outbuf, &map, GST_MAP_WRITE);
+  res = gst_audio_iec61937_payload (data, size, map.data, burst_size, &spec,
+      G_BYTE_ORDER);
+  gst_buffer_unmap (outbuf, &map);
+
+  if (!res) {
+    GstFlowReturn result = GST_FLOW_OK;
+
+    gst_buffer_unref (outbuf);
+    GST_AUDIO_DECODER_ERROR (a52dec, 1, STREAM, DECODE, (NULL),
+        ("failed to payload frame of %" G_GSIZE_FORMAT " bytes", size),
+        result);
+    return result;
+  }
+
+  return gst_audio_decoder_finish_frame (GST_AUDIO_DECODER (a52dec), outbuf,
+      1);
+}
+
 static GstFlowReturn
 gst_a52dec_handle_frame (GstAudioDecoder * bdec, GstBuffer * buffer)
 {
   GstA52Dec *a52dec;
   gint channels, i;
   gboolean need_reneg = FALSE;
-  gint chans;
+  gboolean downmix, dither;
+  gint chans, out_chans, bpf;
   gint length = 0, flags, sample_rate, bit_rate;
   GstMapInfo map;
   GstFlowReturn result = GST_FLOW_OK;
@@ -522,6 +843,16 @@ gst_a52dec_handle_frame (GstAudioDecoder * bdec, GstBuffer * buffer)
     gst_a52dec_update_streaminfo (a52dec);
   }
 
+  if (a52dec->passthrough) {
+    if (need_reneg && !gst_a52dec_reneg (a52dec)) {
+      gst_buffer_unmap (buffer, &map);
+      goto failed_negotiation;
+    }
+    result = gst_a52dec_passthrough (a52dec, map.data, map.size);
+    gst_buffer_unmap (buffer, &map);
+    goto exit;
+  }
+
   /* If we haven't had an explicit number of channels chosen through properties
    * at this point, choose what to downmix to now, based on what the peer will
    * accept - this allows a52dec to do downmixing in preference to a
@@ -571,10 +902,23 @@ gst_a52dec_handle_frame (GstAudioDecoder * bdec, GstBuffer * buffer)
 
     if (caps)
       gst_caps_unref (caps);
+  } else if (a52dec->downmix) {
+    flags = A52_STEREO;
   } else {
     flags = a52dec->using_channels;
   }
 
+  /* decode all channels of the stream for a custom stereo downmix */
+  GST_OBJECT_LOCK (a52dec);
+  downmix = a52dec->custom_downmix;
+  dither = a52dec->dither;
+  GST_OBJECT_UNLOCK (a52dec);
+
+  downmix = downmix && (flags & (A52_CHANNEL_MASK | A52_LFE)) == A52_STEREO
+      && gst_a52dec_channels (a52dec->stream_channels, NULL) > 2;
+  if (downmix)
+    flags = a52dec->stream_channels;
+
   /* process */
   flags |= A52_ADJUST_LEVEL;
   a52dec->level = 1;
@@ -587,9 +931,10 @@ gst_a52dec_handle_frame (GstAudioDecoder * bdec, GstBuffer * buffer)
   gst_buffer_unmap (buffer, &map);
 
   channels = flags & (A52_CHANNEL_MASK | A52_LFE);
-  if (a52dec->using_channels != channels) {
+  if (a52dec->using_channels != channels || a52dec->downmix != downmix) {
     need_reneg = TRUE;
     a52dec->using_channels = channels;
+    a52dec->downmix = downmix;
   }
 
   /* negotiate if required */
@@ -610,10 +955,15 @@ gst_a52dec_handle_frame (GstAudioDecoder * bdec, GstBuffer * buffer)
   if (!chans)
     goto invalid_flags;
 
+  if (downmix)
+    gst_a52dec_update_mix (a52dec, flags);
+  out_chans = downmix ? 2 : chans;
+  bpf = out_chans * (a52dec->format == GST_AUDIO_FORMAT_S16 ?
+      sizeof (gint16) : SAMPLE_WIDTH / 8);
+
   /* handle decoded data;
    * each frame has 6 blocks, one block is 256 samples, ea */
-  outbuf =
-      gst_buffer_new_and_alloc (256 * chans * (SAMPLE_WIDTH / 8) * num_blocks);
+  outbuf = gst_buffer_new_and_alloc (256 * bpf * num_blocks);
 
   gst_buffer_map (outbuf, &map, GST_MAP_WRITE);
   {
@@ -628,17 +978,9 @@ gst_a52dec_handle_frame (GstAudioDecoder * bdec, GstBuffer * buffer)
           goto exit;
         }
       } else {
-        gint n, c;
-        gint *reorder_map = a52dec->channel_reorder_map;
-
-        for (n = 0; n < 256; n++) {
-          for (c = 0; c < chans; c++) {
-            ((sample_t *) ptr)[n * chans + reorder_map[c]] =
-                a52dec->samples[c * 256 + n];
-          }
-        }
+        gst_a52dec_output_block (a52dec, chans, ptr, dither);
       }
-      ptr += 256 * chans * (SAMPLE_WIDTH / 8);
+      ptr += 256 * bpf;
     }
   }
   gst_buffer_unmap (outbuf, &map);
@@ -784,6 +1126,41 @@ gst_a52dec_set_property (GObject * object, guint prop_id, const GValue * value,
       src->request_channels |= g_value_get_boolean (value) ? A52_LFE : 0;
       GST_OBJECT_UNLOCK (src);
       break;
+    case ARG_CUSTOM_DOWNMIX:
+      GST_OBJECT_LOCK (src);
+      src->custom_downmix = g_value_get_boolean (value);
+      GST_OBJECT_UNLOCK (src);
+      break;
+    case ARG_CENTER_MIX_LEVEL:
+      GST_OBJECT_LOCK (src);
+      src->center_mix_level = g_value_get_double (value);
+      GST_OBJECT_UNLOCK (src);
+      break;
+    case ARG_SURROUND_MIX_LEVEL:
+      GST_OBJECT_LOCK (src);
+      src->surround_mix_level = g_value_get_double (value);
+      GST_OBJECT_UNLOCK (src);
+      break;
+    case ARG_LFE_MIX_LEVEL:
+      GST_OBJECT_LOCK (src);
+      src->lfe_mix_level = g_value_get_double (value);
+      GST_OBJECT_UNLOCK (src);
+      break;
+    case ARG_NORMALIZE:
+      GST_OBJECT_LOCK (src);
+      src->normalize = g_value_get_boolean (value);
+      GST_OBJECT_UNLOCK (src);
+      break;
+    case ARG_DITHER:
+      GST_OBJECT_LOCK (src);
+      src->dither = g_value_get_boolean (value);
+      GST_OBJECT_UNLOCK (src);
+      break;
+    case ARG_PASSTHROUGH:
+      GST_OBJECT_LOCK (src);
+      src->passthrough_prop = g_value_get_boolean (value);
+      GST_OBJECT_UNLOCK (src);
+      break;
     default:
       G_OBJECT_WARN_INVALID_PROPERTY_ID (object, prop_id, pspec);
       break;
@@ -812,6 +1189,41 @@ gst_a52dec_get_property (GObject * object, guint prop_id, GValue * value,
       g_value_set_boolean (value, src->request_channels & A52_LFE);
       GST_OBJECT_UNLOCK (src);
       break;
+    case ARG_CUSTOM_DOWNMIX:
+      GST_OBJECT_LOCK (src);
+      g_value_set_boolean (value, src->custom_downmix);
+      GST_OBJECT_UNLOCK (src);
+      break;
+    case ARG_CENTER_MIX_LEVEL:
+      GST_OBJECT_LOCK (src);
+      g_value_set_double (value, src->center_mix_level);
+      GST_OBJECT_UNLOCK (src);
+      break;
+    case ARG_SURROUND_MIX_LEVEL:
+      GST_OBJECT_LOCK (src);
+      g_value_set_double (value, src->surround_mix_level);
+      GST_OBJECT_UNLOCK (src);
+      break;
+    case ARG_LFE_MIX_LEVEL:
+      GST_OBJECT_LOCK (src);
+      g_value_set_double (value, src->lfe_mix_level);
+      GST_OBJECT_UNLOCK (src);
+      break;
+    case ARG_NORMALIZE:
+      GST_OBJECT_LOCK (src);
+      g_value_set_boolean (value, src->normalize);
+      GST_OBJECT_UNLOCK (src);
+      break;
+    case ARG_DITHER:
+      GST_OBJECT_LOCK (src);
+      g_value_set_boolean (value, src->dither);
+      GST_OBJECT_UNLOCK (src);
+      break;
+    case ARG_PASSTHROUGH:
+      GST_OBJECT_LOCK (src);
+      g_value_set_boolean (value, src->passthrough_prop);
+      GST_OBJECT_UNLOCK (src);
+      break;
     default:
       G_OBJECT_WARN_INVALID_PROPERTY_ID (object, prop_id, pspec);
       break;
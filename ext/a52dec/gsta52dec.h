@@ -59,6 +59,23 @@ struct _GstA52Dec {
 
   gint           channel_reorder_map[6];
 
+  /* output stage */
+  GstAudioFormat format;
+  gboolean       downmix;
+  sample_t       mix[2][6];
+  guint32        dither_seed;
+
+  gboolean       custom_downmix;
+  gdouble        center_mix_level;
+  gdouble        surround_mix_level;
+  gdouble        lfe_mix_level;
+  gboolean       normalize;
+  gboolean       dither;
+
+  /* IEC 61937 bursts instead of decoded samples */
+  gboolean       passthrough;
+  gboolean       passthrough_prop;
+
   sample_t       level;
   sample_t       bias;
   gboolean       dynamic_range_compression;
@@ -23,6 +23,8 @@
 
 #include "amrnbdec.h"
 #include "amrnbenc.h"
+#include "amrnbbankdec.h"
+#include "amrnbbankenc.h"
 
 static gboolean
 plugin_init (GstPlugin * plugin)
@@ -30,7 +32,11 @@ plugin_init (GstPlugin * plugin)
   return gst_element_register (plugin, "amrnbdec",
       GST_RANK_PRIMARY, GST_TYPE_AMRNBDEC) &&
       gst_element_register (plugin, "amrnbenc",
-      GST_RANK_SECONDARY, GST_TYPE_AMRNBENC);
+      GST_RANK_SECONDARY, GST_TYPE_AMRNBENC) &&
+      gst_element_register (plugin, "amrnbbankdec",
+      GST_RANK_NONE, GST_TYPE_AMRNBBANKDEC) &&
+      gst_element_register (plugin, "amrnbbankenc",
+      GST_RANK_NONE, GST_TYPE_AMRNBBANKENC);
 }
 
 
@@ -0,0 +1,130 @@
+/* GStreamer Adaptive Multi-Rate Narrow-Band (AMR-NB) plugin
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Library General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Library General Public License for more details.
+ *
+ * You should have received a copy of the GNU Library General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 51 Franklin St, Fifth Floor,
+ * Boston, MA 02110-1301, USA.
+ */
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#include "amrnbbank.h"
+
+/* below this many channels per thread, handing work to the pool costs more
+ * than encoding or decoding the frames */
+#define MIN_CHANNELS_PER_TASK 8
+
+void
+gst_amrnb_bank_init (GstAmrnbBank * bank)
+{
+  bank->pool = NULL;
+  bank->threads = 1;
+  g_mutex_init (&bank->lock);
+  g_cond_init (&bank->cond);
+}
+
+void
+gst_amrnb_bank_clear (GstAmrnbBank * bank)
+{
+  gst_amrnb_bank_stop (bank);
+  g_mutex_clear (&bank->lock);
+  g_cond_clear (&bank->cond);
+}
+
+/* handles the channels of one task, task 0 being the calling thread */
+static void
+gst_amrnb_bank_run_task (GstAmrnbBank * bank, guint task)
+{
+  guint channel, first, last;
+
+  first = task * bank->channels / bank->tasks;
+  last = (task + 1) * bank->channels / bank->tasks;
+
+  for (channel = first; channel < last; channel++)
+    bank->func (bank->user_data, channel);
+}
+
+static void
+gst_amrnb_bank_worker (gpointer data, gpointer user_data)
+{
+  GstAmrnbBank *bank = user_data;
+
+  gst_amrnb_bank_run_task (bank, GPOINTER_TO_UINT (data) - 1);
+
+  g_mutex_lock (&bank->lock);
+  if (--bank->pending == 0)
+    g_cond_signal (&bank->cond);
+  g_mutex_unlock (&bank->lock);
+}
+
+/* threads of 0 means one thread per CPU */
+gboolean
+gst_amrnb_bank_start (GstAmrnbBank * bank, gint threads)
+{
+  gst_amrnb_bank_stop (bank);
+
+  if (threads == 0)
+    threads = g_get_num_processors ();
+  bank->threads = MAX (threads, 1);
+
+  /* the calling thread does a share of the work itself */
+  if (bank->threads > 1) {
+    bank->pool = g_thread_pool_new (gst_amrnb_bank_worker, bank,
+        bank->threads - 1, FALSE, NULL);
+    if (bank->pool == NULL)
+      return FALSE;
+  }
+
+  return TRUE;
+}
+
+void
+gst_amrnb_bank_stop (GstAmrnbBank * bank)
+{
+  if (bank->pool) {
+    g_thread_pool_free (bank->pool, FALSE, TRUE);
+    bank->pool = NULL;
+  }
+}
+
+/* calls func for every channel and returns when all calls are done */
+void
+gst_amrnb_bank_run (GstAmrnbBank * bank, guint channels,
+    GstAmrnbBankFunc func, gpointer user_data)
+{
+  guint task;
+
+  bank->func = func;
+  bank->user_data = user_data;
+  bank->channels = channels;
+  bank->tasks = MIN (bank->threads, channels / MIN_CHANNELS_PER_TASK);
+
+  if (bank->pool == NULL || bank->tasks <= 1) {
+    bank->tasks = 1;
+    gst_amrnb_bank_run_task (bank, 0);
+    return;
+  }
+
+  bank->pending = bank->tasks - 1;
+  for (task = 1; task < bank->tasks; task++)
+    g_thread_pool_push (bank->pool, GUINT_TO_POINTER (task + 1), NULL);
+
+  gst_amrnb_bank_run_task (bank, 0);
+
+  g_mutex_lock (&bank->lock);
+  while (bank->pending > 0)
+    g_cond_wait (&bank->cond, &bank->lock);
+  g_mutex_unlock (&bank->lock);
+}
@@ -0,0 +1,63 @@
+/* GStreamer Adaptive Multi-Rate Narrow-Band (AMR-NB) plugin
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Library General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Library General Public License for more details.
+ *
+ * You should have received a copy of the GNU Library General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 51 Franklin St, Fifth Floor,
+ * Boston, MA 02110-1301, USA.
+ */
+
+#ifndef __GST_AMRNB_BANK_H__
+#define __GST_AMRNB_BANK_H__
+
+#include <gst/gst.h>
+
+G_BEGIN_DECLS
+
+/* channels (independent calls) a bank element handles at most */
+#define GST_AMRNB_BANK_MAX_CHANNELS 4096
+
+/* samples per channel in one 20 ms frame */
+#define GST_AMRNB_BANK_FRAME_SAMPLES 160
+
+typedef void (*GstAmrnbBankFunc) (gpointer user_data, guint channel);
+
+typedef struct _GstAmrnbBank GstAmrnbBank;
+
+/* runs a function for every channel of a tick, spread over a thread pool */
+struct _GstAmrnbBank {
+  GThreadPool *pool;
+  guint threads;
+
+  /* current run */
+  GstAmrnbBankFunc func;
+  gpointer user_data;
+  guint channels;
+  guint tasks;
+
+  GMutex lock;
+  GCond cond;
+  guint pending;
+};
+
+void gst_amrnb_bank_init (GstAmrnbBank * bank);
+void gst_amrnb_bank_clear (GstAmrnbBank * bank);
+
+gboolean gst_amrnb_bank_start (GstAmrnbBank * bank, gint threads);
+void gst_amrnb_bank_stop (GstAmrnbBank * bank);
+
+void gst_amrnb_bank_run (GstAmrnbBank * bank, guint channels,
+    GstAmrnbBankFunc func, gpointer user_data);
+
+G_END_DECLS
+
+#endif /* __GST_AMRNB_BANK_H__ */
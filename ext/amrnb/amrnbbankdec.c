@@ -0,0 +1,404 @@
+/* GStreamer Adaptive Multi-Rate Narrow-Band (AMR-NB) plugin
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Library General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Library General Public License for more details.
+ *
+ * You should have received a copy of the GNU Library General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 51 Franklin St, Fifth Floor,
+ * Boston, MA 02110-1301, USA.
+ */
+
+/**
+ * SECTION:element-amrnbbankdec
+ * @see_also: #GstAmrnbDec, #GstAmrnbBankEnc
+ *
+ * AMR narrowband decoder for many independent calls at once, based on the
+ * <ulink url="http://sourceforge.net/projects/opencore-amr">opencore codec implementation</ulink>.
+ *
+ * The input consists of multi-channel AMR frame blocks as produced by
+ * #GstAmrnbBankEnc, holding one frame in storage format per channel. Every
+ * channel is decoded by its own decoder instance, on a pool of
+ * #GstAmrnbBankDec:threads threads, and output as one channel of the raw
+ * audio. Non-interleaved output is preferred if downstream accepts it, as it
+ * needs no extra pass over the samples.
+ *
+ * <refsect2>
+ * <title>Example launch line</title>
+ * |[
+ * gst-launch-1.0 audiotestsrc num-buffers=100 ! audio/x-raw,rate=8000,channels=16,channel-mask=(bitmask)0 ! amrnbbankenc ! amrnbbankdec ! fakesink
+ * ]| Encode and decode 16 calls at once.
+ * </refsect2>
+ */
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#include "amrnbbankdec.h"
+
+static GstStaticPadTemplate sink_template = GST_STATIC_PAD_TEMPLATE ("sink",
+    GST_PAD_SINK,
+    GST_PAD_ALWAYS,
+    GST_STATIC_CAPS ("audio/AMR, " "rate = (int) 8000, "
+        "channels = (int) [ 1, " G_STRINGIFY (GST_AMRNB_BANK_MAX_CHANNELS) " ]")
+    );
+
+static GstStaticPadTemplate src_template = GST_STATIC_PAD_TEMPLATE ("src",
+    GST_PAD_SRC,
+    GST_PAD_ALWAYS,
+    GST_STATIC_CAPS ("audio/x-raw, format = (string) " GST_AUDIO_NE (S16) ", "
+        "layout = (string) { non-interleaved, interleaved }, "
+        "rate = (int) 8000, "
+        "channels = (int) [ 1, "
+        G_STRINGIFY (GST_AMRNB_BANK_MAX_CHANNELS) " ]")
+    );
+
+GST_DEBUG_CATEGORY_STATIC (gst_amrnbbankdec_debug);
+#define GST_CAT_DEFAULT gst_amrnbbankdec_debug
+
+static const gint block_size_if1[16] = { 12, 13, 15, 17, 19, 20, 26, 31, 5,
+  0, 0, 0, 0, 0, 0, 0
+};
+
+#define THREADS_DEFAULT 0
+enum
+{
+  PROP_0,
+  PROP_THREADS
+};
+
+static void gst_amrnbbankdec_set_property (GObject * object, guint prop_id,
+    const GValue * value, GParamSpec * pspec);
+static void gst_amrnbbankdec_get_property (GObject * object, guint prop_id,
+    GValue * value, GParamSpec * pspec);
+static void gst_amrnbbankdec_finalize (GObject * object);
+
+static gboolean gst_amrnbbankdec_start (GstAudioDecoder * dec);
+static gboolean gst_amrnbbankdec_stop (GstAudioDecoder * dec);
+static gboolean gst_amrnbbankdec_set_format (GstAudioDecoder * dec,
+    GstCaps * caps);
+static GstFlowReturn gst_amrnbbankdec_parse (GstAudioDecoder * dec,
+    GstAdapter * adapter, gint * offset, gint * length);
+static GstFlowReturn gst_amrnbbankdec_handle_frame (GstAudioDecoder * dec,
+    GstBuffer * buffer);
+
+#define gst_amrnbbankdec_parent_class parent_class
+G_DEFINE_TYPE (GstAmrnbBankDec, gst_amrnbbankdec, GST_TYPE_AUDIO_DECODER);
+
+static void
+gst_amrnbbankdec_class_init (GstAmrnbBankDecClass * klass)
+{
+  GObjectClass *object_class = G_OBJECT_CLASS (klass);
+  GstElementClass *element_class = GST_ELEMENT_CLASS (klass);
+  GstAudioDecoderClass *base_class = GST_AUDIO_DECODER_CLASS (klass);
+
+  object_class->set_property = gst_amrnbbankdec_set_property;
+  object_class->get_property = gst_amrnbbankdec_get_property;
+  object_class->finalize = gst_amrnbbankdec_finalize;
+
+  gst_element_class_add_static_pad_template (element_class, &sink_template);
+  gst_element_class_add_static_pad_template (element_class, &src_template);
+
+  gst_element_class_set_static_metadata (element_class,
+      "AMR-NB audio decoder bank", "Codec/Decoder/Audio",
+      "Adaptive Multi-Rate Narrow-Band decoder for many channels at once",
+      "GStreamer maintainers <gstreamer-devel@lists.freedesktop.org>");
+
+  base_class->start = GST_DEBUG_FUNCPTR (gst_amrnbbankdec_start);
+  base_class->stop = GST_DEBUG_FUNCPTR (gst_amrnbbankdec_stop);
+  base_class->set_format = GST_DEBUG_FUNCPTR (gst_amrnbbankdec_set_format);
+  base_class->parse = GST_DEBUG_FUNCPTR (gst_amrnbbankdec_parse);
+  base_class->handle_frame = GST_DEBUG_FUNCPTR (gst_amrnbbankdec_handle_frame);
+
+  g_object_class_install_property (object_class, PROP_THREADS,
+      g_param_spec_int ("threads", "Threads",
+          "Number of threads decoding the channels (0 = number of CPUs)",
+          0, 64, THREADS_DEFAULT,
+          G_PARAM_READWRITE | G_PARAM_CONSTRUCT | G_PARAM_STATIC_STRINGS));
+
+  GST_DEBUG_CATEGORY_INIT (gst_amrnbbankdec_debug, "amrnbbankdec", 0,
+      "AMR-NB audio decoder bank");
+}
+
+static void
+gst_amrnbbankdec_init (GstAmrnbBankDec * self)
+{
+  gst_audio_decoder_set_needs_format (GST_AUDIO_DECODER (self), TRUE);
+  gst_audio_decoder_set_use_default_pad_acceptcaps (GST_AUDIO_DECODER_CAST
+      (self), TRUE);
+  GST_PAD_SET_ACCEPT_TEMPLATE (GST_AUDIO_DECODER_SINK_PAD (self));
+
+  gst_amrnb_bank_init (&self->bank);
+}
+
+static void
+gst_amrnbbankdec_finalize (GObject * object)
+{
+  GstAmrnbBankDec *self = GST_AMRNBBANKDEC (object);
+
+  gst_amrnb_bank_clear (&self->bank);
+
+  G_OBJECT_CLASS (parent_class)->finalize (object);
+}
+
+static void
+gst_amrnbbankdec_free_channels (GstAmrnbBankDec * self)
+{
+  gint i;
+
+  if (self->handles) {
+    for (i = 0; i < self->channels; i++) {
+      if (self->handles[i])
+        Decoder_Interface_exit (self->handles[i]);
+    }
+    g_free (self->handles);
+    self->handles = NULL;
+  }
+
+  g_free (self->frames);
+  self->frames = NULL;
+  g_free (self->samples);
+  self->samples = NULL;
+
+  self->channels = 0;
+}
+
+static gboolean
+gst_amrnbbankdec_start (GstAudioDecoder * dec)
+{
+  GstAmrnbBankDec *self = GST_AMRNBBANKDEC (dec);
+
+  GST_DEBUG_OBJECT (dec, "start");
+
+  self->rate = 0;
+  self->channels = 0;
+
+  return gst_amrnb_bank_start (&self->bank, self->threads);
+}
+
+static gboolean
+gst_amrnbbankdec_stop (GstAudioDecoder * dec)
+{
+  GstAmrnbBankDec *self = GST_AMRNBBANKDEC (dec);
+
+  GST_DEBUG_OBJECT (dec, "stop");
+
+  gst_amrnb_bank_stop (&self->bank);
+  gst_amrnbbankdec_free_channels (self);
+
+  return TRUE;
+}
+
+static void
+gst_amrnbbankdec_set_property (GObject * object, guint prop_id,
+    const GValue * value, GParamSpec * pspec)
+{
+  GstAmrnbBankDec *self = GST_AMRNBBANKDEC (object);
+
+  switch (prop_id) {
+    case PROP_THREADS:
+      self->threads = g_value_get_int (value);
+      break;
+    default:
+      G_OBJECT_WARN_INVALID_PROPERTY_ID (object, prop_id, pspec);
+      break;
+  }
+  return;
+}
+
+static void
+gst_amrnbbankdec_get_property (GObject * object, guint prop_id,
+    GValue * value, GParamSpec * pspec)
+{
+  GstAmrnbBankDec *self = GST_AMRNBBANKDEC (object);
+
+  switch (prop_id) {
+    case PROP_THREADS:
+      g_value_set_int (value, self->threads);
+      break;
+    default:
+      G_OBJECT_WARN_INVALID_PROPERTY_ID (object, prop_id, pspec);
+      break;
+  }
+  return;
+}
+
+static gboolean
+gst_amrnbbankdec_set_format (GstAudioDecoder * dec, GstCaps * caps)
+{
+  GstStructure *structure;
+  GstAmrnbBankDec *self;
+  GstAudioInfo info;
+  GstCaps *allowed, *planar;
+  gint i, channels = 0;
+
+  self = GST_AMRNBBANKDEC (dec);
+
+  /* fresh codec states for the new calls */
+  gst_amrnbbankdec_free_channels (self);
+
+  structure = gst_caps_get_structure (caps, 0);
+
+  /* get channel count */
+  gst_structure_get_int (structure, "channels", &channels);
+  gst_structure_get_int (structure, "rate", &self->rate);
+  if (channels < 1)
+    return FALSE;
+
+  self->handles = g_new0 (void *, channels);
+  self->channels = channels;
+  for (i = 0; i < channels; i++) {
+    if (!(self->handles[i] = Decoder_Interface_init ()))
+      goto init_failed;
+  }
+
+  self->frames = g_new (const guint8 *, channels);
+  self->samples = g_new (gint16, channels * GST_AMRNB_BANK_FRAME_SAMPLES);
+
+  /* decode straight into the channel planes if downstream takes them */
+  self->interleaved = TRUE;
+  allowed = gst_pad_get_allowed_caps (GST_AUDIO_DECODER_SRC_PAD (dec));
+  if (allowed) {
+    planar = gst_caps_new_simple ("audio/x-raw",
+        "layout", G_TYPE_STRING, "non-interleaved", NULL);
+    self->interleaved = !gst_caps_can_intersect (allowed, planar);
+    gst_caps_unref (planar);
+    gst_caps_unref (allowed);
+  }
+
+  GST_INFO_OBJECT (self, "decoding %d channels to %s output", channels,
+      self->interleaved ? "interleaved" : "non-interleaved");
+
+  /* create reverse caps */
+  gst_audio_info_init (&info);
+  gst_audio_info_set_format (&info,
+      GST_AUDIO_FORMAT_S16, self->rate, channels, NULL);
+  if (!self->interleaved)
+    info.layout = GST_AUDIO_LAYOUT_NON_INTERLEAVED;
+
+  return gst_audio_decoder_set_output_format (dec, &info);
+
+  /* ERRORS */
+init_failed:
+  {
+    GST_ERROR_OBJECT (self, "failed to create decoder for channel %d", i);
+    gst_amrnbbankdec_free_channels (self);
+    return FALSE;
+  }
+}
+
+/* returns the size of the frame block at data, or 0 if it is incomplete */
+static gsize
+gst_amrnbbankdec_block_size (GstAmrnbBankDec * self, const guint8 * data,
+    gsize size, const guint8 ** frames)
+{
+  gsize block = 0;
+  gint c, mode;
+
+  for (c = 0; c < self->channels; c++) {
+    if (block >= size)
+      return 0;
+    if (frames)
+      frames[c] = data + block;
+    mode = (data[block] >> 3) & 0x0F;
+    block += block_size_if1[mode] + 1;
+  }
+
+  return (block <= size) ? block : 0;
+}
+
+static GstFlowReturn
+gst_amrnbbankdec_parse (GstAudioDecoder * dec, GstAdapter * adapter,
+    gint * offset, gint * length)
+{
+  GstAmrnbBankDec *self = GST_AMRNBBANKDEC (dec);
+  const guint8 *data;
+  gsize size, block;
+
+  size = gst_adapter_available (adapter);
+  g_return_val_if_fail (size > 0, GST_FLOW_ERROR);
+
+  if (G_UNLIKELY (self->channels == 0))
+    return GST_FLOW_NOT_NEGOTIATED;
+
+  /* need to peek data of all channels to get the size */
+  data = gst_adapter_map (adapter, size);
+  block = gst_amrnbbankdec_block_size (self, data, size, NULL);
+  gst_adapter_unmap (adapter);
+
+  GST_LOG_OBJECT (self, "block %" G_GSIZE_FORMAT, block);
+
+  if (block == 0)
+    return GST_FLOW_EOS;
+
+  *offset = 0;
+  *length = block;
+
+  return GST_FLOW_OK;
+}
+
+/* runs in the threads of the bank */
+static void
+gst_amrnbbankdec_decode_channel (gpointer user_data, guint channel)
+{
+  GstAmrnbBankDec *self = user_data;
+  gint16 *samples;
+  gint i;
+
+  if (!self->interleaved) {
+    Decoder_Interface_Decode (self->handles[channel], self->frames[channel],
+        self->output + channel * GST_AMRNB_BANK_FRAME_SAMPLES, 0);
+    return;
+  }
+
+  samples = self->samples + channel * GST_AMRNB_BANK_FRAME_SAMPLES;
+  Decoder_Interface_Decode (self->handles[channel], self->frames[channel],
+      samples, 0);
+  for (i = 0; i < GST_AMRNB_BANK_FRAME_SAMPLES; i++)
+    self->output[i * self->channels + channel] = samples[i];
+}
+
+static GstFlowReturn
+gst_amrnbbankdec_handle_frame (GstAudioDecoder * dec, GstBuffer * buffer)
+{
+  GstAmrnbBankDec *self;
+  GstMapInfo inmap, outmap;
+  GstBuffer *out;
+
+  self = GST_AMRNBBANKDEC (dec);
+
+  /* no fancy flushing */
+  if (!buffer || !gst_buffer_get_size (buffer))
+    return GST_FLOW_OK;
+
+  gst_buffer_map (buffer, &inmap, GST_MAP_READ);
+  if (!gst_amrnbbankdec_block_size (self, inmap.data, inmap.size,
+          self->frames)) {
+    gst_buffer_unmap (buffer, &inmap);
+    GST_WARNING_OBJECT (self, "incomplete frame block, skipping");
+    return gst_audio_decoder_finish_frame (dec, NULL, 1);
+  }
+
+  /* get output */
+  out = gst_buffer_new_and_alloc (self->channels *
+      GST_AMRNB_BANK_FRAME_SAMPLES * 2);
+  /* decode */
+  gst_buffer_map (out, &outmap, GST_MAP_WRITE);
+  self->output = (gint16 *) outmap.data;
+  gst_amrnb_bank_run (&self->bank, self->channels,
+      gst_amrnbbankdec_decode_channel, self);
+  self->output = NULL;
+  gst_buffer_unmap (out, &outmap);
+
+  gst_buffer_unmap (buffer, &inmap);
+
+  return gst_audio_decoder_finish_frame (dec, out, 1);
+}
@@ -0,0 +1,74 @@
+/* GStreamer Adaptive Multi-Rate Narrow-Band (AMR-NB) plugin
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Library General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Library General Public License for more details.
+ *
+ * You should have received a copy of the GNU Library General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 51 Franklin St, Fifth Floor,
+ * Boston, MA 02110-1301, USA.
+ */
+
+#ifndef __GST_AMRNBBANKDEC_H__
+#define __GST_AMRNBBANKDEC_H__
+
+#include <gst/gst.h>
+#include <gst/audio/gstaudiodecoder.h>
+
+#include <opencore-amrnb/interf_dec.h>
+
+#include "amrnbbank.h"
+
+G_BEGIN_DECLS
+
+#define GST_TYPE_AMRNBBANKDEC \
+  (gst_amrnbbankdec_get_type())
+#define GST_AMRNBBANKDEC(obj) \
+  (G_TYPE_CHECK_INSTANCE_CAST((obj), GST_TYPE_AMRNBBANKDEC, GstAmrnbBankDec))
+#define GST_AMRNBBANKDEC_CLASS(klass) \
+  (G_TYPE_CHECK_CLASS_CAST((klass), GST_TYPE_AMRNBBANKDEC, GstAmrnbBankDecClass))
+#define GST_IS_AMRNBBANKDEC(obj) \
+  (G_TYPE_CHECK_INSTANCE_TYPE((obj), GST_TYPE_AMRNBBANKDEC))
+#define GST_IS_AMRNBBANKDEC_CLASS(klass) \
+  (G_TYPE_CHECK_CLASS_TYPE((klass), GST_TYPE_AMRNBBANKDEC))
+
+typedef struct _GstAmrnbBankDec GstAmrnbBankDec;
+typedef struct _GstAmrnbBankDecClass GstAmrnbBankDecClass;
+
+struct _GstAmrnbBankDec {
+  GstAudioDecoder element;
+
+  /* library handles, one per channel */
+  void **handles;
+
+  /* output settings */
+  gint channels, rate;
+  gboolean interleaved;
+
+  /* current frame block and its decoded samples */
+  const guint8 **frames;
+  gint16 *samples;
+  gint16 *output;
+
+  GstAmrnbBank bank;
+
+  /* properties */
+  gint threads;
+};
+
+struct _GstAmrnbBankDecClass {
+  GstAudioDecoderClass parent_class;
+};
+
+GType gst_amrnbbankdec_get_type (void);
+
+G_END_DECLS
+
+#endif /* __GST_AMRNBBANKDEC_H__ */
@@ -0,0 +1,420 @@
+/* GStreamer Adaptive Multi-Rate Narrow-Band (AMR-NB) plugin
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Library General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Library General Public License for more details.
+ *
+ * You should have received a copy of the GNU Library General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 51 Franklin St, Fifth Floor,
+ * Boston, MA 02110-1301, USA.
+ */
+
+/**
+ * SECTION:element-amrnbbankenc
+ * @see_also: #GstAmrnbEnc, #GstAmrnbBankDec
+ *
+ * AMR narrowband encoder for many independent calls at once, based on the
+ * <ulink url="http://sourceforge.net/projects/opencore-amr">opencore codec implementation</ulink>.
+ *
+ * Every channel of the input is encoded by its own encoder instance, as if
+ * it was fed to a separate #GstAmrnbEnc. For each 20 ms tick the frames of
+ * all channels are encoded on a pool of #GstAmrnbBankEnc:threads threads and
+ * output as one multi-channel AMR frame block, holding one frame per channel
+ * in channel order as in the multi-channel AMR storage format of RFC 4867.
+ * This saves the per-element and per-buffer overhead of running one encoder
+ * element for every call, which easily exceeds the cost of the codec itself.
+ *
+ * Input with more than two channels needs an unpositioned channel layout,
+ * i.e. a channel-mask of 0. Non-interleaved input is accepted as well.
+ *
+ * <refsect2>
+ * <title>Example launch line</title>
+ * |[
+ * gst-launch-1.0 audiotestsrc num-buffers=100 ! audio/x-raw,rate=8000,channels=16,channel-mask=(bitmask)0 ! amrnbbankenc ! amrnbbankdec ! fakesink
+ * ]| Encode and decode 16 calls at once.
+ * </refsect2>
+ */
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#include <string.h>
+
+#include "amrnbbankenc.h"
+#include "amrnbenc.h"
+
+/* maximum size of an encoded frame, including its header */
+#define MAX_FRAME_SIZE 32
+
+#define BANDMODE_DEFAULT MR122
+#define THREADS_DEFAULT 0
+enum
+{
+  PROP_0,
+  PROP_BANDMODE,
+  PROP_THREADS
+};
+
+static GstStaticPadTemplate sink_template = GST_STATIC_PAD_TEMPLATE ("sink",
+    GST_PAD_SINK,
+    GST_PAD_ALWAYS,
+    GST_STATIC_CAPS ("audio/x-raw, format = (string) " GST_AUDIO_NE (S16) ", "
+        "layout = (string) { interleaved, non-interleaved }, "
+        "rate = (int) 8000, "
+        "channels = (int) [ 1, "
+        G_STRINGIFY (GST_AMRNB_BANK_MAX_CHANNELS) " ]")
+    );
+
+static GstStaticPadTemplate src_template = GST_STATIC_PAD_TEMPLATE ("src",
+    GST_PAD_SRC,
+    GST_PAD_ALWAYS,
+    GST_STATIC_CAPS ("audio/AMR, " "rate = (int) 8000, "
+        "channels = (int) [ 1, " G_STRINGIFY (GST_AMRNB_BANK_MAX_CHANNELS) " ]")
+    );
+
+GST_DEBUG_CATEGORY_STATIC (gst_amrnbbankenc_debug);
+#define GST_CAT_DEFAULT gst_amrnbbankenc_debug
+
+static void gst_amrnbbankenc_finalize (GObject * object);
+static gboolean gst_amrnbbankenc_start (GstAudioEncoder * enc);
+static gboolean gst_amrnbbankenc_stop (GstAudioEncoder * enc);
+static gboolean gst_amrnbbankenc_set_format (GstAudioEncoder * enc,
+    GstAudioInfo * info);
+static GstFlowReturn gst_amrnbbankenc_handle_frame (GstAudioEncoder * enc,
+    GstBuffer * in_buf);
+static void gst_amrnbbankenc_flush (GstAudioEncoder * enc);
+
+#define gst_amrnbbankenc_parent_class parent_class
+G_DEFINE_TYPE (GstAmrnbBankEnc, gst_amrnbbankenc, GST_TYPE_AUDIO_ENCODER);
+
+static void
+gst_amrnbbankenc_set_property (GObject * object, guint prop_id,
+    const GValue * value, GParamSpec * pspec)
+{
+  GstAmrnbBankEnc *self = GST_AMRNBBANKENC (object);
+
+  switch (prop_id) {
+    case PROP_BANDMODE:
+      self->bandmode = g_value_get_enum (value);
+      break;
+    case PROP_THREADS:
+      self->threads = g_value_get_int (value);
+      break;
+    default:
+      G_OBJECT_WARN_INVALID_PROPERTY_ID (object, prop_id, pspec);
+      break;
+  }
+  return;
+}
+
+static void
+gst_amrnbbankenc_get_property (GObject * object, guint prop_id,
+    GValue * value, GParamSpec * pspec)
+{
+  GstAmrnbBankEnc *self = GST_AMRNBBANKENC (object);
+
+  switch (prop_id) {
+    case PROP_BANDMODE:
+      g_value_set_enum (value, self->bandmode);
+      break;
+    case PROP_THREADS:
+      g_value_set_int (value, self->threads);
+      break;
+    default:
+      G_OBJECT_WARN_INVALID_PROPERTY_ID (object, prop_id, pspec);
+      break;
+  }
+  return;
+}
+
+static void
+gst_amrnbbankenc_class_init (GstAmrnbBankEncClass * klass)
+{
+  GObjectClass *object_class = G_OBJECT_CLASS (klass);
+  GstElementClass *element_class = GST_ELEMENT_CLASS (klass);
+  GstAudioEncoderClass *base_class = GST_AUDIO_ENCODER_CLASS (klass);
+
+  object_class->set_property = gst_amrnbbankenc_set_property;
+  object_class->get_property = gst_amrnbbankenc_get_property;
+  object_class->finalize = gst_amrnbbankenc_finalize;
+
+  base_class->start = GST_DEBUG_FUNCPTR (gst_amrnbbankenc_start);
+  base_class->stop = GST_DEBUG_FUNCPTR (gst_amrnbbankenc_stop);
+  base_class->set_format = GST_DEBUG_FUNCPTR (gst_amrnbbankenc_set_format);
+  base_class->handle_frame = GST_DEBUG_FUNCPTR (gst_amrnbbankenc_handle_frame);
+  base_class->flush = GST_DEBUG_FUNCPTR (gst_amrnbbankenc_flush);
+
+  g_object_class_install_property (object_class, PROP_BANDMODE,
+      g_param_spec_enum ("band-mode", "Band Mode",
+          "Encoding Band Mode (Kbps)", GST_AMRNBENC_BANDMODE_TYPE,
+          BANDMODE_DEFAULT,
+          G_PARAM_READWRITE | G_PARAM_CONSTRUCT | G_PARAM_STATIC_STRINGS));
+  g_object_class_install_property (object_class, PROP_THREADS,
+      g_param_spec_int ("threads", "Threads",
+          "Number of threads encoding the channels (0 = number of CPUs)",
+          0, 64, THREADS_DEFAULT,
+          G_PARAM_READWRITE | G_PARAM_CONSTRUCT | G_PARAM_STATIC_STRINGS));
+
+  gst_element_class_add_static_pad_template (element_class, &sink_template);
+  gst_element_class_add_static_pad_template (element_class, &src_template);
+
+  gst_element_class_set_static_metadata (element_class,
+      "AMR-NB audio encoder bank", "Codec/Encoder/Audio",
+      "Adaptive Multi-Rate Narrow-Band encoder for many channels at once",
+      "GStreamer maintainers <gstreamer-devel@lists.freedesktop.org>");
+
+  GST_DEBUG_CATEGORY_INIT (gst_amrnbbankenc_debug, "amrnbbankenc", 0,
+      "AMR-NB audio encoder bank");
+}
+
+static void
+gst_amrnbbankenc_init (GstAmrnbBankEnc * self)
+{
+  GST_PAD_SET_ACCEPT_TEMPLATE (GST_AUDIO_ENCODER_SINK_PAD (self));
+
+  gst_amrnb_bank_init (&self->bank);
+}
+
+static void
+gst_amrnbbankenc_finalize (GObject * object)
+{
+  GstAmrnbBankEnc *self = GST_AMRNBBANKENC (object);
+
+  gst_amrnb_bank_clear (&self->bank);
+
+  G_OBJECT_CLASS (parent_class)->finalize (object);
+}
+
+static void
+gst_amrnbbankenc_free_channels (GstAmrnbBankEnc * self)
+{
+  gint i;
+
+  if (self->handles) {
+    for (i = 0; i < self->channels; i++) {
+      if (self->handles[i])
+        Encoder_Interface_exit (self->handles[i]);
+    }
+    g_free (self->handles);
+    self->handles = NULL;
+  }
+
+  g_free (self->samples);
+  self->samples = NULL;
+  g_free (self->frames);
+  self->frames = NULL;
+  g_free (self->sizes);
+  self->sizes = NULL;
+
+  self->channels = 0;
+  self->filled = 0;
+}
+
+static gboolean
+gst_amrnbbankenc_start (GstAudioEncoder * enc)
+{
+  GstAmrnbBankEnc *self = GST_AMRNBBANKENC (enc);
+
+  GST_DEBUG_OBJECT (self, "start");
+
+  return gst_amrnb_bank_start (&self->bank, self->threads);
+}
+
+static gboolean
+gst_amrnbbankenc_stop (GstAudioEncoder * enc)
+{
+  GstAmrnbBankEnc *self = GST_AMRNBBANKENC (enc);
+
+  GST_DEBUG_OBJECT (self, "stop");
+
+  gst_amrnb_bank_stop (&self->bank);
+  gst_amrnbbankenc_free_channels (self);
+
+  return TRUE;
+}
+
+static gboolean
+gst_amrnbbankenc_set_format (GstAudioEncoder * enc, GstAudioInfo * info)
+{
+  GstAmrnbBankEnc *self;
+  GstCaps *copy;
+  gint i, channels;
+
+  self = GST_AMRNBBANKENC (enc);
+
+  /* fresh codec states for the new calls */
+  gst_amrnbbankenc_free_channels (self);
+
+  /* parameters already parsed for us */
+  channels = GST_AUDIO_INFO_CHANNELS (info);
+  self->interleaved =
+      GST_AUDIO_INFO_LAYOUT (info) == GST_AUDIO_LAYOUT_INTERLEAVED;
+
+  self->handles = g_new0 (void *, channels);
+  self->channels = channels;
+  for (i = 0; i < channels; i++) {
+    if (!(self->handles[i] = Encoder_Interface_init (0)))
+      goto init_failed;
+  }
+
+  self->samples = g_new (gint16, channels * GST_AMRNB_BANK_FRAME_SAMPLES);
+  self->frames = g_new (guint8, channels * MAX_FRAME_SIZE);
+  self->sizes = g_new (gsize, channels);
+
+  GST_INFO_OBJECT (self, "encoding %d %s channels", channels,
+      self->interleaved ? "interleaved" : "non-interleaved");
+
+  /* create reverse caps */
+  copy = gst_caps_new_simple ("audio/AMR",
+      "channels", G_TYPE_INT, channels,
+      "rate", G_TYPE_INT, GST_AUDIO_INFO_RATE (info), NULL);
+
+  gst_audio_encoder_set_output_format (GST_AUDIO_ENCODER (self), copy);
+  gst_caps_unref (copy);
+
+  /* report needs to base class: hand us all available, we collect the
+   * samples of a tick per channel anyway, which also keeps non-interleaved
+   * buffers intact */
+  gst_audio_encoder_set_frame_samples_min (enc, 0);
+  gst_audio_encoder_set_frame_samples_max (enc, 0);
+  gst_audio_encoder_set_frame_max (enc, 0);
+
+  return TRUE;
+
+  /* ERRORS */
+init_failed:
+  {
+    GST_ERROR_OBJECT (self, "failed to create encoder for channel %d", i);
+    gst_amrnbbankenc_free_channels (self);
+    return FALSE;
+  }
+}
+
+static void
+gst_amrnbbankenc_flush (GstAudioEncoder * enc)
+{
+  GstAmrnbBankEnc *self = GST_AMRNBBANKENC (enc);
+
+  self->filled = 0;
+}
+
+/* runs in the threads of the bank */
+static void
+gst_amrnbbankenc_encode_channel (gpointer user_data, guint channel)
+{
+  GstAmrnbBankEnc *self = user_data;
+
+  self->sizes[channel] =
+      Encoder_Interface_Encode (self->handles[channel], self->bandmode,
+      self->samples + channel * GST_AMRNB_BANK_FRAME_SAMPLES,
+      self->frames + channel * MAX_FRAME_SIZE, 0);
+}
+
+/* encodes the collected tick and outputs one frame block */
+static GstFlowReturn
+gst_amrnbbankenc_encode_tick (GstAmrnbBankEnc * self)
+{
+  GstBuffer *out;
+  GstMapInfo out_map;
+  gsize out_size = 0;
+  gint i;
+
+  self->filled = 0;
+
+  gst_amrnb_bank_run (&self->bank, self->channels,
+      gst_amrnbbankenc_encode_channel, self);
+
+  for (i = 0; i < self->channels; i++)
+    out_size += self->sizes[i];
+
+  if (G_UNLIKELY (out_size == 0)) {
+    /* should not happen (without dtx or so at least) */
+    GST_WARNING_OBJECT (self, "no encoded data; discarding input");
+    return gst_audio_encoder_finish_frame (GST_AUDIO_ENCODER (self), NULL,
+        GST_AMRNB_BANK_FRAME_SAMPLES);
+  }
+
+  out = gst_buffer_new_and_alloc (out_size);
+  gst_buffer_map (out, &out_map, GST_MAP_WRITE);
+  out_size = 0;
+  for (i = 0; i < self->channels; i++) {
+    memcpy (out_map.data + out_size, self->frames + i * MAX_FRAME_SIZE,
+        self->sizes[i]);
+    out_size += self->sizes[i];
+  }
+  gst_buffer_unmap (out, &out_map);
+
+  GST_LOG_OBJECT (self, "output frame block size %" G_GSIZE_FORMAT, out_size);
+
+  return gst_audio_encoder_finish_frame (GST_AUDIO_ENCODER (self), out,
+      GST_AMRNB_BANK_FRAME_SAMPLES);
+}
+
+static GstFlowReturn
+gst_amrnbbankenc_handle_frame (GstAudioEncoder * enc, GstBuffer * buffer)
+{
+  GstAmrnbBankEnc *self;
+  GstFlowReturn ret = GST_FLOW_OK;
+  GstMapInfo in_map;
+  const gint16 *in;
+  gint channels, num_samples, pos, n, i, c;
+
+  self = GST_AMRNBBANKENC (enc);
+
+  g_return_val_if_fail (self->handles, GST_FLOW_NOT_NEGOTIATED);
+
+  /* we don't deal with squeezing remnants, so simply discard those */
+  if (G_UNLIKELY (buffer == NULL)) {
+    GST_DEBUG_OBJECT (self, "discarding trailing %d samples", self->filled);
+    if (self->filled > 0) {
+      n = self->filled;
+      self->filled = 0;
+      return gst_audio_encoder_finish_frame (enc, NULL, n);
+    }
+    return GST_FLOW_OK;
+  }
+
+  channels = self->channels;
+
+  gst_buffer_map (buffer, &in_map, GST_MAP_READ);
+  in = (const gint16 *) in_map.data;
+  num_samples = in_map.size / (2 * channels);
+
+  /* collect the samples of each channel, and encode whenever a tick is
+   * complete */
+  for (pos = 0; pos < num_samples && ret == GST_FLOW_OK; pos += n) {
+    n = MIN (num_samples - pos, GST_AMRNB_BANK_FRAME_SAMPLES - self->filled);
+
+    if (self->interleaved) {
+      const gint16 *src = in + pos * channels;
+
+      for (i = 0; i < n; i++) {
+        for (c = 0; c < channels; c++) {
+          self->samples[c * GST_AMRNB_BANK_FRAME_SAMPLES + self->filled + i] =
+              *src++;
+        }
+      }
+    } else {
+      for (c = 0; c < channels; c++) {
+        memcpy (self->samples + c * GST_AMRNB_BANK_FRAME_SAMPLES +
+            self->filled, in + c * num_samples + pos, n * 2);
+      }
+    }
+
+    self->filled += n;
+    if (self->filled == GST_AMRNB_BANK_FRAME_SAMPLES)
+      ret = gst_amrnbbankenc_encode_tick (self);
+  }
+
+  gst_buffer_unmap (buffer, &in_map);
+
+  return ret;
+}
@@ -0,0 +1,78 @@
+/* GStreamer Adaptive Multi-Rate Narrow-Band (AMR-NB) plugin
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Library General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Library General Public License for more details.
+ *
+ * You should have received a copy of the GNU Library General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 51 Franklin St, Fifth Floor,
+ * Boston, MA 02110-1301, USA.
+ */
+
+#ifndef __GST_AMRNBBANKENC_H__
+#define __GST_AMRNBBANKENC_H__
+
+#include <gst/gst.h>
+#include <gst/audio/gstaudioencoder.h>
+
+#include <opencore-amrnb/interf_enc.h>
+
+#include "amrnbbank.h"
+
+G_BEGIN_DECLS
+
+#define GST_TYPE_AMRNBBANKENC \
+  (gst_amrnbbankenc_get_type())
+#define GST_AMRNBBANKENC(obj) \
+  (G_TYPE_CHECK_INSTANCE_CAST((obj), GST_TYPE_AMRNBBANKENC, GstAmrnbBankEnc))
+#define GST_AMRNBBANKENC_CLASS(klass) \
+  (G_TYPE_CHECK_CLASS_CAST((klass), GST_TYPE_AMRNBBANKENC, GstAmrnbBankEncClass))
+#define GST_IS_AMRNBBANKENC(obj) \
+  (G_TYPE_CHECK_INSTANCE_TYPE((obj), GST_TYPE_AMRNBBANKENC))
+#define GST_IS_AMRNBBANKENC_CLASS(klass) \
+  (G_TYPE_CHECK_CLASS_TYPE((klass), GST_TYPE_AMRNBBANKENC))
+
+typedef struct _GstAmrnbBankEnc GstAmrnbBankEnc;
+typedef struct _GstAmrnbBankEncClass GstAmrnbBankEncClass;
+
+struct _GstAmrnbBankEnc {
+  GstAudioEncoder element;
+
+  /* library handles, one per channel */
+  void **handles;
+
+  /* input settings */
+  gint channels;
+  gboolean interleaved;
+
+  /* samples of the current tick, one array per channel */
+  gint16 *samples;
+  gint filled;
+
+  /* encoded frames of the current tick */
+  guint8 *frames;
+  gsize *sizes;
+
+  GstAmrnbBank bank;
+
+  /* properties */
+  enum Mode bandmode;
+  gint threads;
+};
+
+struct _GstAmrnbBankEncClass {
+  GstAudioEncoderClass parent_class;
+};
+
+GType gst_amrnbbankenc_get_type (void);
+
+G_END_DECLS
+
+#endif /* __GST_AMRNBBANKENC_H__ */
@@ -29,7 +29,15 @@
  * |[
  * gst-launch-1.0 filesrc location=abc.amr ! amrparse ! amrnbdec ! audioconvert ! audioresample ! autoaudiosink
  * ]|
+ * |[
+ * gst-launch-1.0 filesrc location=abc.amr ! amrparse ! amrnbdec max-frames=250 ! audioconvert ! vorbisenc ! oggmux ! filesink location=abc.ogg
+ * ]| Transcode, decoding up to 5 seconds of audio into one buffer
  * </refsect2>
+ *
+ * With #GstAmrnbDec:max-frames larger than 1, the decoder collects that many
+ * frames, or all remaining ones at the end of the stream, and decodes them
+ * into one output buffer. This cuts the per-buffer overhead for offline
+ * transcoding at the cost of that much latency.
  */
 
 #ifdef HAVE_CONFIG_H
@@ -82,10 +90,12 @@ gst_amrnb_variant_get_type (void)
 #define GST_AMRNB_VARIANT_TYPE (gst_amrnb_variant_get_type())
 
 #define VARIANT_DEFAULT GST_AMRNB_VARIANT_IF1
+#define MAX_FRAMES_DEFAULT 1
 enum
 {
   PROP_0,
-  PROP_VARIANT
+  PROP_VARIANT,
+  PROP_MAX_FRAMES
 };
 
 static void gst_amrnbdec_set_property (GObject * object, guint prop_id,
@@ -95,6 +105,7 @@ static void gst_amrnbdec_get_property (GObject * object, guint prop_id,
 
 static gboolean gst_amrnbdec_start (GstAudioDecoder * dec);
 static gboolean gst_amrnbdec_stop (GstAudioDecoder * dec);
+static void gst_amrnbdec_flush (GstAudioDecoder * dec, gboolean hard);
 static gboolean gst_amrnbdec_set_format (GstAudioDecoder * dec, GstCaps * caps);
 static GstFlowReturn gst_amrnbdec_parse (GstAudioDecoder * dec,
     GstAdapter * adapter, gint * offset, gint * length);
@@ -124,6 +135,7 @@ gst_amrnbdec_class_init (GstAmrnbDecClass * klass)
 
   base_class->start = GST_DEBUG_FUNCPTR (gst_amrnbdec_start);
   base_class->stop = GST_DEBUG_FUNCPTR (gst_amrnbdec_stop);
+  base_class->flush = GST_DEBUG_FUNCPTR (gst_amrnbdec_flush);
   base_class->set_format = GST_DEBUG_FUNCPTR (gst_amrnbdec_set_format);
   base_class->parse = GST_DEBUG_FUNCPTR (gst_amrnbdec_parse);
   base_class->handle_frame = GST_DEBUG_FUNCPTR (gst_amrnbdec_handle_frame);
@@ -133,6 +145,11 @@ gst_amrnbdec_class_init (GstAmrnbDecClass * klass)
           "The decoder variant", GST_AMRNB_VARIANT_TYPE,
           VARIANT_DEFAULT,
           G_PARAM_READWRITE | G_PARAM_CONSTRUCT | G_PARAM_STATIC_STRINGS));
+  g_object_class_install_property (object_class, PROP_MAX_FRAMES,
+      g_param_spec_uint ("max-frames", "Max frames",
+          "Maximum number of frames to decode into one output buffer",
+          1, 65536, MAX_FRAMES_DEFAULT,
+          G_PARAM_READWRITE | G_PARAM_CONSTRUCT | G_PARAM_STATIC_STRINGS));
 
   GST_DEBUG_CATEGORY_INIT (gst_amrnbdec_debug, "amrnbdec", 0,
       "AMR-NB audio decoder");
@@ -158,6 +175,8 @@ gst_amrnbdec_start (GstAudioDecoder * dec)
 
   amrnbdec->rate = 0;
   amrnbdec->channels = 0;
+  amrnbdec->parse_frames = 0;
+  amrnbdec->parse_len = 0;
 
   return TRUE;
 }
@@ -173,6 +192,15 @@ gst_amrnbdec_stop (GstAudioDecoder * dec)
   return TRUE;
 }
 
+static void
+gst_amrnbdec_flush (GstAudioDecoder * dec, gboolean hard)
+{
+  GstAmrnbDec *amrnbdec = GST_AMRNBDEC (dec);
+
+  amrnbdec->parse_frames = 0;
+  amrnbdec->parse_len = 0;
+}
+
 static void
 gst_amrnbdec_set_property (GObject * object, guint prop_id,
     const GValue * value, GParamSpec * pspec)
@@ -183,6 +211,9 @@ gst_amrnbdec_set_property (GObject * object, guint prop_id,
     case PROP_VARIANT:
       self->variant = g_value_get_enum (value);
       break;
+    case PROP_MAX_FRAMES:
+      self->max_frames = g_value_get_uint (value);
+      break;
     default:
       G_OBJECT_WARN_INVALID_PROPERTY_ID (object, prop_id, pspec);
       break;
@@ -200,6 +231,9 @@ gst_amrnbdec_get_property (GObject * object, guint prop_id,
     case PROP_VARIANT:
       g_value_set_enum (value, self->variant);
       break;
+    case PROP_MAX_FRAMES:
+      g_value_set_uint (value, self->max_frames);
+      break;
     default:
       G_OBJECT_WARN_INVALID_PROPERTY_ID (object, prop_id, pspec);
       break;
@@ -213,6 +247,7 @@ gst_amrnbdec_set_format (GstAudioDecoder * dec, GstCaps * caps)
   GstStructure *structure;
   GstAmrnbDec *amrnbdec;
   GstAudioInfo info;
+  GstClockTime latency;
 
   amrnbdec = GST_AMRNBDEC (dec);
 
@@ -227,53 +262,75 @@ gst_amrnbdec_set_format (GstAudioDecoder * dec, GstCaps * caps)
   gst_audio_info_set_format (&info,
       GST_AUDIO_FORMAT_S16, amrnbdec->rate, amrnbdec->channels, NULL);
 
+  latency = (amrnbdec->max_frames - 1) * 20 * GST_MSECOND;
+  gst_audio_decoder_set_latency (dec, latency, latency);
+
   return gst_audio_decoder_set_output_format (dec, &info);
 }
 
+/* returns the size of the frame starting with head, including the header */
+static gint
+gst_amrnbdec_frame_size (GstAmrnbDec * amrnbdec, guint8 head)
+{
+  switch (amrnbdec->variant) {
+    case GST_AMRNB_VARIANT_IF1:
+      return block_size_if1[(head >> 3) & 0x0F] + 1;
+    case GST_AMRNB_VARIANT_IF2:
+      return block_size_if2[head & 0x0F] + 1;
+    default:
+      g_assert_not_reached ();
+      return 1;
+  }
+}
+
 static GstFlowReturn
 gst_amrnbdec_parse (GstAudioDecoder * dec, GstAdapter * adapter,
     gint * offset, gint * length)
 {
   GstAmrnbDec *amrnbdec = GST_AMRNBDEC (dec);
-  guint8 head[1];
-  guint size;
+  guint8 head;
+  guint size, frames;
   gboolean sync, eos;
-  gint block, mode;
+  gint block, len;
 
   size = gst_adapter_available (adapter);
   g_return_val_if_fail (size > 0, GST_FLOW_ERROR);
 
   gst_audio_decoder_get_parse_state (dec, &sync, &eos);
 
-  /* need to peek data to get the size */
-  if (size < 1)
-    return GST_FLOW_ERROR;
-
-  gst_adapter_copy (adapter, head, 0, 1);
+  /* take as many complete frames as available, up to max-frames; while
+   * waiting for a full batch, continue after the frames found by the
+   * previous call instead of scanning the whole batch again */
+  if (amrnbdec->parse_len > size) {
+    amrnbdec->parse_frames = 0;
+    amrnbdec->parse_len = 0;
+  }
+  frames = amrnbdec->parse_frames;
+  len = amrnbdec->parse_len;
 
-  /* get size */
-  switch (amrnbdec->variant) {
-    case GST_AMRNB_VARIANT_IF1:
-      mode = (head[0] >> 3) & 0x0F;
-      block = block_size_if1[mode] + 1;
-      break;
-    case GST_AMRNB_VARIANT_IF2:
-      mode = head[0] & 0x0F;
-      block = block_size_if2[mode] + 1;
-      break;
-    default:
-      g_assert_not_reached ();
-      return GST_FLOW_ERROR;
+  while (frames < amrnbdec->max_frames && len < size) {
+    gst_adapter_copy (adapter, &head, len, 1);
+    block = gst_amrnbdec_frame_size (amrnbdec, head);
+    if (len + block > size)
       break;
+    len += block;
+    frames++;
   }
 
-  GST_DEBUG_OBJECT (amrnbdec, "mode %d, block %d", mode, block);
+  GST_LOG_OBJECT (amrnbdec, "%u frames, %d bytes", frames, len);
 
-  if (block > size)
+  /* wait for a full batch, unless this is all we will get */
+  if (len == 0 || (frames < amrnbdec->max_frames && !eos)) {
+    amrnbdec->parse_frames = frames;
+    amrnbdec->parse_len = len;
     return GST_FLOW_EOS;
+  }
+
+  amrnbdec->parse_frames = 0;
+  amrnbdec->parse_len = 0;
 
   *offset = 0;
-  *length = block;
+  *length = len;
 
   return GST_FLOW_OK;
 }
@@ -284,6 +341,9 @@ gst_amrnbdec_handle_frame (GstAudioDecoder * dec, GstBuffer * buffer)
   GstAmrnbDec *amrnbdec;
   GstMapInfo inmap, outmap;
   GstBuffer *out;
+  gsize pos;
+  guint frames;
+  gint16 *samples;
 
   amrnbdec = GST_AMRNBDEC (dec);
 
@@ -293,12 +353,20 @@ gst_amrnbdec_handle_frame (GstAudioDecoder * dec, GstBuffer * buffer)
 
   gst_buffer_map (buffer, &inmap, GST_MAP_READ);
 
+  /* parse gave us complete frames only */
+  frames = 0;
+  for (pos = 0; pos < inmap.size; frames++)
+    pos += gst_amrnbdec_frame_size (amrnbdec, inmap.data[pos]);
+
   /* get output */
-  out = gst_buffer_new_and_alloc (160 * 2);
+  out = gst_audio_decoder_allocate_output_buffer (dec, frames * 160 * 2);
   /* decode */
   gst_buffer_map (out, &outmap, GST_MAP_WRITE);
-  Decoder_Interface_Decode (amrnbdec->handle, inmap.data,
-      (gint16 *) outmap.data, 0);
+  samples = (gint16 *) outmap.data;
+  for (pos = 0; pos < inmap.size; samples += 160) {
+    Decoder_Interface_Decode (amrnbdec->handle, inmap.data + pos, samples, 0);
+    pos += gst_amrnbdec_frame_size (amrnbdec, inmap.data[pos]);
+  }
   gst_buffer_unmap (out, &outmap);
 
   gst_buffer_unmap (buffer, &inmap);
@@ -40,7 +40,7 @@
 
 #include "amrnbenc.h"
 
-static GType
+GType
 gst_amrnbenc_bandmode_get_type (void)
 {
   static GType gst_amrnbenc_bandmode_type = 0;
@@ -63,8 +63,6 @@ gst_amrnbenc_bandmode_get_type (void)
   return gst_amrnbenc_bandmode_type;
 }
 
-#define GST_AMRNBENC_BANDMODE_TYPE (gst_amrnbenc_bandmode_get_type())
-
 #define BANDMODE_DEFAULT MR122
 enum
 {
@@ -38,6 +38,8 @@ G_BEGIN_DECLS
 #define GST_IS_AMRNBENC_CLASS(klass) \
   (G_TYPE_CHECK_CLASS_TYPE((klass), GST_TYPE_AMRNBENC))
 
+#define GST_AMRNBENC_BANDMODE_TYPE (gst_amrnbenc_bandmode_get_type())
+
 typedef struct _GstAmrnbEnc GstAmrnbEnc;
 typedef struct _GstAmrnbEncClass GstAmrnbEncClass;
 
@@ -60,6 +62,7 @@ struct _GstAmrnbEncClass {
 };
 
 GType gst_amrnbenc_get_type (void);
+GType gst_amrnbenc_bandmode_get_type (void);
 
 G_END_DECLS
 
@@ -29,7 +29,15 @@
  * |[
  * gst-launch-1.0 filesrc location=abc.amr ! amrparse ! amrwbdec ! audioconvert ! audioresample ! autoaudiosink
  * ]|
+ * |[
+ * gst-launch-1.0 filesrc location=abc.amr ! amrparse ! amrwbdec max-frames=250 ! audioconvert ! vorbisenc ! oggmux ! filesink location=abc.ogg
+ * ]| Transcode, decoding up to 5 seconds of audio into one buffer
  * </refsect2>
+ *
+ * With #GstAmrwbDec:max-frames larger than 1, the decoder collects that many
+ * frames, or all remaining ones at the end of the stream, and decodes them
+ * into one output buffer. This cuts the per-buffer overhead for offline
+ * transcoding at the cost of that much latency.
  */
 
 #ifdef HAVE_CONFIG_H
@@ -66,8 +74,21 @@ static const unsigned char block_size[16] =
   6, 0, 0, 0, 0, 1, 1
 };
 
+#define MAX_FRAMES_DEFAULT 1
+enum
+{
+  PROP_0,
+  PROP_MAX_FRAMES
+};
+
+static void gst_amrwbdec_set_property (GObject * object, guint prop_id,
+    const GValue * value, GParamSpec * pspec);
+static void gst_amrwbdec_get_property (GObject * object, guint prop_id,
+    GValue * value, GParamSpec * pspec);
+
 static gboolean gst_amrwbdec_start (GstAudioDecoder * dec);
 static gboolean gst_amrwbdec_stop (GstAudioDecoder * dec);
+static void gst_amrwbdec_flush (GstAudioDecoder * dec, gboolean hard);
 static gboolean gst_amrwbdec_set_format (GstAudioDecoder * dec, GstCaps * caps);
 static GstFlowReturn gst_amrwbdec_parse (GstAudioDecoder * dec,
     GstAdapter * adapter, gint * offset, gint * length);
@@ -80,9 +101,13 @@ G_DEFINE_TYPE (GstAmrwbDec, gst_amrwbdec, GST_TYPE_AUDIO_DECODER);
 static void
 gst_amrwbdec_class_init (GstAmrwbDecClass * klass)
 {
+  GObjectClass *object_class = G_OBJECT_CLASS (klass);
   GstAudioDecoderClass *base_class = GST_AUDIO_DECODER_CLASS (klass);
   GstElementClass *element_class = GST_ELEMENT_CLASS (klass);
 
+  object_class->set_property = gst_amrwbdec_set_property;
+  object_class->get_property = gst_amrwbdec_get_property;
+
   gst_element_class_add_static_pad_template (element_class, &sink_template);
   gst_element_class_add_static_pad_template (element_class, &src_template);
 
@@ -93,10 +118,17 @@ gst_amrwbdec_class_init (GstAmrwbDecClass * klass)
 
   base_class->start = GST_DEBUG_FUNCPTR (gst_amrwbdec_start);
   base_class->stop = GST_DEBUG_FUNCPTR (gst_amrwbdec_stop);
+  base_class->flush = GST_DEBUG_FUNCPTR (gst_amrwbdec_flush);
   base_class->set_format = GST_DEBUG_FUNCPTR (gst_amrwbdec_set_format);
   base_class->parse = GST_DEBUG_FUNCPTR (gst_amrwbdec_parse);
   base_class->handle_frame = GST_DEBUG_FUNCPTR (gst_amrwbdec_handle_frame);
 
+  g_object_class_install_property (object_class, PROP_MAX_FRAMES,
+      g_param_spec_uint ("max-frames", "Max frames",
+          "Maximum number of frames to decode into one output buffer",
+          1, 65536, MAX_FRAMES_DEFAULT,
+          G_PARAM_READWRITE | G_PARAM_CONSTRUCT | G_PARAM_STATIC_STRINGS));
+
   GST_DEBUG_CATEGORY_INIT (gst_amrwbdec_debug, "amrwbdec", 0,
       "AMR-WB audio decoder");
 }
@@ -121,6 +153,8 @@ gst_amrwbdec_start (GstAudioDecoder * dec)
 
   amrwbdec->rate = 0;
   amrwbdec->channels = 0;
+  amrwbdec->parse_frames = 0;
+  amrwbdec->parse_len = 0;
 
   return TRUE;
 }
@@ -136,12 +170,54 @@ gst_amrwbdec_stop (GstAudioDecoder * dec)
   return TRUE;
 }
 
+static void
+gst_amrwbdec_flush (GstAudioDecoder * dec, gboolean hard)
+{
+  GstAmrwbDec *amrwbdec = GST_AMRWBDEC (dec);
+
+  amrwbdec->parse_frames = 0;
+  amrwbdec->parse_len = 0;
+}
+
+static void
+gst_amrwbdec_set_property (GObject * object, guint prop_id,
+    const GValue * value, GParamSpec * pspec)
+{
+  GstAmrwbDec *self = GST_AMRWBDEC (object);
+
+  switch (prop_id) {
+    case PROP_MAX_FRAMES:
+      self->max_frames = g_value_get_uint (value);
+      break;
+    default:
+      G_OBJECT_WARN_INVALID_PROPERTY_ID (object, prop_id, pspec);
+      break;
+  }
+}
+
+static void
+gst_amrwbdec_get_property (GObject * object, guint prop_id,
+    GValue * value, GParamSpec * pspec)
+{
+  GstAmrwbDec *self = GST_AMRWBDEC (object);
+
+  switch (prop_id) {
+    case PROP_MAX_FRAMES:
+      g_value_set_uint (value, self->max_frames);
+      break;
+    default:
+      G_OBJECT_WARN_INVALID_PROPERTY_ID (object, prop_id, pspec);
+      break;
+  }
+}
+
 static gboolean
 gst_amrwbdec_set_format (GstAudioDecoder * dec, GstCaps * caps)
 {
   GstStructure *structure;
   GstAmrwbDec *amrwbdec;
   GstAudioInfo info;
+  GstClockTime latency;
 
   amrwbdec = GST_AMRWBDEC (dec);
 
@@ -156,6 +232,9 @@ gst_amrwbdec_set_format (GstAudioDecoder * dec, GstCaps * caps)
   gst_audio_info_set_format (&info,
       GST_AUDIO_FORMAT_S16, amrwbdec->rate, amrwbdec->channels, NULL);
 
+  latency = (amrwbdec->max_frames - 1) * 20 * GST_MSECOND;
+  gst_audio_decoder_set_latency (dec, latency, latency);
+
   gst_audio_decoder_set_output_format (dec, &info);
 
   return TRUE;
@@ -166,38 +245,59 @@ gst_amrwbdec_parse (GstAudioDecoder * dec, GstAdapter * adapter,
     gint * offset, gint * length)
 {
   GstAmrwbDec *amrwbdec = GST_AMRWBDEC (dec);
-  guint8 header[1];
-  guint size;
+  guint8 head;
+  guint size, frames;
   gboolean sync, eos;
-  gint block, mode;
+  gint block = 0, mode, len;
 
   size = gst_adapter_available (adapter);
   g_return_val_if_fail (size > 0, GST_FLOW_ERROR);
 
   gst_audio_decoder_get_parse_state (dec, &sync, &eos);
 
-  /* need to peek data to get the size */
-  if (size < 1)
-    return GST_FLOW_ERROR;
-
-  gst_adapter_copy (adapter, header, 0, 1);
-  mode = (header[0] >> 3) & 0x0F;
-  block = block_size[mode];
+  /* take as many complete frames as available, up to max-frames; while
+   * waiting for a full batch, continue after the frames found by the
+   * previous call instead of scanning the whole batch again */
+  if (amrwbdec->parse_len > size) {
+    amrwbdec->parse_frames = 0;
+    amrwbdec->parse_len = 0;
+  }
+  frames = amrwbdec->parse_frames;
+  len = amrwbdec->parse_len;
+
+  while (frames < amrwbdec->max_frames && len < size) {
+    gst_adapter_copy (adapter, &head, len, 1);
+    mode = (head >> 3) & 0x0F;
+    block = block_size[mode];
+    if (block == 0 || len + block > size)
+      break;
+    len += block;
+    frames++;
+  }
 
-  GST_DEBUG_OBJECT (amrwbdec, "mode %d, block %d", mode, block);
+  GST_LOG_OBJECT (amrwbdec, "%u frames, %d bytes", frames, len);
 
-  if (block) {
-    if (block > size)
-      return GST_FLOW_EOS;
-    *offset = 0;
-    *length = block;
-  } else {
+  if (len == 0 && block == 0) {
     /* no frame yet, skip one byte */
     GST_LOG_OBJECT (amrwbdec, "skipping byte");
     *offset = 1;
     return GST_FLOW_EOS;
   }
 
+  /* wait for a full batch, unless this is all we will get or an invalid
+   * frame follows */
+  if (len == 0 || (frames < amrwbdec->max_frames && block != 0 && !eos)) {
+    amrwbdec->parse_frames = frames;
+    amrwbdec->parse_len = len;
+    return GST_FLOW_EOS;
+  }
+
+  amrwbdec->parse_frames = 0;
+  amrwbdec->parse_len = 0;
+
+  *offset = 0;
+  *length = len;
+
   return GST_FLOW_OK;
 }
 
@@ -207,6 +307,9 @@ gst_amrwbdec_handle_frame (GstAudioDecoder * dec, GstBuffer * buffer)
   GstAmrwbDec *amrwbdec;
   GstBuffer *out;
   GstMapInfo inmap, outmap;
+  gsize pos;
+  guint frames;
+  short int *samples;
 
   amrwbdec = GST_AMRWBDEC (dec);
 
@@ -218,13 +321,23 @@ gst_amrwbdec_handle_frame (GstAudioDecoder * dec, GstBuffer * buffer)
   /* should be no problem */
   gst_buffer_map (buffer, &inmap, GST_MAP_READ);
 
+  /* parse gave us complete frames only */
+  frames = 0;
+  for (pos = 0; pos < inmap.size; frames++)
+    pos += block_size[(inmap.data[pos] >> 3) & 0x0F];
+
   /* get output */
-  out = gst_buffer_new_and_alloc (sizeof (gint16) * L_FRAME16k);
+  out = gst_audio_decoder_allocate_output_buffer (dec,
+      frames * sizeof (gint16) * L_FRAME16k);
   gst_buffer_map (out, &outmap, GST_MAP_WRITE);
 
   /* decode */
-  D_IF_decode (amrwbdec->handle, (unsigned char *) inmap.data,
-      (short int *) outmap.data, _good_frame);
+  samples = (short int *) outmap.data;
+  for (pos = 0; pos < inmap.size; samples += L_FRAME16k) {
+    D_IF_decode (amrwbdec->handle, (unsigned char *) inmap.data + pos,
+        samples, _good_frame);
+    pos += block_size[(inmap.data[pos] >> 3) & 0x0F];
+  }
 
   gst_buffer_unmap (out, &outmap);
   gst_buffer_unmap (buffer, &inmap);
@@ -55,6 +55,13 @@ struct _GstAmrwbDec {
 
   /* output settings */
   gint channels, rate;
+
+  /* property */
+  guint max_frames;
+
+  /* complete frames found in the adapter so far, while waiting for a batch */
+  guint parse_frames;
+  gint parse_len;
 };
 
 struct _GstAmrwbDecClass {
@@ -51,6 +51,15 @@
  * posted on the bus as part of the tag messages.
  * </para>
  * <para>
+ * If the #GstCdioCddaSrc:checksums property is set, the element computes
+ * a CRC32 and the AccurateRip v1 and v2 checksums of each track while it
+ * is being read, and posts them on the bus in a "cdio-track-checksums"
+ * element message once the last sector of the track has been read. The
+ * message contains the fields "track" (G_TYPE_UINT), "crc32",
+ * "accuraterip-v1" and "accuraterip-v2" (all G_TYPE_UINT). No message is
+ * posted for tracks that were not read from start to end in one go.
+ * </para>
+ * <para>
  * cdiocddasrc supports the GstUriHandler interface, so applications can use
  * playbin with cdda://&lt;track-number&gt; URIs for playback (they will have
  * to connect to playbin's notify::source signal and set the device on the
@@ -88,11 +97,17 @@
 #define SAMPLES_PER_SECTOR (CDIO_CD_FRAMESIZE_RAW / sizeof (gint16))
 
 #define DEFAULT_READ_SPEED   -1
+#define DEFAULT_READ_AHEAD   1
+#define DEFAULT_CHECKSUMS    FALSE
+
+#define MAX_READ_AHEAD       1024
 
 enum
 {
   PROP_0 = 0,
-  PROP_READ_SPEED
+  PROP_READ_SPEED,
+  PROP_READ_AHEAD,
+  PROP_CHECKSUMS
 };
 
 G_DEFINE_TYPE (GstCdioCddaSrc, gst_cdio_cdda_src, GST_TYPE_AUDIO_CD_SRC);
@@ -167,43 +182,190 @@ empty_devices:
 }
 #endif
 
-static GstBuffer *
-gst_cdio_cdda_src_read_sector (GstAudioCdSrc * audiocdsrc, gint sector)
+/* swaps the byte order of all 16-bit samples in data; processes two samples
+ * at a time, which compilers turn into vector byte shuffles */
+static void
+gst_cdio_cdda_src_swap_samples (guint8 * data, gsize size)
 {
-  GstCdioCddaSrc *src;
-  guint8 *data;
+  guint32 *pcm_data = (guint32 *) data;
+  gsize i, n;
 
-  src = GST_CDIO_CDDA_SRC (audiocdsrc);
+  n = size / sizeof (guint32);
+
+  for (i = 0; i < n; ++i) {
+    guint32 v = pcm_data[i];
+
+    pcm_data[i] = ((v & 0x00ff00ff) << 8) | ((v & 0xff00ff00) >> 8);
+  }
+}
+
+/* returns the index of the audio track containing @sector, or -1 */
+static gint
+gst_cdio_cdda_src_find_track (GstCdioCddaSrc * src, gint sector)
+{
+  gint i;
+
+  for (i = 0; i < src->num_tracks; ++i) {
+    if (sector >= src->track_starts[i] && sector <= src->track_ends[i])
+      return i;
+  }
+
+  return -1;
+}
+
+/* returns the last sector of the audio track containing @sector, or -1 */
+static gint
+gst_cdio_cdda_src_get_track_end (GstCdioCddaSrc * src, gint sector)
+{
+  gint i;
+
+  i = gst_cdio_cdda_src_find_track (src, sector);
+
+  return (i >= 0) ? src->track_ends[i] : -1;
+}
+
+static void
+gst_cdio_cdda_src_update_checksums (GstCdioCddaSrc * src, gint sector,
+    const guint8 * data)
+{
+  GstStructure *s;
+  gint t;
+
+  t = gst_cdio_cdda_src_find_track (src, sector);
+  if (t < 0)
+    return;
+
+  if (sector == src->track_starts[t]) {
+    guint32 num_samples;
+
+    num_samples = (src->track_ends[t] - src->track_starts[t] + 1) *
+        SAMPLES_PER_SECTOR / 2;
+    gst_cdio_checksum_init (&src->csum, num_samples, t == 0,
+        t == src->num_tracks - 1);
+    src->csum_track = t;
+  } else if (src->csum_track != t || sector != src->csum_next_sector) {
+    if (src->csum_track >= 0) {
+      GST_DEBUG_OBJECT (src, "non-contiguous read at sector %d, no checksums "
+          "for track %d", sector, src->track_nums[src->csum_track]);
+    }
+    src->csum_track = -1;
+    return;
+  }
+
+  gst_cdio_checksum_update (&src->csum, data, CDIO_CD_FRAMESIZE_RAW);
+  src->csum_next_sector = sector + 1;
+
+  if (sector < src->track_ends[t])
+    return;
+
+  s = gst_structure_new ("cdio-track-checksums",
+      "track", G_TYPE_UINT, (guint) src->track_nums[t],
+      "crc32", G_TYPE_UINT, gst_cdio_checksum_get_crc32 (&src->csum),
+      "accuraterip-v1", G_TYPE_UINT, src->csum.ar_v1,
+      "accuraterip-v2", G_TYPE_UINT, src->csum.ar_v2, NULL);
+
+  GST_INFO_OBJECT (src, "track checksums: %" GST_PTR_FORMAT, s);
+
+  gst_element_post_message (GST_ELEMENT_CAST (src),
+      gst_message_new_element (GST_OBJECT_CAST (src), s));
+
+  src->csum_track = -1;
+}
+
+static void
+gst_cdio_cdda_src_clear_cache (GstCdioCddaSrc * src)
+{
+  if (src->cache) {
+    gst_buffer_unref (src->cache);
+    src->cache = NULL;
+  }
+  src->cache_start = 0;
+  src->cache_len = 0;
+}
+
+/* reads up to read-ahead sectors starting at @sector into the cache with one
+ * libcdio call, without reading past the end of the current track */
+static gboolean
+gst_cdio_cdda_src_fill_cache (GstCdioCddaSrc * src, gint sector)
+{
+  GstBuffer *buf;
+  GstMapInfo map;
+  gint num_sectors, track_end;
+
+  gst_cdio_cdda_src_clear_cache (src);
 
-  data = g_malloc (CDIO_CD_FRAMESIZE_RAW);
+  num_sectors = g_atomic_int_get (&src->read_ahead);
+  track_end = gst_cdio_cdda_src_get_track_end (src, sector);
+  if (track_end >= sector)
+    num_sectors = MIN (num_sectors, track_end - sector + 1);
+  else
+    num_sectors = 1;
 
   /* can't use pad_alloc because we can't return the GstFlowReturn (FIXME 0.11) */
-  if (cdio_read_audio_sector (src->cdio, data, sector) != 0)
+  buf = gst_buffer_new_allocate (NULL, num_sectors * CDIO_CD_FRAMESIZE_RAW,
+      NULL);
+  gst_buffer_map (buf, &map, GST_MAP_WRITE);
+
+  if (cdio_read_audio_sectors (src->cdio, map.data, sector, num_sectors) != 0)
     goto read_failed;
 
-  if (src->swap_le_be) {
-    gint16 *pcm_data = (gint16 *) data;
-    gint i;
+  if (src->swap_le_be)
+    gst_cdio_cdda_src_swap_samples (map.data, map.size);
 
-    for (i = 0; i < SAMPLES_PER_SECTOR; ++i)
-      pcm_data[i] = GUINT16_SWAP_LE_BE (pcm_data[i]);
-  }
+  gst_buffer_unmap (buf, &map);
 
-  return gst_buffer_new_wrapped (data, CDIO_CD_FRAMESIZE_RAW);
+  GST_LOG_OBJECT (src, "read %d sectors at %d", num_sectors, sector);
+
+  src->cache = buf;
+  src->cache_start = sector;
+  src->cache_len = num_sectors;
+
+  return TRUE;
 
   /* ERRORS */
 read_failed:
   {
-    GST_WARNING_OBJECT (src, "read at sector %d failed!", sector);
+    GST_WARNING_OBJECT (src, "read of %d sectors at sector %d failed!",
+        num_sectors, sector);
     GST_ELEMENT_ERROR (src, RESOURCE, READ,
         (_("Could not read from CD.")),
-        ("cdio_read_audio_sector at %d failed: %s", sector,
+        ("cdio_read_audio_sectors at %d failed: %s", sector,
             g_strerror (errno)));
-    g_free (data);
-    return NULL;
+    gst_buffer_unmap (buf, &map);
+    gst_buffer_unref (buf);
+    return FALSE;
   }
 }
 
+static GstBuffer *
+gst_cdio_cdda_src_read_sector (GstAudioCdSrc * audiocdsrc, gint sector)
+{
+  GstCdioCddaSrc *src;
+  gsize offset;
+
+  src = GST_CDIO_CDDA_SRC (audiocdsrc);
+
+  if (src->cache == NULL || sector < src->cache_start ||
+      sector >= src->cache_start + src->cache_len) {
+    if (!gst_cdio_cdda_src_fill_cache (src, sector))
+      return NULL;
+  }
+
+  offset = (sector - src->cache_start) * CDIO_CD_FRAMESIZE_RAW;
+
+  if (src->checksums) {
+    GstMapInfo map;
+
+    gst_buffer_map (src->cache, &map, GST_MAP_READ);
+    gst_cdio_cdda_src_update_checksums (src, sector, map.data + offset);
+    gst_buffer_unmap (src->cache, &map);
+  }
+
+  /* sectors handed out share the memory of the read-ahead buffer */
+  return gst_buffer_copy_region (src->cache, GST_BUFFER_COPY_MEMORY, offset,
+      CDIO_CD_FRAMESIZE_RAW);
+}
+
 static gboolean
 gst_cdio_cdda_src_do_detect_drive_endianness (GstCdioCddaSrc * src, gint from,
     gint to)
@@ -361,6 +523,11 @@ gst_cdio_cdda_src_open (GstAudioCdSrc * audiocdsrc, const gchar * device)
 
   GST_LOG_OBJECT (src, "%u tracks, first track: %d", num_tracks, first_track);
 
+  src->num_tracks = 0;
+  src->track_nums = g_new0 (gint, num_tracks);
+  src->track_starts = g_new0 (gint, num_tracks);
+  src->track_ends = g_new0 (gint, num_tracks);
+
   for (i = 0; i < num_tracks; ++i) {
     GstAudioCdSrcTrack track = { 0, };
     gint len_sectors;
@@ -378,6 +545,11 @@ gst_cdio_cdda_src_open (GstAudioCdSrc * audiocdsrc, const gchar * device)
     if (track.is_audio) {
       first_audio_sector = MIN (first_audio_sector, track.start);
       last_audio_sector = MAX (last_audio_sector, track.end);
+
+      src->track_nums[src->num_tracks] = track.num;
+      src->track_starts[src->num_tracks] = track.start;
+      src->track_ends[src->num_tracks] = track.end;
+      ++src->num_tracks;
     }
 #if LIBCDIO_VERSION_NUM > 83
     if (NULL != cdtext)
@@ -423,6 +595,17 @@ gst_cdio_cdda_src_close (GstAudioCdSrc * audiocdsrc)
 {
   GstCdioCddaSrc *src = GST_CDIO_CDDA_SRC (audiocdsrc);
 
+  gst_cdio_cdda_src_clear_cache (src);
+
+  g_free (src->track_nums);
+  src->track_nums = NULL;
+  g_free (src->track_starts);
+  src->track_starts = NULL;
+  g_free (src->track_ends);
+  src->track_ends = NULL;
+  src->num_tracks = 0;
+  src->csum_track = -1;
+
   if (src->cdio) {
     cdio_destroy (src->cdio);
     src->cdio = NULL;
@@ -433,6 +616,9 @@ static void
 gst_cdio_cdda_src_init (GstCdioCddaSrc * src)
 {
   src->read_speed = DEFAULT_READ_SPEED; /* don't need atomic access here */
+  src->read_ahead = DEFAULT_READ_AHEAD;
+  src->checksums = DEFAULT_CHECKSUMS;
+  src->csum_track = -1;
   src->cdio = NULL;
 }
 
@@ -441,6 +627,12 @@ gst_cdio_cdda_src_finalize (GObject * obj)
 {
   GstCdioCddaSrc *src = GST_CDIO_CDDA_SRC (obj);
 
+  gst_cdio_cdda_src_clear_cache (src);
+
+  g_free (src->track_nums);
+  g_free (src->track_starts);
+  g_free (src->track_ends);
+
   if (src->cdio) {
     cdio_destroy (src->cdio);
     src->cdio = NULL;
@@ -473,6 +665,18 @@ gst_cdio_cdda_src_class_init (GstCdioCddaSrcClass * klass)
           "Read from device at the specified speed (-1 = default)", -1, 100,
           DEFAULT_READ_SPEED, G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS));
 
+  g_object_class_install_property (G_OBJECT_CLASS (klass), PROP_READ_AHEAD,
+      g_param_spec_int ("read-ahead", "Read ahead",
+          "Number of sectors to read from the device in one go", 1,
+          MAX_READ_AHEAD, DEFAULT_READ_AHEAD,
+          G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS));
+
+  g_object_class_install_property (G_OBJECT_CLASS (klass), PROP_CHECKSUMS,
+      g_param_spec_boolean ("checksums", "Checksums",
+          "Compute CRC32 and AccurateRip checksums of each track and post "
+          "them in an element message at the end of the track",
+          DEFAULT_CHECKSUMS, G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS));
+
   gst_element_class_set_static_metadata (element_class,
       "CD audio source (CDDA)", "Source/File",
       "Read audio from CD using libcdio",
@@ -493,6 +697,16 @@ gst_cdio_cdda_src_set_property (GObject * object, guint prop_id,
       g_atomic_int_set (&src->read_speed, speed);
       break;
     }
+    case PROP_READ_AHEAD:{
+      gint read_ahead;
+
+      read_ahead = g_value_get_int (value);
+      g_atomic_int_set (&src->read_ahead, read_ahead);
+      break;
+    }
+    case PROP_CHECKSUMS:
+      src->checksums = g_value_get_boolean (value);
+      break;
     default:
       G_OBJECT_WARN_INVALID_PROPERTY_ID (object, prop_id, pspec);
       break;
@@ -513,6 +727,16 @@ gst_cdio_cdda_src_get_property (GObject * object, guint prop_id,
       g_value_set_int (value, speed);
       break;
     }
+    case PROP_READ_AHEAD:{
+      gint read_ahead;
+
+      read_ahead = g_atomic_int_get (&src->read_ahead);
+      g_value_set_int (value, read_ahead);
+      break;
+    }
+    case PROP_CHECKSUMS:
+      g_value_set_boolean (value, src->checksums);
+      break;
     default:
       G_OBJECT_WARN_INVALID_PROPERTY_ID (object, prop_id, pspec);
       break;
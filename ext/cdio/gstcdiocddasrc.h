@@ -23,6 +23,8 @@
 #include <gst/audio/gstaudiocdsrc.h>
 #include <cdio/cdio.h>
 
+#include "gstcdiochecksum.h"
+
 #define GST_TYPE_CDIO_CDDA_SRC            (gst_cdio_cdda_src_get_type ())
 #define GST_CDIO_CDDA_SRC(obj)            (G_TYPE_CHECK_INSTANCE_CAST((obj), GST_TYPE_CDIO_CDDA_SRC, GstCdioCddaSrc))
 #define GST_CDIO_CDDA_SRC_CLASS(klass)    (G_TYPE_CHECK_CLASS_CAST((klass),  GST_TYPE_CDIO_CDDA_SRC, GstCdioCddaSrcClass))
@@ -37,10 +39,28 @@ struct _GstCdioCddaSrc
   GstAudioCdSrc  audiocdsrc;
 
   gint           read_speed;    /* ATOMIC */
+  gint           read_ahead;    /* ATOMIC, sectors read per libcdio call */
+  gboolean       checksums;     /* compute and post per-track checksums */
 
   gboolean       swap_le_be;    /* Drive produces samples in other endianness */
 
   CdIo          *cdio;          /* NULL if not open */
+
+  /* audio track layout, gathered in open() */
+  gint           num_tracks;
+  gint          *track_nums;
+  gint          *track_starts;
+  gint          *track_ends;
+
+  /* checksums of the track being read, csum_track is -1 if not valid */
+  GstCdioChecksum csum;
+  gint           csum_track;
+  gint           csum_next_sector;
+
+  /* read-ahead cache, holds sectors [cache_start, cache_start + cache_len) */
+  GstBuffer     *cache;
+  gint           cache_start;
+  gint           cache_len;
 };
 
 struct _GstCdioCddaSrcClass
@@ -0,0 +1,170 @@
+/* GStreamer
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Library General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Library General Public License for more details.
+ *
+ * You should have received a copy of the GNU Library General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 51 Franklin St, Fifth Floor,
+ * Boston, MA 02110-1301, USA.
+ */
+
+/* Incremental CRC32 (as used by e.g. EAC for 'copy CRC') and AccurateRip
+ * v1/v2 track checksums, computed on the sector data while it streams */
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#include "gstcdiochecksum.h"
+
+#include <gst/gst.h>
+
+/* AccurateRip ignores the first 5 sectors of the first track and the last
+ * 5 sectors of the last track, to account for drive read offsets */
+#define AR_SKIP_SAMPLES (5 * 588)
+
+/* slicing-by-8 lookup tables for the reflected CRC32 polynomial */
+static guint32 crc_table[8][256];
+
+static gpointer
+gst_cdio_checksum_init_crc_table (gpointer data)
+{
+  guint32 i, j, crc;
+
+  for (i = 0; i < 256; ++i) {
+    crc = i;
+    for (j = 0; j < 8; ++j)
+      crc = (crc >> 1) ^ ((crc & 1) ? 0xedb88320 : 0);
+    crc_table[0][i] = crc;
+  }
+
+  for (i = 0; i < 256; ++i) {
+    for (j = 1; j < 8; ++j) {
+      crc = crc_table[j - 1][i];
+      crc_table[j][i] = (crc >> 8) ^ crc_table[0][crc & 0xff];
+    }
+  }
+
+  return NULL;
+}
+
+void
+gst_cdio_checksum_init (GstCdioChecksum * csum, guint32 num_samples,
+    gboolean first_track, gboolean last_track)
+{
+  static GOnce table_once = G_ONCE_INIT;
+
+  g_once (&table_once, gst_cdio_checksum_init_crc_table, NULL);
+
+  csum->crc = 0xffffffff;
+
+  csum->ar_v1 = 0;
+  csum->ar_v2 = 0;
+  csum->ar_pos = 1;
+  csum->ar_check_from = first_track ? AR_SKIP_SAMPLES : 0;
+  csum->ar_check_to = num_samples;
+  if (last_track)
+    csum->ar_check_to -= MIN (num_samples, AR_SKIP_SAMPLES);
+}
+
+static guint32
+gst_cdio_checksum_crc32_update (guint32 crc, const guint8 * data, gsize size)
+{
+  while (size >= 8) {
+    guint32 one = GST_READ_UINT32_LE (data) ^ crc;
+    guint32 two = GST_READ_UINT32_LE (data + 4);
+
+    crc = crc_table[7][one & 0xff] ^
+        crc_table[6][(one >> 8) & 0xff] ^
+        crc_table[5][(one >> 16) & 0xff] ^
+        crc_table[4][one >> 24] ^
+        crc_table[3][two & 0xff] ^
+        crc_table[2][(two >> 8) & 0xff] ^
+        crc_table[1][(two >> 16) & 0xff] ^ crc_table[0][two >> 24];
+
+    data += 8;
+    size -= 8;
+  }
+
+  while (size--)
+    crc = (crc >> 8) ^ crc_table[0][(crc ^ *data++) & 0xff];
+
+  return crc;
+}
+
+/* the CRC is defined on the little endian CD-DA byte stream, so on big
+ * endian hosts the samples are swapped back in small blocks for it */
+static guint32
+gst_cdio_checksum_crc32_update_samples (guint32 crc, const guint8 * data,
+    gsize size)
+{
+#if G_BYTE_ORDER == G_LITTLE_ENDIAN
+  return gst_cdio_checksum_crc32_update (crc, data, size);
+#else
+  const guint16 *pcm_data = (const guint16 *) data;
+  guint16 le[256];
+  gsize i, n;
+
+  while (size >= 2) {
+    n = MIN (size / 2, G_N_ELEMENTS (le));
+    for (i = 0; i < n; ++i)
+      le[i] = GUINT16_TO_LE (pcm_data[i]);
+    crc = gst_cdio_checksum_crc32_update (crc, (const guint8 *) le, n * 2);
+    pcm_data += n;
+    size -= n * 2;
+  }
+
+  return crc;
+#endif
+}
+
+/* data must contain interleaved stereo samples in host endianness */
+void
+gst_cdio_checksum_update (GstCdioChecksum * csum, const guint8 * data,
+    gsize size)
+{
+  const gint16 *pcm_data = (const gint16 *) data;
+  guint32 v1, v2, pos;
+  gsize i, n;
+
+  csum->crc = gst_cdio_checksum_crc32_update_samples (csum->crc, data, size);
+
+  v1 = csum->ar_v1;
+  v2 = csum->ar_v2;
+  pos = csum->ar_pos;
+
+  n = size / (2 * sizeof (gint16));
+  for (i = 0; i < n; ++i, ++pos) {
+    guint32 sample;
+    guint64 product;
+
+    if (pos < csum->ar_check_from || pos > csum->ar_check_to)
+      continue;
+
+    /* left channel in the lower 16 bits, as in a little endian dword */
+    sample = (guint16) pcm_data[2 * i] |
+        ((guint32) (guint16) pcm_data[2 * i + 1] << 16);
+
+    product = (guint64) sample * pos;
+    v1 += (guint32) product;
+    v2 += (guint32) product + (guint32) (product >> 32);
+  }
+
+  csum->ar_v1 = v1;
+  csum->ar_v2 = v2;
+  csum->ar_pos = pos;
+}
+
+guint32
+gst_cdio_checksum_get_crc32 (const GstCdioChecksum * csum)
+{
+  return csum->crc ^ 0xffffffff;
+}
@@ -0,0 +1,53 @@
+/* GStreamer
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Library General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Library General Public License for more details.
+ *
+ * You should have received a copy of the GNU Library General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 51 Franklin St, Fifth Floor,
+ * Boston, MA 02110-1301, USA.
+ */
+
+#ifndef __GST_CDIO_CHECKSUM_H__
+#define __GST_CDIO_CHECKSUM_H__
+
+#include <glib.h>
+
+G_BEGIN_DECLS
+
+typedef struct _GstCdioChecksum GstCdioChecksum;
+
+/* running checksums over the audio data of one track */
+struct _GstCdioChecksum
+{
+  guint32  crc;              /* CRC32 of all data so far (not finalised) */
+
+  guint32  ar_v1;            /* AccurateRip v1/v2 checksums */
+  guint32  ar_v2;
+  guint32  ar_pos;           /* 1-based index of the next stereo sample */
+  guint32  ar_check_from;    /* range of samples that count for AccurateRip */
+  guint32  ar_check_to;
+};
+
+void     gst_cdio_checksum_init      (GstCdioChecksum * csum,
+                                      guint32           num_samples,
+                                      gboolean          first_track,
+                                      gboolean          last_track);
+
+void     gst_cdio_checksum_update    (GstCdioChecksum * csum,
+                                      const guint8    * data,
+                                      gsize             size);
+
+guint32  gst_cdio_checksum_get_crc32 (const GstCdioChecksum * csum);
+
+G_END_DECLS
+
+#endif /* __GST_CDIO_CHECKSUM_H__ */
@@ -47,9 +47,15 @@ enum
   ARG_DEVICE,
   ARG_TITLE,
   ARG_CHAPTER,
-  ARG_ANGLE
+  ARG_ANGLE,
+  ARG_LINEAR_READ
 };
 
+#define DEFAULT_LINEAR_READ FALSE
+
+/* maximum number of sectors read in one go in linear read mode (2MB) */
+#define LINEAR_READ_MAX_BLOCKS 1024
+
 static GstStaticPadTemplate srctemplate = GST_STATIC_PAD_TEMPLATE ("src",
     GST_PAD_SRC,
     GST_PAD_ALWAYS,
@@ -123,6 +129,7 @@ gst_dvd_read_src_init (GstDvdReadSrc * src)
   src->uri_title = 1;
   src->uri_chapter = 1;
   src->uri_angle = 1;
+  src->linear_read = DEFAULT_LINEAR_READ;
 
   src->title_lang_event_pending = NULL;
   src->pending_clut_event = NULL;
@@ -163,6 +170,11 @@ gst_dvd_read_src_class_init (GstDvdReadSrcClass * klass)
   g_object_class_install_property (G_OBJECT_CLASS (klass), ARG_ANGLE,
       g_param_spec_int ("angle", "angle", "angle",
           1, 999, 1, G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS));
+  g_object_class_install_property (G_OBJECT_CLASS (klass), ARG_LINEAR_READ,
+      g_param_spec_boolean ("linear-read", "Linear read",
+          "Read cells outside of angle blocks sequentially in large chunks "
+          "instead of VOBU by VOBU (useful for ripping whole titles)",
+          DEFAULT_LINEAR_READ, G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS));
 
   gst_element_class_add_static_pad_template (gstelement_class, &srctemplate);
 
@@ -746,6 +758,52 @@ typedef enum
   GST_DVD_READ_AGAIN = -3
 } GstDvdReadReturn;
 
+/* Reads the rest of the current cell (up to LINEAR_READ_MAX_BLOCKS sectors)
+ * in one go without looking at the NAV packets. Only used for cells that
+ * are not part of an angle block, where the VOBUs of the cell are stored
+ * contiguously and there is nothing to skip. */
+static GstDvdReadReturn
+gst_dvd_read_src_read_linear (GstDvdReadSrc * src, GstBuffer ** p_buf)
+{
+  GstBuffer *buf;
+  GstMapInfo map;
+  guint last_sector, n_blocks;
+  gint len;
+
+  last_sector = src->cur_pgc->cell_playback[src->cur_cell].last_sector;
+  n_blocks = MIN (last_sector + 1 - src->cur_pack, LINEAR_READ_MAX_BLOCKS);
+
+  buf = gst_buffer_new_allocate (NULL, n_blocks * DVD_VIDEO_LB_LEN, NULL);
+
+  GST_LOG_OBJECT (src, "Going to read %u sectors @ pack %d (linear)", n_blocks,
+      src->cur_pack);
+
+  gst_buffer_map (buf, &map, GST_MAP_WRITE);
+  len = DVDReadBlocks (src->dvd_title, src->cur_pack, n_blocks, map.data);
+  gst_buffer_unmap (buf, &map);
+
+  if (len != n_blocks)
+    goto block_read_error;
+
+  GST_BUFFER_TIMESTAMP (buf) =
+      gst_dvd_read_src_get_time_for_sector (src, src->cur_pack);
+
+  *p_buf = buf;
+
+  src->cur_pack += n_blocks;
+
+  return GST_DVD_READ_OK;
+
+  /* ERRORS */
+block_read_error:
+  {
+    GST_ERROR_OBJECT (src, "Read failed for %u blocks at %d", n_blocks,
+        src->cur_pack);
+    gst_buffer_unref (buf);
+    return GST_DVD_READ_ERROR;
+  }
+}
+
 static GstDvdReadReturn
 gst_dvd_read_src_read (GstDvdReadSrc * src, gint angle, gint new_seek,
     GstBuffer ** p_buf)
@@ -754,7 +812,8 @@ gst_dvd_read_src_read (GstDvdReadSrc * src, gint angle, gint new_seek,
   GstSegment *seg;
   guint8 oneblock[DVD_VIDEO_LB_LEN];
   dsi_t dsi_pack;
-  guint next_vobu, cur_output_size;
+  guint next_vobu, cur_output_size, last_sector;
+  gboolean linear;
   gint len;
   gint retries;
   gint64 next_time;
@@ -811,13 +870,29 @@ again:
         src->cur_pack);
   }
 
-  if (src->cur_pack >= src->cur_pgc->cell_playback[src->cur_cell].last_sector) {
+  /* in linear read mode we only need the NAV packets to find our way through
+   * angle blocks, interleaved cells (whose ILVUs alternate with those of
+   * other branches) and to the target of a seek; a TIME segment stop is also
+   * detected via the VOBU timestamps, so stick to VOBU-sized reads then */
+  linear = src->linear_read && !new_seek &&
+      src->cur_pgc->cell_playback[src->cur_cell].block_type !=
+      BLOCK_TYPE_ANGLE_BLOCK &&
+      !src->cur_pgc->cell_playback[src->cur_cell].interleaved &&
+      (seg->format != GST_FORMAT_TIME || !GST_CLOCK_TIME_IS_VALID (seg->stop));
+
+  /* a NAV packet on the last sector would start an empty VOBU, but linear
+   * reads end anywhere and still have to read the last sector */
+  last_sector = src->cur_pgc->cell_playback[src->cur_cell].last_sector;
+  if (src->cur_pack >= (linear ? last_sector + 1 : last_sector)) {
     src->new_cell = TRUE;
     GST_LOG_OBJECT (src, "Beyond last sector for cell %d, going to next cell",
         src->cur_cell);
     return GST_DVD_READ_AGAIN;
   }
 
+  if (linear)
+    return gst_dvd_read_src_read_linear (src, p_buf);
+
   /* read NAV packet */
   retries = 0;
 nav_retry:
@@ -1056,6 +1131,9 @@ gst_dvd_read_src_set_property (GObject * object, guint prop_id,
         src->angle = src->uri_angle - 1;
       }
       break;
+    case ARG_LINEAR_READ:
+      src->linear_read = g_value_get_boolean (value);
+      break;
     default:
       G_OBJECT_WARN_INVALID_PROPERTY_ID (object, prop_id, pspec);
       break;
@@ -1085,6 +1163,9 @@ gst_dvd_read_src_get_property (GObject * object, guint prop_id, GValue * value,
     case ARG_ANGLE:
       g_value_set_int (value, src->uri_angle);
       break;
+    case ARG_LINEAR_READ:
+      g_value_set_boolean (value, src->linear_read);
+      break;
     default:
       G_OBJECT_WARN_INVALID_PROPERTY_ID (object, prop_id, pspec);
       break;
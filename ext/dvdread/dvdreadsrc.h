@@ -58,6 +58,8 @@ struct _GstDvdReadSrc {
   gint             uri_chapter;   /* otherwise not touched; these values     */
   gint             uri_angle;     /* start from 1                            */
 
+  gboolean         linear_read;   /* read non-angle cells in large chunks    */
+
   gint             title;         /* current position while open, set to the */
   gint             chapter;       /* URI-set values in ::start(). these      */
   gint             angle;         /* values start from 0                     */
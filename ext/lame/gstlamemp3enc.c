@@ -24,7 +24,10 @@
  * SECTION:element-lamemp3enc
  * @see_also: lame, mad, vorbisenc
  *
- * This element encodes raw integer audio into an MPEG-1 layer 3 (MP3) stream.
+ * This element encodes raw audio into an MPEG-1 layer 3 (MP3) stream.
+ * Besides 16 bit integer samples it takes 32 bit integer and float samples,
+ * interleaved or not, if the LAME library is recent enough, so decoder output
+ * usually does not need to be converted first.
  * Note that <ulink url="http://en.wikipedia.org/wiki/MP3">MP3</ulink> is not
  * a free format, there are licensing and patent issues to take into
  * consideration. See <ulink url="http://www.vorbis.com/">Ogg/Vorbis</ulink>
@@ -55,6 +58,22 @@
  * |[
  * gst-launch-1.0 -v audiotestsrc num-buffers=10 ! audio/x-raw,rate=44100,channels=1 ! lamemp3enc target=bitrate cbr=true bitrate=48 ! filesink location=test.mp3
  * ]| Encode to a fixed sample rate
+ * |[
+ * gst-launch-1.0 -v filesrc location=audiobook.wav ! wavparse ! audioconvert ! lamemp3enc threads=0 ! filesink location=audiobook.mp3
+ * ]| Encode a long file using all CPU cores
+ * </refsect2>
+ * <refsect2>
+ * <title>Parallel encoding</title>
+ * If #GstLameMP3Enc:threads is not 1 and no resampling is needed, the input
+ * is cut into segments of #GstLameMP3Enc:segment-frames frames that are
+ * encoded concurrently by separate LAME instances. Each instance is also fed
+ * a few frames of audio before and after its segment, whose output is thrown
+ * away, so that the filterbank and psychoacoustic model see the same signal
+ * around the segment edges as in serial encoding and no gaps or clicks are
+ * introduced. Since frames of one instance cannot refer to the bit reservoir
+ * of another, the bit reservoir is disabled in this mode, which costs a bit
+ * of quality at a given bitrate. The latency grows with the number of
+ * segments in flight, so this mode is meant for offline encoding.
  * </refsect2>
  *
  * Since: 0.10.12
@@ -78,6 +97,19 @@ GST_DEBUG_CATEGORY_STATIC (debug);
 
 /* elementfactory information */
 
+/* LAME takes 16 and 32 bit integer and, in newer versions, float samples,
+ * either interleaved or as separate channel arrays */
+#if defined (HAVE_LAME_ENCODE_BUFFER_IEEE_FLOAT) && defined (HAVE_LAME_ENCODE_BUFFER_INTERLEAVED_INT)
+#define FORMATS "{ " GST_AUDIO_NE (S16) ", " GST_AUDIO_NE (S32) ", " \
+    GST_AUDIO_NE (F32) " }"
+#elif defined (HAVE_LAME_ENCODE_BUFFER_IEEE_FLOAT)
+#define FORMATS "{ " GST_AUDIO_NE (S16) ", " GST_AUDIO_NE (F32) " }"
+#elif defined (HAVE_LAME_ENCODE_BUFFER_INTERLEAVED_INT)
+#define FORMATS "{ " GST_AUDIO_NE (S16) ", " GST_AUDIO_NE (S32) " }"
+#else
+#define FORMATS GST_AUDIO_NE (S16)
+#endif
+
 /* LAMEMP3ENC can do MPEG-1, MPEG-2, and MPEG-2.5, so it has 9 possible
  * sample rates it supports */
 static GstStaticPadTemplate gst_lamemp3enc_sink_template =
@@ -85,13 +117,13 @@ static GstStaticPadTemplate gst_lamemp3enc_sink_template =
     GST_PAD_SINK,
     GST_PAD_ALWAYS,
     GST_STATIC_CAPS ("audio/x-raw, "
-        "format = (string) " GST_AUDIO_NE (S16) ", "
+        "format = (string) " FORMATS ", "
         "layout = (string) interleaved, "
         "rate = (int) { 8000, 11025, 12000, 16000, 22050, 24000, 32000, 44100, 48000 }, "
         "channels = (int) 1; "
         "audio/x-raw, "
-        "format = (string) " GST_AUDIO_NE (S16) ", "
-        "layout = (string) interleaved, "
+        "format = (string) " FORMATS ", "
+        "layout = (string) { interleaved, non-interleaved }, "
         "rate = (int) { 8000, 11025, 12000, 16000, 22050, 24000, 32000, 44100, 48000 }, "
         "channels = (int) 2, " "channel-mask = (bitmask) 0x3")
     );
@@ -169,7 +201,9 @@ enum
   ARG_CBR,
   ARG_QUALITY,
   ARG_ENCODING_ENGINE_QUALITY,
-  ARG_MONO
+  ARG_MONO,
+  ARG_THREADS,
+  ARG_SEGMENT_FRAMES
 };
 
 #define DEFAULT_TARGET LAMEMP3ENC_TARGET_QUALITY
@@ -178,6 +212,24 @@ enum
 #define DEFAULT_QUALITY 4
 #define DEFAULT_ENCODING_ENGINE_QUALITY LAMEMP3ENC_ENCODING_ENGINE_QUALITY_STANDARD
 #define DEFAULT_MONO FALSE
+#define DEFAULT_THREADS 1
+#define DEFAULT_SEGMENT_FRAMES 256
+
+/* frames of audio encoded before and after each segment in parallel mode */
+#define SEGMENT_OVERLAP_FRAMES 3
+
+typedef struct
+{
+  GstBuffer *prime;             /* input preceding the segment, or NULL */
+  GstBuffer *input;
+  GstBuffer *postroll;          /* input following the segment, or NULL */
+  GstBuffer *output;            /* encoded frames of the segment, or NULL */
+  gboolean error;
+  gboolean done;                /* protected by the lock */
+} GstLameMP3EncSegment;
+
+/* serialises LAME instance setup, which initialises global tables */
+static GMutex setup_lock;
 
 static gboolean gst_lamemp3enc_start (GstAudioEncoder * enc);
 static gboolean gst_lamemp3enc_stop (GstAudioEncoder * enc);
@@ -192,6 +244,11 @@ static void gst_lamemp3enc_set_property (GObject * object, guint prop_id,
 static void gst_lamemp3enc_get_property (GObject * object, guint prop_id,
     GValue * value, GParamSpec * pspec);
 static gboolean gst_lamemp3enc_setup (GstLameMP3Enc * lame, GstTagList ** tags);
+static gboolean gst_lamemp3enc_apply_settings (GstLameMP3Enc * lame,
+    lame_global_flags * lgf, gboolean disable_reservoir);
+static void gst_lamemp3enc_encode_segment (GstLameMP3EncSegment * segment,
+    GstLameMP3Enc * lame);
+static void gst_lamemp3enc_discard_segments (GstLameMP3Enc * lame);
 
 #define gst_lamemp3enc_parent_class parent_class
 G_DEFINE_TYPE (GstLameMP3Enc, gst_lamemp3enc, GST_TYPE_AUDIO_ENCODER);
@@ -208,7 +265,12 @@ gst_lamemp3enc_release_memory (GstLameMP3Enc * lame)
 static void
 gst_lamemp3enc_finalize (GObject * obj)
 {
-  gst_lamemp3enc_release_memory (GST_LAMEMP3ENC (obj));
+  GstLameMP3Enc *lame = GST_LAMEMP3ENC (obj);
+
+  gst_lamemp3enc_release_memory (lame);
+
+  g_mutex_clear (&lame->lock);
+  g_cond_clear (&lame->cond);
 
   G_OBJECT_CLASS (parent_class)->finalize (obj);
 }
@@ -276,12 +338,26 @@ gst_lamemp3enc_class_init (GstLameMP3EncClass * klass)
       g_param_spec_boolean ("mono", "Mono", "Enforce mono encoding",
           DEFAULT_MONO,
           G_PARAM_CONSTRUCT | G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS));
+  g_object_class_install_property (G_OBJECT_CLASS (klass), ARG_THREADS,
+      g_param_spec_int ("threads", "Threads",
+          "Number of segments to encode in parallel (0 = number of CPUs, "
+          "1 = serial encoding)", 0, 64, DEFAULT_THREADS,
+          G_PARAM_CONSTRUCT | G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS));
+  g_object_class_install_property (G_OBJECT_CLASS (klass), ARG_SEGMENT_FRAMES,
+      g_param_spec_int ("segment-frames", "Segment frames",
+          "Number of frames per segment when encoding in parallel",
+          SEGMENT_OVERLAP_FRAMES, 65536, DEFAULT_SEGMENT_FRAMES,
+          G_PARAM_CONSTRUCT | G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS));
 }
 
 static void
 gst_lamemp3enc_init (GstLameMP3Enc * lame)
 {
   GST_PAD_SET_ACCEPT_TEMPLATE (GST_AUDIO_ENCODER_SINK_PAD (lame));
+
+  g_mutex_init (&lame->lock);
+  g_cond_init (&lame->cond);
+  g_queue_init (&lame->pending);
 }
 
 static gboolean
@@ -305,6 +381,12 @@ gst_lamemp3enc_stop (GstAudioEncoder * enc)
 
   GST_DEBUG_OBJECT (lame, "stop");
 
+  gst_lamemp3enc_discard_segments (lame);
+  if (lame->pool) {
+    g_thread_pool_free (lame->pool, FALSE, TRUE);
+    lame->pool = NULL;
+  }
+
   if (lame->adapter) {
     g_object_unref (lame->adapter);
     lame->adapter = NULL;
@@ -326,9 +408,17 @@ gst_lamemp3enc_set_format (GstAudioEncoder * enc, GstAudioInfo * info)
 
   lame = GST_LAMEMP3ENC (enc);
 
+  /* the base class drained us already, nothing to output anymore */
+  gst_lamemp3enc_discard_segments (lame);
+
   /* parameters already parsed for us */
   lame->samplerate = GST_AUDIO_INFO_RATE (info);
   lame->num_channels = GST_AUDIO_INFO_CHANNELS (info);
+  lame->format = GST_AUDIO_INFO_FORMAT (info);
+  lame->bpf = GST_AUDIO_INFO_BPF (info);
+  lame->interleaved = GST_AUDIO_INFO_LAYOUT (info) ==
+      GST_AUDIO_LAYOUT_INTERLEAVED;
+  memset (lame->headers, 0, sizeof (lame->headers));
 
   /* but we might be asked to reconfigure, so reset */
   gst_lamemp3enc_release_memory (lame);
@@ -368,10 +458,55 @@ gst_lamemp3enc_set_format (GstAudioEncoder * enc, GstAudioInfo * info)
   gst_caps_unref (othercaps);
 
   /* base class feedback:
-   * - we will handle buffers, just hand us all available
+   * - we will handle buffers, just hand us all available, or segments of
+   *   frames if we encode in parallel
    * - report latency */
   latency = gst_util_uint64_scale_int (lame_get_framesize (lame->lgf),
       GST_SECOND, lame->samplerate);
+
+  lame->parallel = FALSE;
+  if (lame->threads != 1) {
+    gint threads, segment_samples;
+
+    threads = lame->threads;
+    if (threads == 0)
+      threads = g_get_num_processors ();
+
+    if (threads > 1 && out_samplerate == lame->samplerate &&
+        (lame->interleaved || lame->num_channels == 1)) {
+      lame->parallel = TRUE;
+
+      if (lame->pool == NULL) {
+        lame->pool = g_thread_pool_new ((GFunc) gst_lamemp3enc_encode_segment,
+            lame, threads, FALSE, NULL);
+      } else {
+        g_thread_pool_set_max_threads (lame->pool, threads, NULL);
+      }
+
+      segment_samples = lame->segment_frames * lame_get_framesize (lame->lgf);
+      gst_audio_encoder_set_frame_samples_min (enc, segment_samples);
+      gst_audio_encoder_set_frame_samples_max (enc, segment_samples);
+      gst_audio_encoder_set_frame_max (enc, 1);
+
+      /* one segment is held back for its post-roll, and up to two segments
+       * per thread are in flight */
+      latency += gst_util_uint64_scale_int (segment_samples * (2 * threads + 1),
+          GST_SECOND, lame->samplerate);
+
+      GST_INFO_OBJECT (lame, "encoding segments of %d frames with %d threads",
+          lame->segment_frames, threads);
+    } else if (threads > 1) {
+      GST_WARNING_OBJECT (lame, "resampling internally or non-interleaved "
+          "input, encoding serially");
+    }
+  }
+
+  if (!lame->parallel) {
+    gst_audio_encoder_set_frame_samples_min (enc, 0);
+    gst_audio_encoder_set_frame_samples_max (enc, 0);
+    gst_audio_encoder_set_frame_max (enc, 0);
+  }
+
   gst_audio_encoder_set_latency (enc, latency, latency);
 
   if (tags) {
@@ -461,6 +596,12 @@ gst_lamemp3enc_set_property (GObject * object, guint prop_id,
     case ARG_MONO:
       lame->mono = g_value_get_boolean (value);
       break;
+    case ARG_THREADS:
+      lame->threads = g_value_get_int (value);
+      break;
+    case ARG_SEGMENT_FRAMES:
+      lame->segment_frames = g_value_get_int (value);
+      break;
     default:
       G_OBJECT_WARN_INVALID_PROPERTY_ID (object, prop_id, pspec);
       break;
@@ -494,6 +635,12 @@ gst_lamemp3enc_get_property (GObject * object, guint prop_id, GValue * value,
     case ARG_MONO:
       g_value_set_boolean (value, lame->mono);
       break;
+    case ARG_THREADS:
+      g_value_set_int (value, lame->threads);
+      break;
+    case ARG_SEGMENT_FRAMES:
+      g_value_set_int (value, lame->segment_frames);
+      break;
     default:
       G_OBJECT_WARN_INVALID_PROPERTY_ID (object, prop_id, pspec);
       break;
@@ -641,66 +788,171 @@ mp3_sync_check (GstLameMP3Enc * lame, unsigned long head)
 
 /* **** end mpegaudioparse **** */
 
+/* returns the size of the frame at data, or 0 if there is no complete frame
+ * with a valid header */
+static guint
+gst_lamemp3enc_parse_frame (GstLameMP3Enc * lame, const guint8 * data,
+    gsize avail)
+{
+  guint32 header;
+  guint size;
+
+  if (avail < 4)
+    return 0;
+
+  header = GST_READ_UINT32_BE (data);
+  if (!mp3_sync_check (lame, header))
+    return 0;
+
+  size = mp3_type_frame_length_from_header (lame, header, NULL, NULL, NULL,
+      NULL, NULL, NULL, NULL);
+
+  return (size <= avail) ? size : 0;
+}
+
+/* returns the size of the frame with the given header and the number of
+ * input samples it holds, or 0 if the header is not one we produce. Frames
+ * mostly differ in the padding bit only, so the last two headers are
+ * remembered */
+static guint
+gst_lamemp3enc_frame_info (GstLameMP3Enc * lame, guint32 header,
+    guint * samples)
+{
+  guint rate, version, layer, size, i;
+
+  for (i = 0; i < G_N_ELEMENTS (lame->headers); i++) {
+    if (lame->headers[i].header == header && header != 0) {
+      *samples = lame->headers[i].samples;
+      return lame->headers[i].size;
+    }
+  }
+
+  if (!mp3_sync_check (lame, header))
+    return 0;
+
+  size = mp3_type_frame_length_from_header (lame, header, &version, &layer,
+      NULL, NULL, &rate, NULL, NULL);
+
+  if (G_UNLIKELY (layer != 3 || rate != lame->out_samplerate)) {
+    GST_DEBUG_OBJECT (lame,
+        "unexpected mp3 header with rate %u, version %u, layer %u",
+        rate, version, layer);
+    return 0;
+  }
+
+  /* Account for the internal resampling, finish frame really wants to
+   * know about the number of incoming samples
+   */
+  *samples = (version == 1) ? 1152 : 576;
+  *samples *= lame->samplerate;
+  *samples /= lame->out_samplerate;
+
+  lame->headers[1] = lame->headers[0];
+  lame->headers[0].header = header;
+  lame->headers[0].size = size;
+  lame->headers[0].samples = *samples;
+
+  return size;
+}
+
+/* splits the encoded data in buf into frames and finishes them; frames share
+ * the memory of buf, only a frame that LAME has not completed yet is kept in
+ * the adapter until the next output arrives, and only that frame is copied
+ * together once it is complete */
 static GstFlowReturn
-gst_lamemp3enc_finish_frames (GstLameMP3Enc * lame)
+gst_lamemp3enc_finish_frames (GstLameMP3Enc * lame, GstBuffer * buf)
 {
+  GstBuffer *mp3_buf;
+  gsize offset = 0, buf_size;
+  guint8 data[4];
+  guint32 header = 0;
+  guint size, samples_per_frame;
   gint av;
-  guint header;
   GstFlowReturn result = GST_FLOW_OK;
 
-  /* limited parsing, we don't expect to lose sync here */
-  while ((result == GST_FLOW_OK) &&
-      ((av = gst_adapter_available (lame->adapter)) > 4)) {
-    guint rate, version, layer, size;
-    GstBuffer *mp3_buf;
-    const guint8 *data;
-    guint samples_per_frame;
-
-    data = gst_adapter_map (lame->adapter, 4);
-    header = GST_READ_UINT32_BE (data);
-    gst_adapter_unmap (lame->adapter);
+  buf_size = gst_buffer_get_size (buf);
+
+  if ((av = gst_adapter_available (lame->adapter)) > 0) {
+    GstMapInfo map;
+
+    if (av + buf_size <= 4)
+      goto incomplete;
+
+    /* the header may straddle the leftover and the new data as well */
+    if (av >= 4) {
+      gst_adapter_copy (lame->adapter, data, 0, 4);
+    } else {
+      gst_adapter_copy (lame->adapter, data, 0, av);
+      gst_buffer_extract (buf, 0, data + av, 4 - av);
+    }
 
-    if (!mp3_sync_check (lame, header))
+    header = GST_READ_UINT32_BE (data);
+    size = gst_lamemp3enc_frame_info (lame, header, &samples_per_frame);
+    if (size == 0 || size <= av)
       goto invalid_header;
 
-    size = mp3_type_frame_length_from_header (lame, header, &version, &layer,
-        NULL, NULL, &rate, NULL, NULL);
+    if (size > av + buf_size)
+      goto incomplete;
+
+    mp3_buf = gst_buffer_new_allocate (NULL, size, NULL);
+    gst_buffer_map (mp3_buf, &map, GST_MAP_WRITE);
+    gst_adapter_copy (lame->adapter, map.data, 0, av);
+    gst_buffer_extract (buf, 0, map.data + av, size - av);
+    gst_buffer_unmap (mp3_buf, &map);
+    gst_adapter_clear (lame->adapter);
+
+    offset = size - av;
+    result = gst_audio_encoder_finish_frame (GST_AUDIO_ENCODER (lame),
+        mp3_buf, samples_per_frame);
+  }
 
-    if (G_UNLIKELY (layer != 3 || rate != lame->out_samplerate)) {
-      GST_DEBUG_OBJECT (lame,
-          "unexpected mp3 header with rate %u, version %u, layer %u",
-          rate, version, layer);
+  /* limited parsing, we don't expect to lose sync here */
+  while (result == GST_FLOW_OK && buf_size - offset > 4) {
+    gst_buffer_extract (buf, offset, data, 4);
+    header = GST_READ_UINT32_BE (data);
+    size = gst_lamemp3enc_frame_info (lame, header, &samples_per_frame);
+    if (size == 0)
       goto invalid_header;
-    }
 
-    if (size > av) {
+    if (size > buf_size - offset) {
       /* pretty likely to occur when lame is holding back on us */
-      GST_LOG_OBJECT (lame, "frame size %u (> %d)", size, av);
+      GST_LOG_OBJECT (lame, "frame size %u (> %" G_GSIZE_FORMAT ")", size,
+          buf_size - offset);
       break;
     }
 
-    /* Account for the internal resampling, finish frame really wants to
-     * know about the number of incoming samples
-     */
-    samples_per_frame = (version == 1) ? 1152 : 576;
-    samples_per_frame *= lame->samplerate;
-    samples_per_frame /= lame->out_samplerate;
-
     /* should be ok now */
-    mp3_buf = gst_adapter_take_buffer (lame->adapter, size);
+    mp3_buf = gst_buffer_copy_region (buf, GST_BUFFER_COPY_MEMORY, offset,
+        size);
+    offset += size;
     /* number of samples for MPEG-1, layer 3 */
     result = gst_audio_encoder_finish_frame (GST_AUDIO_ENCODER (lame),
         mp3_buf, samples_per_frame);
   }
 
+  if (result == GST_FLOW_OK && offset < buf_size) {
+    gst_adapter_push (lame->adapter, gst_buffer_copy_region (buf,
+            GST_BUFFER_COPY_MEMORY, offset, buf_size - offset));
+  }
+
 exit:
+  gst_buffer_unref (buf);
   return result;
 
+incomplete:
+  {
+    GST_LOG_OBJECT (lame, "frame still incomplete with %" G_GSIZE_FORMAT
+        " bytes", av + buf_size);
+    gst_adapter_push (lame->adapter, buf);
+    return GST_FLOW_OK;
+  }
+
   /* ERRORS */
 invalid_header:
   {
     GST_ELEMENT_ERROR (lame, STREAM, ENCODE,
         ("invalid lame mp3 sync header %08X", header), (NULL));
+    gst_adapter_clear (lame->adapter);
     result = GST_FLOW_ERROR;
     goto exit;
   }
@@ -726,19 +978,22 @@ gst_lamemp3enc_flush_full (GstLameMP3Enc * lame, gboolean push)
     gst_buffer_unmap (buf, &map);
     gst_buffer_resize (buf, 0, size);
     GST_DEBUG_OBJECT (lame, "collecting final %d bytes", size);
-    gst_adapter_push (lame->adapter, buf);
   } else {
     gst_buffer_unmap (buf, &map);
     GST_DEBUG_OBJECT (lame, "no final packet (size=%d, push=%d)", size, push);
     gst_buffer_unref (buf);
+    buf = NULL;
     result = GST_FLOW_OK;
   }
 
-  if (push) {
-    result = gst_lamemp3enc_finish_frames (lame);
+  if (push && buf) {
+    result = gst_lamemp3enc_finish_frames (lame, buf);
   } else {
     /* never mind */
-    gst_adapter_clear (lame->adapter);
+    if (buf)
+      gst_buffer_unref (buf);
+    if (!push)
+      gst_adapter_clear (lame->adapter);
   }
 
   /* either way, we expect nothing left */
@@ -755,7 +1010,344 @@ gst_lamemp3enc_flush_full (GstLameMP3Enc * lame, gboolean push)
 static void
 gst_lamemp3enc_flush (GstAudioEncoder * enc)
 {
-  gst_lamemp3enc_flush_full (GST_LAMEMP3ENC (enc), FALSE);
+  GstLameMP3Enc *lame = GST_LAMEMP3ENC (enc);
+
+  if (lame->parallel)
+    gst_lamemp3enc_discard_segments (lame);
+  else
+    gst_lamemp3enc_flush_full (lame, FALSE);
+}
+
+/* encodes the mapped raw audio of buf, returns the number of bytes written to
+ * out or a negative value on error */
+static gint
+gst_lamemp3enc_encode (GstLameMP3Enc * lame, lame_global_flags * lgf,
+    GstBuffer * buf, GstMapInfo * map, guint8 * out, gint out_size)
+{
+  gint num_samples;
+  guint8 *data, *left, *right;
+
+  data = left = right = map->data;
+  num_samples = map->size / lame->bpf;
+
+  /* non-interleaved buffers hold one channel after the other, possibly with
+   * a gap in between that is described by the audio meta; and lame seems to
+   * be too stupid to get mono interleaved going */
+  if (lame->num_channels == 2 && !lame->interleaved) {
+#if GST_CHECK_VERSION (1, 16, 0)
+    GstAudioMeta *meta = gst_buffer_get_audio_meta (buf);
+
+    if (meta != NULL) {
+      num_samples = meta->samples;
+      left = data + meta->offsets[0];
+      right = data + meta->offsets[1];
+    } else
+#endif
+    {
+      right = data + map->size / 2;
+    }
+  }
+
+  switch (lame->format) {
+    case GST_AUDIO_FORMAT_S16:
+      if (lame->num_channels == 2 && lame->interleaved)
+        return lame_encode_buffer_interleaved (lgf, (short int *) data,
+            num_samples, out, out_size);
+      return lame_encode_buffer (lgf, (short int *) left,
+          (short int *) right, num_samples, out, out_size);
+#ifdef HAVE_LAME_ENCODE_BUFFER_INTERLEAVED_INT
+    case GST_AUDIO_FORMAT_S32:
+      if (lame->num_channels == 2 && lame->interleaved)
+        return lame_encode_buffer_interleaved_int (lgf, (int *) data,
+            num_samples, out, out_size);
+      return lame_encode_buffer_int (lgf, (int *) left, (int *) right,
+          num_samples, out, out_size);
+#endif
+#ifdef HAVE_LAME_ENCODE_BUFFER_IEEE_FLOAT
+    case GST_AUDIO_FORMAT_F32:
+      if (lame->num_channels == 2 && lame->interleaved)
+        return lame_encode_buffer_interleaved_ieee_float (lgf,
+            (float *) data, num_samples, out, out_size);
+      return lame_encode_buffer_ieee_float (lgf, (float *) left,
+          (float *) right, num_samples, out, out_size);
+#endif
+    default:
+      g_assert_not_reached ();
+      return -1;
+  }
+}
+
+/* encodes the data of buf (if not NULL) and appends the output to out */
+static gboolean
+gst_lamemp3enc_encode_append (GstLameMP3Enc * lame, lame_global_flags * lgf,
+    GstBuffer * buf, guint8 * out, gint out_size, gint * out_pos)
+{
+  GstMapInfo map;
+  gint size;
+
+  if (buf == NULL)
+    return TRUE;
+
+  gst_buffer_map (buf, &map, GST_MAP_READ);
+  size = gst_lamemp3enc_encode (lame, lgf, buf, &map,
+      out + *out_pos, out_size - *out_pos);
+  gst_buffer_unmap (buf, &map);
+
+  if (size < 0) {
+    GST_ERROR_OBJECT (lame, "encoding failed: %d", size);
+    return FALSE;
+  }
+
+  *out_pos += size;
+  return TRUE;
+}
+
+/* runs in a thread of the pool */
+static void
+gst_lamemp3enc_encode_segment (GstLameMP3EncSegment * segment,
+    GstLameMP3Enc * lame)
+{
+  lame_global_flags *lgf;
+  GstMapInfo map;
+  gsize in_size, bpf;
+  gint framesize, out_size, out_pos = 0, size;
+  guint n_prime, n_frames, frame, len;
+  guint offset = 0, start = G_MAXUINT;
+
+  g_mutex_lock (&setup_lock);
+  lgf = lame_init ();
+  if (lgf != NULL) {
+    lame_set_in_samplerate (lgf, lame->samplerate);
+    lame_set_out_samplerate (lgf, lame->out_samplerate);
+    if (!gst_lamemp3enc_apply_settings (lame, lgf, TRUE) ||
+        lame_init_params (lgf) < 0) {
+      lame_close (lgf);
+      lgf = NULL;
+    }
+  }
+  g_mutex_unlock (&setup_lock);
+
+  if (lgf == NULL) {
+    GST_ERROR_OBJECT (lame, "failed to set up LAME instance");
+    segment->error = TRUE;
+    goto done;
+  }
+
+  framesize = lame_get_framesize (lgf);
+  bpf = lame->bpf;
+
+  in_size = gst_buffer_get_size (segment->input);
+  n_prime = segment->prime ?
+      gst_buffer_get_size (segment->prime) / (bpf * framesize) : 0;
+  n_frames = in_size / (bpf * framesize);
+
+  /* room for the priming, the segment, the post-roll and a final flush */
+  if (segment->prime)
+    in_size += gst_buffer_get_size (segment->prime);
+  if (segment->postroll)
+    in_size += gst_buffer_get_size (segment->postroll);
+  out_size = 1.25 * (in_size / bpf) * lame->num_channels + 2 * 7200;
+
+  segment->output = gst_buffer_new_allocate (NULL, out_size, NULL);
+  gst_buffer_map (segment->output, &map, GST_MAP_WRITE);
+
+  if (!gst_lamemp3enc_encode_append (lame, lgf, segment->prime, map.data,
+          out_size, &out_pos) ||
+      !gst_lamemp3enc_encode_append (lame, lgf, segment->input, map.data,
+          out_size, &out_pos) ||
+      !gst_lamemp3enc_encode_append (lame, lgf, segment->postroll, map.data,
+          out_size, &out_pos)) {
+    segment->error = TRUE;
+    goto unmap;
+  }
+
+  /* the last segment gets everything LAME still holds back; for the others
+   * the post-roll should have pushed out all frames of the segment */
+  if (segment->postroll == NULL) {
+    size = lame_encode_flush (lgf, map.data + out_pos, out_size - out_pos);
+    if (size > 0)
+      out_pos += size;
+  }
+
+  /* skip the frames of the priming, keep the frames of the segment */
+  for (frame = 0; offset < (guint) out_pos; ++frame) {
+    if (frame == n_prime)
+      start = offset;
+    if (segment->postroll && frame == n_prime + n_frames)
+      break;
+
+    len = gst_lamemp3enc_parse_frame (lame, map.data + offset,
+        out_pos - offset);
+    if (len == 0) {
+      GST_ERROR_OBJECT (lame, "invalid frame in segment output");
+      segment->error = TRUE;
+      goto unmap;
+    }
+    offset += len;
+  }
+
+  if (segment->postroll && frame < n_prime + n_frames) {
+    GST_WARNING_OBJECT (lame, "post-roll too short, got %u of %u frames",
+        frame - MIN (frame, n_prime), n_frames);
+  }
+
+unmap:
+  gst_buffer_unmap (segment->output, &map);
+  lame_close (lgf);
+
+  if (segment->error || start == G_MAXUINT || offset == start) {
+    gst_buffer_unref (segment->output);
+    segment->output = NULL;
+  } else {
+    gst_buffer_resize (segment->output, start, offset - start);
+  }
+
+done:
+  g_mutex_lock (&lame->lock);
+  segment->done = TRUE;
+  g_cond_broadcast (&lame->cond);
+  g_mutex_unlock (&lame->lock);
+}
+
+static void
+gst_lamemp3enc_segment_free (GstLameMP3EncSegment * segment)
+{
+  if (segment->prime)
+    gst_buffer_unref (segment->prime);
+  if (segment->postroll)
+    gst_buffer_unref (segment->postroll);
+  if (segment->output)
+    gst_buffer_unref (segment->output);
+  gst_buffer_unref (segment->input);
+  g_slice_free (GstLameMP3EncSegment, segment);
+}
+
+/* hands input to the pool, with postroll taken from the next segment */
+static void
+gst_lamemp3enc_queue_segment (GstLameMP3Enc * lame, GstBuffer * input,
+    GstBuffer * postroll)
+{
+  GstLameMP3EncSegment *segment;
+  gsize size, prime_size;
+
+  segment = g_slice_new0 (GstLameMP3EncSegment);
+  segment->prime = lame->prime;
+  segment->input = input;
+  segment->postroll = postroll;
+
+  /* keep the end of this segment to prime the encoder of the next one */
+  size = gst_buffer_get_size (input);
+  prime_size = MIN (size, SEGMENT_OVERLAP_FRAMES *
+      lame_get_framesize (lame->lgf) * lame->bpf);
+  lame->prime = gst_buffer_copy_region (input, GST_BUFFER_COPY_MEMORY,
+      size - prime_size, prime_size);
+
+  g_queue_push_tail (&lame->pending, segment);
+  g_thread_pool_push (lame->pool, segment, NULL);
+}
+
+/* waits for the oldest pending segment and outputs its frames if push is
+ * TRUE */
+static GstFlowReturn
+gst_lamemp3enc_finish_segment (GstLameMP3Enc * lame, gboolean push)
+{
+  GstLameMP3EncSegment *segment;
+  GstFlowReturn ret = GST_FLOW_OK;
+
+  segment = g_queue_pop_head (&lame->pending);
+
+  g_mutex_lock (&lame->lock);
+  while (!segment->done)
+    g_cond_wait (&lame->cond, &lame->lock);
+  g_mutex_unlock (&lame->lock);
+
+  if (!push)
+    goto done;
+
+  if (segment->error) {
+    GST_ELEMENT_ERROR (lame, STREAM, ENCODE, (NULL),
+        ("Failed to encode segment"));
+    ret = GST_FLOW_ERROR;
+    goto done;
+  }
+
+  if (segment->output) {
+    ret = gst_lamemp3enc_finish_frames (lame, segment->output);
+    segment->output = NULL;
+  }
+
+done:
+  gst_lamemp3enc_segment_free (segment);
+  return ret;
+}
+
+static void
+gst_lamemp3enc_discard_segments (GstLameMP3Enc * lame)
+{
+  while (!g_queue_is_empty (&lame->pending))
+    gst_lamemp3enc_finish_segment (lame, FALSE);
+
+  gst_buffer_replace (&lame->prime, NULL);
+  gst_buffer_replace (&lame->held, NULL);
+  if (lame->adapter)
+    gst_adapter_clear (lame->adapter);
+}
+
+static GstFlowReturn
+gst_lamemp3enc_handle_frame_parallel (GstLameMP3Enc * lame, GstBuffer * in_buf)
+{
+  GstLameMP3EncSegment *segment;
+  GstFlowReturn ret = GST_FLOW_OK;
+  guint max_pending;
+
+  /* drain, encode the held back segment as the last one and output
+   * everything */
+  if (G_UNLIKELY (in_buf == NULL)) {
+    if (lame->held) {
+      gst_lamemp3enc_queue_segment (lame, lame->held, NULL);
+      lame->held = NULL;
+    }
+
+    while (ret == GST_FLOW_OK && !g_queue_is_empty (&lame->pending))
+      ret = gst_lamemp3enc_finish_segment (lame, TRUE);
+
+    gst_lamemp3enc_discard_segments (lame);
+    return ret;
+  }
+
+  /* the start of this segment is the post-roll of the previous one */
+  if (lame->held) {
+    GstBuffer *postroll;
+    gsize size;
+
+    size = MIN (gst_buffer_get_size (in_buf), SEGMENT_OVERLAP_FRAMES *
+        lame_get_framesize (lame->lgf) * lame->bpf);
+    postroll = gst_buffer_copy_region (in_buf, GST_BUFFER_COPY_MEMORY, 0,
+        size);
+
+    gst_lamemp3enc_queue_segment (lame, lame->held, postroll);
+  }
+  lame->held = gst_buffer_ref (in_buf);
+
+  /* output finished segments in order, and wait for the oldest one if too
+   * many are in flight */
+  max_pending = 2 * g_thread_pool_get_max_threads (lame->pool);
+  while (ret == GST_FLOW_OK && !g_queue_is_empty (&lame->pending)) {
+    gboolean done;
+
+    segment = g_queue_peek_head (&lame->pending);
+
+    g_mutex_lock (&lame->lock);
+    done = segment->done;
+    g_mutex_unlock (&lame->lock);
+
+    if (!done && g_queue_get_length (&lame->pending) <= max_pending)
+      break;
+
+    ret = gst_lamemp3enc_finish_segment (lame, TRUE);
+  }
+
+  return ret;
 }
 
 static GstFlowReturn
@@ -770,29 +1362,24 @@ gst_lamemp3enc_handle_frame (GstAudioEncoder * enc, GstBuffer * in_buf)
 
   lame = GST_LAMEMP3ENC (enc);
 
+  if (lame->parallel)
+    return gst_lamemp3enc_handle_frame_parallel (lame, in_buf);
+
   /* squeeze remaining and push */
   if (G_UNLIKELY (in_buf == NULL))
     return gst_lamemp3enc_flush_full (lame, TRUE);
 
   gst_buffer_map (in_buf, &in_map, GST_MAP_READ);
 
-  num_samples = in_map.size / 2;
+  num_samples = in_map.size / lame->bpf * lame->num_channels;
 
   /* allocate space for output */
   mp3_buffer_size = 1.25 * num_samples + 7200;
   mp3_buf = gst_buffer_new_allocate (NULL, mp3_buffer_size, NULL);
   gst_buffer_map (mp3_buf, &mp3_map, GST_MAP_WRITE);
 
-  /* lame seems to be too stupid to get mono interleaved going */
-  if (lame->num_channels == 1) {
-    mp3_size = lame_encode_buffer (lame->lgf,
-        (short int *) in_map.data,
-        (short int *) in_map.data, num_samples, mp3_map.data, mp3_buffer_size);
-  } else {
-    mp3_size = lame_encode_buffer_interleaved (lame->lgf,
-        (short int *) in_map.data,
-        num_samples / lame->num_channels, mp3_map.data, mp3_buffer_size);
-  }
+  mp3_size = gst_lamemp3enc_encode (lame, lame->lgf, in_buf, &in_map,
+      mp3_map.data, mp3_buffer_size);
   gst_buffer_unmap (in_buf, &in_map);
 
   GST_LOG_OBJECT (lame, "encoded %" G_GSIZE_FORMAT " bytes of audio "
@@ -803,8 +1390,7 @@ gst_lamemp3enc_handle_frame (GstAudioEncoder * enc, GstBuffer * in_buf)
      * so collect output and parse into frames ... */
     gst_buffer_unmap (mp3_buf, &mp3_map);
     gst_buffer_resize (mp3_buf, 0, mp3_size);
-    gst_adapter_push (lame->adapter, mp3_buf);
-    result = gst_lamemp3enc_finish_frames (lame);
+    result = gst_lamemp3enc_finish_frames (lame, mp3_buf);
   } else {
     gst_buffer_unmap (mp3_buf, &mp3_map);
     if (mp3_size < 0) {
@@ -818,29 +1404,67 @@ gst_lamemp3enc_handle_frame (GstAudioEncoder * enc, GstBuffer * in_buf)
   return result;
 }
 
-/* set up the encoder state */
+/* applies the encoding settings to lgf; in- and output sample rate need to
+ * be set by the caller. The bit reservoir is only disabled for the instances
+ * encoding segments in parallel, frames of separately encoded segments can't
+ * share it. */
 static gboolean
-gst_lamemp3enc_setup (GstLameMP3Enc * lame, GstTagList ** tags)
+gst_lamemp3enc_apply_settings (GstLameMP3Enc * lame, lame_global_flags * lgf,
+    gboolean disable_reservoir)
 {
-  gboolean res;
-
 #define CHECK_ERROR(command) G_STMT_START {\
   if ((command) < 0) { \
     GST_ERROR_OBJECT (lame, "setup failed: " G_STRINGIFY (command)); \
-    if (*tags) { \
-      gst_tag_list_unref (*tags); \
-      *tags = NULL; \
-    } \
     return FALSE; \
   } \
 }G_STMT_END
 
+  CHECK_ERROR (lame_set_num_channels (lgf, lame->num_channels));
+  CHECK_ERROR (lame_set_bWriteVbrTag (lgf, 0));
+
+  if (lame->target == LAMEMP3ENC_TARGET_QUALITY) {
+    CHECK_ERROR (lame_set_VBR (lgf, vbr_default));
+    CHECK_ERROR (lame_set_VBR_quality (lgf, lame->quality));
+  } else {
+    if (lame->cbr) {
+      CHECK_ERROR (lame_set_VBR (lgf, vbr_off));
+      CHECK_ERROR (lame_set_brate (lgf, lame->bitrate));
+    } else {
+      CHECK_ERROR (lame_set_VBR (lgf, vbr_abr));
+      CHECK_ERROR (lame_set_VBR_mean_bitrate_kbps (lgf, lame->bitrate));
+    }
+  }
+
+  if (lame->encoding_engine_quality == LAMEMP3ENC_ENCODING_ENGINE_QUALITY_FAST)
+    CHECK_ERROR (lame_set_quality (lgf, 7));
+  else if (lame->encoding_engine_quality ==
+      LAMEMP3ENC_ENCODING_ENGINE_QUALITY_HIGH)
+    CHECK_ERROR (lame_set_quality (lgf, 2));
+  /* else default */
+
+  if (lame->mono)
+    CHECK_ERROR (lame_set_mode (lgf, MONO));
+
+  if (disable_reservoir)
+    CHECK_ERROR (lame_set_disable_reservoir (lgf, 1));
+
+  return TRUE;
+#undef CHECK_ERROR
+}
+
+/* set up the encoder state */
+static gboolean
+gst_lamemp3enc_setup (GstLameMP3Enc * lame, GstTagList ** tags)
+{
+  gboolean res;
   int retval;
   GstCaps *allowed_caps;
 
   GST_DEBUG_OBJECT (lame, "starting setup");
 
+  g_mutex_lock (&setup_lock);
   lame->lgf = lame_init ();
+  g_mutex_unlock (&setup_lock);
 
   if (lame->lgf == NULL)
     return FALSE;
@@ -874,37 +1498,27 @@ gst_lamemp3enc_setup (GstLameMP3Enc * lame, GstTagList ** tags)
     lame_set_out_samplerate (lame->lgf, 0);
   }
 
-  CHECK_ERROR (lame_set_num_channels (lame->lgf, lame->num_channels));
-  CHECK_ERROR (lame_set_bWriteVbrTag (lame->lgf, 0));
-
-  if (lame->target == LAMEMP3ENC_TARGET_QUALITY) {
-    CHECK_ERROR (lame_set_VBR (lame->lgf, vbr_default));
-    CHECK_ERROR (lame_set_VBR_quality (lame->lgf, lame->quality));
-  } else {
-    if (lame->cbr) {
+  if (lame->target == LAMEMP3ENC_TARGET_BITRATE) {
+    if (lame->cbr)
       CHECK_AND_FIXUP_BITRATE (lame, "bitrate", lame->bitrate);
-      CHECK_ERROR (lame_set_VBR (lame->lgf, vbr_off));
-      CHECK_ERROR (lame_set_brate (lame->lgf, lame->bitrate));
-    } else {
-      CHECK_ERROR (lame_set_VBR (lame->lgf, vbr_abr));
-      CHECK_ERROR (lame_set_VBR_mean_bitrate_kbps (lame->lgf, lame->bitrate));
-    }
     gst_tag_list_add (*tags, GST_TAG_MERGE_REPLACE, GST_TAG_BITRATE,
         lame->bitrate * 1000, NULL);
   }
 
-  if (lame->encoding_engine_quality == LAMEMP3ENC_ENCODING_ENGINE_QUALITY_FAST)
-    CHECK_ERROR (lame_set_quality (lame->lgf, 7));
-  else if (lame->encoding_engine_quality ==
-      LAMEMP3ENC_ENCODING_ENGINE_QUALITY_HIGH)
-    CHECK_ERROR (lame_set_quality (lame->lgf, 2));
-  /* else default */
-
-  if (lame->mono)
-    CHECK_ERROR (lame_set_mode (lame->lgf, MONO));
+  /* the serial instance only provides the stream parameters when encoding in
+   * parallel, so it keeps its bit reservoir */
+  if (!gst_lamemp3enc_apply_settings (lame, lame->lgf, FALSE)) {
+    gst_tag_list_unref (*tags);
+    *tags = NULL;
+    return FALSE;
+  }
 
   /* initialize the lame encoder */
-  if ((retval = lame_init_params (lame->lgf)) >= 0) {
+  g_mutex_lock (&setup_lock);
+  retval = lame_init_params (lame->lgf);
+  g_mutex_unlock (&setup_lock);
+
+  if (retval >= 0) {
     /* FIXME: it would be nice to print out the mode here */
     GST_INFO
         ("lame encoder setup (target %s, quality %f, bitrate %d, %d Hz, %d channels)",
@@ -918,7 +1532,6 @@ gst_lamemp3enc_setup (GstLameMP3Enc * lame, GstTagList ** tags)
 
   GST_DEBUG_OBJECT (lame, "done with setup");
   return res;
-#undef CHECK_ERROR
 }
 
 gboolean
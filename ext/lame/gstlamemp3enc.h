@@ -57,6 +57,9 @@ struct _GstLameMP3Enc {
   gint samplerate;
   gint out_samplerate;
   gint num_channels;
+  GstAudioFormat format;
+  gint bpf;
+  gboolean interleaved;
 
   /* properties */
   gint target;
@@ -65,10 +68,28 @@ struct _GstLameMP3Enc {
   gfloat quality;
   gint encoding_engine_quality;
   gboolean mono;
+  gint threads;
+  gint segment_frames;
 
   lame_global_flags *lgf;
 
-  GstAdapter *adapter;
+  GstAdapter *adapter;          /* incomplete frame */
+
+  /* recently parsed frame headers */
+  struct {
+    guint32 header;
+    guint size;
+    guint samples;
+  } headers[2];
+
+  /* parallel encoding of segments */
+  gboolean parallel;
+  GThreadPool *pool;
+  GQueue pending;               /* GstLameMP3EncSegment, in input order */
+  GMutex lock;
+  GCond cond;
+  GstBuffer *prime;             /* tail of the segment before held */
+  GstBuffer *held;              /* segment waiting for its post-roll */
 };
 
 struct _GstLameMP3EncClass {
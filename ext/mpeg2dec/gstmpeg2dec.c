@@ -41,6 +41,36 @@ GST_DEBUG_CATEGORY_STATIC (CAT_PERFORMANCE);
  */
 #define WARN_THRESHOLD (5)
 
+enum
+{
+  PROP_0,
+  PROP_SKIP_FRAMES,
+  PROP_GOP_JOBS
+};
+
+#define DEFAULT_SKIP_FRAMES MPEG2DEC_SKIP_FRAMES_NONE
+#define DEFAULT_GOP_JOBS 0
+
+#define GST_TYPE_MPEG2DEC_SKIP_FRAMES (gst_mpeg2dec_skip_frames_get_type())
+static GType
+gst_mpeg2dec_skip_frames_get_type (void)
+{
+  static GType skip_frames_type = 0;
+
+  static const GEnumValue skip_frames[] = {
+    {MPEG2DEC_SKIP_FRAMES_NONE, "Decode all pictures", "none"},
+    {MPEG2DEC_SKIP_FRAMES_B, "Skip B-pictures", "b"},
+    {MPEG2DEC_SKIP_FRAMES_NON_KEY, "Skip P- and B-pictures", "non-key"},
+    {0, NULL, NULL}
+  };
+
+  if (!skip_frames_type) {
+    skip_frames_type =
+        g_enum_register_static ("GstMpeg2decSkipFrames", skip_frames);
+  }
+  return skip_frames_type;
+}
+
 static GstStaticPadTemplate sink_template_factory =
 GST_STATIC_PAD_TEMPLATE ("sink",
     GST_PAD_SINK,
@@ -64,6 +94,10 @@ GST_STATIC_PAD_TEMPLATE ("src",
 G_DEFINE_TYPE (GstMpeg2dec, gst_mpeg2dec, GST_TYPE_VIDEO_DECODER);
 
 static void gst_mpeg2dec_finalize (GObject * object);
+static void gst_mpeg2dec_set_property (GObject * object, guint prop_id,
+    const GValue * value, GParamSpec * pspec);
+static void gst_mpeg2dec_get_property (GObject * object, guint prop_id,
+    GValue * value, GParamSpec * pspec);
 
 /* GstVideoDecoder base class method */
 static gboolean gst_mpeg2dec_open (GstVideoDecoder * decoder);
@@ -80,6 +114,8 @@ static gboolean gst_mpeg2dec_decide_allocation (GstVideoDecoder * decoder,
     GstQuery * query);
 
 static void gst_mpeg2dec_clear_buffers (GstMpeg2dec * mpeg2dec);
+static void gst_mpeg2dec_clear_gops (GstMpeg2dec * mpeg2dec);
+static GstFlowReturn gst_mpeg2dec_drain_gops (GstMpeg2dec * mpeg2dec);
 static gboolean gst_mpeg2dec_crop_buffer (GstMpeg2dec * dec,
     GstVideoCodecFrame * in_frame, GstVideoFrame * in_vframe);
 
@@ -91,6 +127,38 @@ gst_mpeg2dec_class_init (GstMpeg2decClass * klass)
   GstVideoDecoderClass *video_decoder_class = GST_VIDEO_DECODER_CLASS (klass);
 
   gobject_class->finalize = gst_mpeg2dec_finalize;
+  gobject_class->set_property = gst_mpeg2dec_set_property;
+  gobject_class->get_property = gst_mpeg2dec_get_property;
+
+  /**
+   * GstMpeg2dec:skip-frames:
+   *
+   * Pictures that are not decoded at all, for fast forward and thumbnails.
+   * Segments with the %GST_SEGMENT_FLAG_TRICKMODE_KEY_UNITS flag always skip
+   * all but the I-pictures.
+   */
+  g_object_class_install_property (gobject_class, PROP_SKIP_FRAMES,
+      g_param_spec_enum ("skip-frames", "Skip frames",
+          "Picture types that are dropped without decoding them",
+          GST_TYPE_MPEG2DEC_SKIP_FRAMES, DEFAULT_SKIP_FRAMES,
+          G_PARAM_READWRITE | GST_PARAM_MUTABLE_PLAYING |
+          G_PARAM_STATIC_STRINGS));
+
+  /**
+   * GstMpeg2dec:gop-jobs:
+   *
+   * For offline transcoding, decode this many independent GOPs at the same
+   * time, each with its own libmpeg2 instance. The stream is cut at closed
+   * GOPs and at open GOPs that don't start with B-pictures referring back
+   * to the previous GOP, and the decoded pictures are output in order. The
+   * output is then delayed by up to a GOP per job.
+   */
+  g_object_class_install_property (gobject_class, PROP_GOP_JOBS,
+      g_param_spec_uint ("gop-jobs", "GOP jobs",
+          "Number of GOPs decoded at the same time (0 = sequential decoding)",
+          0, G_MAXINT, DEFAULT_GOP_JOBS,
+          G_PARAM_READWRITE | GST_PARAM_MUTABLE_READY |
+          G_PARAM_STATIC_STRINGS));
 
   gst_element_class_add_static_pad_template (element_class,
       &src_template_factory);
@@ -127,9 +195,62 @@ gst_mpeg2dec_init (GstMpeg2dec * mpeg2dec)
       (mpeg2dec), TRUE);
   GST_PAD_SET_ACCEPT_TEMPLATE (GST_VIDEO_DECODER_SINK_PAD (mpeg2dec));
 
+  mpeg2dec->skip_frames = DEFAULT_SKIP_FRAMES;
+  mpeg2dec->gop_jobs = DEFAULT_GOP_JOBS;
+
+  g_queue_init (&mpeg2dec->gops);
+  g_mutex_init (&mpeg2dec->gop_lock);
+  g_cond_init (&mpeg2dec->gop_cond);
+
   /* initialize the mpeg2dec acceleration */
 }
 
+static void
+gst_mpeg2dec_set_property (GObject * object, guint prop_id,
+    const GValue * value, GParamSpec * pspec)
+{
+  GstMpeg2dec *mpeg2dec = GST_MPEG2DEC (object);
+
+  switch (prop_id) {
+    case PROP_SKIP_FRAMES:
+      GST_OBJECT_LOCK (mpeg2dec);
+      mpeg2dec->skip_frames = g_value_get_enum (value);
+      GST_OBJECT_UNLOCK (mpeg2dec);
+      break;
+    case PROP_GOP_JOBS:
+      GST_OBJECT_LOCK (mpeg2dec);
+      mpeg2dec->gop_jobs = g_value_get_uint (value);
+      GST_OBJECT_UNLOCK (mpeg2dec);
+      break;
+    default:
+      G_OBJECT_WARN_INVALID_PROPERTY_ID (object, prop_id, pspec);
+      break;
+  }
+}
+
+static void
+gst_mpeg2dec_get_property (GObject * object, guint prop_id, GValue * value,
+    GParamSpec * pspec)
+{
+  GstMpeg2dec *mpeg2dec = GST_MPEG2DEC (object);
+
+  switch (prop_id) {
+    case PROP_SKIP_FRAMES:
+      GST_OBJECT_LOCK (mpeg2dec);
+      g_value_set_enum (value, mpeg2dec->skip_frames);
+      GST_OBJECT_UNLOCK (mpeg2dec);
+      break;
+    case PROP_GOP_JOBS:
+      GST_OBJECT_LOCK (mpeg2dec);
+      g_value_set_uint (value, mpeg2dec->gop_jobs);
+      GST_OBJECT_UNLOCK (mpeg2dec);
+      break;
+    default:
+      G_OBJECT_WARN_INVALID_PROPERTY_ID (object, prop_id, pspec);
+      break;
+  }
+}
+
 static void
 gst_mpeg2dec_finalize (GObject * object)
 {
@@ -145,6 +266,9 @@ gst_mpeg2dec_finalize (GObject * object)
   g_free (mpeg2dec->dummybuf[3]);
   mpeg2dec->dummybuf[3] = NULL;
 
+  g_mutex_clear (&mpeg2dec->gop_lock);
+  g_cond_clear (&mpeg2dec->gop_cond);
+
   G_OBJECT_CLASS (parent_class)->finalize (object);
 }
 
@@ -195,6 +319,12 @@ gst_mpeg2dec_start (GstVideoDecoder * decoder)
   GstMpeg2dec *mpeg2dec = GST_MPEG2DEC (decoder);
 
   mpeg2dec->discont_state = MPEG2DEC_DISC_NEW_PICTURE;
+  mpeg2dec->skipping = FALSE;
+  mpeg2dec->broken_refs = 0;
+
+  GST_OBJECT_LOCK (mpeg2dec);
+  mpeg2dec->parallel = mpeg2dec->gop_jobs > 0;
+  GST_OBJECT_UNLOCK (mpeg2dec);
 
   return TRUE;
 }
@@ -208,6 +338,15 @@ gst_mpeg2dec_stop (GstVideoDecoder * decoder)
   mpeg2_skip (mpeg2dec->decoder, 1);
 
   gst_mpeg2dec_clear_buffers (mpeg2dec);
+  gst_mpeg2dec_clear_gops (mpeg2dec);
+  if (mpeg2dec->gop_pool) {
+    g_thread_pool_free (mpeg2dec->gop_pool, FALSE, TRUE);
+    mpeg2dec->gop_pool = NULL;
+  }
+  if (mpeg2dec->sequence) {
+    g_bytes_unref (mpeg2dec->sequence);
+    mpeg2dec->sequence = NULL;
+  }
 
   if (mpeg2dec->input_state)
     gst_video_codec_state_unref (mpeg2dec->input_state);
@@ -228,10 +367,13 @@ gst_mpeg2dec_flush (GstVideoDecoder * decoder)
 
   /* reset the initial video state */
   mpeg2dec->discont_state = MPEG2DEC_DISC_NEW_PICTURE;
+  mpeg2dec->skipping = FALSE;
+  mpeg2dec->broken_refs = 0;
   mpeg2_reset (mpeg2dec->decoder, 1);
   mpeg2_skip (mpeg2dec->decoder, 1);
 
   gst_mpeg2dec_clear_buffers (mpeg2dec);
+  gst_mpeg2dec_clear_gops (mpeg2dec);
 
   if (mpeg2dec->downstream_pool)
     gst_buffer_pool_set_active (mpeg2dec->downstream_pool, FALSE);
@@ -242,6 +384,11 @@ gst_mpeg2dec_flush (GstVideoDecoder * decoder)
 static GstFlowReturn
 gst_mpeg2dec_finish (GstVideoDecoder * decoder)
 {
+  GstMpeg2dec *mpeg2dec = GST_MPEG2DEC (decoder);
+
+  if (mpeg2dec->parallel)
+    return gst_mpeg2dec_drain_gops (mpeg2dec);
+
   return GST_FLOW_OK;
 }
 
@@ -858,6 +1005,94 @@ negotiation_fail:
   }
 }
 
+/* Whether the picture of @type is left undecoded, either because of
+ * skip-frames and trick mode, or because it refers to a skipped picture */
+static gboolean
+gst_mpeg2dec_skip_picture (GstMpeg2dec * mpeg2dec, gint type)
+{
+  GstVideoDecoder *decoder = (GstVideoDecoder *) mpeg2dec;
+  GstMpeg2decSkipFrames skip_frames;
+  gboolean skip;
+
+  GST_OBJECT_LOCK (mpeg2dec);
+  skip_frames = mpeg2dec->skip_frames;
+  GST_OBJECT_UNLOCK (mpeg2dec);
+
+  if (decoder->input_segment.flags & GST_SEGMENT_FLAG_TRICKMODE_KEY_UNITS)
+    skip_frames = MPEG2DEC_SKIP_FRAMES_NON_KEY;
+
+  switch (skip_frames) {
+    case MPEG2DEC_SKIP_FRAMES_B:
+      skip = type == PIC_FLAG_CODING_TYPE_B;
+      break;
+    case MPEG2DEC_SKIP_FRAMES_NON_KEY:
+      skip = type != PIC_FLAG_CODING_TYPE_I;
+      break;
+    default:
+      skip = FALSE;
+      break;
+  }
+
+  if (skip) {
+    if (type == PIC_FLAG_CODING_TYPE_P)
+      mpeg2dec->broken_refs = 2;
+    return TRUE;
+  }
+
+  /* the pictures predicted from a skipped P-picture can't be decoded
+   * either: P-pictures up to the next I-picture, and B-pictures up to the
+   * P-picture after it */
+  if ((mpeg2dec->broken_refs == 2 && type != PIC_FLAG_CODING_TYPE_I)
+      || (mpeg2dec->broken_refs == 1 && type == PIC_FLAG_CODING_TYPE_B)) {
+    GST_DEBUG_OBJECT (mpeg2dec, "skipping picture predicted from a skipped "
+        "picture");
+    return TRUE;
+  }
+
+  if (type != PIC_FLAG_CODING_TYPE_B && mpeg2dec->broken_refs > 0)
+    mpeg2dec->broken_refs--;
+
+  return FALSE;
+}
+
+/* Lets libmpeg2 parse the picture without decoding any of its slices into
+ * the scratch buffer, whose NULL id keeps it from being displayed, and
+ * drops the frame right away */
+static GstFlowReturn
+gst_mpeg2dec_drop_picture (GstMpeg2dec * mpeg2dec, GstVideoCodecFrame * frame)
+{
+  GST_DEBUG_OBJECT (mpeg2dec, "skipping picture of frame %i",
+      frame->system_frame_number);
+
+  mpeg2_skip (mpeg2dec->decoder, 1);
+  mpeg2dec->skipping = TRUE;
+
+  mpeg2_stride (mpeg2dec->decoder,
+      GST_VIDEO_INFO_PLANE_STRIDE (&mpeg2dec->decoded_info, 0));
+  mpeg2_set_buf (mpeg2dec->decoder, mpeg2dec->dummybuf, NULL);
+
+  gst_video_codec_frame_ref (frame);
+  return gst_video_decoder_drop_frame (GST_VIDEO_DECODER (mpeg2dec), frame);
+}
+
+static void
+gst_mpeg2dec_set_field_flags (const GstVideoInfo * info, GstBuffer * buffer,
+    guint32 flags)
+{
+  if (GST_VIDEO_INFO_IS_INTERLACED (info)) {
+    /* This implies SEQ_FLAG_PROGRESSIVE_SEQUENCE is not set */
+    if (flags & PIC_FLAG_TOP_FIELD_FIRST) {
+      GST_BUFFER_FLAG_SET (buffer, GST_VIDEO_BUFFER_FLAG_TFF);
+    }
+    if (!(flags & PIC_FLAG_PROGRESSIVE_FRAME)) {
+      GST_BUFFER_FLAG_SET (buffer, GST_VIDEO_BUFFER_FLAG_INTERLACED);
+    }
+    if (flags & PIC_FLAG_REPEAT_FIRST_FIELD) {
+      GST_BUFFER_FLAG_SET (buffer, GST_VIDEO_BUFFER_FLAG_RFF);
+    }
+  }
+}
+
 static GstFlowReturn
 handle_picture (GstMpeg2dec * mpeg2dec, const mpeg2_info_t * info,
     GstVideoCodecFrame * frame)
@@ -871,10 +1106,6 @@ handle_picture (GstMpeg2dec * mpeg2dec, const mpeg2_info_t * info,
   GstVideoFrame vframe;
   guint8 *buf[3];
 
-  ret = gst_video_decoder_allocate_output_frame (decoder, frame);
-  if (ret != GST_FLOW_OK)
-    return ret;
-
   type = picture->flags & PIC_MASK_CODING_TYPE;
   switch (type) {
     case PIC_FLAG_CODING_TYPE_I:
@@ -900,20 +1131,24 @@ handle_picture (GstMpeg2dec * mpeg2dec, const mpeg2_info_t * info,
   GST_DEBUG_OBJECT (mpeg2dec, "picture %s, frame %i",
       key_frame ? ", kf," : "    ", frame->system_frame_number);
 
-  if (GST_VIDEO_INFO_IS_INTERLACED (&mpeg2dec->decoded_info)) {
-    /* This implies SEQ_FLAG_PROGRESSIVE_SEQUENCE is not set */
-    if (picture->flags & PIC_FLAG_TOP_FIELD_FIRST) {
-      GST_BUFFER_FLAG_SET (frame->output_buffer, GST_VIDEO_BUFFER_FLAG_TFF);
-    }
-    if (!(picture->flags & PIC_FLAG_PROGRESSIVE_FRAME)) {
-      GST_BUFFER_FLAG_SET (frame->output_buffer,
-          GST_VIDEO_BUFFER_FLAG_INTERLACED);
-    }
-    if (picture->flags & PIC_FLAG_REPEAT_FIRST_FIELD) {
-      GST_BUFFER_FLAG_SET (frame->output_buffer, GST_VIDEO_BUFFER_FLAG_RFF);
-    }
+  if (gst_mpeg2dec_skip_picture (mpeg2dec, type))
+    return gst_mpeg2dec_drop_picture (mpeg2dec, frame);
+
+  /* decode again after skipped pictures, unless still waiting for the
+   * first keyframe */
+  if (mpeg2dec->skipping) {
+    mpeg2dec->skipping = FALSE;
+    if (mpeg2dec->discont_state != MPEG2DEC_DISC_NEW_PICTURE)
+      mpeg2_skip (mpeg2dec->decoder, 0);
   }
 
+  ret = gst_video_decoder_allocate_output_frame (decoder, frame);
+  if (ret != GST_FLOW_OK)
+    return ret;
+
+  gst_mpeg2dec_set_field_flags (&mpeg2dec->decoded_info, frame->output_buffer,
+      picture->flags);
+
   if (mpeg2dec->discont_state == MPEG2DEC_DISC_NEW_PICTURE && key_frame) {
     mpeg2dec->discont_state = MPEG2DEC_DISC_NEW_KEYFRAME;
   }
@@ -1036,6 +1271,501 @@ no_frame:
   }
 }
 
+/* GOP-parallel decoding: the main decoder only parses the headers, to
+ * negotiate and to find the places where the stream can be cut. The frames
+ * in between are decoded by a libmpeg2 instance of their own on a thread
+ * pool, into buffers laid out like the ones the main decoder would use. The
+ * GOPs are output in order once they are decoded. */
+typedef struct
+{
+  GstBuffer *buffer;
+  GstVideoFrame vframe;
+  gboolean mapped;
+  guint32 flags;
+} GstMpeg2decGopPicture;
+
+struct _GstMpeg2decGop
+{
+  GstVideoInfo info;
+
+  /* sequence header to decode first, if the GOP has none */
+  GBytes *sequence;
+
+  /* GstVideoCodecFrame, in decoding order, and their pictures */
+  GPtrArray *frames;
+  GstMpeg2decGopPicture *pictures;
+
+  /* indices of the pictures to output, in display order */
+  GArray *display;
+  guint8 *dummybuf[4];
+  gboolean keyframe;
+  gint errors;
+  gboolean done;
+};
+
+static void
+gst_mpeg2dec_gop_free (GstMpeg2decGop * gop)
+{
+  guint i;
+
+  for (i = 0; gop->pictures && i < gop->frames->len; i++) {
+    if (gop->pictures[i].buffer)
+      gst_buffer_unref (gop->pictures[i].buffer);
+  }
+  g_ptr_array_free (gop->frames, TRUE);
+  g_free (gop->pictures);
+  if (gop->display)
+    g_array_free (gop->display, TRUE);
+  if (gop->sequence)
+    g_bytes_unref (gop->sequence);
+  g_slice_free (GstMpeg2decGop, gop);
+}
+
+static void
+gst_mpeg2dec_gop_set_buf (GstMpeg2decGop * gop, mpeg2dec_t * decoder,
+    gint index)
+{
+  GstMpeg2decGopPicture *picture;
+  GstAllocationParams params;
+  guint8 *buf[3];
+
+  if (index < 0 || gop->pictures[index].buffer)
+    goto dummy;
+
+  picture = &gop->pictures[index];
+  gst_allocation_params_init (&params);
+  params.align = 15;
+  picture->buffer = gst_buffer_new_allocate (NULL, gop->info.size, &params);
+  if (!gst_video_frame_map (&picture->vframe, &gop->info, picture->buffer,
+          GST_MAP_READ | GST_MAP_WRITE))
+    goto dummy;
+  picture->mapped = TRUE;
+
+  buf[0] = GST_VIDEO_FRAME_PLANE_DATA (&picture->vframe, 0);
+  buf[1] = GST_VIDEO_FRAME_PLANE_DATA (&picture->vframe, 1);
+  buf[2] = GST_VIDEO_FRAME_PLANE_DATA (&picture->vframe, 2);
+
+  mpeg2_stride (decoder, GST_VIDEO_FRAME_PLANE_STRIDE (&picture->vframe, 0));
+  mpeg2_set_buf (decoder, buf, GINT_TO_POINTER (index + 1));
+  return;
+
+dummy:
+  mpeg2_stride (decoder, GST_VIDEO_INFO_PLANE_STRIDE (&gop->info, 0));
+  mpeg2_set_buf (decoder, gop->dummybuf, NULL);
+}
+
+static void
+gst_mpeg2dec_gop_display (GstMpeg2decGop * gop, const mpeg2_info_t * info)
+{
+  gint index = GPOINTER_TO_INT (info->display_fbuf->id) - 1;
+  guint32 flags = info->display_picture->flags;
+
+  /* pictures in front of the first I-picture of the stream miss their
+   * references */
+  if ((flags & PIC_MASK_CODING_TYPE) == PIC_FLAG_CODING_TYPE_I)
+    gop->keyframe = TRUE;
+  if (!gop->keyframe || (flags & PIC_FLAG_SKIP))
+    return;
+
+  gop->pictures[index].flags = flags;
+  g_array_append_val (gop->display, index);
+}
+
+static void
+gst_mpeg2dec_gop_parse (GstMpeg2decGop * gop, mpeg2dec_t * decoder,
+    const guint8 * data, gsize size, gint index)
+{
+  const mpeg2_info_t *info = mpeg2_info (decoder);
+  mpeg2_state_t state;
+
+  mpeg2_buffer (decoder, (guint8 *) data, (guint8 *) data + size);
+  while ((state = mpeg2_parse (decoder)) != STATE_BUFFER) {
+    switch (state) {
+      case STATE_SEQUENCE:
+      case STATE_SEQUENCE_MODIFIED:
+        mpeg2_custom_fbuf (decoder, 1);
+        mpeg2_set_buf (decoder, gop->dummybuf, NULL);
+        mpeg2_set_buf (decoder, gop->dummybuf, NULL);
+        mpeg2_set_buf (decoder, gop->dummybuf, NULL);
+        break;
+      case STATE_PICTURE:
+        gst_mpeg2dec_gop_set_buf (gop, decoder, index);
+        break;
+      case STATE_INVALID_END:
+      case STATE_END:
+      case STATE_SLICE:
+        if (info->display_fbuf && info->display_fbuf->id)
+          gst_mpeg2dec_gop_display (gop, info);
+        break;
+      case STATE_INVALID:
+        gop->errors++;
+        break;
+      default:
+        break;
+    }
+  }
+}
+
+/* runs on the GOP thread pool */
+static void
+gst_mpeg2dec_decode_gop (GstMpeg2decGop * gop, GstMpeg2dec * mpeg2dec)
+{
+  /* a sequence end code makes libmpeg2 output the last reference picture */
+  static const guint8 end_code[] = { 0x00, 0x00, 0x01, 0xb7 };
+  mpeg2dec_t *decoder;
+  GstMapInfo minfo;
+  guint i;
+
+  gop->dummybuf[3] = g_malloc0 (gop->info.size + 15);
+  gop->dummybuf[0] = ALIGN_16 (gop->dummybuf[3]);
+  gop->dummybuf[1] =
+      gop->dummybuf[0] + GST_VIDEO_INFO_PLANE_OFFSET (&gop->info, 1);
+  gop->dummybuf[2] =
+      gop->dummybuf[0] + GST_VIDEO_INFO_PLANE_OFFSET (&gop->info, 2);
+  gop->pictures = g_new0 (GstMpeg2decGopPicture, gop->frames->len);
+  gop->display = g_array_new (FALSE, FALSE, sizeof (gint));
+
+  if ((decoder = mpeg2_init ()) == NULL) {
+    gop->errors++;
+    goto done;
+  }
+
+  if (gop->sequence) {
+    gst_mpeg2dec_gop_parse (gop, decoder,
+        g_bytes_get_data (gop->sequence, NULL),
+        g_bytes_get_size (gop->sequence), -1);
+  }
+
+  for (i = 0; i < gop->frames->len; i++) {
+    GstVideoCodecFrame *frame = g_ptr_array_index (gop->frames, i);
+
+    if (!gst_buffer_map (frame->input_buffer, &minfo, GST_MAP_READ)) {
+      gop->errors++;
+      continue;
+    }
+    gst_mpeg2dec_gop_parse (gop, decoder, minfo.data, minfo.size, i);
+    gst_buffer_unmap (frame->input_buffer, &minfo);
+  }
+  gst_mpeg2dec_gop_parse (gop, decoder, end_code, sizeof (end_code), -1);
+
+  mpeg2_close (decoder);
+
+done:
+  for (i = 0; i < gop->frames->len; i++) {
+    if (gop->pictures[i].mapped)
+      gst_video_frame_unmap (&gop->pictures[i].vframe);
+  }
+  g_free (gop->dummybuf[3]);
+
+  g_mutex_lock (&mpeg2dec->gop_lock);
+  gop->done = TRUE;
+  g_cond_broadcast (&mpeg2dec->gop_cond);
+  g_mutex_unlock (&mpeg2dec->gop_lock);
+}
+
+static void
+gst_mpeg2dec_submit_gop (GstMpeg2dec * mpeg2dec)
+{
+  GstMpeg2decGop *gop = mpeg2dec->gop;
+
+  mpeg2dec->gop = NULL;
+  if (!gop)
+    return;
+
+  if (!mpeg2dec->gop_pool)
+    mpeg2dec->gop_pool =
+        g_thread_pool_new ((GFunc) gst_mpeg2dec_decode_gop, mpeg2dec,
+        mpeg2dec->gop_jobs, FALSE, NULL);
+
+  GST_DEBUG_OBJECT (mpeg2dec, "submitting GOP of %u frames", gop->frames->len);
+
+  g_queue_push_tail (&mpeg2dec->gops, gop);
+  g_thread_pool_push (mpeg2dec->gop_pool, gop, NULL);
+}
+
+/* appends a frame to the GOP being collected, starting a new one first if
+ * the stream can be cut in front of the frame */
+static void
+gst_mpeg2dec_add_gop_frame (GstMpeg2dec * mpeg2dec, GstVideoCodecFrame * frame,
+    gboolean split, gboolean sequence)
+{
+  GstMpeg2decGop *gop;
+
+  if (split)
+    gst_mpeg2dec_submit_gop (mpeg2dec);
+
+  if (!(gop = mpeg2dec->gop)) {
+    gop = g_slice_new0 (GstMpeg2decGop);
+    gop->info = mpeg2dec->decoded_info;
+    gop->frames =
+        g_ptr_array_new_with_free_func ((GDestroyNotify)
+        gst_video_codec_frame_unref);
+    if (!sequence && mpeg2dec->sequence)
+      gop->sequence = g_bytes_ref (mpeg2dec->sequence);
+    mpeg2dec->gop = gop;
+  }
+
+  g_ptr_array_add (gop->frames, frame);
+}
+
+static GstFlowReturn
+gst_mpeg2dec_finish_picture (GstMpeg2dec * mpeg2dec, GstMpeg2decGop * gop,
+    gint index)
+{
+  GstVideoDecoder *decoder = (GstVideoDecoder *) mpeg2dec;
+  GstVideoCodecFrame *frame = g_ptr_array_index (gop->frames, index);
+  GstMpeg2decGopPicture *picture = &gop->pictures[index];
+  GstFlowReturn ret;
+
+  gst_video_codec_frame_ref (frame);
+  gst_mpeg2dec_set_field_flags (&gop->info, picture->buffer, picture->flags);
+
+  /* do cropping if the target region is smaller than the input one */
+  if (mpeg2dec->downstream_pool) {
+    GstVideoFrame vframe;
+
+    if (!gst_video_frame_map (&vframe, &gop->info, picture->buffer,
+            GST_MAP_READ)) {
+      gst_video_decoder_drop_frame (decoder, frame);
+      GST_ELEMENT_ERROR (mpeg2dec, RESOURCE, READ, ("Failed to map frame"),
+          (NULL));
+      return GST_FLOW_ERROR;
+    }
+    ret = gst_mpeg2dec_crop_buffer (mpeg2dec, frame, &vframe);
+    gst_video_frame_unmap (&vframe);
+
+    if (ret != GST_FLOW_OK) {
+      gst_video_decoder_drop_frame (decoder, frame);
+      return ret;
+    }
+  } else {
+    frame->output_buffer = gst_buffer_ref (picture->buffer);
+    if (mpeg2dec->need_alignment) {
+      gst_buffer_add_video_meta_full (frame->output_buffer,
+          GST_VIDEO_FRAME_FLAG_NONE, GST_VIDEO_INFO_FORMAT (&gop->info),
+          GST_VIDEO_INFO_WIDTH (&gop->info), GST_VIDEO_INFO_HEIGHT (&gop->info),
+          GST_VIDEO_INFO_N_PLANES (&gop->info), gop->info.offset,
+          gop->info.stride);
+    }
+  }
+
+  return gst_video_decoder_finish_frame (decoder, frame);
+}
+
+static GstFlowReturn
+gst_mpeg2dec_push_gop (GstMpeg2dec * mpeg2dec, GstMpeg2decGop * gop,
+    gboolean send)
+{
+  GstVideoDecoder *decoder = (GstVideoDecoder *) mpeg2dec;
+  GstFlowReturn ret = GST_FLOW_OK;
+  guint i;
+
+  if (!send)
+    return GST_FLOW_OK;
+
+  if (gop->errors > 0) {
+    GST_VIDEO_DECODER_ERROR (decoder, gop->errors, STREAM, DECODE,
+        ("decoding error"), ("Reached libmpeg2 invalid state"), ret);
+    if (ret != GST_FLOW_OK)
+      return ret;
+  }
+
+  for (i = 0; i < gop->display->len && ret == GST_FLOW_OK; i++) {
+    gint index = g_array_index (gop->display, gint, i);
+
+    ret = gst_mpeg2dec_finish_picture (mpeg2dec, gop, index);
+    gst_buffer_unref (gop->pictures[index].buffer);
+    gop->pictures[index].buffer = NULL;
+  }
+
+  /* the frames that were not displayed */
+  for (i = 0; i < gop->frames->len && ret == GST_FLOW_OK; i++) {
+    if (gop->pictures[i].buffer || !gop->pictures[i].flags) {
+      GstVideoCodecFrame *frame = g_ptr_array_index (gop->frames, i);
+
+      ret = gst_video_decoder_drop_frame (decoder,
+          gst_video_codec_frame_ref (frame));
+    }
+  }
+
+  return ret;
+}
+
+/* outputs the decoded GOPs at the head of the queue, waiting for them if all
+ * GOPs are wanted or too many are in flight */
+static GstFlowReturn
+gst_mpeg2dec_finish_gops (GstMpeg2dec * mpeg2dec, gboolean all, gboolean send)
+{
+  GstFlowReturn ret = GST_FLOW_OK;
+  GstMpeg2decGop *gop;
+
+  while ((gop = g_queue_peek_head (&mpeg2dec->gops))) {
+    gboolean done;
+
+    g_mutex_lock (&mpeg2dec->gop_lock);
+    if (all || mpeg2dec->gops.length > mpeg2dec->gop_jobs) {
+      while (!gop->done)
+        g_cond_wait (&mpeg2dec->gop_cond, &mpeg2dec->gop_lock);
+    }
+    done = gop->done;
+    g_mutex_unlock (&mpeg2dec->gop_lock);
+
+    if (!done)
+      break;
+
+    g_queue_pop_head (&mpeg2dec->gops);
+    if (ret == GST_FLOW_OK)
+      ret = gst_mpeg2dec_push_gop (mpeg2dec, gop, send);
+    gst_mpeg2dec_gop_free (gop);
+  }
+
+  return ret;
+}
+
+static GstFlowReturn
+gst_mpeg2dec_drain_gops (GstMpeg2dec * mpeg2dec)
+{
+  if (mpeg2dec->open_gop) {
+    gst_mpeg2dec_add_gop_frame (mpeg2dec, mpeg2dec->open_gop, FALSE,
+        mpeg2dec->open_gop_sequence);
+    mpeg2dec->open_gop = NULL;
+  }
+  gst_mpeg2dec_submit_gop (mpeg2dec);
+
+  return gst_mpeg2dec_finish_gops (mpeg2dec, TRUE, TRUE);
+}
+
+static void
+gst_mpeg2dec_clear_gops (GstMpeg2dec * mpeg2dec)
+{
+  if (mpeg2dec->open_gop) {
+    gst_video_codec_frame_unref (mpeg2dec->open_gop);
+    mpeg2dec->open_gop = NULL;
+  }
+  if (mpeg2dec->gop) {
+    gst_mpeg2dec_gop_free (mpeg2dec->gop);
+    mpeg2dec->gop = NULL;
+  }
+  gst_mpeg2dec_finish_gops (mpeg2dec, TRUE, FALSE);
+}
+
+/* copies the sequence header and its extensions up to the next GOP or
+ * picture header */
+static GBytes *
+gst_mpeg2dec_copy_sequence (const guint8 * data, gsize size)
+{
+  gsize i, start = size;
+
+  for (i = 0; i + 3 < size; i++) {
+    if (data[i] != 0x00 || data[i + 1] != 0x00 || data[i + 2] != 0x01)
+      continue;
+    if (start == size) {
+      if (data[i + 3] == 0xb3)
+        start = i;
+    } else if (data[i + 3] == 0xb8 || data[i + 3] == 0x00) {
+      return g_bytes_new (data + start, i - start);
+    }
+  }
+
+  return NULL;
+}
+
+static GstFlowReturn
+gst_mpeg2dec_queue_frame (GstMpeg2dec * mpeg2dec, GstVideoCodecFrame * frame,
+    GstMapInfo * minfo)
+{
+  GstVideoDecoder *decoder = (GstVideoDecoder *) mpeg2dec;
+  const mpeg2_info_t *info = mpeg2dec->info;
+  mpeg2_state_t state;
+  GstFlowReturn ret = GST_FLOW_OK;
+  gboolean sequence = FALSE, modified = FALSE;
+  gboolean gop_start = FALSE, closed = FALSE;
+  gint type = 0;
+
+  mpeg2_buffer (mpeg2dec->decoder, minfo->data, minfo->data + minfo->size);
+  while ((state = mpeg2_parse (mpeg2dec->decoder)) != STATE_BUFFER) {
+    switch (state) {
+      case STATE_SEQUENCE_MODIFIED:
+        GST_DEBUG_OBJECT (mpeg2dec, "sequence modified");
+        modified = TRUE;
+        /* fall through */
+      case STATE_SEQUENCE:
+        /* the queued GOPs were set up for the previous sequence, output
+         * them before the new one changes the output state */
+        ret = gst_mpeg2dec_drain_gops (mpeg2dec);
+        if (ret != GST_FLOW_OK) {
+          gst_video_decoder_drop_frame (decoder, frame);
+          return ret;
+        }
+        ret = handle_sequence (mpeg2dec, info);
+        if (ret == GST_FLOW_ERROR) {
+          GST_VIDEO_DECODER_ERROR (decoder, 1, STREAM, DECODE,
+              ("decoding error"), ("Bad sequence header"), ret);
+          gst_video_decoder_drop_frame (decoder, frame);
+          gst_mpeg2dec_flush (decoder);
+          return ret;
+        }
+        /* fall through */
+      case STATE_SEQUENCE_REPEATED:
+        sequence = TRUE;
+        break;
+      case STATE_GOP:
+        gop_start = TRUE;
+        closed = (info->gop->flags &
+            (GOP_FLAG_CLOSED_GOP | GOP_FLAG_BROKEN_LINK)) != 0;
+        break;
+      case STATE_PICTURE:
+        type = info->current_picture->flags & PIC_MASK_CODING_TYPE;
+        /* the slices are decoded by the GOP decoders */
+        mpeg2_skip (mpeg2dec->decoder, 1);
+        mpeg2_stride (mpeg2dec->decoder,
+            GST_VIDEO_INFO_PLANE_STRIDE (&mpeg2dec->decoded_info, 0));
+        mpeg2_set_buf (mpeg2dec->decoder, mpeg2dec->dummybuf, NULL);
+        break;
+      case STATE_INVALID:
+        GST_VIDEO_DECODER_ERROR (decoder, 1, STREAM, DECODE,
+            ("decoding error"), ("Reached libmpeg2 invalid state"), ret);
+        if (ret != GST_FLOW_OK) {
+          gst_video_decoder_drop_frame (decoder, frame);
+          return ret;
+        }
+        break;
+      default:
+        break;
+    }
+  }
+
+  /* an open GOP can only be cut off if its I-picture is not followed by
+   * B-pictures that refer to the previous GOP */
+  if (type != 0 && mpeg2dec->open_gop) {
+    gst_mpeg2dec_add_gop_frame (mpeg2dec, mpeg2dec->open_gop,
+        type != PIC_FLAG_CODING_TYPE_B, mpeg2dec->open_gop_sequence);
+    mpeg2dec->open_gop = NULL;
+  }
+
+  if (sequence) {
+    if (mpeg2dec->sequence)
+      g_bytes_unref (mpeg2dec->sequence);
+    mpeg2dec->sequence = gst_mpeg2dec_copy_sequence (minfo->data, minfo->size);
+  }
+
+  if (type == 0 || gst_mpeg2dec_skip_picture (mpeg2dec, type)) {
+    GST_DEBUG_OBJECT (mpeg2dec, "dropping frame %i",
+        frame->system_frame_number);
+    return gst_video_decoder_drop_frame (decoder, frame);
+  }
+
+  if (gop_start && !closed && !modified) {
+    mpeg2dec->open_gop = frame;
+    mpeg2dec->open_gop_sequence = sequence;
+  } else {
+    gst_mpeg2dec_add_gop_frame (mpeg2dec, frame, modified || gop_start,
+        sequence);
+  }
+
+  return gst_mpeg2dec_finish_gops (mpeg2dec, FALSE, TRUE);
+}
+
 static GstFlowReturn
 gst_mpeg2dec_handle_frame (GstVideoDecoder * decoder,
     GstVideoCodecFrame * frame)
@@ -1059,6 +1789,11 @@ gst_mpeg2dec_handle_frame (GstVideoDecoder * decoder,
     return GST_FLOW_ERROR;
   }
 
+  if (mpeg2dec->parallel) {
+    ret = gst_mpeg2dec_queue_frame (mpeg2dec, frame, &minfo);
+    goto done;
+  }
+
   info = mpeg2dec->info;
 
   GST_LOG_OBJECT (mpeg2dec, "calling mpeg2_buffer");
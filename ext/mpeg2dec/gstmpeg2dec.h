@@ -45,6 +45,7 @@ G_BEGIN_DECLS
 
 typedef struct _GstMpeg2dec GstMpeg2dec;
 typedef struct _GstMpeg2decClass GstMpeg2decClass;
+typedef struct _GstMpeg2decGop GstMpeg2decGop;
 
 typedef enum
 {
@@ -53,6 +54,13 @@ typedef enum
   MPEG2DEC_DISC_NEW_KEYFRAME
 } DiscontState;
 
+typedef enum
+{
+  MPEG2DEC_SKIP_FRAMES_NONE     = 0,
+  MPEG2DEC_SKIP_FRAMES_B,
+  MPEG2DEC_SKIP_FRAMES_NON_KEY
+} GstMpeg2decSkipFrames;
+
 struct _GstMpeg2dec {
   GstVideoDecoder element;
 
@@ -76,6 +84,24 @@ struct _GstMpeg2dec {
   gboolean            need_alignment;
 
   guint8        *dummybuf[4];
+
+  /* pictures left undecoded */
+  GstMpeg2decSkipFrames skip_frames;
+  gboolean       skipping;
+  guint          broken_refs;    /* references still to decode after a
+                                  * skipped P-picture */
+
+  /* GOP-parallel decoding */
+  guint          gop_jobs;
+  gboolean       parallel;
+  GBytes        *sequence;
+  GstVideoCodecFrame *open_gop;
+  gboolean       open_gop_sequence;
+  GstMpeg2decGop *gop;
+  GQueue         gops;
+  GThreadPool   *gop_pool;
+  GMutex         gop_lock;
+  GCond          gop_cond;
 };
 
 struct _GstMpeg2decClass {
@@ -28,13 +28,28 @@
  * This plugin will first load the complete program into memory before starting
  * the emulator and producing output.
  *
+ * The emulator renders audio as fast as downstream consumes it. When
+ * rendering to files rather than playing back, set #GstSidDec:offline to
+ * output a second of audio per buffer, or a larger #GstSidDec:blocksize,
+ * which reduces the per-buffer overhead.
+ *
  * Seeking is not (and cannot be) implemented.
  *
+ * A .sid file usually contains several songs (subtunes), of which one is
+ * selected with the #GstSidDec:tune property. The number of songs in the file
+ * and the song being played are posted as #GST_TAG_TRACK_COUNT and
+ * #GST_TAG_TRACK_NUMBER tags. libsidplay keeps the emulator state in global
+ * variables, so the songs of a collection can only be rendered in parallel by
+ * running one process per song.
+ *
  * <refsect2>
  * <title>Example pipelines</title>
  * |[
  * gst-launch-1.0 -v filesrc location=Hawkeye.sid ! siddec ! audioconvert ! audioresample ! autoaudiosink
  * ]| Decode a sid file and play it back.
+ * |[
+ * gst-launch-1.0 -v filesrc location=Hawkeye.sid ! siddec tune=3 offline=true ! audioconvert ! wavenc ! filesink location=Hawkeye-3.wav
+ * ]| Render the third song of a sid file to a WAV file.
  * </refsect2>
  */
 
@@ -54,6 +69,7 @@
 #define DEFAULT_MOS8580		FALSE
 #define DEFAULT_FORCE_SPEED	FALSE
 #define DEFAULT_BLOCKSIZE	4096
+#define DEFAULT_OFFLINE		FALSE
 
 enum
 {
@@ -66,7 +82,8 @@ enum
   PROP_MOS8580,
   PROP_FORCE_SPEED,
   PROP_BLOCKSIZE,
-  PROP_METADATA
+  PROP_METADATA,
+  PROP_OFFLINE
 };
 
 static GstStaticPadTemplate sink_templ = GST_STATIC_PAD_TEMPLATE ("sink",
@@ -125,6 +142,9 @@ gst_sid_memory_get_type (void)
 }
 
 static void gst_siddec_finalize (GObject * object);
+static GstStateChangeReturn gst_siddec_change_state (GstElement * element,
+    GstStateChange transition);
+static void siddec_release_pool (GstSidDec * siddec);
 
 static GstFlowReturn gst_siddec_chain (GstPad * pad, GstObject * parent,
     GstBuffer * buffer);
@@ -159,6 +179,8 @@ gst_siddec_class_init (GstSidDecClass * klass)
   gobject_class->set_property = gst_siddec_set_property;
   gobject_class->get_property = gst_siddec_get_property;
 
+  gstelement_class->change_state = gst_siddec_change_state;
+
   g_object_class_install_property (G_OBJECT_CLASS (klass), PROP_TUNE,
       g_param_spec_int ("tune", "tune", "tune",
           0, 100, DEFAULT_TUNE,
@@ -193,6 +215,17 @@ gst_siddec_class_init (GstSidDecClass * klass)
   g_object_class_install_property (gobject_class, PROP_METADATA,
       g_param_spec_boxed ("metadata", "Metadata", "Metadata", GST_TYPE_CAPS,
           (GParamFlags) (G_PARAM_READABLE | G_PARAM_STATIC_STRINGS)));
+  /**
+   * GstSidDec:offline:
+   *
+   * Render for files rather than for playback: output at least a second of
+   * audio per buffer, whatever #GstSidDec:blocksize is set to.
+   */
+  g_object_class_install_property (gobject_class, PROP_OFFLINE,
+      g_param_spec_boolean ("offline", "Offline",
+          "Output a second of audio per buffer at least, for rendering to "
+          "files", DEFAULT_OFFLINE,
+          (GParamFlags) (G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS)));
 
   gst_element_class_set_static_metadata (gstelement_class, "Sid decoder",
       "Codec/Decoder/Audio", "Use libsidplay to decode SID audio tunes",
@@ -238,6 +271,11 @@ gst_siddec_init (GstSidDec * siddec)
   siddec->tune_number = 0;
   siddec->total_bytes = 0;
   siddec->blocksize = DEFAULT_BLOCKSIZE;
+  siddec->offline = DEFAULT_OFFLINE;
+  siddec->bytes_per_sample = 0;
+  siddec->byterate = 0;
+  siddec->pool = NULL;
+  siddec->pool_size = 0;
 
   siddec->have_group_id = FALSE;
   siddec->group_id = G_MAXUINT;
@@ -251,6 +289,8 @@ gst_siddec_finalize (GObject * object)
   g_free (siddec->config);
   g_free (siddec->tune_buffer);
 
+  siddec_release_pool (siddec);
+
   delete (siddec->tune);
   delete (siddec->engine);
 
@@ -278,10 +318,87 @@ update_tags (GstSidDec * siddec)
       gst_tag_list_add (list, GST_TAG_MERGE_REPLACE,
           GST_TAG_COPYRIGHT, info.copyrightString, (void *) NULL);
     }
+    if (info.songs > 0) {
+      guint song;
+
+      /* tune 0 selects the default song of the file */
+      song = siddec->tune_number > 0 ? siddec->tune_number : info.startSong;
+
+      GST_DEBUG_OBJECT (siddec, "playing song %u of %u", song, info.songs);
+
+      gst_tag_list_add (list, GST_TAG_MERGE_REPLACE,
+          GST_TAG_TRACK_NUMBER, song, GST_TAG_TRACK_COUNT,
+          (guint) info.songs, (void *) NULL);
+    }
     gst_pad_push_event (siddec->srcpad, gst_event_new_tag (list));
   }
 }
 
+static void
+siddec_release_pool (GstSidDec * siddec)
+{
+  if (siddec->pool) {
+    gst_buffer_pool_set_active (siddec->pool, FALSE);
+    gst_object_unref (siddec->pool);
+    siddec->pool = NULL;
+  }
+  siddec->pool_size = 0;
+}
+
+/* (re)creates the pool we take our output buffers from */
+static gboolean
+siddec_setup_pool (GstSidDec * siddec, guint size)
+{
+  GstStructure *config;
+
+  siddec_release_pool (siddec);
+
+  siddec->pool = gst_buffer_pool_new ();
+  siddec->pool_size = size;
+
+  config = gst_buffer_pool_get_config (siddec->pool);
+  gst_buffer_pool_config_set_params (config, NULL, size, 0, 0);
+  if (!gst_buffer_pool_set_config (siddec->pool, config))
+    goto config_failed;
+
+  if (!gst_buffer_pool_set_active (siddec->pool, TRUE))
+    goto activate_failed;
+
+  return TRUE;
+
+  /* ERRORS */
+config_failed:
+  {
+    GST_WARNING_OBJECT (siddec, "failed to configure buffer pool");
+    goto error;
+  }
+activate_failed:
+  {
+    GST_WARNING_OBJECT (siddec, "failed to activate buffer pool");
+    goto error;
+  }
+error:
+  {
+    gst_object_unref (siddec->pool);
+    siddec->pool = NULL;
+    siddec->pool_size = 0;
+    return FALSE;
+  }
+}
+
+/* the size of the next output buffer, in whole samples */
+static guint
+siddec_get_blocksize (GstSidDec * siddec)
+{
+  guint blocksize = siddec->blocksize;
+
+  if (siddec->offline)
+    blocksize = MAX (blocksize, siddec->byterate);
+
+  return MAX (blocksize - blocksize % siddec->bytes_per_sample,
+      siddec->bytes_per_sample);
+}
+
 static gboolean
 siddec_negotiate (GstSidDec * siddec)
 {
@@ -371,6 +488,13 @@ siddec_negotiate (GstSidDec * siddec)
 
   siddec->engine->setConfig (*siddec->config);
 
+  siddec->bytes_per_sample =
+      (siddec->config->bitsPerSample >> 3) * siddec->config->channels;
+  siddec->byterate = siddec->bytes_per_sample * siddec->config->frequency;
+
+  if (!siddec_setup_pool (siddec, siddec_get_blocksize (siddec)))
+    return FALSE;
+
   return TRUE;
 
   /* ERRORS */
@@ -394,43 +518,39 @@ play_loop (GstPad * pad)
   GstSidDec *siddec;
   GstBuffer *out;
   GstMapInfo outmap;
-  gint64 value, offset, time = 0;
-  GstFormat format;
+  guint blocksize;
+  guint64 start_time, end_time;
 
   siddec = GST_SIDDEC (gst_pad_get_parent (pad));
 
-  out = gst_buffer_new_and_alloc (siddec->blocksize);
+  /* blocksize may have been changed while running */
+  blocksize = siddec_get_blocksize (siddec);
+  if (blocksize != siddec->pool_size
+      && !siddec_setup_pool (siddec, blocksize)) {
+    ret = GST_FLOW_ERROR;
+    goto pause;
+  }
+
+  ret = gst_buffer_pool_acquire_buffer (siddec->pool, &out, NULL);
+  if (ret != GST_FLOW_OK)
+    goto pause;
 
   gst_buffer_map (out, &outmap, GST_MAP_WRITE);
-  sidEmuFillBuffer (*siddec->engine, *siddec->tune,
-      outmap.data, siddec->blocksize);
+  sidEmuFillBuffer (*siddec->engine, *siddec->tune, outmap.data, blocksize);
   gst_buffer_unmap (out, &outmap);
 
-  /* get offset in samples */
-  format = GST_FORMAT_DEFAULT;
-  if (gst_siddec_src_convert (siddec->srcpad,
-        GST_FORMAT_BYTES, siddec->total_bytes, &format, &offset))
-    GST_BUFFER_OFFSET (out) = offset;
-
-  /* get current timestamp */
-  format = GST_FORMAT_TIME;
-  if (gst_siddec_src_convert (siddec->srcpad,
-        GST_FORMAT_BYTES, siddec->total_bytes, &format, &time))
-    GST_BUFFER_TIMESTAMP (out) = time;
+  /* offsets in samples, timestamps from the cached byte rate */
+  start_time = gst_util_uint64_scale_int (siddec->total_bytes, GST_SECOND,
+      siddec->byterate);
+  GST_BUFFER_OFFSET (out) = siddec->total_bytes / siddec->bytes_per_sample;
+  GST_BUFFER_TIMESTAMP (out) = start_time;
 
-  /* update position and get new timestamp to calculate duration */
-  siddec->total_bytes += siddec->blocksize;
+  siddec->total_bytes += blocksize;
 
-  /* get offset in samples */
-  format = GST_FORMAT_DEFAULT;
-  if (gst_siddec_src_convert (siddec->srcpad,
-        GST_FORMAT_BYTES, siddec->total_bytes, &format, &value))
-    GST_BUFFER_OFFSET_END (out) = value;
-
-  format = GST_FORMAT_TIME;
-  if (gst_siddec_src_convert (siddec->srcpad,
-        GST_FORMAT_BYTES, siddec->total_bytes, &format, &value))
-    GST_BUFFER_DURATION (out) = value - time;
+  end_time = gst_util_uint64_scale_int (siddec->total_bytes, GST_SECOND,
+      siddec->byterate);
+  GST_BUFFER_OFFSET_END (out) = siddec->total_bytes / siddec->bytes_per_sample;
+  GST_BUFFER_DURATION (out) = end_time - start_time;
 
   if ((ret = gst_pad_push (siddec->srcpad, out)) != GST_FLOW_OK)
     goto pause;
@@ -507,6 +627,28 @@ could_not_init:
   }
 }
 
+static GstStateChangeReturn
+gst_siddec_change_state (GstElement * element, GstStateChange transition)
+{
+  GstSidDec *siddec = GST_SIDDEC (element);
+  GstStateChangeReturn ret;
+
+  ret = GST_ELEMENT_CLASS (parent_class)->change_state (element, transition);
+
+  switch (transition) {
+    case GST_STATE_CHANGE_PAUSED_TO_READY:
+      /* the streaming task is stopped now */
+      siddec_release_pool (siddec);
+      siddec->tune_len = 0;
+      siddec->total_bytes = 0;
+      break;
+    default:
+      break;
+  }
+
+  return ret;
+}
+
 static gboolean
 gst_siddec_sink_event (GstPad * pad, GstObject * parent, GstEvent * event)
 {
@@ -712,6 +854,9 @@ gst_siddec_set_property (GObject * object, guint prop_id, const GValue * value,
     case PROP_BLOCKSIZE:
       siddec->blocksize = g_value_get_uint (value);
       break;
+    case PROP_OFFLINE:
+      siddec->offline = g_value_get_boolean (value);
+      break;
     case PROP_FORCE_SPEED:
       siddec->config->forceSongSpeed = g_value_get_boolean (value);
       break;
@@ -756,6 +901,9 @@ gst_siddec_get_property (GObject * object, guint prop_id, GValue * value,
     case PROP_METADATA:
       g_value_set_boxed (value, NULL);
       break;
+    case PROP_OFFLINE:
+      g_value_set_boolean (value, siddec->offline);
+      break;
     default:
       G_OBJECT_WARN_INVALID_PROPERTY_ID (object, prop_id, pspec);
       break;
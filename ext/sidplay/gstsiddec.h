@@ -62,6 +62,15 @@ struct _GstSidDec {
   emuConfig     *config;
 
   guint         blocksize;
+  gboolean      offline;
+
+  /* conversion factors, cached in siddec_negotiate() */
+  guint          bytes_per_sample;
+  guint          byterate;
+
+  /* output buffers of pool_size bytes */
+  GstBufferPool *pool;
+  guint          pool_size;
 };
 
 struct _GstSidDecClass {
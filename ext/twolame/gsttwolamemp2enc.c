@@ -44,8 +44,21 @@
  * |[
  * gst-launch-1.0 -v cdda://5 ! audioconvert ! twolame bitrate=192 ! filesink location=track5.mp2
  * ]| Encode Audio CD track 5 to MP2
+ * |[
+ * gst-launch-1.0 -v filesrc location=archive.wav ! wavparse ! audioconvert ! twolame threads=0 bitrate=256 ! filesink location=archive.mp2
+ * ]| Transcode a long file to MP2, encoding on all CPU cores
  * </refsect2>
  *
+ * MPEG-1 Layer II frames have no bit reservoir, so when #GstTwoLame:threads
+ * is not 1, the input is split into chunks of #GstTwoLame:chunk-frames frames
+ * that are encoded concurrently by separate TwoLAME contexts, and the output
+ * is put back in order. Each context is primed with the two frames preceding
+ * its chunk (whose output is discarded), so that the filterbank has the same
+ * history as in serial encoding. The result is not byte-identical to serial
+ * encoding, since the psychoacoustic model state and padding decisions are
+ * restarted at every chunk, and the latency grows with the number of chunks
+ * in flight, so this mode is meant for offline transcoding.
+ *
  */
 
 #ifdef HAVE_CONFIG_H
@@ -167,6 +180,14 @@ gst_two_lame_emphasis_get_type (void)
   return two_lame_emphasis_type;
 }
 
+#define DEFAULT_THREADS 1
+#define DEFAULT_CHUNK_FRAMES 32
+
+/* frames of input used to prime the encoder of a chunk */
+#define PRIME_FRAMES 2
+
+#define FRAME_SAMPLES 1152
+
 /********** Standard stuff for signals and arguments **********/
 
 enum
@@ -186,9 +207,22 @@ enum
   ARG_ATH_LEVEL,
   ARG_VBR_MAX_BITRATE,
   ARG_QUICK_MODE,
-  ARG_QUICK_MODE_COUNT
+  ARG_QUICK_MODE_COUNT,
+  ARG_THREADS,
+  ARG_CHUNK_FRAMES
 };
 
+typedef struct
+{
+  GstBuffer *prime;             /* input preceding the chunk, or NULL */
+  GstBuffer *input;
+  GstBuffer *output;            /* NULL if nothing was encoded */
+  gint samples;                 /* samples per channel in input */
+  gboolean flush;               /* input ends with a partial frame */
+  gboolean error;
+  gboolean done;                /* protected by the lock */
+} GstTwoLameChunk;
+
 static gboolean gst_two_lame_start (GstAudioEncoder * enc);
 static gboolean gst_two_lame_stop (GstAudioEncoder * enc);
 static gboolean gst_two_lame_set_format (GstAudioEncoder * enc,
@@ -202,6 +236,9 @@ static void gst_two_lame_set_property (GObject * object, guint prop_id,
 static void gst_two_lame_get_property (GObject * object, guint prop_id,
     GValue * value, GParamSpec * pspec);
 static gboolean gst_two_lame_setup (GstTwoLame * twolame);
+static void gst_two_lame_encode_chunk (GstTwoLameChunk * chunk,
+    GstTwoLame * twolame);
+static void gst_two_lame_discard_chunks (GstTwoLame * twolame);
 
 G_DEFINE_TYPE (GstTwoLame, gst_two_lame, GST_TYPE_AUDIO_ENCODER);
 
@@ -217,7 +254,12 @@ gst_two_lame_release_memory (GstTwoLame * twolame)
 static void
 gst_two_lame_finalize (GObject * obj)
 {
-  gst_two_lame_release_memory (GST_TWO_LAME (obj));
+  GstTwoLame *twolame = GST_TWO_LAME (obj);
+
+  gst_two_lame_release_memory (twolame);
+
+  g_mutex_clear (&twolame->lock);
+  g_cond_clear (&twolame->cond);
 
   G_OBJECT_CLASS (gst_two_lame_parent_class)->finalize (obj);
 }
@@ -327,6 +369,18 @@ gst_two_lame_class_init (GstTwoLameClass * klass)
           0, G_MAXINT, gst_two_lame_default_settings.quick_mode_count,
           G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS));
 
+  g_object_class_install_property (G_OBJECT_CLASS (klass), ARG_THREADS,
+      g_param_spec_int ("threads", "Threads",
+          "Number of chunks to encode in parallel (0 = number of CPUs, "
+          "1 = serial encoding)", 0, 64, DEFAULT_THREADS,
+          G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS));
+
+  g_object_class_install_property (G_OBJECT_CLASS (klass), ARG_CHUNK_FRAMES,
+      g_param_spec_int ("chunk-frames", "Chunk frames",
+          "Number of frames per chunk when encoding in parallel",
+          PRIME_FRAMES, 4096, DEFAULT_CHUNK_FRAMES,
+          G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS));
+
   gst_element_class_add_static_pad_template (GST_ELEMENT_CLASS (klass),
       &gst_two_lame_src_template);
   gst_element_class_add_static_pad_template (GST_ELEMENT_CLASS (klass),
@@ -348,6 +402,9 @@ gst_two_lame_set_format (GstAudioEncoder * enc, GstAudioInfo * info)
 
   twolame = GST_TWO_LAME (enc);
 
+  /* the base class drained us already, nothing to output anymore */
+  gst_two_lame_discard_chunks (twolame);
+
   /* parameters already parsed for us */
   twolame->samplerate = GST_AUDIO_INFO_RATE (info);
   twolame->num_channels = GST_AUDIO_INFO_CHANNELS (info);
@@ -390,11 +447,40 @@ gst_two_lame_set_format (GstAudioEncoder * enc, GstAudioInfo * info)
   gst_caps_unref (othercaps);
 
   /* report needs to base class:
-   * hand one frame at a time, if we are pretty sure what a frame is */
+   * hand one frame at a time, if we are pretty sure what a frame is,
+   * or a chunk of frames if we encode in parallel */
+  twolame->parallel = FALSE;
   if (out_samplerate == twolame->samplerate) {
-    gst_audio_encoder_set_frame_samples_min (enc, 1152);
-    gst_audio_encoder_set_frame_samples_max (enc, 1152);
+    gint threads, chunk_samples = FRAME_SAMPLES;
+    GstClockTime latency = 0;
+
+    threads = twolame->threads;
+    if (threads == 0)
+      threads = g_get_num_processors ();
+
+    if (threads > 1) {
+      twolame->parallel = TRUE;
+      chunk_samples = FRAME_SAMPLES * twolame->chunk_frames;
+
+      if (twolame->pool == NULL) {
+        twolame->pool = g_thread_pool_new ((GFunc) gst_two_lame_encode_chunk,
+            twolame, threads, FALSE, NULL);
+      } else {
+        g_thread_pool_set_max_threads (twolame->pool, threads, NULL);
+      }
+
+      /* up to two chunks per thread are in flight */
+      latency = gst_util_uint64_scale_int (chunk_samples * 2 * threads,
+          GST_SECOND, twolame->samplerate);
+
+      GST_INFO_OBJECT (twolame, "encoding chunks of %d frames with %d threads",
+          twolame->chunk_frames, threads);
+    }
+
+    gst_audio_encoder_set_frame_samples_min (enc, chunk_samples);
+    gst_audio_encoder_set_frame_samples_max (enc, chunk_samples);
     gst_audio_encoder_set_frame_max (enc, 1);
+    gst_audio_encoder_set_latency (enc, latency, latency);
   }
 
   return TRUE;
@@ -436,6 +522,12 @@ gst_two_lame_init (GstTwoLame * twolame)
   twolame->vbr_max_bitrate = gst_two_lame_default_settings.vbr_max_bitrate;
   twolame->quick_mode = gst_two_lame_default_settings.quick_mode;
   twolame->quick_mode_count = gst_two_lame_default_settings.quick_mode_count;
+  twolame->threads = DEFAULT_THREADS;
+  twolame->chunk_frames = DEFAULT_CHUNK_FRAMES;
+
+  g_mutex_init (&twolame->lock);
+  g_cond_init (&twolame->cond);
+  g_queue_init (&twolame->pending);
 
   GST_DEBUG_OBJECT (twolame, "done initializing");
 }
@@ -456,6 +548,12 @@ gst_two_lame_stop (GstAudioEncoder * enc)
 
   GST_DEBUG_OBJECT (twolame, "stop");
 
+  gst_two_lame_discard_chunks (twolame);
+  if (twolame->pool) {
+    g_thread_pool_free (twolame->pool, FALSE, TRUE);
+    twolame->pool = NULL;
+  }
+
   gst_two_lame_release_memory (twolame);
   return TRUE;
 }
@@ -547,6 +645,12 @@ gst_two_lame_set_property (GObject * object, guint prop_id,
     case ARG_QUICK_MODE_COUNT:
       twolame->quick_mode_count = g_value_get_int (value);
       break;
+    case ARG_THREADS:
+      twolame->threads = g_value_get_int (value);
+      break;
+    case ARG_CHUNK_FRAMES:
+      twolame->chunk_frames = g_value_get_int (value);
+      break;
     default:
       G_OBJECT_WARN_INVALID_PROPERTY_ID (object, prop_id, pspec);
       break;
@@ -605,6 +709,12 @@ gst_two_lame_get_property (GObject * object, guint prop_id, GValue * value,
     case ARG_QUICK_MODE_COUNT:
       g_value_set_int (value, twolame->quick_mode_count);
       break;
+    case ARG_THREADS:
+      g_value_set_int (value, twolame->threads);
+      break;
+    case ARG_CHUNK_FRAMES:
+      g_value_set_int (value, twolame->chunk_frames);
+      break;
     default:
       G_OBJECT_WARN_INVALID_PROPERTY_ID (object, prop_id, pspec);
       break;
@@ -642,7 +752,263 @@ gst_two_lame_flush_full (GstTwoLame * lame, gboolean push)
 static void
 gst_two_lame_flush (GstAudioEncoder * enc)
 {
-  gst_two_lame_flush_full (GST_TWO_LAME (enc), FALSE);
+  GstTwoLame *twolame = GST_TWO_LAME (enc);
+
+  if (twolame->parallel)
+    gst_two_lame_discard_chunks (twolame);
+  else
+    gst_two_lame_flush_full (twolame, FALSE);
+}
+
+/* encodes size bytes of raw audio, returns the number of bytes written to
+ * out or a negative value on error */
+static gint
+gst_two_lame_encode (GstTwoLame * twolame, twolame_options * glopts,
+    guint8 * data, gsize size, guint8 * out, gint out_size)
+{
+  gint num_samples;
+
+  if (twolame->float_input)
+    num_samples = size / 4;
+  else
+    num_samples = size / 2;
+
+  if (twolame->num_channels == 1) {
+    if (twolame->float_input)
+      return twolame_encode_buffer_float32 (glopts, (float *) data,
+          (float *) data, num_samples, out, out_size);
+    else
+      return twolame_encode_buffer (glopts, (short int *) data,
+          (short int *) data, num_samples, out, out_size);
+  } else {
+    if (twolame->float_input)
+      return twolame_encode_buffer_float32_interleaved (glopts,
+          (float *) data, num_samples / twolame->num_channels, out, out_size);
+    else
+      return twolame_encode_buffer_interleaved (glopts, (short int *) data,
+          num_samples / twolame->num_channels, out, out_size);
+  }
+}
+
+/* creates a new encoder context with the same settings as twolame->glopts */
+static twolame_options *
+gst_two_lame_clone_options (GstTwoLame * twolame)
+{
+  twolame_options *src = twolame->glopts;
+  twolame_options *glopts;
+
+  glopts = twolame_init ();
+  if (glopts == NULL)
+    return NULL;
+
+  twolame_set_in_samplerate (glopts, twolame_get_in_samplerate (src));
+  twolame_set_out_samplerate (glopts, twolame_get_out_samplerate (src));
+  twolame_set_num_channels (glopts, twolame_get_num_channels (src));
+  twolame_set_mode (glopts, twolame_get_mode (src));
+  twolame_set_psymodel (glopts, twolame_get_psymodel (src));
+  twolame_set_bitrate (glopts, twolame_get_bitrate (src));
+  twolame_set_padding (glopts, twolame_get_padding (src));
+  twolame_set_energy_levels (glopts, twolame_get_energy_levels (src));
+  twolame_set_emphasis (glopts, twolame_get_emphasis (src));
+  twolame_set_error_protection (glopts, twolame_get_error_protection (src));
+  twolame_set_copyright (glopts, twolame_get_copyright (src));
+  twolame_set_original (glopts, twolame_get_original (src));
+  twolame_set_VBR (glopts, twolame_get_VBR (src));
+  twolame_set_VBR_level (glopts, twolame_get_VBR_level (src));
+  twolame_set_ATH_level (glopts, twolame_get_ATH_level (src));
+  twolame_set_VBR_max_bitrate_kbps (glopts,
+      twolame_get_VBR_max_bitrate_kbps (src));
+  twolame_set_quick_mode (glopts, twolame_get_quick_mode (src));
+  twolame_set_quick_count (glopts, twolame_get_quick_count (src));
+
+  if (twolame_init_params (glopts) < 0) {
+    twolame_close (&glopts);
+    return NULL;
+  }
+
+  return glopts;
+}
+
+/* runs in a thread of the pool */
+static void
+gst_two_lame_encode_chunk (GstTwoLameChunk * chunk, GstTwoLame * twolame)
+{
+  twolame_options *glopts;
+  GstMapInfo map, out_map;
+  gint out_size, size, flushed;
+  gsize prime_size;
+
+  glopts = gst_two_lame_clone_options (twolame);
+  if (glopts == NULL) {
+    GST_ERROR_OBJECT (twolame, "failed to create encoder context");
+    chunk->error = TRUE;
+    goto done;
+  }
+
+  prime_size = chunk->prime ? gst_buffer_get_size (chunk->prime) : 0;
+
+  gst_buffer_map (chunk->input, &map, GST_MAP_READ);
+
+  /* allocate space for output of the priming and the chunk itself */
+  out_size = 1.25 * (map.size + prime_size) / 2 + 16384;
+  chunk->output = gst_buffer_new_and_alloc (out_size);
+  gst_buffer_map (chunk->output, &out_map, GST_MAP_WRITE);
+
+  /* feed the frames preceding the chunk first, so the filterbank is in the
+   * same state as when encoding serially, and throw away their output */
+  if (chunk->prime) {
+    GstMapInfo prime_map;
+
+    gst_buffer_map (chunk->prime, &prime_map, GST_MAP_READ);
+    gst_two_lame_encode (twolame, glopts, prime_map.data, prime_map.size,
+        out_map.data, out_size);
+    gst_buffer_unmap (chunk->prime, &prime_map);
+  }
+
+  size = gst_two_lame_encode (twolame, glopts, map.data, map.size,
+      out_map.data, out_size);
+
+  if (size >= 0 && chunk->flush) {
+    flushed = twolame_encode_flush (glopts, out_map.data + size,
+        out_size - size);
+    if (flushed > 0)
+      size += flushed;
+  }
+
+  gst_buffer_unmap (chunk->output, &out_map);
+  gst_buffer_unmap (chunk->input, &map);
+
+  twolame_close (&glopts);
+
+  GST_LOG_OBJECT (twolame, "encoded chunk of %d samples to %d bytes",
+      chunk->samples, size);
+
+  if (size > 0) {
+    gst_buffer_set_size (chunk->output, size);
+  } else {
+    if (size < 0) {
+      GST_ERROR_OBJECT (twolame, "encoding failed: %d", size);
+      chunk->error = TRUE;
+    }
+    gst_buffer_unref (chunk->output);
+    chunk->output = NULL;
+  }
+
+done:
+  g_mutex_lock (&twolame->lock);
+  chunk->done = TRUE;
+  g_cond_broadcast (&twolame->cond);
+  g_mutex_unlock (&twolame->lock);
+}
+
+static void
+gst_two_lame_chunk_free (GstTwoLameChunk * chunk)
+{
+  if (chunk->prime)
+    gst_buffer_unref (chunk->prime);
+  if (chunk->output)
+    gst_buffer_unref (chunk->output);
+  gst_buffer_unref (chunk->input);
+  g_slice_free (GstTwoLameChunk, chunk);
+}
+
+/* waits for the oldest pending chunk and outputs it if push is TRUE */
+static GstFlowReturn
+gst_two_lame_finish_chunk (GstTwoLame * twolame, gboolean push)
+{
+  GstTwoLameChunk *chunk;
+  GstFlowReturn ret = GST_FLOW_OK;
+
+  chunk = g_queue_pop_head (&twolame->pending);
+
+  g_mutex_lock (&twolame->lock);
+  while (!chunk->done)
+    g_cond_wait (&twolame->cond, &twolame->lock);
+  g_mutex_unlock (&twolame->lock);
+
+  if (!push)
+    goto done;
+
+  if (chunk->error) {
+    GST_ELEMENT_ERROR (twolame, STREAM, ENCODE, (NULL),
+        ("Failed to encode chunk of %d samples", chunk->samples));
+    ret = GST_FLOW_ERROR;
+    goto done;
+  }
+
+  ret = gst_audio_encoder_finish_frame (GST_AUDIO_ENCODER (twolame),
+      chunk->output, chunk->samples);
+  chunk->output = NULL;
+
+done:
+  gst_two_lame_chunk_free (chunk);
+  return ret;
+}
+
+static void
+gst_two_lame_discard_chunks (GstTwoLame * twolame)
+{
+  while (!g_queue_is_empty (&twolame->pending))
+    gst_two_lame_finish_chunk (twolame, FALSE);
+
+  gst_buffer_replace (&twolame->prime, NULL);
+}
+
+static GstFlowReturn
+gst_two_lame_handle_frame_parallel (GstTwoLame * twolame, GstBuffer * buf)
+{
+  GstTwoLameChunk *chunk;
+  GstFlowReturn ret = GST_FLOW_OK;
+  gsize size, prime_size;
+  guint max_pending;
+  gint bpf;
+
+  /* drain, output everything that is still being encoded */
+  if (G_UNLIKELY (buf == NULL)) {
+    while (ret == GST_FLOW_OK && !g_queue_is_empty (&twolame->pending))
+      ret = gst_two_lame_finish_chunk (twolame, TRUE);
+
+    gst_two_lame_discard_chunks (twolame);
+    return ret;
+  }
+
+  bpf = GST_AUDIO_INFO_BPF (gst_audio_encoder_get_audio_info (GST_AUDIO_ENCODER
+          (twolame)));
+  size = gst_buffer_get_size (buf);
+
+  chunk = g_slice_new0 (GstTwoLameChunk);
+  chunk->prime = twolame->prime;
+  chunk->input = gst_buffer_ref (buf);
+  chunk->samples = size / bpf;
+  chunk->flush = (chunk->samples % FRAME_SAMPLES) != 0;
+
+  /* keep the end of this chunk to prime the encoder of the next one */
+  prime_size = MIN (size, PRIME_FRAMES * FRAME_SAMPLES * bpf);
+  twolame->prime = gst_buffer_copy_region (buf, GST_BUFFER_COPY_MEMORY,
+      size - prime_size, prime_size);
+
+  g_queue_push_tail (&twolame->pending, chunk);
+  g_thread_pool_push (twolame->pool, chunk, NULL);
+
+  /* output finished chunks in order, and wait for the oldest one if too
+   * many are in flight */
+  max_pending = 2 * g_thread_pool_get_max_threads (twolame->pool);
+  while (ret == GST_FLOW_OK && !g_queue_is_empty (&twolame->pending)) {
+    gboolean done;
+
+    chunk = g_queue_peek_head (&twolame->pending);
+
+    g_mutex_lock (&twolame->lock);
+    done = chunk->done;
+    g_mutex_unlock (&twolame->lock);
+
+    if (!done && g_queue_get_length (&twolame->pending) <= max_pending)
+      break;
+
+    ret = gst_two_lame_finish_chunk (twolame, TRUE);
+  }
+
+  return ret;
 }
 
 static GstFlowReturn
@@ -657,6 +1023,9 @@ gst_two_lame_handle_frame (GstAudioEncoder * enc, GstBuffer * buf)
 
   twolame = GST_TWO_LAME (enc);
 
+  if (twolame->parallel)
+    return gst_two_lame_handle_frame_parallel (twolame, buf);
+
   /* squeeze remaining and push */
   if (G_UNLIKELY (buf == NULL))
     return gst_two_lame_flush_full (twolame, TRUE);
@@ -673,25 +1042,8 @@ gst_two_lame_handle_frame (GstAudioEncoder * enc, GstBuffer * buf)
   mp3_buf = gst_buffer_new_and_alloc (mp3_buffer_size);
   gst_buffer_map (mp3_buf, &mp3_map, GST_MAP_WRITE);
 
-  if (twolame->num_channels == 1) {
-    if (twolame->float_input)
-      mp3_size = twolame_encode_buffer_float32 (twolame->glopts,
-          (float *) map.data,
-          (float *) map.data, num_samples, mp3_map.data, mp3_buffer_size);
-    else
-      mp3_size = twolame_encode_buffer (twolame->glopts,
-          (short int *) map.data,
-          (short int *) map.data, num_samples, mp3_map.data, mp3_buffer_size);
-  } else {
-    if (twolame->float_input)
-      mp3_size = twolame_encode_buffer_float32_interleaved (twolame->glopts,
-          (float *) map.data,
-          num_samples / twolame->num_channels, mp3_map.data, mp3_buffer_size);
-    else
-      mp3_size = twolame_encode_buffer_interleaved (twolame->glopts,
-          (short int *) map.data,
-          num_samples / twolame->num_channels, mp3_map.data, mp3_buffer_size);
-  }
+  mp3_size = gst_two_lame_encode (twolame, twolame->glopts, map.data, map.size,
+      mp3_map.data, mp3_buffer_size);
 
   GST_LOG_OBJECT (twolame, "encoded %" G_GSIZE_FORMAT " bytes of audio "
       "to %d bytes of mp3", map.size, mp3_size);
@@ -72,8 +72,18 @@ struct _GstTwoLame {
   gint vbr_max_bitrate;
   gboolean quick_mode;
   gint quick_mode_count;
+  gint threads;
+  gint chunk_frames;
 
   twolame_options *glopts;
+
+  /* parallel encoding of chunks of frames */
+  gboolean parallel;
+  GThreadPool *pool;
+  GQueue pending;               /* GstTwoLameChunk, in input order */
+  GMutex lock;
+  GCond cond;
+  GstBuffer *prime;             /* tail of the previous chunk */
 };
 
 struct _GstTwoLameClass {
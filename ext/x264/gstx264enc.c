@@ -33,6 +33,13 @@
  * Alternatively, one may choose to perform Constant Quantizer or Quality encoding,
  * in which case the #GstX264Enc:quantizer property controls much of the outcome, in that case #GstX264Enc:bitrate is the maximum bitrate.
  *
+ * Multipass encoding normally runs the pipeline once per pass, sharing the
+ * statistics through #GstX264Enc:multipass-cache-file. With pass=two-pass
+ * the element instead keeps a copy of all input until the end of the stream,
+ * analyses it on the way in and encodes it for real when draining, so the
+ * whole output appears at EOS. This is meant for offline encoding of files
+ * that fit in memory.
+ *
  * The H264 profile that is eventually used depends on a few settings.
  * If #GstX264Enc:dct8x8 is enabled, then High profile is used.
  * Otherwise, if #GstX264Enc:cabac entropy coding is enabled or #GstX264Enc:bframes
@@ -61,6 +68,32 @@
  * overall encoding quality so may not be appropriate for your use case.
  * </note>
  *
+ * For the lowest latency, #GstX264Enc:slice-output pushes every slice
+ * downstream as soon as it is encoded instead of waiting for the whole frame.
+ * Combine it with tune=zerolatency and several slices per frame, e.g. by
+ * setting slices or slice-max-size in the #GstX264Enc:option-string. The
+ * last part of every frame carries the %GST_BUFFER_FLAG_MARKER flag.
+ *
+ * For offline transcoding, #GstX264Enc:chunk-frames cuts the input into
+ * chunks of that many frames, each starting with an IDR frame, and encodes
+ * #GstX264Enc:chunk-jobs of them at the same time with separate encoder
+ * instances. The output does not depend on the number of jobs. Rate control
+ * works per chunk, and this mode adds a lot of latency.
+ *
+ * Regions of interest attached to the input as #GstVideoRegionOfInterestMeta
+ * can be given more or fewer bits with #GstX264Enc:roi-quant-offsets, which
+ * maps region types to quantizer offsets, e.g. "offsets, face=-6.0". This
+ * needs adaptive quantization, which is enabled by default.
+ *
+ * To monitor an encoder, #GstX264Enc:frame-stats attaches a
+ * #GstX264EncFrameStatsMeta with the frame type, quantizer, size and encoding
+ * time to every output buffer, and #GstX264Enc:stats-interval posts an
+ * "x264enc-stats" element message summarizing every that many frames, with
+ * the fields "frames", "i-frames", "p-frames", "b-frames", "average-qp",
+ * "bytes", "average-encode-time", "max-encode-time" and "delayed-frames",
+ * plus "average-psnr" and "average-ssim" when enabled with psnr=1 and
+ * ssim=1 in the #GstX264Enc:option-string.
+ *
  * <refsect2>
  * <title>Example pipeline</title>
  * |[
@@ -99,11 +132,13 @@
 #endif
 
 #include "gstx264enc.h"
+#include "gstx264ladderenc.h"
 
 #include <gst/pbutils/pbutils.h>
 #include <gst/video/video.h>
 #include <gst/video/gstvideometa.h>
 #include <gst/video/gstvideopool.h>
+#include <glib/gstdio.h>
 
 #include <string.h>
 #include <stdlib.h>
@@ -152,6 +187,12 @@ enum
   ARG_PSY_TUNE,
   ARG_TUNE,
   ARG_FRAME_PACKING,
+  ARG_SLICE_OUTPUT,
+  ARG_CHUNK_FRAMES,
+  ARG_CHUNK_JOBS,
+  ARG_ROI_QUANT_OFFSETS,
+  ARG_FRAME_STATS,
+  ARG_STATS_INTERVAL,
 };
 
 #define ARG_THREADS_DEFAULT            0        /* 0 means 'auto' which is 1.5x number of CPU cores */
@@ -193,6 +234,11 @@ static GString *x264enc_defaults;
 #define ARG_PSY_TUNE_DEFAULT           0        /* no psy tuning */
 #define ARG_TUNE_DEFAULT               0        /* no tuning */
 #define ARG_FRAME_PACKING_DEFAULT      -1       /* automatic (none, or from input caps) */
+#define ARG_SLICE_OUTPUT_DEFAULT       FALSE
+#define ARG_CHUNK_FRAMES_DEFAULT       0        /* no chunked encoding */
+#define ARG_CHUNK_JOBS_DEFAULT         0        /* number of CPUs */
+#define ARG_FRAME_STATS_DEFAULT        FALSE
+#define ARG_STATS_INTERVAL_DEFAULT     0        /* no stats messages */
 
 enum
 {
@@ -208,7 +254,8 @@ enum
   GST_X264_ENC_PASS_QUAL,
   GST_X264_ENC_PASS_PASS1 = 0x11,
   GST_X264_ENC_PASS_PASS2,
-  GST_X264_ENC_PASS_PASS3
+  GST_X264_ENC_PASS_PASS3,
+  GST_X264_ENC_PASS_TWO_PASS = 0x20
 };
 
 #define GST_X264_ENC_PASS_TYPE (gst_x264_enc_pass_get_type())
@@ -224,6 +271,8 @@ gst_x264_enc_pass_get_type (void)
     {GST_X264_ENC_PASS_PASS1, "VBR Encoding - Pass 1", "pass1"},
     {GST_X264_ENC_PASS_PASS2, "VBR Encoding - Pass 2", "pass2"},
     {GST_X264_ENC_PASS_PASS3, "VBR Encoding - Pass 3", "pass3"},
+    {GST_X264_ENC_PASS_TWO_PASS, "VBR Encoding - Both Passes on Buffered Input",
+        "two-pass"},
     {0, NULL, NULL}
   };
 
@@ -281,8 +330,7 @@ gst_x264_enc_analyse_get_type (void)
   return analyse_type;
 }
 
-#define GST_X264_ENC_SPEED_PRESET_TYPE (gst_x264_enc_speed_preset_get_type())
-static GType
+GType
 gst_x264_enc_speed_preset_get_type (void)
 {
   static GType speed_preset_type = 0;
@@ -463,7 +511,7 @@ static GstStaticPadTemplate src_factory = GST_STATIC_PAD_TEMPLATE ("src",
         "framerate = (fraction) [0/1, MAX], "
         "width = (int) [ 1, MAX ], " "height = (int) [ 1, MAX ], "
         "stream-format = (string) { avc, byte-stream }, "
-        "alignment = (string) au, "
+        "alignment = (string) { au, nal }, "
         "profile = (string) { high-4:4:4, high-4:2:2, high-10, high, main,"
         " baseline, constrained-baseline, high-4:4:4-intra, high-4:2:2-intra,"
         " high-10-intra }")
@@ -475,12 +523,24 @@ static gboolean gst_x264_enc_stop (GstVideoEncoder * encoder);
 static gboolean gst_x264_enc_flush (GstVideoEncoder * encoder);
 
 static gboolean gst_x264_enc_init_encoder (GstX264Enc * encoder);
+static void gst_x264_enc_remove_stats (GstX264Enc * encoder);
+static void gst_x264_enc_reset_stats (GstX264Enc * encoder);
 static void gst_x264_enc_close_encoder (GstX264Enc * encoder);
 
 static GstFlowReturn gst_x264_enc_finish (GstVideoEncoder * encoder);
 static GstFlowReturn gst_x264_enc_handle_frame (GstVideoEncoder * encoder,
     GstVideoCodecFrame * frame);
-static void gst_x264_enc_flush_frames (GstX264Enc * encoder, gboolean send);
+static GstFlowReturn gst_x264_enc_flush_frames (GstX264Enc * encoder,
+    gboolean send);
+static void gst_x264_enc_nalu_process (x264_t * h, x264_nal_t * nal,
+    void *opaque);
+static void gst_x264_enc_clear_nals (GstX264Enc * encoder);
+static void gst_x264_enc_queue_slices (GstX264Enc * encoder,
+    GstVideoCodecFrame * frame);
+static guint gst_x264_enc_chunk_jobs (GstX264Enc * encoder);
+static void gst_x264_enc_chunk_free (GstX264EncChunk * chunk);
+static GstFlowReturn gst_x264_enc_finish_chunks (GstX264Enc * encoder,
+    gboolean all, gboolean send);
 static GstFlowReturn gst_x264_enc_encode_frame (GstX264Enc * encoder,
     x264_picture_t * pic_in, GstVideoCodecFrame * input_frame, int *i_nal,
     gboolean send);
@@ -847,6 +907,43 @@ gst_x264_enc_class_init (GstX264EncClass * klass)
           "Set frame packing mode for Stereoscopic content",
           GST_X264_ENC_FRAME_PACKING_TYPE, ARG_FRAME_PACKING_DEFAULT,
           G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS));
+  g_object_class_install_property (gobject_class, ARG_SLICE_OUTPUT,
+      g_param_spec_boolean ("slice-output", "Slice output",
+          "Push every slice downstream as soon as it is encoded "
+          "(implies sliced-threads and no B-frames, outputs alignment=nal)",
+          ARG_SLICE_OUTPUT_DEFAULT,
+          G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS));
+  g_object_class_install_property (gobject_class, ARG_CHUNK_FRAMES,
+      g_param_spec_uint ("chunk-frames", "Chunk frames",
+          "Split the input into closed GOP chunks of this many frames that "
+          "are encoded in parallel (0 = disabled, single pass only)",
+          0, G_MAXINT, ARG_CHUNK_FRAMES_DEFAULT,
+          G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS));
+  g_object_class_install_property (gobject_class, ARG_CHUNK_JOBS,
+      g_param_spec_uint ("chunk-jobs", "Chunk jobs",
+          "Number of chunks encoded at the same time (0 = number of CPUs)",
+          0, 256, ARG_CHUNK_JOBS_DEFAULT,
+          G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS));
+  g_object_class_install_property (gobject_class, ARG_ROI_QUANT_OFFSETS,
+      g_param_spec_boxed ("roi-quant-offsets", "ROI quantizer offsets",
+          "Quantizer offset for each region of interest type, e.g. "
+          "\"offsets, face=-6.0, motion=-3.0\" (NULL = ignore regions)",
+          GST_TYPE_STRUCTURE,
+          G_PARAM_READWRITE | GST_PARAM_MUTABLE_PLAYING |
+          G_PARAM_STATIC_STRINGS));
+  g_object_class_install_property (gobject_class, ARG_FRAME_STATS,
+      g_param_spec_boolean ("frame-stats", "Frame statistics",
+          "Attach a GstX264EncFrameStatsMeta to every output buffer",
+          ARG_FRAME_STATS_DEFAULT,
+          G_PARAM_READWRITE | GST_PARAM_MUTABLE_PLAYING |
+          G_PARAM_STATIC_STRINGS));
+  g_object_class_install_property (gobject_class, ARG_STATS_INTERVAL,
+      g_param_spec_uint ("stats-interval", "Statistics interval",
+          "Post an element message with the encoder statistics every "
+          "this many frames (0 = never)",
+          0, G_MAXINT, ARG_STATS_INTERVAL_DEFAULT,
+          G_PARAM_READWRITE | GST_PARAM_MUTABLE_PLAYING |
+          G_PARAM_STATIC_STRINGS));
 
   /* options for which we _do_ use string equivalents */
   g_object_class_install_property (gobject_class, ARG_THREADS,
@@ -1072,6 +1169,85 @@ gst_x264_enc_log_callback (gpointer private, gint level, const char *format,
 #endif /* GST_DISABLE_GST_DEBUG */
 }
 
+GType
+gst_x264_enc_frame_stats_meta_api_get_type (void)
+{
+  static volatile GType type;
+  static const gchar *tags[] = { NULL };
+
+  if (g_once_init_enter (&type)) {
+    GType _type =
+        gst_meta_api_type_register ("GstX264EncFrameStatsMetaAPI", tags);
+    g_once_init_leave (&type, _type);
+  }
+  return type;
+}
+
+static gboolean
+gst_x264_enc_frame_stats_meta_transform (GstBuffer * dest, GstMeta * meta,
+    GstBuffer * buffer, GQuark type, gpointer data)
+{
+  GstX264EncFrameStatsMeta *smeta = (GstX264EncFrameStatsMeta *) meta;
+  GstX264EncFrameStatsMeta *dmeta;
+
+  if (!GST_META_TRANSFORM_IS_COPY (type))
+    return FALSE;
+
+  dmeta = (GstX264EncFrameStatsMeta *) gst_buffer_add_meta (dest,
+      GST_X264_ENC_FRAME_STATS_META_INFO, NULL);
+  if (!dmeta)
+    return FALSE;
+
+  dmeta->type = smeta->type;
+  dmeta->qp = smeta->qp;
+  dmeta->size = smeta->size;
+  dmeta->psnr = smeta->psnr;
+  dmeta->ssim = smeta->ssim;
+  dmeta->encode_time = smeta->encode_time;
+  dmeta->delayed_frames = smeta->delayed_frames;
+
+  return TRUE;
+}
+
+const GstMetaInfo *
+gst_x264_enc_frame_stats_meta_get_info (void)
+{
+  static const GstMetaInfo *meta_info = NULL;
+
+  if (g_once_init_enter (&meta_info)) {
+    const GstMetaInfo *mi =
+        gst_meta_register (GST_X264_ENC_FRAME_STATS_META_API_TYPE,
+        "GstX264EncFrameStatsMeta", sizeof (GstX264EncFrameStatsMeta),
+        (GstMetaInitFunction) NULL, (GstMetaFreeFunction) NULL,
+        gst_x264_enc_frame_stats_meta_transform);
+    g_once_init_leave (&meta_info, mi);
+  }
+  return meta_info;
+}
+
+typedef struct
+{
+  GstX264Enc *encoder;
+  GstVideoCodecFrame *frame;
+  GstVideoFrame vframe;
+  gboolean push_slices;
+  gfloat *quant_offsets;
+} FrameData;
+
+static GstFlowReturn gst_x264_enc_add_chunk_frame (GstX264Enc * encoder,
+    FrameData * fdata);
+
+/* a NAL unit x264 encoded straight into our memory, sharing the memory of
+ * its frame */
+typedef struct
+{
+  GstMemory *mem;
+  guint order;
+  gint type;
+  gint first_mb;
+  gint last_mb;
+} NalData;
+
 /* initialize the new element
  * instantiate pads and add them to element
  * set functions
@@ -1120,21 +1296,30 @@ gst_x264_enc_init (GstX264Enc * encoder)
   encoder->psy_tune = ARG_PSY_TUNE_DEFAULT;
   encoder->tune = ARG_TUNE_DEFAULT;
   encoder->frame_packing = ARG_FRAME_PACKING_DEFAULT;
+  encoder->slice_output = ARG_SLICE_OUTPUT_DEFAULT;
+  encoder->chunk_frames = ARG_CHUNK_FRAMES_DEFAULT;
+  encoder->chunk_jobs = ARG_CHUNK_JOBS_DEFAULT;
+  encoder->frame_stats = ARG_FRAME_STATS_DEFAULT;
+  encoder->stats_interval = ARG_STATS_INTERVAL_DEFAULT;
 
   x264_param_default (&encoder->x264param);
 
+  g_mutex_init (&encoder->nal_lock);
+  encoder->nals = g_array_new (FALSE, FALSE, sizeof (NalData));
+  g_queue_init (&encoder->slice_queue);
+  g_mutex_init (&encoder->slice_push_lock);
+
+  g_mutex_init (&encoder->chunk_lock);
+  g_cond_init (&encoder->chunk_cond);
+  g_queue_init (&encoder->chunks);
+  g_queue_init (&encoder->two_pass_frames);
+
   /* log callback setup; part of parameters */
   encoder->x264param.pf_log = gst_x264_enc_log_callback;
   encoder->x264param.p_log_private = encoder;
   encoder->x264param.i_log_level = X264_LOG_DEBUG;
 }
 
-typedef struct
-{
-  GstVideoCodecFrame *frame;
-  GstVideoFrame vframe;
-} FrameData;
-
 static FrameData *
 gst_x264_enc_queue_frame (GstX264Enc * enc, GstVideoCodecFrame * frame,
     GstVideoInfo * info)
@@ -1146,7 +1331,10 @@ gst_x264_enc_queue_frame (GstX264Enc * enc, GstVideoCodecFrame * frame,
     return NULL;
 
   fdata = g_slice_new (FrameData);
+  fdata->encoder = enc;
   fdata->frame = gst_video_codec_frame_ref (frame);
+  fdata->push_slices = FALSE;
+  fdata->quant_offsets = NULL;
   fdata->vframe = vframe;
 
   enc->pending_frames = g_list_prepend (enc->pending_frames, fdata);
@@ -1167,6 +1355,7 @@ gst_x264_enc_dequeue_frame (GstX264Enc * enc, GstVideoCodecFrame * frame)
 
     gst_video_frame_unmap (&fdata->vframe);
     gst_video_codec_frame_unref (fdata->frame);
+    g_free (fdata->quant_offsets);
     g_slice_free (FrameData, fdata);
 
     enc->pending_frames = g_list_delete_link (enc->pending_frames, l);
@@ -1184,6 +1373,7 @@ gst_x264_enc_dequeue_all_frames (GstX264Enc * enc)
 
     gst_video_frame_unmap (&fdata->vframe);
     gst_video_codec_frame_unref (fdata->frame);
+    g_free (fdata->quant_offsets);
     g_slice_free (FrameData, fdata);
   }
   g_list_free (enc->pending_frames);
@@ -1211,6 +1401,7 @@ gst_x264_enc_stop (GstVideoEncoder * encoder)
 
   gst_x264_enc_flush_frames (x264enc, FALSE);
   gst_x264_enc_close_encoder (x264enc);
+  gst_x264_enc_remove_stats (x264enc);
   gst_x264_enc_dequeue_all_frames (x264enc);
 
   if (x264enc->input_state)
@@ -1257,7 +1448,18 @@ gst_x264_enc_finalize (GObject * object)
   g_free (encoder->mp_cache_file);
   encoder->mp_cache_file = NULL;
 
+  if (encoder->roi_quant_offsets)
+    gst_structure_free (encoder->roi_quant_offsets);
+  encoder->roi_quant_offsets = NULL;
+
   gst_x264_enc_close_encoder (encoder);
+  gst_x264_enc_remove_stats (encoder);
+
+  g_array_free (encoder->nals, TRUE);
+  g_mutex_clear (&encoder->nal_lock);
+  g_mutex_clear (&encoder->slice_push_lock);
+  g_mutex_clear (&encoder->chunk_lock);
+  g_cond_clear (&encoder->chunk_cond);
 
   G_OBJECT_CLASS (parent_class)->finalize (object);
 }
@@ -1494,6 +1696,7 @@ gst_x264_enc_init_encoder (GstX264Enc * encoder)
     case GST_X264_ENC_PASS_PASS1:
     case GST_X264_ENC_PASS_PASS2:
     case GST_X264_ENC_PASS_PASS3:
+    case GST_X264_ENC_PASS_TWO_PASS:
     default:
       encoder->x264param.rc.i_rc_method = X264_RC_ABR;
       encoder->x264param.rc.i_bitrate = encoder->bitrate;
@@ -1505,6 +1708,28 @@ gst_x264_enc_init_encoder (GstX264Enc * encoder)
       break;
   }
 
+  /* both passes run on the buffered input, with a private stats file */
+  if (encoder->pass == GST_X264_ENC_PASS_TWO_PASS) {
+    if (!encoder->stats_dir) {
+      GError *err = NULL;
+
+      encoder->stats_dir = g_dir_make_tmp ("x264enc-XXXXXX", &err);
+      if (!encoder->stats_dir) {
+        GST_OBJECT_UNLOCK (encoder);
+        GST_ELEMENT_ERROR (encoder, RESOURCE, OPEN_WRITE,
+            ("Can not create a directory for the first pass statistics."),
+            ("%s", err->message));
+        g_error_free (err);
+        return FALSE;
+      }
+      encoder->stats_file = g_build_filename (encoder->stats_dir,
+          "x264_2pass.log", NULL);
+    }
+    encoder->x264param.rc.psz_stat_out = encoder->stats_file;
+    encoder->x264param.rc.psz_stat_in = encoder->stats_file;
+    pass = encoder->second_pass ? 2 : 1;
+  }
+
   switch (pass) {
     case 0:
       encoder->x264param.rc.b_stat_read = 0;
@@ -1575,6 +1800,58 @@ gst_x264_enc_init_encoder (GstX264Enc * encoder)
   GST_DEBUG_OBJECT (encoder, "Stereo frame packing = %d",
       encoder->x264param.i_frame_packing);
 
+  /* chunks are encoded independently, which rules out sharing rate control
+   * statistics between passes */
+  encoder->chunked = encoder->chunk_frames > 0;
+  if (encoder->chunked && encoder->pass >= GST_X264_ENC_PASS_PASS1) {
+    GST_WARNING_OBJECT (encoder, "chunked encoding needs a single pass");
+    encoder->chunked = FALSE;
+  }
+
+  /* Slices can only be pushed while the frame is being encoded without frame
+   * threads, and only in encoding order without B-frames */
+  encoder->nal_alignment = encoder->slice_output && !encoder->chunked;
+  if (encoder->nal_alignment) {
+    if (encoder->x264param.i_threads != 1
+        && !encoder->x264param.b_sliced_threads) {
+      GST_INFO_OBJECT (encoder, "enabling sliced threads for slice output");
+      encoder->x264param.b_sliced_threads = TRUE;
+    }
+    encoder->x264param.i_bframe = 0;
+    if (encoder->x264param.i_nal_hrd != X264_NAL_HRD_NONE) {
+      GST_WARNING_OBJECT (encoder, "disabling HRD signalling for slice output");
+      encoder->x264param.i_nal_hrd = X264_NAL_HRD_NONE;
+    }
+  }
+  encoder->frame_mbs = ((encoder->x264param.i_width + 15) / 16) *
+      ((encoder->x264param.i_height + 15) / 16);
+
+  if (encoder->roi_quant_offsets
+      && encoder->x264param.rc.i_aq_mode == X264_AQ_NONE)
+    GST_WARNING_OBJECT (encoder, "ROI quantizer offsets need adaptive "
+        "quantization, which is disabled");
+  encoder->slice_output_started = FALSE;
+  gst_x264_enc_reset_stats (encoder);
+
+  /* Without frame threads x264 can encode the NAL units straight into our
+   * output memory, which saves copying every frame. The HRD buffering period
+   * SEI is not passed to the callback, so keep the copy in that case. */
+  if ((encoder->x264param.i_threads == 1
+          || encoder->x264param.b_sliced_threads)
+      && encoder->x264param.i_nal_hrd == X264_NAL_HRD_NONE
+      && !encoder->chunked && pass != 1)
+    encoder->x264param.nalu_process = gst_x264_enc_nalu_process;
+  else
+    encoder->x264param.nalu_process = NULL;
+
+  GST_DEBUG_OBJECT (encoder, "%s output NAL units",
+      encoder->x264param.nalu_process ? "direct" : "copying");
+
+  /* a raw luma plane is plenty for the first frame */
+  encoder->nal_arena_hint =
+      encoder->x264param.i_width * encoder->x264param.i_height;
+  encoder->nal_frame_bytes = 0;
+
   encoder->reconfig = FALSE;
 
   GST_OBJECT_UNLOCK (encoder);
@@ -1605,6 +1882,46 @@ gst_x264_enc_close_encoder (GstX264Enc * encoder)
     x264_encoder_close (encoder->x264enc);
     encoder->x264enc = NULL;
   }
+  if (encoder->header_enc != NULL) {
+    x264_encoder_close (encoder->header_enc);
+    encoder->header_enc = NULL;
+  }
+  gst_x264_enc_clear_nals (encoder);
+
+  /* drop chunks that were not output */
+  if (encoder->chunk) {
+    gst_x264_enc_chunk_free (encoder->chunk);
+    encoder->chunk = NULL;
+  }
+  gst_x264_enc_finish_chunks (encoder, TRUE, FALSE);
+  if (encoder->chunk_pool) {
+    g_thread_pool_free (encoder->chunk_pool, FALSE, TRUE);
+    encoder->chunk_pool = NULL;
+  }
+}
+
+/* x264 passes the NAL units of x264_encoder_headers() to nalu_process too,
+ * before any frame exists. Take them from a second encoder set up the same
+ * way but without the callback, which gives the same SPS and PPS. */
+static int
+gst_x264_enc_encoder_headers (GstX264Enc * encoder, x264_nal_t ** nal,
+    int *i_nal)
+{
+  x264_param_t param;
+
+  if (!encoder->x264param.nalu_process)
+    return x264_encoder_headers (encoder->x264enc, nal, i_nal);
+
+  if (!encoder->header_enc) {
+    param = encoder->x264param;
+    param.nalu_process = NULL;
+    param.rc.b_stat_write = FALSE;
+    encoder->header_enc = x264_encoder_open (&param);
+    if (!encoder->header_enc)
+      return -1;
+  }
+
+  return x264_encoder_headers (encoder->header_enc, nal, i_nal);
 }
 
 static gboolean
@@ -1621,7 +1938,7 @@ gst_x264_enc_set_profile_and_level (GstX264Enc * encoder, GstCaps * caps)
   GstStructure *s2;
   const gchar *allowed_profile;
 
-  header_return = x264_encoder_headers (encoder->x264enc, &nal, &i_nal);
+  header_return = gst_x264_enc_encoder_headers (encoder, &nal, &i_nal);
   if (header_return < 0) {
     GST_ELEMENT_ERROR (encoder, STREAM, ENCODE, ("Encode x264 header failed."),
         ("x264_encoder_headers return code=%d", header_return));
@@ -1707,7 +2024,7 @@ gst_x264_enc_header_buf (GstX264Enc * encoder)
 
   /* Create avcC header. */
 
-  header_return = x264_encoder_headers (encoder->x264enc, &nal, &i_nal);
+  header_return = gst_x264_enc_encoder_headers (encoder, &nal, &i_nal);
   if (header_return < 0) {
     GST_ELEMENT_ERROR (encoder, STREAM, ENCODE, ("Encode x264 header failed."),
         ("x264_encoder_headers return code=%d", header_return));
@@ -1807,7 +2124,8 @@ gst_x264_enc_set_src_caps (GstX264Enc * encoder, GstCaps * caps)
     gst_structure_set (structure, "stream-format", G_TYPE_STRING, "byte-stream",
         NULL);
   }
-  gst_structure_set (structure, "alignment", G_TYPE_STRING, "au", NULL);
+  gst_structure_set (structure, "alignment", G_TYPE_STRING,
+      encoder->nal_alignment ? "nal" : "au", NULL);
 
   if (!gst_x264_enc_set_profile_and_level (encoder, outcaps)) {
     gst_caps_unref (outcaps);
@@ -1870,6 +2188,9 @@ gst_x264_enc_set_latency (GstX264Enc * encoder)
   GstClockTime latency;
 
   max_delayed_frames = x264_encoder_maximum_delayed_frames (encoder->x264enc);
+  if (encoder->chunked)
+    max_delayed_frames += encoder->chunk_frames *
+        (gst_x264_enc_chunk_jobs (encoder) + 1);
 
   if (info->fps_n) {
     latency = gst_util_uint64_scale_ceil (GST_SECOND * info->fps_d,
@@ -2054,8 +2375,7 @@ gst_x264_enc_set_format (GstVideoEncoder * video_enc,
 static GstFlowReturn
 gst_x264_enc_finish (GstVideoEncoder * encoder)
 {
-  gst_x264_enc_flush_frames (GST_X264_ENC (encoder), TRUE);
-  return GST_FLOW_OK;
+  return gst_x264_enc_flush_frames (GST_X264_ENC (encoder), TRUE);
 }
 
 static gboolean
@@ -2079,6 +2399,196 @@ gst_x264_enc_propose_allocation (GstVideoEncoder * encoder, GstQuery * query)
       query);
 }
 
+/* Builds the per macroblock quantizer offsets for the regions of interest
+ * of a frame whose type has an offset configured, or returns NULL. Where
+ * regions overlap the larger offset wins. */
+static gfloat *
+gst_x264_enc_roi_quant_offsets (GstX264Enc * encoder,
+    GstVideoCodecFrame * frame)
+{
+  GstMeta *meta;
+  gpointer state = NULL;
+  gfloat *offsets = NULL;
+  gint mb_width, mb_height;
+
+  mb_width = (encoder->x264param.i_width + 15) / 16;
+  if (encoder->x264param.b_interlaced)
+    mb_height = ((encoder->x264param.i_height + 31) / 32) * 2;
+  else
+    mb_height = (encoder->x264param.i_height + 15) / 16;
+
+  GST_OBJECT_LOCK (encoder);
+  if (!encoder->roi_quant_offsets)
+    goto done;
+
+  while ((meta = gst_buffer_iterate_meta (frame->input_buffer, &state))) {
+    GstVideoRegionOfInterestMeta *roi;
+    const GValue *value;
+    gdouble offset;
+    gint x, y, x0, y0, x1, y1;
+
+    if (meta->info->api != GST_VIDEO_REGION_OF_INTEREST_META_API_TYPE)
+      continue;
+
+    roi = (GstVideoRegionOfInterestMeta *) meta;
+    value = gst_structure_id_get_value (encoder->roi_quant_offsets,
+        roi->roi_type);
+    if (value && G_VALUE_HOLDS_DOUBLE (value))
+      offset = g_value_get_double (value);
+    else if (value && G_VALUE_HOLDS_INT (value))
+      offset = g_value_get_int (value);
+    else
+      continue;
+
+    x0 = MIN (roi->x / 16, mb_width);
+    y0 = MIN (roi->y / 16, mb_height);
+    x1 = MIN ((roi->x + roi->w + 15) / 16, mb_width);
+    y1 = MIN ((roi->y + roi->h + 15) / 16, mb_height);
+
+    GST_LOG_OBJECT (encoder, "ROI %s at %u,%u %ux%u: offset %f",
+        g_quark_to_string (roi->roi_type), roi->x, roi->y, roi->w, roi->h,
+        offset);
+
+    if (!offsets)
+      offsets = g_new0 (gfloat, mb_width * mb_height);
+
+    for (y = y0; y < y1; y++) {
+      for (x = x0; x < x1; x++) {
+        gfloat *mb = &offsets[y * mb_width + x];
+
+        if (ABS (offset) > ABS (*mb))
+          *mb = offset;
+      }
+    }
+  }
+
+done:
+  GST_OBJECT_UNLOCK (encoder);
+
+  return offsets;
+}
+
+/* create x264_picture_t from the buffer */
+/* mostly taken from mplayer (file ve_x264.c) */
+static void
+gst_x264_enc_fill_picture (GstX264Enc * encoder, FrameData * fdata,
+    x264_picture_t * pic_in)
+{
+  GstVideoInfo *info = &encoder->input_state->info;
+  gint i, nplanes = 0;
+
+  /* set up input picture */
+  memset (pic_in, 0, sizeof (*pic_in));
+
+  pic_in->img.i_csp =
+      gst_x264_enc_gst_to_x264_video_format (info->finfo->format, &nplanes);
+  pic_in->img.i_plane = nplanes;
+  for (i = 0; i < nplanes; i++) {
+    pic_in->img.plane[i] = GST_VIDEO_FRAME_COMP_DATA (&fdata->vframe, i);
+    pic_in->img.i_stride[i] = GST_VIDEO_FRAME_COMP_STRIDE (&fdata->vframe, i);
+  }
+
+  pic_in->i_type = X264_TYPE_AUTO;
+  pic_in->i_pts = fdata->frame->pts;
+  pic_in->opaque = fdata;
+  pic_in->prop.quant_offsets =
+      gst_x264_enc_roi_quant_offsets (encoder, fdata->frame);
+  pic_in->prop.quant_offsets_free = g_free;
+}
+
+/* Runs the first pass of two-pass encoding over a frame, which only writes
+ * the statistics. The frame is encoded for real by the second pass. */
+static GstFlowReturn
+gst_x264_enc_analyse_frame (GstX264Enc * encoder, x264_picture_t * pic_in,
+    GstVideoCodecFrame * frame)
+{
+  x264_picture_t pic_out;
+  x264_nal_t *nal;
+  int i_nal, i_size;
+
+  /* both passes must agree on the forced keyframes */
+  if (GST_VIDEO_CODEC_FRAME_IS_FORCE_KEYFRAME (frame))
+    pic_in->i_type = X264_TYPE_IDR;
+
+  i_size = x264_encoder_encode (encoder->x264enc, &nal, &i_nal, pic_in,
+      &pic_out);
+  if (i_size < 0) {
+    GST_ELEMENT_ERROR (encoder, STREAM, ENCODE, ("Encode x264 frame failed."),
+        ("x264_encoder_encode return code=%d", i_size));
+    return GST_FLOW_ERROR;
+  }
+
+  return GST_FLOW_OK;
+}
+
+/* Finishes the first pass and encodes all buffered frames again with the
+ * statistics it wrote. */
+static GstFlowReturn
+gst_x264_enc_second_pass (GstX264Enc * encoder)
+{
+  GstFlowReturn ret = GST_FLOW_OK;
+  x264_picture_t pic_in, pic_out;
+  x264_nal_t *nal;
+  FrameData *fdata;
+  gint i_nal;
+
+  while (x264_encoder_delayed_frames (encoder->x264enc) > 0) {
+    if (x264_encoder_encode (encoder->x264enc, &nal, &i_nal, NULL,
+            &pic_out) < 0)
+      break;
+  }
+
+  GST_DEBUG_OBJECT (encoder, "starting second pass over %u frames",
+      encoder->two_pass_frames.length);
+
+  /* closing the encoder writes out the statistics */
+  encoder->second_pass = TRUE;
+  if (!gst_x264_enc_init_encoder (encoder))
+    return GST_FLOW_ERROR;
+
+  /* the analysis pass had different headers */
+  if (!gst_x264_enc_set_src_caps (encoder, encoder->input_state->caps))
+    return GST_FLOW_NOT_NEGOTIATED;
+
+  while (ret == GST_FLOW_OK
+      && (fdata = g_queue_pop_head (&encoder->two_pass_frames))) {
+    gst_x264_enc_fill_picture (encoder, fdata, &pic_in);
+    ret = gst_x264_enc_encode_frame (encoder, &pic_in,
+        gst_video_codec_frame_ref (fdata->frame), &i_nal, TRUE);
+  }
+
+  return ret;
+}
+
+/* removes the statistics of two-pass encoding */
+static void
+gst_x264_enc_remove_stats (GstX264Enc * encoder)
+{
+  const gchar *name;
+  GDir *dir;
+
+  if (!encoder->stats_dir)
+    return;
+
+  /* x264 writes temporary files and the mbtree data next to the stats */
+  dir = g_dir_open (encoder->stats_dir, 0, NULL);
+  if (dir) {
+    while ((name = g_dir_read_name (dir))) {
+      gchar *path = g_build_filename (encoder->stats_dir, name, NULL);
+
+      g_unlink (path);
+      g_free (path);
+    }
+    g_dir_close (dir);
+  }
+  g_rmdir (encoder->stats_dir);
+
+  g_free (encoder->stats_dir);
+  encoder->stats_dir = NULL;
+  g_free (encoder->stats_file);
+  encoder->stats_file = NULL;
+}
+
 /* chain function
  * this function does the actual processing
  */
@@ -2090,34 +2600,53 @@ gst_x264_enc_handle_frame (GstVideoEncoder * video_enc,
   GstVideoInfo *info = &encoder->input_state->info;
   GstFlowReturn ret;
   x264_picture_t pic_in;
-  gint i_nal, i;
+  gint i_nal;
   FrameData *fdata;
-  gint nplanes = 0;
+
+  /* a two-pass encoder is closed at the end of each stream */
+  if (G_UNLIKELY (encoder->x264enc == NULL)
+      && encoder->pass == GST_X264_ENC_PASS_TWO_PASS && encoder->input_state) {
+    if (!gst_x264_enc_init_encoder (encoder))
+      return GST_FLOW_ERROR;
+  }
 
   if (G_UNLIKELY (encoder->x264enc == NULL))
     goto not_inited;
 
-  /* create x264_picture_t from the buffer */
-  /* mostly taken from mplayer (file ve_x264.c) */
+  if (encoder->pass == GST_X264_ENC_PASS_TWO_PASS && !encoder->second_pass) {
+    GstBuffer *copy;
 
-  /* set up input picture */
-  memset (&pic_in, 0, sizeof (pic_in));
+    /* the input is held until the end of the stream, so don't keep upstream
+     * pool buffers that long */
+    copy = gst_buffer_copy_deep (frame->input_buffer);
+    gst_buffer_unref (frame->input_buffer);
+    frame->input_buffer = copy;
+  }
 
   fdata = gst_x264_enc_queue_frame (encoder, frame, info);
   if (!fdata)
     goto invalid_frame;
 
-  pic_in.img.i_csp =
-      gst_x264_enc_gst_to_x264_video_format (info->finfo->format, &nplanes);
-  pic_in.img.i_plane = nplanes;
-  for (i = 0; i < nplanes; i++) {
-    pic_in.img.plane[i] = GST_VIDEO_FRAME_COMP_DATA (&fdata->vframe, i);
-    pic_in.img.i_stride[i] = GST_VIDEO_FRAME_COMP_STRIDE (&fdata->vframe, i);
+  gst_x264_enc_fill_picture (encoder, fdata, &pic_in);
+
+  if (encoder->pass == GST_X264_ENC_PASS_TWO_PASS && !encoder->second_pass) {
+    g_queue_push_tail (&encoder->two_pass_frames, fdata);
+    ret = gst_x264_enc_analyse_frame (encoder, &pic_in, frame);
+    gst_video_codec_frame_unref (frame);
+    return ret;
+  }
+
+  if (encoder->chunked) {
+    fdata->quant_offsets = pic_in.prop.quant_offsets;
+    gst_video_codec_frame_unref (frame);
+    return gst_x264_enc_add_chunk_frame (encoder, fdata);
   }
 
-  pic_in.i_type = X264_TYPE_AUTO;
-  pic_in.i_pts = frame->pts;
-  pic_in.opaque = GINT_TO_POINTER (frame->system_frame_number);
+  /* frames that carry events or a keyframe request must wait for the base
+   * class to push those first */
+  fdata->push_slices = encoder->nal_alignment
+      && encoder->slice_output_started && frame->events == NULL
+      && !GST_VIDEO_CODEC_FRAME_IS_FORCE_KEYFRAME (frame);
 
   ret = gst_x264_enc_encode_frame (encoder, &pic_in, frame, &i_nal, TRUE);
 
@@ -2137,19 +2666,438 @@ invalid_frame:
   }
 }
 
+static gint gst_x264_enc_compare_nals (gconstpointer a, gconstpointer b);
+
+/* Queues the slices that are done in picture order, with the NAL units in
+ * front of them, as parts of the frame, one NAL unit per buffer. The last
+ * slice is left to be output with the frame. Call with the nal lock held. */
+static void
+gst_x264_enc_queue_slices (GstX264Enc * encoder, GstVideoCodecFrame * frame)
+{
+  gboolean keyframe = FALSE;
+  guint i, end = 0;
+
+  g_array_sort (encoder->nals, gst_x264_enc_compare_nals);
+  for (i = 0; i < encoder->nals->len; i++) {
+    NalData *nal_data = &g_array_index (encoder->nals, NalData, i);
+
+    if (nal_data->order == 2)
+      break;
+    if (nal_data->order == 1) {
+      if (nal_data->first_mb != encoder->next_mb
+          || nal_data->last_mb >= encoder->frame_mbs - 1)
+        break;
+      encoder->next_mb = nal_data->last_mb + 1;
+      end = i + 1;
+    }
+  }
+  if (end == 0)
+    return;
+
+  for (i = 0; i < end; i++) {
+    if (g_array_index (encoder->nals, NalData, i).type == NAL_SLICE_IDR)
+      keyframe = TRUE;
+  }
+
+  for (i = 0; i < end; i++) {
+    NalData *nal_data = &g_array_index (encoder->nals, NalData, i);
+    GstBuffer *buf;
+
+    buf = gst_buffer_new ();
+    gst_buffer_append_memory (buf, nal_data->mem);
+
+    /* there are no B-frames, so decoding order is presentation order */
+    GST_BUFFER_PTS (buf) = frame->pts;
+    GST_BUFFER_DTS (buf) = frame->pts;
+    if (!keyframe)
+      GST_BUFFER_FLAG_SET (buf, GST_BUFFER_FLAG_DELTA_UNIT);
+
+    g_queue_push_tail (&encoder->slice_queue, buf);
+  }
+  g_array_remove_range (encoder->nals, 0, end);
+
+  GST_LOG_OBJECT (encoder, "queued slices up to macroblock %d",
+      encoder->next_mb - 1);
+}
+
+/* Pushes the queued slices in order. The slice threads push them while the
+ * streaming thread waits for x264_encoder_encode() to return, so it doesn't
+ * push anything itself, and only one of them at a time; a thread that finds
+ * another one pushing leaves its slices to that one, or to the streaming
+ * thread, which pushes what is left when the frame is encoded. */
+static void
+gst_x264_enc_push_slices (GstX264Enc * encoder, gboolean wait)
+{
+  GstBuffer *buf;
+  GstFlowReturn ret;
+
+  if (wait)
+    g_mutex_lock (&encoder->slice_push_lock);
+  else if (!g_mutex_trylock (&encoder->slice_push_lock))
+    return;
+
+  for (;;) {
+    g_mutex_lock (&encoder->nal_lock);
+    buf = g_queue_pop_head (&encoder->slice_queue);
+    g_mutex_unlock (&encoder->nal_lock);
+    if (buf == NULL)
+      break;
+
+    if (encoder->slice_ret != GST_FLOW_OK) {
+      gst_buffer_unref (buf);
+      continue;
+    }
+
+    ret = gst_pad_push (GST_VIDEO_ENCODER_SRC_PAD (encoder), buf);
+    if (ret != GST_FLOW_OK)
+      encoder->slice_ret = ret;
+  }
+
+  g_mutex_unlock (&encoder->slice_push_lock);
+}
+
+/* called by x264 for each NAL unit as soon as it is done, possibly from
+ * several slice threads at once */
+static void
+gst_x264_enc_nalu_process (x264_t * h, x264_nal_t * nal, void *opaque)
+{
+  FrameData *fdata = opaque;
+  GstX264Enc *encoder = fdata->encoder;
+  NalData nal_data;
+  GstMemory *arena;
+  guint8 *data;
+  gsize offset, reserve;
+
+  /* the worst case size x264_nal_encode() needs */
+  reserve = nal->i_payload * 3 / 2 + 5 + 64;
+
+  /* reserve room in the memory of the frame, and start a new one if it is
+   * full; the memory is written without mapping it, since it is shared by
+   * the NAL units already done */
+  g_mutex_lock (&encoder->nal_lock);
+  if (encoder->nal_arena == NULL
+      || encoder->nal_arena_size - encoder->nal_arena_used < reserve) {
+    if (encoder->nal_arena)
+      gst_memory_unref (encoder->nal_arena);
+    encoder->nal_arena_size = MAX (reserve, encoder->nal_arena_hint);
+    encoder->nal_arena_data = g_malloc (encoder->nal_arena_size);
+    encoder->nal_arena = gst_memory_new_wrapped (0, encoder->nal_arena_data,
+        encoder->nal_arena_size, 0, encoder->nal_arena_size,
+        encoder->nal_arena_data, g_free);
+    encoder->nal_arena_used = 0;
+  }
+  arena = gst_memory_ref (encoder->nal_arena);
+  data = encoder->nal_arena_data;
+  offset = encoder->nal_arena_used;
+  encoder->nal_arena_used += reserve;
+  encoder->nal_frame_bytes += reserve;
+  g_mutex_unlock (&encoder->nal_lock);
+
+  x264_nal_encode (h, data + offset, nal);
+
+  g_mutex_lock (&encoder->nal_lock);
+  /* give back what was not used, unless another NAL unit came after */
+  if (arena == encoder->nal_arena
+      && encoder->nal_arena_used == offset + reserve) {
+    encoder->nal_arena_used = offset + nal->i_payload;
+    encoder->nal_frame_bytes -= reserve - nal->i_payload;
+  }
+
+  nal_data.mem = gst_memory_share (arena, offset, nal->i_payload);
+  gst_memory_unref (arena);
+  nal_data.type = nal->i_type;
+
+  /* slices can finish out of order, sort them by position; everything
+   * else keeps its place before or after them */
+  if (nal->i_type == NAL_SLICE || nal->i_type == NAL_SLICE_IDR) {
+    encoder->nal_slices = TRUE;
+    nal_data.order = 1;
+    nal_data.first_mb = nal->i_first_mb;
+    nal_data.last_mb = nal->i_last_mb;
+  } else {
+    nal_data.order = encoder->nal_slices ? 2 : 0;
+    nal_data.first_mb = nal_data.last_mb = encoder->nals->len;
+  }
+  g_array_append_val (encoder->nals, nal_data);
+  if (fdata->push_slices)
+    gst_x264_enc_queue_slices (encoder, fdata->frame);
+  g_mutex_unlock (&encoder->nal_lock);
+
+  /* never block on downstream with the lock held */
+  if (fdata->push_slices)
+    gst_x264_enc_push_slices (encoder, FALSE);
+}
+
+static gint
+gst_x264_enc_compare_nals (gconstpointer a, gconstpointer b)
+{
+  const NalData *na = a, *nb = b;
+
+  if (na->order != nb->order)
+    return na->order - nb->order;
+  return na->first_mb - nb->first_mb;
+}
+
+static void
+gst_x264_enc_clear_nals (GstX264Enc * encoder)
+{
+  guint i;
+
+  for (i = 0; i < encoder->nals->len; i++)
+    gst_memory_unref (g_array_index (encoder->nals, NalData, i).mem);
+  g_array_set_size (encoder->nals, 0);
+  encoder->nal_slices = FALSE;
+
+  /* the next frame starts a memory of its own, of about twice the size this
+   * one took */
+  if (encoder->nal_arena) {
+    gst_memory_unref (encoder->nal_arena);
+    encoder->nal_arena = NULL;
+  }
+  if (encoder->nal_frame_bytes > 0)
+    encoder->nal_arena_hint = 2 * encoder->nal_frame_bytes + 1024;
+  encoder->nal_frame_bytes = 0;
+}
+
+/* Output buffer with one memory per NAL unit, so that NAL units can be
+ * replaced or prefixed without copying the others. */
+static GstBuffer *gst_x264_enc_copy_nals (GstBuffer * out_buf,
+    x264_nal_t * nal, int i_nal, int i_size);
+
+static GstBuffer *
+gst_x264_enc_output_buffer (GstX264Enc * encoder, x264_nal_t * nal, int i_nal,
+    int i_size)
+{
+  GstBuffer *out_buf;
+  guint i;
+
+  out_buf = gst_buffer_new ();
+
+  if (encoder->x264param.nalu_process) {
+    /* more than gst_buffer_get_max_memory() memories end up merged */
+    g_array_sort (encoder->nals, gst_x264_enc_compare_nals);
+    for (i = 0; i < encoder->nals->len; i++)
+      gst_buffer_append_memory (out_buf,
+          gst_memory_ref (g_array_index (encoder->nals, NalData, i).mem));
+    gst_x264_enc_clear_nals (encoder);
+    return out_buf;
+  }
+
+  return gst_x264_enc_copy_nals (out_buf, nal, i_nal, i_size);
+}
+
+/* x264 reuses its NAL memory on the next call, so copy all NAL units
+ * at once and share the copy */
+static GstBuffer *
+gst_x264_enc_copy_nals (GstBuffer * out_buf, x264_nal_t * nal, int i_nal,
+    int i_size)
+{
+  GstMemory *mem;
+  GstMapInfo map;
+  guint i;
+
+  mem = gst_allocator_alloc (NULL, i_size, NULL);
+  gst_memory_map (mem, &map, GST_MAP_WRITE);
+  memcpy (map.data, nal[0].p_payload, i_size);
+  gst_memory_unmap (mem, &map);
+
+  if (i_nal > 1 && (guint) i_nal <= gst_buffer_get_max_memory ()) {
+    for (i = 0; i < (guint) i_nal; i++)
+      gst_buffer_append_memory (out_buf, gst_memory_share (mem,
+              nal[i].p_payload - nal[0].p_payload, nal[i].i_payload));
+    gst_memory_unref (mem);
+  } else {
+    gst_buffer_append_memory (out_buf, mem);
+  }
+
+  return out_buf;
+}
+
+/* With alignment=nal every NAL unit of the frame that was not pushed yet
+ * is a buffer of its own */
+static GPtrArray *
+gst_x264_enc_output_nals (GstX264Enc * encoder, x264_nal_t * nal, int i_nal,
+    int i_size)
+{
+  GPtrArray *nal_bufs;
+  GstBuffer *buf;
+  GstMemory *mem;
+  GstMapInfo map;
+  guint i;
+
+  nal_bufs = g_ptr_array_new ();
+
+  if (encoder->x264param.nalu_process) {
+    g_array_sort (encoder->nals, gst_x264_enc_compare_nals);
+    for (i = 0; i < encoder->nals->len; i++) {
+      buf = gst_buffer_new ();
+      gst_buffer_append_memory (buf,
+          gst_memory_ref (g_array_index (encoder->nals, NalData, i).mem));
+      g_ptr_array_add (nal_bufs, buf);
+    }
+    gst_x264_enc_clear_nals (encoder);
+    return nal_bufs;
+  }
+
+  mem = gst_allocator_alloc (NULL, i_size, NULL);
+  gst_memory_map (mem, &map, GST_MAP_WRITE);
+  memcpy (map.data, nal[0].p_payload, i_size);
+  gst_memory_unmap (mem, &map);
+
+  for (i = 0; i < (guint) i_nal; i++) {
+    buf = gst_buffer_new ();
+    gst_buffer_append_memory (buf, gst_memory_share (mem,
+            nal[i].p_payload - nal[0].p_payload, nal[i].i_payload));
+    g_ptr_array_add (nal_bufs, buf);
+  }
+  gst_memory_unref (mem);
+
+  return nal_bufs;
+}
+
+/* Pushes the NAL units of a frame that follow the one output with it */
+static GstFlowReturn
+gst_x264_enc_push_nals (GstX264Enc * encoder, GPtrArray * nal_bufs,
+    GstClockTime pts, GstClockTime dts, gboolean keyframe, GstFlowReturn ret)
+{
+  GstBuffer *buf;
+
+  while (ret == GST_FLOW_OK && nal_bufs->len > 0) {
+    buf = g_ptr_array_remove_index (nal_bufs, 0);
+    GST_BUFFER_PTS (buf) = pts;
+    GST_BUFFER_DTS (buf) = dts;
+    if (!keyframe)
+      GST_BUFFER_FLAG_SET (buf, GST_BUFFER_FLAG_DELTA_UNIT);
+    ret = gst_pad_push (GST_VIDEO_ENCODER_SRC_PAD (encoder), buf);
+  }
+
+  return ret;
+}
+
+static void
+gst_x264_enc_free_nals (GPtrArray * nal_bufs)
+{
+  g_ptr_array_foreach (nal_bufs, (GFunc) gst_buffer_unref, NULL);
+  g_ptr_array_free (nal_bufs, TRUE);
+}
+
+static void
+gst_x264_enc_reset_stats (GstX264Enc * encoder)
+{
+  encoder->stats_frames = 0;
+  memset (encoder->stats_type_frames, 0, sizeof (encoder->stats_type_frames));
+  encoder->stats_qp = encoder->stats_psnr = encoder->stats_ssim = 0.0;
+  encoder->stats_bytes = 0;
+  encoder->stats_time = encoder->stats_max_time = 0;
+}
+
+/* Attaches the statistics of an encoded frame to its buffer, and adds them
+ * to the next statistics message */
+static void
+gst_x264_enc_frame_stats (GstX264Enc * encoder, GstBuffer * buffer,
+    x264_picture_t * pic_out, gint size, GstClockTime encode_time,
+    gint delayed_frames)
+{
+  GstX264EncFrameStatsMeta *meta;
+  GstStructure *s;
+  gdouble psnr = -1.0, ssim = -1.0;
+  gchar type;
+
+  /* the letters of the x264 stats file */
+  switch (pic_out->i_type) {
+    case X264_TYPE_IDR:
+      type = 'I';
+      break;
+    case X264_TYPE_I:
+      type = 'i';
+      break;
+    case X264_TYPE_P:
+      type = 'P';
+      break;
+    case X264_TYPE_BREF:
+      type = 'B';
+      break;
+    default:
+      type = 'b';
+      break;
+  }
+  if (encoder->x264param.analyse.b_psnr)
+    psnr = pic_out->prop.f_psnr_avg;
+  if (encoder->x264param.analyse.b_ssim)
+    ssim = pic_out->prop.f_ssim;
+
+  if (encoder->frame_stats) {
+    meta = (GstX264EncFrameStatsMeta *) gst_buffer_add_meta (buffer,
+        GST_X264_ENC_FRAME_STATS_META_INFO, NULL);
+    meta->type = type;
+    meta->qp = pic_out->i_qpplus1 - 1;
+    meta->size = size;
+    meta->psnr = psnr;
+    meta->ssim = ssim;
+    meta->encode_time = encode_time;
+    meta->delayed_frames = delayed_frames;
+  }
+
+  if (!encoder->stats_interval)
+    return;
+
+  encoder->stats_frames++;
+  if (type == 'I' || type == 'i')
+    encoder->stats_type_frames[0]++;
+  else if (type == 'P')
+    encoder->stats_type_frames[1]++;
+  else
+    encoder->stats_type_frames[2]++;
+  encoder->stats_qp += pic_out->i_qpplus1 - 1;
+  encoder->stats_psnr += psnr;
+  encoder->stats_ssim += ssim;
+  encoder->stats_bytes += size;
+  encoder->stats_time += encode_time;
+  encoder->stats_max_time = MAX (encoder->stats_max_time, encode_time);
+
+  if (encoder->stats_frames < encoder->stats_interval)
+    return;
+
+  s = gst_structure_new ("x264enc-stats",
+      "frames", G_TYPE_UINT, encoder->stats_frames,
+      "i-frames", G_TYPE_UINT, encoder->stats_type_frames[0],
+      "p-frames", G_TYPE_UINT, encoder->stats_type_frames[1],
+      "b-frames", G_TYPE_UINT, encoder->stats_type_frames[2],
+      "average-qp", G_TYPE_DOUBLE,
+      encoder->stats_qp / encoder->stats_frames,
+      "bytes", G_TYPE_UINT64, encoder->stats_bytes,
+      "average-encode-time", G_TYPE_UINT64,
+      encoder->stats_time / encoder->stats_frames,
+      "max-encode-time", G_TYPE_UINT64, encoder->stats_max_time,
+      "delayed-frames", G_TYPE_INT, delayed_frames, NULL);
+  if (psnr >= 0.0)
+    gst_structure_set (s, "average-psnr", G_TYPE_DOUBLE,
+        encoder->stats_psnr / encoder->stats_frames, NULL);
+  if (ssim >= 0.0)
+    gst_structure_set (s, "average-ssim", G_TYPE_DOUBLE,
+        encoder->stats_ssim / encoder->stats_frames, NULL);
+
+  gst_element_post_message (GST_ELEMENT_CAST (encoder),
+      gst_message_new_element (GST_OBJECT_CAST (encoder), s));
+
+  gst_x264_enc_reset_stats (encoder);
+}
+
 static GstFlowReturn
 gst_x264_enc_encode_frame (GstX264Enc * encoder, x264_picture_t * pic_in,
     GstVideoCodecFrame * input_frame, int *i_nal, gboolean send)
 {
   GstVideoCodecFrame *frame = NULL;
   GstBuffer *out_buf = NULL;
+  GPtrArray *nal_bufs = NULL;
   x264_picture_t pic_out;
   x264_nal_t *nal;
   int i_size;
   int encoder_return;
   GstFlowReturn ret = GST_FLOW_OK;
-  guint8 *data;
+  FrameData *fdata;
   gboolean update_latency = FALSE;
+  GstClockTime encode_time;
 
   if (G_UNLIKELY (encoder->x264enc == NULL)) {
     if (input_frame)
@@ -2179,8 +3127,17 @@ gst_x264_enc_encode_frame (GstX264Enc * encoder, x264_picture_t * pic_in,
   if (G_UNLIKELY (update_latency))
     gst_x264_enc_set_latency (encoder);
 
+  encoder->next_mb = 0;
+  encoder->slice_ret = GST_FLOW_OK;
+
+  encode_time = gst_util_get_timestamp ();
   encoder_return = x264_encoder_encode (encoder->x264enc,
       &nal, i_nal, pic_in, &pic_out);
+  encode_time = gst_util_get_timestamp () - encode_time;
+
+  /* whatever the slice threads left */
+  if (encoder->nal_alignment)
+    gst_x264_enc_push_slices (encoder, TRUE);
 
   if (encoder_return < 0) {
     GST_ELEMENT_ERROR (encoder, STREAM, ENCODE, ("Encode x264 frame failed."),
@@ -2201,20 +3158,33 @@ gst_x264_enc_encode_frame (GstX264Enc * encoder, x264_picture_t * pic_in,
   }
 
   i_size = encoder_return;
-  data = nal[0].p_payload;
+  if (encoder->nal_alignment) {
+    nal_bufs = gst_x264_enc_output_nals (encoder, nal, *i_nal, i_size);
+    out_buf = g_ptr_array_remove_index (nal_bufs, 0);
+  } else {
+    out_buf = gst_x264_enc_output_buffer (encoder, nal, *i_nal, i_size);
+  }
 
+  fdata = pic_out.opaque;
   frame = gst_video_encoder_get_frame (GST_VIDEO_ENCODER (encoder),
-      GPOINTER_TO_INT (pic_out.opaque));
+      fdata->frame->system_frame_number);
   g_assert (frame || !send);
 
   if (!send || !frame) {
+    gst_buffer_unref (out_buf);
     ret = GST_FLOW_OK;
     goto out;
   }
 
-  out_buf = gst_buffer_new_allocate (NULL, i_size, NULL);
-  gst_buffer_fill (out_buf, 0, data, i_size);
   frame->output_buffer = out_buf;
+  if (nal_bufs) {
+    /* the last part of the frame */
+    if (nal_bufs->len > 0)
+      GST_BUFFER_FLAG_SET (g_ptr_array_index (nal_bufs, nal_bufs->len - 1),
+          GST_BUFFER_FLAG_MARKER);
+    else
+      GST_BUFFER_FLAG_SET (out_buf, GST_BUFFER_FLAG_MARKER);
+  }
 
   GST_LOG_OBJECT (encoder,
       "output: dts %" G_GINT64_FORMAT " pts %" G_GINT64_FORMAT,
@@ -2231,27 +3201,343 @@ gst_x264_enc_encode_frame (GstX264Enc * encoder, x264_picture_t * pic_in,
     GST_VIDEO_CODEC_FRAME_SET_SYNC_POINT (frame);
   }
 
+  gst_x264_enc_frame_stats (encoder, out_buf, &pic_out, i_size, encode_time,
+      x264_encoder_delayed_frames (encoder->x264enc));
+
 out:
   if (frame) {
+    GstClockTime pts = frame->pts, dts = frame->dts;
+    gboolean keyframe = GST_VIDEO_CODEC_FRAME_IS_SYNC_POINT (frame);
+
     gst_x264_enc_dequeue_frame (encoder, frame);
     ret = gst_video_encoder_finish_frame (GST_VIDEO_ENCODER (encoder), frame);
+    /* pending events and caps are out, following frames can be pushed
+     * in parts */
+    if (ret == GST_FLOW_OK)
+      encoder->slice_output_started = TRUE;
+
+    /* the first NAL unit went out with the frame, now the others */
+    if (nal_bufs && send)
+      ret = gst_x264_enc_push_nals (encoder, nal_bufs, pts, dts, keyframe,
+          ret);
   }
 
+  if (nal_bufs)
+    gst_x264_enc_free_nals (nal_bufs);
+
+  if (ret == GST_FLOW_OK)
+    ret = encoder->slice_ret;
+
   return ret;
 }
 
+/* Chunked encoding: closed GOP chunks of chunk-frames input frames are
+ * encoded by their own x264 instance on a thread pool, all set up with the
+ * same parameters so that they share SPS and PPS. The main encoder then only
+ * provides the headers. Chunks are output in order; as x264 derives DTS from
+ * the PTS of the first frames and the frame rate, the timestamps continue
+ * across chunks. */
+struct _GstX264EncChunk
+{
+  x264_param_t param;
+  gint csp, nplanes;
+
+  /* FrameData, in input order */
+  GPtrArray *frames;
+
+  /* ChunkOutput, in decoding order */
+  GQueue output;
+  gint error;
+  gboolean done;
+};
+
+typedef struct
+{
+  GstBuffer *buffer;
+  x264_picture_t pic_out;
+  gint size;
+  GstClockTime encode_time;
+  gint delayed_frames;
+} ChunkOutput;
+
+static guint
+gst_x264_enc_chunk_jobs (GstX264Enc * encoder)
+{
+  return encoder->chunk_jobs ? encoder->chunk_jobs : g_get_num_processors ();
+}
+
+static void
+gst_x264_enc_chunk_free (GstX264EncChunk * chunk)
+{
+  ChunkOutput *out;
+
+  while ((out = g_queue_pop_head (&chunk->output))) {
+    gst_buffer_unref (out->buffer);
+    g_slice_free (ChunkOutput, out);
+  }
+  g_ptr_array_free (chunk->frames, TRUE);
+  g_slice_free (GstX264EncChunk, chunk);
+}
+
+static void
+gst_x264_enc_chunk_output (GstX264EncChunk * chunk, x264_t * x264enc,
+    x264_nal_t * nal, int i_nal, int i_size, x264_picture_t * pic_out,
+    GstClockTime encode_time)
+{
+  ChunkOutput *out;
+
+  if (i_size < 0) {
+    chunk->error = i_size;
+    return;
+  }
+  if (!i_nal)
+    return;
+
+  out = g_slice_new (ChunkOutput);
+  out->buffer = gst_x264_enc_copy_nals (gst_buffer_new (), nal, i_nal, i_size);
+  out->pic_out = *pic_out;
+  out->size = i_size;
+  out->encode_time = encode_time;
+  out->delayed_frames = x264_encoder_delayed_frames (x264enc);
+  g_queue_push_tail (&chunk->output, out);
+}
+
+/* runs on the chunk thread pool */
+static void
+gst_x264_enc_encode_chunk (GstX264EncChunk * chunk, GstX264Enc * encoder)
+{
+  x264_picture_t pic_in, pic_out;
+  x264_nal_t *nal;
+  x264_t *x264enc;
+  int i_nal, i_size;
+  GstClockTime start;
+  guint i;
+  gint j;
+
+  x264enc = x264_encoder_open (&chunk->param);
+  if (!x264enc) {
+    chunk->error = -1;
+    goto done;
+  }
+
+  for (i = 0; i < chunk->frames->len && !chunk->error; i++) {
+    FrameData *fdata = g_ptr_array_index (chunk->frames, i);
+
+    memset (&pic_in, 0, sizeof (pic_in));
+    pic_in.img.i_csp = chunk->csp;
+    pic_in.img.i_plane = chunk->nplanes;
+    for (j = 0; j < chunk->nplanes; j++) {
+      pic_in.img.plane[j] = GST_VIDEO_FRAME_COMP_DATA (&fdata->vframe, j);
+      pic_in.img.i_stride[j] = GST_VIDEO_FRAME_COMP_STRIDE (&fdata->vframe, j);
+    }
+
+    /* every chunk starts with an IDR frame */
+    if (i == 0 || GST_VIDEO_CODEC_FRAME_IS_FORCE_KEYFRAME (fdata->frame))
+      pic_in.i_type = X264_TYPE_IDR;
+    else
+      pic_in.i_type = X264_TYPE_AUTO;
+    pic_in.i_pts = fdata->frame->pts;
+    pic_in.opaque = fdata;
+    /* x264 frees the offsets once it is done with them */
+    pic_in.prop.quant_offsets = fdata->quant_offsets;
+    pic_in.prop.quant_offsets_free = g_free;
+    fdata->quant_offsets = NULL;
+
+    start = gst_util_get_timestamp ();
+    i_size = x264_encoder_encode (x264enc, &nal, &i_nal, &pic_in, &pic_out);
+    gst_x264_enc_chunk_output (chunk, x264enc, nal, i_nal, i_size, &pic_out,
+        gst_util_get_timestamp () - start);
+  }
+
+  while (!chunk->error && x264_encoder_delayed_frames (x264enc) > 0) {
+    start = gst_util_get_timestamp ();
+    i_size = x264_encoder_encode (x264enc, &nal, &i_nal, NULL, &pic_out);
+    gst_x264_enc_chunk_output (chunk, x264enc, nal, i_nal, i_size, &pic_out,
+        gst_util_get_timestamp () - start);
+  }
+
+  x264_encoder_close (x264enc);
+
+done:
+  g_mutex_lock (&encoder->chunk_lock);
+  chunk->done = TRUE;
+  g_cond_broadcast (&encoder->chunk_cond);
+  g_mutex_unlock (&encoder->chunk_lock);
+}
+
 static void
+gst_x264_enc_submit_chunk (GstX264Enc * encoder)
+{
+  GstX264EncChunk *chunk = encoder->chunk;
+  GstVideoInfo *info = &encoder->input_state->info;
+
+  encoder->chunk = NULL;
+  if (!chunk)
+    return;
+
+  if (!encoder->chunk_pool)
+    encoder->chunk_pool =
+        g_thread_pool_new ((GFunc) gst_x264_enc_encode_chunk, encoder,
+        gst_x264_enc_chunk_jobs (encoder), FALSE, NULL);
+
+  GST_OBJECT_LOCK (encoder);
+  chunk->param = encoder->x264param;
+  GST_OBJECT_UNLOCK (encoder);
+
+  /* the chunks provide the parallelism, so don't let every one of them
+   * start a thread per CPU */
+  if (chunk->param.i_threads == X264_THREADS_AUTO)
+    chunk->param.i_threads = 1;
+  chunk->param.nalu_process = NULL;
+  chunk->csp =
+      gst_x264_enc_gst_to_x264_video_format (info->finfo->format,
+      &chunk->nplanes);
+
+  GST_DEBUG_OBJECT (encoder, "submitting chunk of %u frames",
+      chunk->frames->len);
+
+  g_queue_push_tail (&encoder->chunks, chunk);
+  g_thread_pool_push (encoder->chunk_pool, chunk, NULL);
+}
+
+static GstFlowReturn
+gst_x264_enc_push_chunk (GstX264Enc * encoder, GstX264EncChunk * chunk,
+    gboolean send)
+{
+  GstFlowReturn ret = GST_FLOW_OK;
+  ChunkOutput *out;
+
+  if (chunk->error) {
+    GST_ELEMENT_ERROR (encoder, STREAM, ENCODE, ("Encode x264 frame failed."),
+        ("x264_encoder_encode return code=%d", chunk->error));
+    ret = GST_FLOW_ERROR;
+  }
+
+  while ((out = g_queue_pop_head (&chunk->output))) {
+    FrameData *fdata = out->pic_out.opaque;
+    GstVideoCodecFrame *frame;
+
+    frame = gst_video_encoder_get_frame (GST_VIDEO_ENCODER (encoder),
+        fdata->frame->system_frame_number);
+
+    if (frame && send && ret == GST_FLOW_OK) {
+      frame->output_buffer = out->buffer;
+      frame->dts = out->pic_out.i_dts;
+      frame->pts = out->pic_out.i_pts;
+      if (out->pic_out.b_keyframe)
+        GST_VIDEO_CODEC_FRAME_SET_SYNC_POINT (frame);
+      gst_x264_enc_frame_stats (encoder, out->buffer, &out->pic_out,
+          out->size, out->encode_time, out->delayed_frames);
+    } else {
+      gst_buffer_unref (out->buffer);
+    }
+    g_slice_free (ChunkOutput, out);
+
+    if (frame) {
+      GstFlowReturn frame_ret;
+
+      gst_x264_enc_dequeue_frame (encoder, frame);
+      frame_ret =
+          gst_video_encoder_finish_frame (GST_VIDEO_ENCODER (encoder), frame);
+      if (ret == GST_FLOW_OK)
+        ret = frame_ret;
+    }
+  }
+
+  return ret;
+}
+
+/* outputs the finished chunks at the head of the queue, waiting for them
+ * if all chunks are wanted or too many are in flight */
+static GstFlowReturn
+gst_x264_enc_finish_chunks (GstX264Enc * encoder, gboolean all, gboolean send)
+{
+  GstFlowReturn ret = GST_FLOW_OK;
+  GstX264EncChunk *chunk;
+
+  while ((chunk = g_queue_peek_head (&encoder->chunks))) {
+    gboolean done;
+
+    g_mutex_lock (&encoder->chunk_lock);
+    if (all || encoder->chunks.length > gst_x264_enc_chunk_jobs (encoder)) {
+      while (!chunk->done)
+        g_cond_wait (&encoder->chunk_cond, &encoder->chunk_lock);
+    }
+    done = chunk->done;
+    g_mutex_unlock (&encoder->chunk_lock);
+
+    if (!done)
+      break;
+
+    g_queue_pop_head (&encoder->chunks);
+    if (ret == GST_FLOW_OK)
+      ret = gst_x264_enc_push_chunk (encoder, chunk, send);
+    else
+      gst_x264_enc_push_chunk (encoder, chunk, FALSE);
+    gst_x264_enc_chunk_free (chunk);
+  }
+
+  return ret;
+}
+
+static GstFlowReturn
+gst_x264_enc_add_chunk_frame (GstX264Enc * encoder, FrameData * fdata)
+{
+  if (!encoder->chunk) {
+    encoder->chunk = g_slice_new0 (GstX264EncChunk);
+    encoder->chunk->frames = g_ptr_array_new ();
+    g_queue_init (&encoder->chunk->output);
+  }
+
+  g_ptr_array_add (encoder->chunk->frames, fdata);
+  if (encoder->chunk->frames->len >= encoder->chunk_frames)
+    gst_x264_enc_submit_chunk (encoder);
+
+  return gst_x264_enc_finish_chunks (encoder, FALSE, TRUE);
+}
+
+/* returns the first error of pushing the remaining frames, if any */
+static GstFlowReturn
 gst_x264_enc_flush_frames (GstX264Enc * encoder, gboolean send)
 {
-  GstFlowReturn flow_ret;
+  GstFlowReturn ret, flow_ret = GST_FLOW_OK;
   gint i_nal;
 
+  /* encode the last partial chunk too, or drop it */
+  if (send) {
+    gst_x264_enc_submit_chunk (encoder);
+  } else if (encoder->chunk) {
+    gst_x264_enc_chunk_free (encoder->chunk);
+    encoder->chunk = NULL;
+  }
+  ret = gst_x264_enc_finish_chunks (encoder, TRUE, send);
+
+  /* encode the buffered frames for real, or forget them */
+  if (send && encoder->x264enc && encoder->two_pass_frames.length > 0)
+    flow_ret = gst_x264_enc_second_pass (encoder);
+  g_queue_clear (&encoder->two_pass_frames);
+  if (ret == GST_FLOW_OK)
+    ret = flow_ret;
+
   /* first send the remaining frames */
-  if (encoder->x264enc)
+  if (encoder->x264enc) {
     do {
       flow_ret = gst_x264_enc_encode_frame (encoder, NULL, NULL, &i_nal, send);
     } while (flow_ret == GST_FLOW_OK
         && x264_encoder_delayed_frames (encoder->x264enc) > 0);
+    if (ret == GST_FLOW_OK)
+      ret = flow_ret;
+  }
+
+  /* whatever follows starts with a first pass again, on an encoder that is
+   * set up when it arrives */
+  if (encoder->second_pass) {
+    encoder->second_pass = FALSE;
+    gst_x264_enc_close_encoder (encoder);
+    gst_x264_enc_remove_stats (encoder);
+  }
+
+  return ret;
 }
 
 static void
@@ -2269,6 +3555,7 @@ gst_x264_enc_reconfig (GstX264Enc * encoder)
     case GST_X264_ENC_PASS_PASS1:
     case GST_X264_ENC_PASS_PASS2:
     case GST_X264_ENC_PASS_PASS3:
+    case GST_X264_ENC_PASS_TWO_PASS:
     default:
       encoder->x264param.rc.i_bitrate = encoder->bitrate;
       encoder->x264param.rc.i_vbv_max_bitrate = encoder->bitrate;
@@ -2481,6 +3768,26 @@ gst_x264_enc_set_property (GObject * object, guint prop_id,
     case ARG_FRAME_PACKING:
       encoder->frame_packing = g_value_get_enum (value);
       break;
+    case ARG_SLICE_OUTPUT:
+      encoder->slice_output = g_value_get_boolean (value);
+      break;
+    case ARG_CHUNK_FRAMES:
+      encoder->chunk_frames = g_value_get_uint (value);
+      break;
+    case ARG_CHUNK_JOBS:
+      encoder->chunk_jobs = g_value_get_uint (value);
+      break;
+    case ARG_ROI_QUANT_OFFSETS:
+      if (encoder->roi_quant_offsets)
+        gst_structure_free (encoder->roi_quant_offsets);
+      encoder->roi_quant_offsets = g_value_dup_boxed (value);
+      break;
+    case ARG_FRAME_STATS:
+      encoder->frame_stats = g_value_get_boolean (value);
+      break;
+    case ARG_STATS_INTERVAL:
+      encoder->stats_interval = g_value_get_uint (value);
+      break;
     default:
       G_OBJECT_WARN_INVALID_PROPERTY_ID (object, prop_id, pspec);
       break;
@@ -2620,6 +3927,24 @@ gst_x264_enc_get_property (GObject * object, guint prop_id,
     case ARG_FRAME_PACKING:
       g_value_set_enum (value, encoder->frame_packing);
       break;
+    case ARG_SLICE_OUTPUT:
+      g_value_set_boolean (value, encoder->slice_output);
+      break;
+    case ARG_CHUNK_FRAMES:
+      g_value_set_uint (value, encoder->chunk_frames);
+      break;
+    case ARG_CHUNK_JOBS:
+      g_value_set_uint (value, encoder->chunk_jobs);
+      break;
+    case ARG_ROI_QUANT_OFFSETS:
+      g_value_set_boxed (value, encoder->roi_quant_offsets);
+      break;
+    case ARG_FRAME_STATS:
+      g_value_set_boolean (value, encoder->frame_stats);
+      break;
+    case ARG_STATS_INTERVAL:
+      g_value_set_uint (value, encoder->stats_interval);
+      break;
     default:
       G_OBJECT_WARN_INVALID_PROPERTY_ID (object, prop_id, pspec);
       break;
@@ -2635,8 +3960,12 @@ plugin_init (GstPlugin * plugin)
 
   GST_INFO ("x264 build: %u", X264_BUILD);
 
-  return gst_element_register (plugin, "x264enc",
-      GST_RANK_PRIMARY, GST_TYPE_X264_ENC);
+  if (!gst_element_register (plugin, "x264enc",
+          GST_RANK_PRIMARY, GST_TYPE_X264_ENC))
+    return FALSE;
+
+  return gst_element_register (plugin, "x264ladderenc",
+      GST_RANK_NONE, GST_TYPE_X264_LADDER_ENC);
 }
 
 GST_PLUGIN_DEFINE (GST_VERSION_MAJOR,
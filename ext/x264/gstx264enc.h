@@ -46,6 +46,8 @@ G_BEGIN_DECLS
 
 typedef struct _GstX264Enc GstX264Enc;
 typedef struct _GstX264EncClass GstX264EncClass;
+typedef struct _GstX264EncChunk GstX264EncChunk;
+typedef struct _GstX264EncFrameStatsMeta GstX264EncFrameStatsMeta;
 
 struct _GstX264Enc
 {
@@ -56,6 +58,43 @@ struct _GstX264Enc
   x264_param_t x264param;
   gint current_byte_stream;
 
+  /* only gives the stream headers when NAL units are output directly */
+  x264_t *header_enc;
+
+  /* NAL units of the frame being encoded, when output directly; they are
+   * encoded into one memory per frame, and share it */
+  GMutex nal_lock;
+  GArray *nals;
+  gboolean nal_slices;
+  GstMemory *nal_arena;
+  guint8 *nal_arena_data;
+  gsize nal_arena_size, nal_arena_used;
+  gsize nal_frame_bytes, nal_arena_hint;
+
+  /* slice output state; the slices done while the frame is encoded are
+   * queued and pushed one NAL unit per buffer, one thread at a time */
+  gboolean nal_alignment;
+  gboolean slice_output_started;
+  gint frame_mbs;
+  gint next_mb;
+  GQueue slice_queue;
+  GMutex slice_push_lock;
+  GstFlowReturn slice_ret;
+
+  /* two-pass encoding state: the frames buffered during the first pass */
+  GQueue two_pass_frames;
+  gboolean second_pass;
+  gchar *stats_dir;
+  gchar *stats_file;
+
+  /* chunked encoding state */
+  gboolean chunked;
+  GstX264EncChunk *chunk;
+  GQueue chunks;
+  GThreadPool *chunk_pool;
+  GMutex chunk_lock;
+  GCond chunk_cond;
+
   /* List of frame/buffer mapping structs for
    * pending frames */
   GList *pending_frames;
@@ -101,6 +140,19 @@ struct _GstX264Enc
   GString *option_string_prop; /* option-string property */
   GString *option_string; /* used by set prop */
   gint frame_packing;
+  gboolean slice_output;
+  guint chunk_frames;
+  guint chunk_jobs;
+  GstStructure *roi_quant_offsets;
+  gboolean frame_stats;
+  guint stats_interval;
+
+  /* statistics of the frames since the last stats message */
+  guint stats_frames;
+  guint stats_type_frames[3];
+  gdouble stats_qp, stats_psnr, stats_ssim;
+  guint64 stats_bytes;
+  GstClockTime stats_time, stats_max_time;
 
   /* input description */
   GstVideoCodecState *input_state;
@@ -121,6 +173,45 @@ struct _GstX264EncClass
 
 GType gst_x264_enc_get_type (void);
 
+#define GST_X264_ENC_SPEED_PRESET_TYPE (gst_x264_enc_speed_preset_get_type())
+GType gst_x264_enc_speed_preset_get_type (void);
+
+/**
+ * GstX264EncFrameStatsMeta:
+ * @meta: parent #GstMeta
+ * @type: frame type as in the x264 stats file: 'I' for IDR, 'i' for other
+ *     intra frames, 'P', 'B' for referenced and 'b' for other B-frames
+ * @qp: average quantizer of the frame
+ * @size: encoded size in bytes
+ * @psnr: average PSNR, or -1 unless enabled in the option-string
+ * @ssim: SSIM, or -1 unless enabled in the option-string
+ * @encode_time: wall clock time of the encoder call that output the frame
+ * @delayed_frames: frames buffered in the encoder after that call
+ *
+ * Statistics of an encoded frame, attached to the output buffers when
+ * #GstX264Enc:frame-stats is enabled. Applications find the API type by its
+ * name, "GstX264EncFrameStatsMetaAPI".
+ */
+struct _GstX264EncFrameStatsMeta
+{
+  GstMeta meta;
+
+  gchar type;
+  gint qp;
+  guint size;
+  gdouble psnr;
+  gdouble ssim;
+  GstClockTime encode_time;
+  gint delayed_frames;
+};
+
+#define GST_X264_ENC_FRAME_STATS_META_API_TYPE \
+  (gst_x264_enc_frame_stats_meta_api_get_type())
+#define GST_X264_ENC_FRAME_STATS_META_INFO \
+  (gst_x264_enc_frame_stats_meta_get_info())
+GType gst_x264_enc_frame_stats_meta_api_get_type (void);
+const GstMetaInfo *gst_x264_enc_frame_stats_meta_get_info (void);
+
 G_END_DECLS
 
 #endif /* __GST_X264_ENC_H__ */
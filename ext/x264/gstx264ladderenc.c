@@ -0,0 +1,1048 @@
+/* GStreamer H264 encoder plugin
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Library General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Library General Public License for more details.
+ *
+ * You should have received a copy of the GNU Library General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 51 Franklin St, Fifth Floor,
+ * Boston, MA 02110-1301, USA.
+ */
+
+/**
+ * SECTION:element-x264ladderenc
+ * @see_also: x264enc
+ *
+ * This element encodes one raw video stream into a ladder of H264 renditions
+ * of different sizes and bitrates, as used for HLS or DASH. Each rendition
+ * is output on its own src pad, named src_0, src_1, ... in the order
+ * given by the #GstX264LadderEnc:renditions property.
+ *
+ * All renditions share the input frames, their timestamps and the placement
+ * of keyframes: scene-cut detection is disabled and IDR frames are placed
+ * every #GstX264LadderEnc:key-int-max frames, or where a keyframe was
+ * requested with a force-key-unit event, on all renditions at once. Segments
+ * cut at IDR frames therefore line up across the ladder.
+ *
+ * Each input frame is scaled and encoded for all renditions in parallel,
+ * one rendition per thread. Every rendition's encoder can additionally use
+ * the number of threads given by #GstX264LadderEnc:threads.
+ *
+ * The output is in byte-stream format with the stream headers repeated
+ * before every IDR frame.
+ *
+ * <refsect2>
+ * <title>Example pipeline</title>
+ * |[
+ * gst-launch-1.0 videotestsrc num-buffers=600 ! video/x-raw,width=1280,height=720 ! \
+ *   x264ladderenc name=enc renditions="1280x720:3000,640x360:800" \
+ *   enc.src_0 ! h264parse ! mpegtsmux ! filesink location=720p.ts \
+ *   enc.src_1 ! h264parse ! mpegtsmux ! filesink location=360p.ts
+ * ]| This example pipeline encodes a test video source into a 720p and a 360p
+ * rendition with aligned keyframes, and muxes each in MPEG-TS.
+ * </refsect2>
+ */
+
+#ifdef HAVE_CONFIG_H
+#  include "config.h"
+#endif
+
+#include "gstx264ladderenc.h"
+#include "gstx264enc.h"
+
+#include <stdio.h>
+#include <string.h>
+
+GST_DEBUG_CATEGORY_STATIC (x264_ladder_enc_debug);
+#define GST_CAT_DEFAULT x264_ladder_enc_debug
+
+/* like the video encoder base class, timestamps are shifted so that DTS
+ * stays positive when B-frames are used */
+#define GST_X264_LADDER_ENC_TIME_OFFSET (GST_SECOND * 60 * 60 * 1000)
+
+enum
+{
+  ARG_0,
+  ARG_RENDITIONS,
+  ARG_KEYINT_MAX,
+  ARG_SPEED_PRESET,
+  ARG_THREADS,
+  ARG_OPTION_STRING
+};
+
+#define ARG_RENDITIONS_DEFAULT         "1280x720:3000,640x360:800"
+#define ARG_KEYINT_MAX_DEFAULT         0
+#define ARG_SPEED_PRESET_DEFAULT       6        /* 'medium' preset */
+#define ARG_THREADS_DEFAULT            0        /* 0 means 'auto' */
+#define ARG_OPTION_STRING_DEFAULT      ""
+
+static GstStaticPadTemplate sink_factory = GST_STATIC_PAD_TEMPLATE ("sink",
+    GST_PAD_SINK,
+    GST_PAD_ALWAYS,
+    GST_STATIC_CAPS ("video/x-raw, "
+        "format = (string) { I420, YV12, NV12, Y42B, Y444 }, "
+        "framerate = (fraction) [0, MAX], "
+        "width = (int) [ 16, MAX ], " "height = (int) [ 16, MAX ]")
+    );
+
+static GstStaticPadTemplate src_factory = GST_STATIC_PAD_TEMPLATE ("src_%u",
+    GST_PAD_SRC,
+    GST_PAD_SOMETIMES,
+    GST_STATIC_CAPS ("video/x-h264, "
+        "framerate = (fraction) [0/1, MAX], "
+        "width = (int) [ 16, MAX ], " "height = (int) [ 16, MAX ], "
+        "stream-format = (string) byte-stream, " "alignment = (string) au")
+    );
+
+static void gst_x264_ladder_enc_finalize (GObject * object);
+static void gst_x264_ladder_enc_set_property (GObject * object, guint prop_id,
+    const GValue * value, GParamSpec * pspec);
+static void gst_x264_ladder_enc_get_property (GObject * object, guint prop_id,
+    GValue * value, GParamSpec * pspec);
+static GstStateChangeReturn gst_x264_ladder_enc_change_state (GstElement *
+    element, GstStateChange transition);
+
+static gboolean gst_x264_ladder_enc_sink_event (GstPad * pad,
+    GstObject * parent, GstEvent * event);
+static gboolean gst_x264_ladder_enc_sink_query (GstPad * pad,
+    GstObject * parent, GstQuery * query);
+static gboolean gst_x264_ladder_enc_src_event (GstPad * pad,
+    GstObject * parent, GstEvent * event);
+static gboolean gst_x264_ladder_enc_src_query (GstPad * pad,
+    GstObject * parent, GstQuery * query);
+static GstFlowReturn gst_x264_ladder_enc_chain (GstPad * pad,
+    GstObject * parent, GstBuffer * buf);
+
+static void gst_x264_ladder_enc_encode_rendition (GstX264LadderRendition * r,
+    GstX264LadderEnc * ladder);
+
+#define gst_x264_ladder_enc_parent_class parent_class
+G_DEFINE_TYPE (GstX264LadderEnc, gst_x264_ladder_enc, GST_TYPE_ELEMENT);
+
+static void
+gst_x264_ladder_enc_class_init (GstX264LadderEncClass * klass)
+{
+  GObjectClass *gobject_class;
+  GstElementClass *element_class;
+
+  gobject_class = G_OBJECT_CLASS (klass);
+  element_class = GST_ELEMENT_CLASS (klass);
+
+  gobject_class->set_property = gst_x264_ladder_enc_set_property;
+  gobject_class->get_property = gst_x264_ladder_enc_get_property;
+  gobject_class->finalize = gst_x264_ladder_enc_finalize;
+
+  element_class->change_state =
+      GST_DEBUG_FUNCPTR (gst_x264_ladder_enc_change_state);
+
+  g_object_class_install_property (gobject_class, ARG_RENDITIONS,
+      g_param_spec_string ("renditions", "Renditions",
+          "Comma separated list of WIDTHxHEIGHT:KBITRATE renditions, "
+          "one src pad is created for each (can only be set in NULL state)",
+          ARG_RENDITIONS_DEFAULT,
+          G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS));
+  g_object_class_install_property (gobject_class, ARG_KEYINT_MAX,
+      g_param_spec_uint ("key-int-max", "Key-frame maximal interval",
+          "Distance between two key-frames on all renditions "
+          "(0 for 2 seconds worth of frames)",
+          0, G_MAXINT, ARG_KEYINT_MAX_DEFAULT,
+          G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS));
+  g_object_class_install_property (gobject_class, ARG_SPEED_PRESET,
+      g_param_spec_enum ("speed-preset", "Speed/quality preset",
+          "Preset name for speed/quality tradeoff options (can affect decode "
+          "compatibility - impose restrictions separately for your target "
+          "decoder)", GST_X264_ENC_SPEED_PRESET_TYPE,
+          ARG_SPEED_PRESET_DEFAULT,
+          G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS));
+  g_object_class_install_property (gobject_class, ARG_THREADS,
+      g_param_spec_uint ("threads", "Threads",
+          "Number of threads used by the encoder of each rendition "
+          "(0 for automatic)", 0, G_MAXINT, ARG_THREADS_DEFAULT,
+          G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS));
+  g_object_class_install_property (gobject_class, ARG_OPTION_STRING,
+      g_param_spec_string ("option-string", "Option string",
+          "String of x264 options applied to all renditions "
+          "(overridden by element properties)", ARG_OPTION_STRING_DEFAULT,
+          G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS));
+
+  gst_element_class_set_static_metadata (element_class,
+      "x264 ABR ladder encoder", "Codec/Encoder/Video",
+      "H264 encoder producing several renditions of one input",
+      "GStreamer maintainers <gstreamer-devel@lists.freedesktop.org>");
+
+  gst_element_class_add_static_pad_template (element_class, &sink_factory);
+  gst_element_class_add_static_pad_template (element_class, &src_factory);
+
+  GST_DEBUG_CATEGORY_INIT (x264_ladder_enc_debug, "x264ladderenc", 0,
+      "h264 ladder encoding element");
+}
+
+static void
+gst_x264_ladder_enc_remove_renditions (GstX264LadderEnc * ladder)
+{
+  guint i;
+
+  for (i = 0; i < ladder->n_renditions; i++) {
+    GstX264LadderRendition *r = &ladder->renditions[i];
+
+    gst_flow_combiner_remove_pad (ladder->flow_combiner, r->srcpad);
+    gst_element_remove_pad (GST_ELEMENT (ladder), r->srcpad);
+    r->srcpad = NULL;
+  }
+  ladder->n_renditions = 0;
+}
+
+/* parses the renditions property and creates a src pad for each entry */
+static gboolean
+gst_x264_ladder_enc_set_renditions (GstX264LadderEnc * ladder,
+    const gchar * str)
+{
+  gint width[GST_X264_LADDER_ENC_MAX_RENDITIONS];
+  gint height[GST_X264_LADDER_ENC_MAX_RENDITIONS];
+  guint bitrate[GST_X264_LADDER_ENC_MAX_RENDITIONS];
+  gchar **entries;
+  guint i, n;
+
+  entries = g_strsplit (str ? str : "", ",", -1);
+  n = g_strv_length (entries);
+  if (n == 0 || n > GST_X264_LADDER_ENC_MAX_RENDITIONS)
+    goto invalid;
+
+  for (i = 0; i < n; i++) {
+    if (sscanf (g_strstrip (entries[i]), "%dx%d:%u", &width[i], &height[i],
+            &bitrate[i]) != 3)
+      goto invalid;
+    if (width[i] < 16 || height[i] < 16 || bitrate[i] == 0)
+      goto invalid;
+  }
+  g_strfreev (entries);
+
+  gst_x264_ladder_enc_remove_renditions (ladder);
+
+  for (i = 0; i < n; i++) {
+    GstX264LadderRendition *r = &ladder->renditions[i];
+    gchar *name;
+
+    r->ladder = ladder;
+    /* I420 needs even dimensions */
+    r->width = width[i] & ~1;
+    r->height = height[i] & ~1;
+    r->bitrate = bitrate[i];
+    g_queue_init (&r->output);
+
+    name = g_strdup_printf ("src_%u", i);
+    r->srcpad = gst_pad_new_from_static_template (&src_factory, name);
+    g_free (name);
+
+    gst_pad_set_event_function (r->srcpad,
+        GST_DEBUG_FUNCPTR (gst_x264_ladder_enc_src_event));
+    gst_pad_set_query_function (r->srcpad,
+        GST_DEBUG_FUNCPTR (gst_x264_ladder_enc_src_query));
+    gst_pad_use_fixed_caps (r->srcpad);
+    gst_element_add_pad (GST_ELEMENT (ladder), r->srcpad);
+    gst_flow_combiner_add_pad (ladder->flow_combiner, r->srcpad);
+  }
+  ladder->n_renditions = n;
+  gst_element_no_more_pads (GST_ELEMENT (ladder));
+
+  g_free (ladder->renditions_str);
+  ladder->renditions_str = g_strdup (str);
+
+  return TRUE;
+
+invalid:
+  {
+    GST_WARNING_OBJECT (ladder, "invalid renditions '%s'", str);
+    g_strfreev (entries);
+    return FALSE;
+  }
+}
+
+static void
+gst_x264_ladder_enc_init (GstX264LadderEnc * ladder)
+{
+  ladder->sinkpad = gst_pad_new_from_static_template (&sink_factory, "sink");
+  gst_pad_set_chain_function (ladder->sinkpad,
+      GST_DEBUG_FUNCPTR (gst_x264_ladder_enc_chain));
+  gst_pad_set_event_function (ladder->sinkpad,
+      GST_DEBUG_FUNCPTR (gst_x264_ladder_enc_sink_event));
+  gst_pad_set_query_function (ladder->sinkpad,
+      GST_DEBUG_FUNCPTR (gst_x264_ladder_enc_sink_query));
+  gst_element_add_pad (GST_ELEMENT (ladder), ladder->sinkpad);
+
+  ladder->flow_combiner = gst_flow_combiner_new ();
+  g_queue_init (&ladder->frames);
+  g_mutex_init (&ladder->lock);
+  g_cond_init (&ladder->cond);
+  gst_segment_init (&ladder->segment, GST_FORMAT_TIME);
+
+  ladder->keyint_max = ARG_KEYINT_MAX_DEFAULT;
+  ladder->speed_preset = ARG_SPEED_PRESET_DEFAULT;
+  ladder->threads = ARG_THREADS_DEFAULT;
+  ladder->option_string = g_strdup (ARG_OPTION_STRING_DEFAULT);
+  gst_x264_ladder_enc_set_renditions (ladder, ARG_RENDITIONS_DEFAULT);
+}
+
+static void
+gst_x264_ladder_enc_finalize (GObject * object)
+{
+  GstX264LadderEnc *ladder = GST_X264_LADDER_ENC (object);
+
+  gst_flow_combiner_free (ladder->flow_combiner);
+  g_mutex_clear (&ladder->lock);
+  g_cond_clear (&ladder->cond);
+  g_free (ladder->renditions_str);
+  g_free (ladder->option_string);
+
+  G_OBJECT_CLASS (parent_class)->finalize (object);
+}
+
+static gboolean
+gst_x264_ladder_enc_parse_options (GstX264LadderEnc * ladder,
+    x264_param_t * param, const gchar * str)
+{
+  GStrv kvpairs;
+  guint npairs, i;
+  gint ret = 0;
+
+  while (*str == ':')
+    str++;
+
+  kvpairs = g_strsplit (str, ":", 0);
+  npairs = g_strv_length (kvpairs);
+
+  for (i = 0; i < npairs; i++) {
+    GStrv key_val = g_strsplit (kvpairs[i], "=", 2);
+
+    if (x264_param_parse (param, key_val[0], key_val[1])) {
+      GST_ERROR_OBJECT (ladder, "Bad option %s=%s",
+          key_val[0] ? key_val[0] : "", key_val[1] ? key_val[1] : "");
+      ret++;
+    }
+    g_strfreev (key_val);
+  }
+
+  g_strfreev (kvpairs);
+  return !ret;
+}
+
+/* call with the object lock held */
+static gboolean
+gst_x264_ladder_enc_open_rendition (GstX264LadderEnc * ladder,
+    GstX264LadderRendition * r)
+{
+  GstVideoInfo *info = &ladder->info;
+  const gchar *preset = NULL;
+  x264_param_t param;
+  gint par_n, par_d;
+  guint keyint_max;
+
+  /* keep the display aspect ratio of the input */
+  if (!gst_util_fraction_multiply (info->width * info->par_n,
+          info->height * info->par_d, r->height, r->width, &par_n, &par_d))
+    par_n = par_d = 1;
+
+  gst_video_info_set_format (&r->info, GST_VIDEO_FORMAT_I420, r->width,
+      r->height);
+  r->info.fps_n = info->fps_n;
+  r->info.fps_d = info->fps_d;
+  r->info.par_n = par_n;
+  r->info.par_d = par_d;
+
+  r->convert = gst_video_converter_new (info, &r->info, NULL);
+  if (!r->convert)
+    return FALSE;
+  r->picture = gst_buffer_new_allocate (NULL, GST_VIDEO_INFO_SIZE (&r->info),
+      NULL);
+
+  if (ladder->speed_preset)
+    preset = x264_preset_names[ladder->speed_preset - 1];
+  if (x264_param_default_preset (&param, preset, NULL) < 0)
+    return FALSE;
+
+  param.i_csp = X264_CSP_I420;
+  param.i_width = r->width;
+  param.i_height = r->height;
+  param.vui.i_sar_width = par_n;
+  param.vui.i_sar_height = par_d;
+  param.i_threads = ladder->threads;
+  param.i_timebase_num = 1;
+  param.i_timebase_den = 1000000000;
+  param.rc.i_rc_method = X264_RC_ABR;
+  param.rc.i_bitrate = r->bitrate;
+
+  if (info->fps_n > 0 && info->fps_d > 0) {
+    param.b_vfr_input = FALSE;
+    param.i_fps_num = info->fps_n;
+    param.i_fps_den = info->fps_d;
+    keyint_max = ladder->keyint_max ? ladder->keyint_max :
+        MAX (2 * info->fps_n / info->fps_d, 1);
+  } else {
+    param.b_vfr_input = TRUE;
+    keyint_max = ladder->keyint_max ? ladder->keyint_max : 250;
+  }
+
+  if (ladder->option_string && *ladder->option_string &&
+      !gst_x264_ladder_enc_parse_options (ladder, &param,
+          ladder->option_string))
+    return FALSE;
+
+  /* keyframes are only placed at fixed intervals or on request, which keeps
+   * them aligned across renditions */
+  param.i_keyint_max = keyint_max;
+  param.i_scenecut_threshold = 0;
+  param.b_open_gop = FALSE;
+  param.b_intra_refresh = FALSE;
+  param.b_annexb = TRUE;
+  param.b_repeat_headers = TRUE;
+
+  r->x264enc = x264_encoder_open (&param);
+  if (!r->x264enc)
+    return FALSE;
+
+  GST_DEBUG_OBJECT (ladder, "opened %dx%d rendition at %u kbit/s, par %d/%d",
+      r->width, r->height, r->bitrate, par_n, par_d);
+
+  return TRUE;
+}
+
+static void
+gst_x264_ladder_enc_close_rendition (GstX264LadderRendition * r)
+{
+  gpointer out;
+
+  if (r->x264enc) {
+    x264_encoder_close (r->x264enc);
+    r->x264enc = NULL;
+  }
+  if (r->convert) {
+    gst_video_converter_free (r->convert);
+    r->convert = NULL;
+  }
+  gst_buffer_replace (&r->picture, NULL);
+
+  while ((out = g_queue_pop_head (&r->output)))
+    gst_mini_object_unref (GST_MINI_OBJECT_CAST (out));
+  r->error = 0;
+}
+
+/* frees the shared frames that all renditions have output, or all of them */
+static void
+gst_x264_ladder_enc_release_frames (GstX264LadderEnc * ladder, gboolean all)
+{
+  GList *l, *next;
+
+  for (l = ladder->frames.head; l; l = next) {
+    GstX264LadderFrame *frame = l->data;
+
+    next = l->next;
+    if (all || g_atomic_int_get (&frame->refs) <= 0) {
+      g_queue_delete_link (&ladder->frames, l);
+      g_list_free_full (frame->events, (GDestroyNotify) gst_event_unref);
+      g_slice_free (GstX264LadderFrame, frame);
+    }
+  }
+}
+
+static void
+gst_x264_ladder_enc_close (GstX264LadderEnc * ladder)
+{
+  guint i;
+
+  for (i = 0; i < ladder->n_renditions; i++)
+    gst_x264_ladder_enc_close_rendition (&ladder->renditions[i]);
+  gst_x264_ladder_enc_release_frames (ladder, TRUE);
+  ladder->configured = FALSE;
+}
+
+static gboolean
+gst_x264_ladder_enc_open (GstX264LadderEnc * ladder)
+{
+  GstClockTime latency = 0;
+  gint max_delayed = 0;
+  guint i;
+
+  GST_OBJECT_LOCK (ladder);
+  for (i = 0; i < ladder->n_renditions; i++) {
+    GstX264LadderRendition *r = &ladder->renditions[i];
+
+    if (!gst_x264_ladder_enc_open_rendition (ladder, r))
+      goto open_failed;
+    max_delayed = MAX (max_delayed,
+        x264_encoder_maximum_delayed_frames (r->x264enc));
+  }
+
+  if (ladder->info.fps_n > 0)
+    latency = gst_util_uint64_scale_ceil (GST_SECOND * ladder->info.fps_d,
+        max_delayed, ladder->info.fps_n);
+  if (latency != ladder->latency) {
+    ladder->latency = latency;
+    GST_OBJECT_UNLOCK (ladder);
+    gst_element_post_message (GST_ELEMENT (ladder),
+        gst_message_new_latency (GST_OBJECT (ladder)));
+  } else {
+    GST_OBJECT_UNLOCK (ladder);
+  }
+
+  for (i = 0; i < ladder->n_renditions; i++) {
+    GstX264LadderRendition *r = &ladder->renditions[i];
+    GstCaps *caps;
+
+    caps = gst_caps_new_simple ("video/x-h264",
+        "stream-format", G_TYPE_STRING, "byte-stream",
+        "alignment", G_TYPE_STRING, "au",
+        "width", G_TYPE_INT, r->width, "height", G_TYPE_INT, r->height,
+        "framerate", GST_TYPE_FRACTION, r->info.fps_n, r->info.fps_d,
+        "pixel-aspect-ratio", GST_TYPE_FRACTION, r->info.par_n,
+        r->info.par_d, NULL);
+    gst_pad_set_caps (r->srcpad, caps);
+    gst_caps_unref (caps);
+  }
+
+  ladder->configured = TRUE;
+  return TRUE;
+
+open_failed:
+  {
+    GST_OBJECT_UNLOCK (ladder);
+    GST_ELEMENT_ERROR (ladder, STREAM, ENCODE,
+        ("Can not initialize x264 encoder."), (NULL));
+    gst_x264_ladder_enc_close (ladder);
+    return FALSE;
+  }
+}
+
+static void
+gst_x264_ladder_enc_take_output (GstX264LadderRendition * r, x264_nal_t * nal,
+    gint size, x264_picture_t * pic_out)
+{
+  GstX264LadderFrame *frame;
+  GstBuffer *out;
+  GList *l;
+
+  if (size < 0) {
+    r->error = size;
+    return;
+  }
+  if (size == 0)
+    return;
+
+  frame = pic_out->opaque;
+
+  /* x264 reuses its NAL memory on the next call, so copy it out here */
+  out = gst_buffer_new_allocate (NULL, size, NULL);
+  gst_buffer_fill (out, 0, nal[0].p_payload, size);
+  GST_BUFFER_PTS (out) = pic_out->i_pts;
+  GST_BUFFER_DTS (out) = pic_out->i_dts;
+  GST_BUFFER_DURATION (out) = frame->duration;
+  if (!pic_out->b_keyframe)
+    GST_BUFFER_FLAG_SET (out, GST_BUFFER_FLAG_DELTA_UNIT);
+
+  /* the key unit requests go out right before the keyframe they asked for,
+   * like GstVideoEncoder does */
+  for (l = frame->events; l; l = l->next)
+    g_queue_push_tail (&r->output, gst_event_ref (l->data));
+  g_queue_push_tail (&r->output, out);
+  g_atomic_int_add (&frame->refs, -1);
+}
+
+/* runs on the thread pool, and on the streaming thread for the first
+ * rendition */
+static void
+gst_x264_ladder_enc_encode_rendition (GstX264LadderRendition * r,
+    GstX264LadderEnc * ladder)
+{
+  x264_picture_t pic_in, pic_out;
+  x264_nal_t *nal;
+  int i_nal, size;
+
+  if (ladder->current) {
+    GstVideoFrame frame;
+    gint i;
+
+    if (!gst_video_frame_map (&frame, &r->info, r->picture, GST_MAP_WRITE)) {
+      r->error = -1;
+      goto done;
+    }
+    gst_video_converter_frame (r->convert, &ladder->input, &frame);
+
+    x264_picture_init (&pic_in);
+    pic_in.img.i_csp = X264_CSP_I420;
+    pic_in.img.i_plane = 3;
+    for (i = 0; i < 3; i++) {
+      pic_in.img.plane[i] = GST_VIDEO_FRAME_COMP_DATA (&frame, i);
+      pic_in.img.i_stride[i] = GST_VIDEO_FRAME_COMP_STRIDE (&frame, i);
+    }
+    pic_in.i_type = ladder->keyframe ? X264_TYPE_IDR : X264_TYPE_AUTO;
+    pic_in.i_pts = ladder->current->pts + GST_X264_LADDER_ENC_TIME_OFFSET;
+    pic_in.opaque = ladder->current;
+
+    /* x264 copies the picture, so the scaled frame can be reused */
+    size = x264_encoder_encode (r->x264enc, &nal, &i_nal, &pic_in, &pic_out);
+    gst_video_frame_unmap (&frame);
+    gst_x264_ladder_enc_take_output (r, nal, size, &pic_out);
+  } else {
+    while (r->error == 0 && x264_encoder_delayed_frames (r->x264enc) > 0) {
+      size = x264_encoder_encode (r->x264enc, &nal, &i_nal, NULL, &pic_out);
+      gst_x264_ladder_enc_take_output (r, nal, size, &pic_out);
+    }
+  }
+
+done:
+  g_mutex_lock (&ladder->lock);
+  if (--ladder->pending == 0)
+    g_cond_signal (&ladder->cond);
+  g_mutex_unlock (&ladder->lock);
+}
+
+/* encodes ladder->current on all renditions, or drains them if it is NULL,
+ * and pushes the output */
+static GstFlowReturn
+gst_x264_ladder_enc_run (GstX264LadderEnc * ladder)
+{
+  GstFlowReturn ret = GST_FLOW_OK;
+  gboolean failed = FALSE;
+  guint i;
+
+  ladder->pending = ladder->n_renditions;
+  for (i = 1; i < ladder->n_renditions; i++)
+    g_thread_pool_push (ladder->pool, &ladder->renditions[i], NULL);
+  gst_x264_ladder_enc_encode_rendition (&ladder->renditions[0], ladder);
+
+  g_mutex_lock (&ladder->lock);
+  while (ladder->pending > 0)
+    g_cond_wait (&ladder->cond, &ladder->lock);
+  g_mutex_unlock (&ladder->lock);
+
+  for (i = 0; i < ladder->n_renditions; i++) {
+    GstX264LadderRendition *r = &ladder->renditions[i];
+    gpointer out;
+
+    if (r->error) {
+      GST_ELEMENT_ERROR (ladder, STREAM, ENCODE, ("Encode x264 frame failed."),
+          ("x264_encoder_encode return code=%d", r->error));
+      failed = TRUE;
+      continue;
+    }
+
+    while ((out = g_queue_pop_head (&r->output))) {
+      GstFlowReturn pad_ret;
+
+      if (GST_IS_EVENT (out)) {
+        gst_pad_push_event (r->srcpad, out);
+        continue;
+      }
+
+      pad_ret = gst_pad_push (r->srcpad, out);
+      ret = gst_flow_combiner_update_pad_flow (ladder->flow_combiner,
+          r->srcpad, pad_ret);
+    }
+  }
+  gst_x264_ladder_enc_release_frames (ladder, FALSE);
+
+  return failed ? GST_FLOW_ERROR : ret;
+}
+
+static GstFlowReturn
+gst_x264_ladder_enc_drain (GstX264LadderEnc * ladder)
+{
+  if (!ladder->configured)
+    return GST_FLOW_OK;
+
+  ladder->current = NULL;
+  return gst_x264_ladder_enc_run (ladder);
+}
+
+static GstFlowReturn
+gst_x264_ladder_enc_chain (GstPad * pad, GstObject * parent, GstBuffer * buf)
+{
+  GstX264LadderEnc *ladder = GST_X264_LADDER_ENC (parent);
+  GstX264LadderFrame *frame;
+  GstFlowReturn ret;
+
+  if (!ladder->configured)
+    goto not_negotiated;
+
+  if (!gst_video_frame_map (&ladder->input, &ladder->info, buf, GST_MAP_READ))
+    goto invalid_frame;
+
+  frame = g_slice_new0 (GstX264LadderFrame);
+  frame->number = ladder->frame_number++;
+  frame->pts = GST_BUFFER_PTS (buf);
+  frame->duration = GST_BUFFER_DURATION (buf);
+  frame->refs = ladder->n_renditions;
+  if (!GST_CLOCK_TIME_IS_VALID (frame->pts)) {
+    /* x264 needs increasing timestamps */
+    if (ladder->info.fps_n > 0)
+      frame->pts = gst_util_uint64_scale (frame->number,
+          GST_SECOND * ladder->info.fps_d, ladder->info.fps_n);
+    else
+      frame->pts = gst_util_uint64_scale (frame->number, GST_SECOND, 25);
+  }
+  g_queue_push_tail (&ladder->frames, frame);
+
+  GST_OBJECT_LOCK (ladder);
+  ladder->keyframe = ladder->force_keyframe;
+  ladder->force_keyframe = FALSE;
+  GST_OBJECT_UNLOCK (ladder);
+  frame->events = ladder->key_unit_events;
+  ladder->key_unit_events = NULL;
+
+  ladder->current = frame;
+  ret = gst_x264_ladder_enc_run (ladder);
+  ladder->current = NULL;
+
+  gst_video_frame_unmap (&ladder->input);
+  gst_buffer_unref (buf);
+
+  return ret;
+
+not_negotiated:
+  {
+    GST_ELEMENT_ERROR (ladder, CORE, NEGOTIATION, (NULL),
+        ("Got buffer before caps"));
+    gst_buffer_unref (buf);
+    return GST_FLOW_NOT_NEGOTIATED;
+  }
+invalid_frame:
+  {
+    GST_ERROR_OBJECT (ladder, "Failed to map frame");
+    gst_buffer_unref (buf);
+    return GST_FLOW_ERROR;
+  }
+}
+
+static gboolean
+gst_x264_ladder_enc_push_event (GstX264LadderEnc * ladder, GstEvent * event)
+{
+  gboolean ret = TRUE;
+  guint i;
+
+  for (i = 0; i < ladder->n_renditions; i++)
+    ret &= gst_pad_push_event (ladder->renditions[i].srcpad,
+        gst_event_ref (event));
+  gst_event_unref (event);
+
+  return ret;
+}
+
+static gboolean
+gst_x264_ladder_enc_sink_event (GstPad * pad, GstObject * parent,
+    GstEvent * event)
+{
+  GstX264LadderEnc *ladder = GST_X264_LADDER_ENC (parent);
+  gboolean ret = TRUE;
+  guint i;
+
+  switch (GST_EVENT_TYPE (event)) {
+    case GST_EVENT_STREAM_START:{
+      gboolean have_group_id;
+      guint group_id;
+
+      /* every rendition is a stream of its own */
+      have_group_id = gst_event_parse_group_id (event, &group_id);
+      for (i = 0; i < ladder->n_renditions; i++) {
+        GstPad *srcpad = ladder->renditions[i].srcpad;
+        GstEvent *start;
+        gchar *stream_id;
+
+        stream_id = gst_pad_create_stream_id_printf (srcpad,
+            GST_ELEMENT_CAST (ladder), "%u", i);
+        start = gst_event_new_stream_start (stream_id);
+        if (have_group_id)
+          gst_event_set_group_id (start, group_id);
+        ret &= gst_pad_push_event (srcpad, start);
+        g_free (stream_id);
+      }
+      gst_event_unref (event);
+      break;
+    }
+    case GST_EVENT_CAPS:{
+      GstVideoInfo info;
+      GstCaps *caps;
+
+      gst_event_parse_caps (event, &caps);
+      if (gst_video_info_from_caps (&info, caps)) {
+        GstFlowReturn flow = GST_FLOW_OK;
+
+        if (ladder->configured) {
+          flow = gst_x264_ladder_enc_drain (ladder);
+          gst_x264_ladder_enc_close (ladder);
+        }
+        ladder->info = info;
+        ret = gst_x264_ladder_enc_open (ladder) && flow == GST_FLOW_OK;
+      } else {
+        ret = FALSE;
+      }
+      gst_event_unref (event);
+      break;
+    }
+    case GST_EVENT_SEGMENT:{
+      GstSegment segment;
+      GstEvent *out;
+
+      gst_event_copy_segment (event, &ladder->segment);
+      segment = ladder->segment;
+      if (segment.format == GST_FORMAT_TIME) {
+        segment.start += GST_X264_LADDER_ENC_TIME_OFFSET;
+        if (GST_CLOCK_TIME_IS_VALID (segment.stop))
+          segment.stop += GST_X264_LADDER_ENC_TIME_OFFSET;
+        if (GST_CLOCK_TIME_IS_VALID (segment.position))
+          segment.position += GST_X264_LADDER_ENC_TIME_OFFSET;
+      }
+      out = gst_event_new_segment (&segment);
+      gst_event_set_seqnum (out, gst_event_get_seqnum (event));
+      gst_event_unref (event);
+      ret = gst_x264_ladder_enc_push_event (ladder, out);
+      break;
+    }
+    case GST_EVENT_EOS:{
+      GstFlowReturn flow;
+      GList *l;
+
+      flow = gst_x264_ladder_enc_drain (ladder);
+
+      /* key units were requested, but no frame came to be one */
+      for (l = ladder->key_unit_events; l; l = l->next)
+        gst_x264_ladder_enc_push_event (ladder, l->data);
+      g_list_free (ladder->key_unit_events);
+      ladder->key_unit_events = NULL;
+
+      /* like GstVideoEncoder, fail the event if the last frames could not
+       * be pushed */
+      ret = gst_x264_ladder_enc_push_event (ladder, event);
+      ret &= flow == GST_FLOW_OK;
+      break;
+    }
+    case GST_EVENT_FLUSH_STOP:
+      /* x264 can't drop its delayed frames, so start over */
+      if (ladder->configured) {
+        gst_x264_ladder_enc_close (ladder);
+        gst_x264_ladder_enc_open (ladder);
+      }
+      gst_segment_init (&ladder->segment, GST_FORMAT_TIME);
+      gst_flow_combiner_reset (ladder->flow_combiner);
+      g_list_free_full (ladder->key_unit_events,
+          (GDestroyNotify) gst_event_unref);
+      ladder->key_unit_events = NULL;
+      ret = gst_x264_ladder_enc_push_event (ladder, event);
+      break;
+    case GST_EVENT_CUSTOM_DOWNSTREAM:
+      if (gst_video_event_is_force_key_unit (event)) {
+        GST_OBJECT_LOCK (ladder);
+        ladder->force_keyframe = TRUE;
+        GST_OBJECT_UNLOCK (ladder);
+        /* held until the keyframe is pushed */
+        ladder->key_unit_events =
+            g_list_append (ladder->key_unit_events, event);
+        break;
+      }
+      ret = gst_x264_ladder_enc_push_event (ladder, event);
+      break;
+    default:
+      ret = gst_x264_ladder_enc_push_event (ladder, event);
+      break;
+  }
+
+  return ret;
+}
+
+static gboolean
+gst_x264_ladder_enc_sink_query (GstPad * pad, GstObject * parent,
+    GstQuery * query)
+{
+  switch (GST_QUERY_TYPE (query)) {
+    case GST_QUERY_ALLOCATION:
+      /* downstream of the src pads only sees encoded data */
+      gst_query_add_allocation_meta (query, GST_VIDEO_META_API_TYPE, NULL);
+      return TRUE;
+    default:
+      return gst_pad_query_default (pad, parent, query);
+  }
+}
+
+static gboolean
+gst_x264_ladder_enc_src_event (GstPad * pad, GstObject * parent,
+    GstEvent * event)
+{
+  GstX264LadderEnc *ladder = GST_X264_LADDER_ENC (parent);
+
+  if (GST_EVENT_TYPE (event) == GST_EVENT_CUSTOM_UPSTREAM &&
+      gst_video_event_is_force_key_unit (event)) {
+    /* a keyframe on one rendition means a keyframe on all of them */
+    GST_OBJECT_LOCK (ladder);
+    ladder->force_keyframe = TRUE;
+    GST_OBJECT_UNLOCK (ladder);
+    gst_event_unref (event);
+    return TRUE;
+  }
+
+  return gst_pad_push_event (ladder->sinkpad, event);
+}
+
+static gboolean
+gst_x264_ladder_enc_src_query (GstPad * pad, GstObject * parent,
+    GstQuery * query)
+{
+  GstX264LadderEnc *ladder = GST_X264_LADDER_ENC (parent);
+  gboolean ret;
+
+  switch (GST_QUERY_TYPE (query)) {
+    case GST_QUERY_LATENCY:{
+      GstClockTime min, max, latency;
+      gboolean live;
+
+      ret = gst_pad_peer_query (ladder->sinkpad, query);
+      if (ret) {
+        gst_query_parse_latency (query, &live, &min, &max);
+
+        GST_OBJECT_LOCK (ladder);
+        latency = ladder->latency;
+        GST_OBJECT_UNLOCK (ladder);
+
+        min += latency;
+        if (GST_CLOCK_TIME_IS_VALID (max))
+          max += latency;
+        gst_query_set_latency (query, live, min, max);
+      }
+      break;
+    }
+    default:
+      ret = gst_pad_query_default (pad, parent, query);
+      break;
+  }
+
+  return ret;
+}
+
+static GstStateChangeReturn
+gst_x264_ladder_enc_change_state (GstElement * element,
+    GstStateChange transition)
+{
+  GstX264LadderEnc *ladder = GST_X264_LADDER_ENC (element);
+  GstStateChangeReturn ret;
+
+  switch (transition) {
+    case GST_STATE_CHANGE_NULL_TO_READY:
+      ladder->pool =
+          g_thread_pool_new ((GFunc) gst_x264_ladder_enc_encode_rendition,
+          ladder, MAX ((gint) ladder->n_renditions - 1, 1), FALSE, NULL);
+      if (!ladder->pool)
+        return GST_STATE_CHANGE_FAILURE;
+      break;
+    case GST_STATE_CHANGE_READY_TO_PAUSED:
+      gst_segment_init (&ladder->segment, GST_FORMAT_TIME);
+      gst_flow_combiner_reset (ladder->flow_combiner);
+      ladder->frame_number = 0;
+      ladder->force_keyframe = FALSE;
+      break;
+    default:
+      break;
+  }
+
+  ret = GST_ELEMENT_CLASS (parent_class)->change_state (element, transition);
+  if (ret == GST_STATE_CHANGE_FAILURE)
+    return ret;
+
+  switch (transition) {
+    case GST_STATE_CHANGE_PAUSED_TO_READY:
+      gst_x264_ladder_enc_close (ladder);
+      g_list_free_full (ladder->key_unit_events,
+          (GDestroyNotify) gst_event_unref);
+      ladder->key_unit_events = NULL;
+      break;
+    case GST_STATE_CHANGE_READY_TO_NULL:
+      g_thread_pool_free (ladder->pool, FALSE, TRUE);
+      ladder->pool = NULL;
+      break;
+    default:
+      break;
+  }
+
+  return ret;
+}
+
+static void
+gst_x264_ladder_enc_set_property (GObject * object, guint prop_id,
+    const GValue * value, GParamSpec * pspec)
+{
+  GstX264LadderEnc *ladder = GST_X264_LADDER_ENC (object);
+  GstState state;
+
+  GST_OBJECT_LOCK (ladder);
+  state = GST_STATE (ladder);
+  if (state != GST_STATE_READY && state != GST_STATE_NULL)
+    goto wrong_state;
+
+  switch (prop_id) {
+    case ARG_RENDITIONS:
+      /* pads can only come and go while nothing is linked up and running */
+      if (state != GST_STATE_NULL)
+        goto wrong_state;
+      GST_OBJECT_UNLOCK (ladder);
+      gst_x264_ladder_enc_set_renditions (ladder, g_value_get_string (value));
+      return;
+    case ARG_KEYINT_MAX:
+      ladder->keyint_max = g_value_get_uint (value);
+      break;
+    case ARG_SPEED_PRESET:
+      ladder->speed_preset = g_value_get_enum (value);
+      break;
+    case ARG_THREADS:
+      ladder->threads = g_value_get_uint (value);
+      break;
+    case ARG_OPTION_STRING:
+      g_free (ladder->option_string);
+      ladder->option_string = g_value_dup_string (value);
+      break;
+    default:
+      G_OBJECT_WARN_INVALID_PROPERTY_ID (object, prop_id, pspec);
+      break;
+  }
+  GST_OBJECT_UNLOCK (ladder);
+  return;
+
+  /* ERROR */
+wrong_state:
+  {
+    GST_WARNING_OBJECT (ladder, "setting property in wrong state");
+    GST_OBJECT_UNLOCK (ladder);
+  }
+}
+
+static void
+gst_x264_ladder_enc_get_property (GObject * object, guint prop_id,
+    GValue * value, GParamSpec * pspec)
+{
+  GstX264LadderEnc *ladder = GST_X264_LADDER_ENC (object);
+
+  GST_OBJECT_LOCK (ladder);
+  switch (prop_id) {
+    case ARG_RENDITIONS:
+      g_value_set_string (value, ladder->renditions_str);
+      break;
+    case ARG_KEYINT_MAX:
+      g_value_set_uint (value, ladder->keyint_max);
+      break;
+    case ARG_SPEED_PRESET:
+      g_value_set_enum (value, ladder->speed_preset);
+      break;
+    case ARG_THREADS:
+      g_value_set_uint (value, ladder->threads);
+      break;
+    case ARG_OPTION_STRING:
+      g_value_set_string (value, ladder->option_string);
+      break;
+    default:
+      G_OBJECT_WARN_INVALID_PROPERTY_ID (object, prop_id, pspec);
+      break;
+  }
+  GST_OBJECT_UNLOCK (ladder);
+}
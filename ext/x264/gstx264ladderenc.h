@@ -0,0 +1,134 @@
+/* GStreamer H264 encoder plugin
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Library General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Library General Public License for more details.
+ *
+ * You should have received a copy of the GNU Library General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 51 Franklin St, Fifth Floor,
+ * Boston, MA 02110-1301, USA.
+ */
+
+#ifndef __GST_X264_LADDER_ENC_H__
+#define __GST_X264_LADDER_ENC_H__
+
+#include <gst/gst.h>
+#include <gst/base/gstflowcombiner.h>
+#include <gst/video/video.h>
+
+#ifdef HAVE_STDINT_H
+#include <stdint.h>
+#endif
+
+#include <x264.h>
+
+G_BEGIN_DECLS
+
+#define GST_TYPE_X264_LADDER_ENC \
+  (gst_x264_ladder_enc_get_type())
+#define GST_X264_LADDER_ENC(obj) \
+  (G_TYPE_CHECK_INSTANCE_CAST((obj),GST_TYPE_X264_LADDER_ENC,GstX264LadderEnc))
+#define GST_X264_LADDER_ENC_CLASS(klass) \
+  (G_TYPE_CHECK_CLASS_CAST((klass),GST_TYPE_X264_LADDER_ENC,GstX264LadderEncClass))
+#define GST_IS_X264_LADDER_ENC(obj) \
+  (G_TYPE_CHECK_INSTANCE_TYPE((obj),GST_TYPE_X264_LADDER_ENC))
+#define GST_IS_X264_LADDER_ENC_CLASS(klass) \
+  (G_TYPE_CHECK_CLASS_TYPE((klass),GST_TYPE_X264_LADDER_ENC))
+
+#define GST_X264_LADDER_ENC_MAX_RENDITIONS 16
+
+typedef struct _GstX264LadderEnc GstX264LadderEnc;
+typedef struct _GstX264LadderEncClass GstX264LadderEncClass;
+typedef struct _GstX264LadderFrame GstX264LadderFrame;
+typedef struct _GstX264LadderRendition GstX264LadderRendition;
+
+/* an input frame, shared by all renditions until each has output it */
+struct _GstX264LadderFrame
+{
+  guint32 number;
+  GstClockTime pts;
+  GstClockTime duration;
+  gint refs;
+
+  /* force-key-unit events to push before the keyframe of this frame */
+  GList *events;
+};
+
+struct _GstX264LadderRendition
+{
+  GstX264LadderEnc *ladder;
+  GstPad *srcpad;
+
+  /* configuration */
+  gint width, height;
+  guint bitrate;
+
+  GstVideoInfo info;
+  GstVideoConverter *convert;
+  GstBuffer *picture;
+  x264_t *x264enc;
+
+  /* encoded buffers waiting to be pushed, and the events to push before
+   * them */
+  GQueue output;
+  gint error;
+};
+
+struct _GstX264LadderEnc
+{
+  GstElement element;
+
+  /*< private >*/
+  GstPad *sinkpad;
+
+  GstX264LadderRendition renditions[GST_X264_LADDER_ENC_MAX_RENDITIONS];
+  guint n_renditions;
+
+  GstVideoInfo info;
+  gboolean configured;
+  GstSegment segment;
+  GstFlowCombiner *flow_combiner;
+  GstClockTime latency;
+
+  /* input frames not yet output by all renditions */
+  GQueue frames;
+  guint32 frame_number;
+  gboolean force_keyframe;
+  /* downstream force-key-unit events held for the next frame */
+  GList *key_unit_events;
+
+  /* frame being encoded, or NULL when draining */
+  GstX264LadderFrame *current;
+  GstVideoFrame input;
+  gboolean keyframe;
+
+  GThreadPool *pool;
+  GMutex lock;
+  GCond cond;
+  guint pending;
+
+  /* properties */
+  gchar *renditions_str;
+  guint keyint_max;
+  gint speed_preset;
+  guint threads;
+  gchar *option_string;
+};
+
+struct _GstX264LadderEncClass
+{
+  GstElementClass parent_class;
+};
+
+GType gst_x264_ladder_enc_get_type (void);
+
+G_END_DECLS
+
+#endif /* __GST_X264_LADDER_ENC_H__ */
@@ -31,13 +31,58 @@
 
 #define GST_ASF_PAYLOAD_KF_COMPLETE(stream, payload) (stream->is_video && payload->keyframe && payload->buf_filled >= payload->mo_size)
 
+/* Packets are parsed by offset into packet->buf. Packets that were
+ * reassembled from several memories (e.g. RTP fragments) are not merged
+ * for parsing: bdata is NULL then and the few header bytes we need are
+ * extracted, while payload buffers still just reference the memory. */
+static inline const guint8 *
+asf_packet_peek (AsfPacket * packet, guint offset, guint len)
+{
+  if (G_LIKELY (packet->bdata != NULL))
+    return packet->bdata + offset;
+
+  g_assert (len <= sizeof (packet->scratch));
+  gst_buffer_extract (packet->buf, offset, packet->scratch, len);
+  return packet->scratch;
+}
+
+static inline void
+asf_packet_copy (AsfPacket * packet, guint offset, gpointer dest, guint len)
+{
+  if (G_LIKELY (packet->bdata != NULL))
+    memcpy (dest, packet->bdata + offset, len);
+  else
+    gst_buffer_extract (packet->buf, offset, dest, len);
+}
+
+static void
+asf_packet_fill_buffer (AsfPacket * packet, guint offset, GstBuffer * buf,
+    guint buf_offset, guint len)
+{
+  GstMapInfo map;
+
+  if (G_LIKELY (packet->bdata != NULL)) {
+    gst_buffer_fill (buf, buf_offset, packet->bdata + offset, len);
+    return;
+  }
+
+  /* clip like gst_buffer_fill() does */
+  gst_buffer_map (buf, &map, GST_MAP_WRITE);
+  if (buf_offset < map.size) {
+    gst_buffer_extract (packet->buf, offset, map.data + buf_offset,
+        MIN (len, map.size - buf_offset));
+  }
+  gst_buffer_unmap (buf, &map);
+}
+
 /* we are unlikely to deal with lengths > 2GB here any time soon, so just
  * return a signed int and use that for error reporting */
 static inline gint
-asf_packet_read_varlen_int (guint lentype_flags, guint lentype_bit_offset,
-    const guint8 ** p_data, guint * p_size)
+asf_packet_read_varlen_int (AsfPacket * packet, guint lentype_flags,
+    guint lentype_bit_offset, guint * p_off, guint * p_size)
 {
   static const guint lens[4] = { 0, 1, 2, 4 };
+  const guint8 *data;
   guint len, val;
 
   len = lens[(lentype_flags >> lentype_bit_offset) & 0x03];
@@ -48,42 +93,44 @@ asf_packet_read_varlen_int (guint lentype_flags, guint lentype_bit_offset,
     return -1;
   }
 
+  if (len == 0)
+    return 0;
+
+  data = asf_packet_peek (packet, *p_off, len);
+
   switch (len) {
-    case 0:
-      val = 0;
-      break;
     case 1:
-      val = GST_READ_UINT8 (*p_data);
+      val = GST_READ_UINT8 (data);
       break;
     case 2:
-      val = GST_READ_UINT16_LE (*p_data);
+      val = GST_READ_UINT16_LE (data);
       break;
     case 4:
-      val = GST_READ_UINT32_LE (*p_data);
+      val = GST_READ_UINT32_LE (data);
       break;
     default:
       val = 0;
       g_assert_not_reached ();
   }
 
-  *p_data += len;
+  *p_off += len;
   *p_size -= len;
 
   return (gint) val;
 }
 
 static GstBuffer *
-asf_packet_create_payload_buffer (AsfPacket * packet, const guint8 ** p_data,
+asf_packet_create_payload_buffer (AsfPacket * packet, guint * p_off,
     guint * p_size, guint payload_len)
 {
   guint off;
 
   g_assert (payload_len <= *p_size);
 
-  off = (guint) (*p_data - packet->bdata);
+  off = *p_off;
   g_assert (off < gst_buffer_get_size (packet->buf));
 
-  *p_data += payload_len;
+  *p_off += payload_len;
   *p_size -= payload_len;
 
   return gst_buffer_copy_region (packet->buf, GST_BUFFER_COPY_ALL, off,
@@ -350,23 +397,25 @@ asf_payload_parse_replicated_data_extensions (AsfStream * stream,
 
 static gboolean
 gst_asf_demux_parse_payload (GstASFDemux * demux, AsfPacket * packet,
-    gint lentype, const guint8 ** p_data, guint * p_size)
+    gint lentype, guint * p_off, guint * p_size)
 {
   AsfPayload payload = { 0, };
   AsfStream *stream;
   gboolean is_compressed;
   guint payload_len;
   guint stream_num;
+  guint8 b;
 
   if (G_UNLIKELY (*p_size < 1)) {
     GST_WARNING_OBJECT (demux, "Short packet!");
     return FALSE;
   }
 
-  stream_num = GST_READ_UINT8 (*p_data) & 0x7f;
-  payload.keyframe = ((GST_READ_UINT8 (*p_data) & 0x80) != 0);
+  b = GST_READ_UINT8 (asf_packet_peek (packet, *p_off, 1));
+  stream_num = b & 0x7f;
+  payload.keyframe = ((b & 0x80) != 0);
 
-  *p_data += 1;
+  *p_off += 1;
   *p_size -= 1;
 
   payload.ts = GST_CLOCK_TIME_NONE;
@@ -378,11 +427,14 @@ gst_asf_demux_parse_payload (GstASFDemux * demux, AsfPacket * packet,
   payload.rff = FALSE;
 
   payload.mo_number =
-      asf_packet_read_varlen_int (packet->prop_flags, 4, p_data, p_size);
+      asf_packet_read_varlen_int (packet, packet->prop_flags, 4, p_off,
+      p_size);
   payload.mo_offset =
-      asf_packet_read_varlen_int (packet->prop_flags, 2, p_data, p_size);
+      asf_packet_read_varlen_int (packet, packet->prop_flags, 2, p_off,
+      p_size);
   payload.rep_data_len =
-      asf_packet_read_varlen_int (packet->prop_flags, 0, p_data, p_size);
+      asf_packet_read_varlen_int (packet, packet->prop_flags, 0, p_off,
+      p_size);
 
   is_compressed = (payload.rep_data_len == 1);
 
@@ -396,10 +448,10 @@ gst_asf_demux_parse_payload (GstASFDemux * demux, AsfPacket * packet,
     return FALSE;
   }
 
-  memcpy (payload.rep_data, *p_data,
+  asf_packet_copy (packet, *p_off, payload.rep_data,
       MIN (sizeof (payload.rep_data), payload.rep_data_len));
 
-  *p_data += payload.rep_data_len;
+  *p_off += payload.rep_data_len;
   *p_size -= payload.rep_data_len;
 
   if (G_UNLIKELY (*p_size == 0)) {
@@ -409,7 +461,8 @@ gst_asf_demux_parse_payload (GstASFDemux * demux, AsfPacket * packet,
 
   /* we use -1 as lentype for a single payload that's the size of the packet */
   if (G_UNLIKELY ((lentype >= 0 && lentype <= 3))) {
-    payload_len = asf_packet_read_varlen_int (lentype, 0, p_data, p_size);
+    payload_len =
+        asf_packet_read_varlen_int (packet, lentype, 0, p_off, p_size);
     if (*p_size < payload_len) {
       GST_WARNING_OBJECT (demux, "Short packet! payload_len=%u, size=%u",
           payload_len, *p_size);
@@ -429,15 +482,26 @@ gst_asf_demux_parse_payload (GstASFDemux * demux, AsfPacket * packet,
           stream_num);
     }
     if (*p_size < payload_len) {
-      *p_data += *p_size;
+      *p_off += *p_size;
       *p_size = 0;
     } else {
-      *p_data += payload_len;
+      *p_off += payload_len;
       *p_size -= payload_len;
     }
     return TRUE;
   }
 
+  /* in pull mode only video keyframes are pushed in key unit trick mode, so
+   * don't bother with video delta units. Audio payloads don't reliably carry
+   * the key flag and are kept, as is everything upstream sends in push mode */
+  if (G_UNLIKELY (GST_ASF_DEMUX_IS_KEY_UNIT_TRICKMODE (demux->segment)
+          && stream->is_video && !demux->streaming && !payload.keyframe)) {
+    GST_LOG_OBJECT (demux, "skipping delta unit payload");
+    *p_off += payload_len;
+    *p_size -= payload_len;
+    return TRUE;
+  }
+
   if (!stream->is_video)
     stream->kf_pos = 0;
 
@@ -462,7 +526,7 @@ gst_asf_demux_parse_payload (GstASFDemux * demux, AsfPacket * packet,
       payload.mo_size = 0;
     } else if (payload.rep_data_len != 0) {
       GST_WARNING_OBJECT (demux, "invalid replicated data length, very bad");
-      *p_data += payload_len;
+      *p_off += payload_len;
       *p_size -= payload_len;
       return FALSE;
     }
@@ -476,21 +540,21 @@ gst_asf_demux_parse_payload (GstASFDemux * demux, AsfPacket * packet,
     } else if (payload.mo_offset == 0 && payload.mo_size == payload_len) {
       /* if the media object is not fragmented, just create a sub-buffer */
       GST_LOG_OBJECT (demux, "unfragmented media object size %u", payload_len);
-      payload.buf = asf_packet_create_payload_buffer (packet, p_data, p_size,
+      payload.buf = asf_packet_create_payload_buffer (packet, p_off, p_size,
           payload_len);
       payload.buf_filled = payload_len;
       gst_asf_payload_queue_for_stream (demux, &payload, stream);
     } else if (GST_ASF_DEMUX_IS_REVERSE_PLAYBACK (demux->segment)) {
       /* Handle fragmented payloads for reverse playback */
       AsfPayload *prev;
-      const guint8 *payload_data = *p_data;
+      guint payload_off = *p_off;
       prev = asf_payload_find_previous_fragment (demux, &payload, stream);
 
       if (prev) {
         gint idx;
         AsfPayload *p;
-        gst_buffer_fill (prev->buf, payload.mo_offset,
-            payload_data, payload_len);
+        asf_packet_fill_buffer (packet, payload_off, prev->buf,
+            payload.mo_offset, payload_len);
         prev->buf_filled += payload_len;
         if (payload.keyframe && payload.mo_offset == 0) {
           stream->reverse_kf_ready = TRUE;
@@ -505,19 +569,19 @@ gst_asf_demux_parse_payload (GstASFDemux * demux, AsfPacket * packet,
         }
       } else {
         payload.buf = gst_buffer_new_allocate (NULL, payload.mo_size, NULL);    /* can we use (mo_size - offset) for size? */
-        gst_buffer_fill (payload.buf, payload.mo_offset,
-            payload_data, payload_len);
+        asf_packet_fill_buffer (packet, payload_off, payload.buf,
+            payload.mo_offset, payload_len);
         payload.buf_filled = payload.mo_size - (payload.mo_offset);
         gst_asf_payload_queue_for_stream (demux, &payload, stream);
       }
-      *p_data += payload_len;
+      *p_off += payload_len;
       *p_size -= payload_len;
     } else {
-      const guint8 *payload_data = *p_data;
+      guint payload_off = *p_off;
 
       g_assert (payload_len <= *p_size);
 
-      *p_data += payload_len;
+      *p_off += payload_len;
       *p_size -= payload_len;
 
       /* n-th fragment of a fragmented media object? */
@@ -539,8 +603,8 @@ gst_asf_demux_parse_payload (GstASFDemux * demux, AsfPacket * packet,
                   "offset=%u vs buf_filled=%u", payload.mo_offset,
                   prev->buf_filled);
             }
-            gst_buffer_fill (prev->buf, payload.mo_offset,
-                payload_data, payload_len);
+            asf_packet_fill_buffer (packet, payload_off, prev->buf,
+                payload.mo_offset, payload_len);
             prev->buf_filled =
                 MAX (prev->buf_filled, payload.mo_offset + payload_len);
             GST_LOG_OBJECT (demux, "Merged media object fragments, size now %u",
@@ -554,22 +618,23 @@ gst_asf_demux_parse_payload (GstASFDemux * demux, AsfPacket * packet,
         GST_LOG_OBJECT (demux, "allocating buffer of size %u for fragmented "
             "media object", payload.mo_size);
         payload.buf = gst_buffer_new_allocate (NULL, payload.mo_size, NULL);
-        gst_buffer_fill (payload.buf, 0, payload_data, payload_len);
+        asf_packet_fill_buffer (packet, payload_off, payload.buf, 0,
+            payload_len);
         payload.buf_filled = payload_len;
 
         gst_asf_payload_queue_for_stream (demux, &payload, stream);
       }
     }
   } else {
-    const guint8 *payload_data;
+    guint payload_off;
     GstClockTime ts, ts_delta;
     guint num;
 
     GST_LOG_OBJECT (demux, "Compressed payload, length=%u", payload_len);
 
-    payload_data = *p_data;
+    payload_off = *p_off;
 
-    *p_data += payload_len;
+    *p_off += payload_len;
     *p_size -= payload_len;
 
     ts = payload.mo_offset * GST_MSECOND;
@@ -582,12 +647,13 @@ gst_asf_demux_parse_payload (GstASFDemux * demux, AsfPacket * packet,
     for (num = 0; payload_len > 0; ++num) {
       guint sub_payload_len;
 
-      sub_payload_len = GST_READ_UINT8 (payload_data);
+      sub_payload_len =
+          GST_READ_UINT8 (asf_packet_peek (packet, payload_off, 1));
 
       GST_LOG_OBJECT (demux, "subpayload #%u: len=%u, ts=%" GST_TIME_FORMAT,
           num, sub_payload_len, GST_TIME_ARGS (ts));
 
-      ++payload_data;
+      ++payload_off;
       --payload_len;
 
       if (G_UNLIKELY (payload_len < sub_payload_len)) {
@@ -597,7 +663,7 @@ gst_asf_demux_parse_payload (GstASFDemux * demux, AsfPacket * packet,
 
       if (G_LIKELY (sub_payload_len > 0)) {
         payload.buf = asf_packet_create_payload_buffer (packet,
-            &payload_data, &payload_len, sub_payload_len);
+            &payload_off, &payload_len, sub_payload_len);
         payload.buf_filled = sub_payload_len;
 
         payload.ts = ts;
@@ -625,11 +691,19 @@ gst_asf_demux_parse_packet (GstASFDemux * demux, GstBuffer * buf)
   gboolean has_multiple_payloads;
   GstAsfDemuxParsePacketError ret = GST_ASF_DEMUX_PARSE_PACKET_ERROR_NONE;
   guint8 ec_flags, flags1;
-  guint size;
+  guint off, size;
+
+  packet.buf = buf;
+
+  /* don't merge packets that span several memories, see asf_packet_peek() */
+  if (gst_buffer_n_memory (buf) == 1) {
+    gst_buffer_map (buf, &map, GST_MAP_READ);
+    /* evidently transient */
+    packet.bdata = map.data;
+  }
 
-  gst_buffer_map (buf, &map, GST_MAP_READ);
-  data = map.data;
-  size = map.size;
+  off = 0;
+  size = gst_buffer_get_size (buf);
   GST_LOG_OBJECT (demux, "Buffer size: %u", size);
 
   /* need at least two payload flag bytes, send time, and duration */
@@ -639,11 +713,7 @@ gst_asf_demux_parse_packet (GstASFDemux * demux, GstBuffer * buf)
     goto done;
   }
 
-  packet.buf = buf;
-  /* evidently transient */
-  packet.bdata = data;
-
-  ec_flags = GST_READ_UINT8 (data);
+  ec_flags = GST_READ_UINT8 (asf_packet_peek (&packet, off, 1));
 
   /* skip optional error correction stuff */
   if ((ec_flags & 0x80) != 0) {
@@ -666,24 +736,28 @@ gst_asf_demux_parse_packet (GstASFDemux * demux, GstBuffer * buf)
       goto done;
     }
 
-    data += 1 + ec_len;
+    off += 1 + ec_len;
     size -= 1 + ec_len;
   }
 
   /* parse payload info */
+  data = asf_packet_peek (&packet, off, 2);
   flags1 = GST_READ_UINT8 (data);
   packet.prop_flags = GST_READ_UINT8 (data + 1);
 
-  data += 2;
+  off += 2;
   size -= 2;
 
   has_multiple_payloads = (flags1 & 0x01) != 0;
 
-  packet.length = asf_packet_read_varlen_int (flags1, 5, &data, &size);
+  packet.length =
+      asf_packet_read_varlen_int (&packet, flags1, 5, &off, &size);
 
-  packet.sequence = asf_packet_read_varlen_int (flags1, 1, &data, &size);
+  packet.sequence =
+      asf_packet_read_varlen_int (&packet, flags1, 1, &off, &size);
 
-  packet.padding = asf_packet_read_varlen_int (flags1, 3, &data, &size);
+  packet.padding =
+      asf_packet_read_varlen_int (&packet, flags1, 3, &off, &size);
 
   if (G_UNLIKELY (size < 6)) {
     GST_WARNING_OBJECT (demux, "Packet size is < 6");
@@ -691,10 +765,11 @@ gst_asf_demux_parse_packet (GstASFDemux * demux, GstBuffer * buf)
     goto done;
   }
 
+  data = asf_packet_peek (&packet, off, 4 + 2);
   packet.send_time = GST_READ_UINT32_LE (data) * GST_MSECOND;
   packet.duration = GST_READ_UINT16_LE (data + 4) * GST_MSECOND;
 
-  data += 4 + 2;
+  off += 4 + 2;
   size -= 4 + 2;
 
   GST_LOG_OBJECT (demux, "flags            : 0x%x", flags1);
@@ -753,10 +828,11 @@ gst_asf_demux_parse_packet (GstASFDemux * demux, GstBuffer * buf)
       goto done;
     }
 
+    data = asf_packet_peek (&packet, off, 1);
     num = (GST_READ_UINT8 (data) & 0x3F) >> 0;
     lentype = (GST_READ_UINT8 (data) & 0xC0) >> 6;
 
-    ++data;
+    ++off;
     --size;
 
     GST_LOG_OBJECT (demux, "num payloads     : %u", num);
@@ -766,7 +842,7 @@ gst_asf_demux_parse_packet (GstASFDemux * demux, GstBuffer * buf)
           size);
 
       if (G_UNLIKELY (!gst_asf_demux_parse_payload (demux, &packet, lentype,
-                  &data, &size))) {
+                  &off, &size))) {
         GST_WARNING_OBJECT (demux, "Failed to parse payload %u/%u", i + 1, num);
         ret = GST_ASF_DEMUX_PARSE_PACKET_ERROR_FATAL;
         break;
@@ -795,7 +871,7 @@ gst_asf_demux_parse_packet (GstASFDemux * demux, GstBuffer * buf)
   } else {
     GST_LOG_OBJECT (demux, "Parsing single payload");
     demux->multiple_payloads = FALSE;
-    if (G_UNLIKELY (!gst_asf_demux_parse_payload (demux, &packet, -1, &data,
+    if (G_UNLIKELY (!gst_asf_demux_parse_payload (demux, &packet, -1, &off,
                 &size))) {
       GST_WARNING_OBJECT (demux, "Failed to parse payload");
       ret = GST_ASF_DEMUX_PARSE_PACKET_ERROR_RECOVERABLE;
@@ -803,6 +879,7 @@ gst_asf_demux_parse_packet (GstASFDemux * demux, GstBuffer * buf)
   }
 
 done:
-  gst_buffer_unmap (buf, &map);
+  if (packet.bdata != NULL)
+    gst_buffer_unmap (buf, &map);
   return ret;
 }
@@ -47,7 +47,8 @@ typedef struct {
 
 typedef struct {
   GstBuffer    *buf;
-  const guint8 *bdata;
+  const guint8 *bdata;             /* NULL if buf spans several memories   */
+  guint8        scratch[8];        /* header bytes extracted from buf      */
   guint         length;            /* packet length (unused)               */
   guint         padding;           /* length of padding at end of packet   */
   guint         sequence;          /* sequence (unused)                    */
@@ -278,6 +278,7 @@ gst_asf_demux_reset (GstASFDemux * demux, gboolean chain_reset)
   demux->sidx_num_entries = 0;
   g_free (demux->sidx_entries);
   demux->sidx_entries = NULL;
+  demux->trick_idx = 0;
 
   demux->speed_packets = 1;
 
@@ -545,6 +546,20 @@ gst_asf_demux_seek_index_lookup (GstASFDemux * demux, guint * packet,
   return TRUE;
 }
 
+static void
+gst_asf_demux_clear_payloads (AsfStream * stream)
+{
+  while (stream->payloads->len > 0) {
+    AsfPayload *payload;
+    guint last;
+
+    last = stream->payloads->len - 1;
+    payload = &g_array_index (stream->payloads, AsfPayload, last);
+    gst_buffer_replace (&payload->buf, NULL);
+    g_array_remove_index (stream->payloads, last);
+  }
+}
+
 static void
 gst_asf_demux_reset_stream_state_after_discont (GstASFDemux * demux)
 {
@@ -559,16 +574,69 @@ gst_asf_demux_reset_stream_state_after_discont (GstASFDemux * demux)
     demux->stream[n].discont = TRUE;
     demux->stream[n].first_buffer = TRUE;
 
-    while (demux->stream[n].payloads->len > 0) {
-      AsfPayload *payload;
-      guint last;
+    gst_asf_demux_clear_payloads (&demux->stream[n]);
+  }
+}
 
-      last = demux->stream[n].payloads->len - 1;
-      payload = &g_array_index (demux->stream[n].payloads, AsfPayload, last);
-      gst_buffer_replace (&payload->buf, NULL);
-      g_array_remove_index (demux->stream[n].payloads, last);
-    }
+/* key unit trick mode: set up the loop to pull the packets of the keyframe
+ * at demux->trick_idx and move on to the entry of the next (or, in reverse,
+ * previous) keyframe packet. Returns FALSE at the end of the segment. */
+static gboolean
+gst_asf_demux_trickmode_next (GstASFDemux * demux)
+{
+  AsfSimpleIndexEntry *entry;
+  GstClockTime idx_time;
+  guint n, packet, count;
+
+  if (demux->trick_idx < 0
+      || (guint) demux->trick_idx >= demux->sidx_num_entries)
+    return FALSE;
+
+  idx_time = demux->sidx_interval * demux->trick_idx;
+  if (G_LIKELY (idx_time >= demux->preroll))
+    idx_time -= demux->preroll;
+
+  if (demux->segment.rate > 0.0) {
+    if (GST_CLOCK_TIME_IS_VALID (demux->segment.stop)
+        && idx_time > demux->segment.stop)
+      return FALSE;
+  } else {
+    /* the entry before the start still has the keyframe at the start */
+    if (idx_time + demux->sidx_interval <= demux->segment.start)
+      return FALSE;
+  }
+
+  entry = &demux->sidx_entries[demux->trick_idx];
+  packet = entry->packet;
+  count = MAX (entry->count, 1);
+  if (demux->num_packets > 0 && packet < demux->num_packets)
+    count = MIN (count, demux->num_packets - packet);
+
+  GST_DEBUG_OBJECT (demux, "keyframe at %" GST_TIME_FORMAT ": packet %u, "
+      "%u packets", GST_TIME_ARGS (idx_time), packet, count);
+
+  demux->packet = packet;
+  demux->speed_packets = count;
+
+  /* subsequent entries may point to the same keyframe */
+  if (demux->segment.rate > 0.0) {
+    while ((guint) demux->trick_idx < demux->sidx_num_entries
+        && demux->sidx_entries[demux->trick_idx].packet == packet)
+      demux->trick_idx++;
+  } else {
+    while (demux->trick_idx >= 0
+        && demux->sidx_entries[demux->trick_idx].packet == packet)
+      demux->trick_idx--;
+  }
+
+  /* drop leftovers of the previous keyframe packets, e.g. the start of a
+   * media object that continues in a packet we skip */
+  for (n = 0; n < demux->num_streams; n++) {
+    demux->stream[n].discont = TRUE;
+    gst_asf_demux_clear_payloads (&demux->stream[n]);
   }
+
+  return TRUE;
 }
 
 static void
@@ -753,6 +821,13 @@ gst_asf_demux_handle_seek_event (GstASFDemux * demux, GstEvent * event)
   gst_segment_do_seek (&segment, rate, format, flags, cur_type,
       cur, stop_type, stop, &only_need_update);
 
+  /* key unit trick mode jumps from keyframe to keyframe with the index */
+  if (GST_ASF_DEMUX_IS_KEY_UNIT_TRICKMODE (segment)
+      && (demux->sidx_num_entries == 0 || demux->sidx_interval == 0)) {
+    GST_DEBUG_OBJECT (demux, "no index, can't do key unit trick mode");
+    segment.flags &= ~GST_SEGMENT_FLAG_TRICKMODE_KEY_UNITS;
+  }
+
   GST_DEBUG_OBJECT (demux, "seeking to time %" GST_TIME_FORMAT ", segment: "
       "%" GST_SEGMENT_FORMAT, GST_TIME_ARGS (segment.start), &segment);
 
@@ -828,6 +903,22 @@ gst_asf_demux_handle_seek_event (GstASFDemux * demux, GstEvent * event)
   demux->segment_seqnum = seqnum;
   demux->speed_packets =
       GST_ASF_DEMUX_IS_REVERSE_PLAYBACK (demux->segment) ? 1 : speed_count;
+  if (GST_ASF_DEMUX_IS_KEY_UNIT_TRICKMODE (demux->segment)) {
+    GstClockTime trick_time;
+
+    if (demux->segment.rate > 0.0)
+      trick_time = demux->segment.start;
+    else if (GST_CLOCK_TIME_IS_VALID (demux->segment.stop))
+      trick_time = demux->segment.stop;
+    else
+      trick_time = demux->segment.duration;
+
+    if (GST_CLOCK_TIME_IS_VALID (trick_time))
+      demux->trick_idx = MIN ((trick_time + demux->preroll) /
+          demux->sidx_interval, demux->sidx_num_entries - 1);
+    else
+      demux->trick_idx = demux->sidx_num_entries - 1;
+  }
   gst_asf_demux_reset_stream_state_after_discont (demux);
   GST_OBJECT_UNLOCK (demux);
 
@@ -1689,7 +1780,7 @@ gst_asf_demux_push_complete_payloads (GstASFDemux * demux, gboolean force)
       /* FIXME : only if ACCURATE ! */
       if (G_LIKELY (!demux->keyunit_sync && !demux->accurate
               && (GST_CLOCK_TIME_IS_VALID (payload->ts)))
-          && !GST_ASF_DEMUX_IS_REVERSE_PLAYBACK (demux->segment)) {
+          && demux->segment.rate > 0.0) {
         GST_DEBUG ("Adjusting newsegment start to %" GST_TIME_FORMAT,
             GST_TIME_ARGS (payload->ts));
         demux->segment.start = payload->ts;
@@ -1837,11 +1928,20 @@ gst_asf_demux_push_complete_payloads (GstASFDemux * demux, gboolean force)
         stream->first_buffer = FALSE;
       }
 
-      if (GST_CLOCK_TIME_IS_VALID (timestamp)
-          && timestamp > demux->segment.position) {
-        demux->segment.position = timestamp;
+      /* the position moves backwards when playing in reverse, and forwards
+       * to the end of the last buffer otherwise */
+      if (GST_CLOCK_TIME_IS_VALID (timestamp) && demux->segment.rate < 0.0) {
+        if (!GST_CLOCK_TIME_IS_VALID (demux->segment.position)
+            || timestamp < demux->segment.position)
+          demux->segment.position = timestamp;
+      } else if (GST_CLOCK_TIME_IS_VALID (timestamp)) {
+        GstClockTime end = timestamp;
+
         if (GST_CLOCK_TIME_IS_VALID (duration))
-          demux->segment.position += timestamp;
+          end += duration;
+        if (!GST_CLOCK_TIME_IS_VALID (demux->segment.position)
+            || end > demux->segment.position)
+          demux->segment.position = end;
       }
 
       ret = gst_pad_push (stream->pad, payload->buf);
@@ -1942,6 +2042,11 @@ gst_asf_demux_loop (GstASFDemux * demux)
 
   g_assert (demux->state == GST_ASF_DEMUX_STATE_DATA);
 
+  if (G_UNLIKELY (GST_ASF_DEMUX_IS_KEY_UNIT_TRICKMODE (demux->segment))) {
+    if (!gst_asf_demux_trickmode_next (demux))
+      goto eos;
+  }
+
   if (G_UNLIKELY (demux->num_packets != 0
           && demux->packet >= demux->num_packets))
     goto eos;
@@ -2055,8 +2160,10 @@ gst_asf_demux_loop (GstASFDemux * demux)
 
   gst_buffer_unref (buf);
 
+  /* in key unit trick mode the index tells where to continue */
   if (G_UNLIKELY ((demux->num_packets > 0
-              && demux->packet >= demux->num_packets)
+              && demux->packet >= demux->num_packets
+              && !GST_ASF_DEMUX_IS_KEY_UNIT_TRICKMODE (demux->segment))
           || flow == GST_FLOW_EOS)) {
     GST_LOG_OBJECT (demux, "reached EOS");
     goto eos;
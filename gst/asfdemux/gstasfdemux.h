@@ -150,7 +150,12 @@ typedef enum {
   GST_ASF_DEMUX_STATE_INDEX
 } GstASFDemuxState;
 
-#define GST_ASF_DEMUX_IS_REVERSE_PLAYBACK(seg) (seg.rate < 0.0? TRUE:FALSE)
+#define GST_ASF_DEMUX_IS_KEY_UNIT_TRICKMODE(seg) \
+    ((seg.flags & GST_SEGMENT_FLAG_TRICKMODE_KEY_UNITS) != 0)
+/* in key unit trick mode negative rates step backwards through the index,
+ * but the packets of each keyframe are parsed and pushed in forward order */
+#define GST_ASF_DEMUX_IS_REVERSE_PLAYBACK(seg) \
+    (seg.rate < 0.0 && !GST_ASF_DEMUX_IS_KEY_UNIT_TRICKMODE (seg))
 
 #define GST_ASF_DEMUX_NUM_VIDEO_PADS   16
 #define GST_ASF_DEMUX_NUM_AUDIO_PADS   32
@@ -238,6 +243,9 @@ struct _GstASFDemux {
   gboolean             seek_to_cur_pos; /* Search packets till we reach 'seek' time */
   gboolean             multiple_payloads; /* Whether packet has multiple payloads */
 
+  /* For key unit trick mode */
+  gint                 trick_idx;       /* next simple index entry to push */
+
   /* parsing 3D */
   GstASF3DMode asf_3D_mode;
 };
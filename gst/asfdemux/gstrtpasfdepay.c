@@ -101,7 +101,7 @@ gst_rtp_asf_depay_class_init (GstRtpAsfDepayClass * klass)
 static void
 gst_rtp_asf_depay_init (GstRtpAsfDepay * depay)
 {
-  depay->adapter = gst_adapter_new ();
+  depay->fragments = NULL;
 }
 
 static void
@@ -111,7 +111,9 @@ gst_rtp_asf_depay_finalize (GObject * object)
 
   depay = GST_RTP_ASF_DEPAY (object);
 
-  g_object_unref (depay->adapter);
+  gst_buffer_replace (&depay->fragments, NULL);
+  if (depay->padding)
+    gst_memory_unref (depay->padding);
 
   G_OBJECT_CLASS (parent_class)->finalize (object);
 }
@@ -163,6 +165,24 @@ gst_rtp_asf_depay_setcaps (GstRTPBaseDepayload * depayload, GstCaps * caps)
   if (depay->packet_size <= 16)
     goto invalid_packetsize;
 
+  /* the padding is shared from this memory, so it must cover a whole packet
+   * of the negotiated size */
+  if (depay->padding
+      && gst_memory_get_sizes (depay->padding, NULL, NULL) !=
+      depay->packet_size) {
+    gst_memory_unref (depay->padding);
+    depay->padding = NULL;
+  }
+
+  if (!depay->padding) {
+    GstMapInfo map;
+
+    depay->padding = gst_allocator_alloc (NULL, depay->packet_size, NULL);
+    gst_memory_map (depay->padding, &map, GST_MAP_WRITE);
+    memset (map.data, 0, map.size);
+    gst_memory_unmap (depay->padding, &map);
+  }
+
   headers = (guint8 *) g_base64_decode (config_str, &headers_len);
 
   if (headers == NULL || headers_len < 16
@@ -240,15 +260,19 @@ field_size (guint8 field)
 }
 
 /* Set the padding field to te correct value as the spec
- * says it should be se to 0 in the rtp packets
+ * says it should be se to 0 in the rtp packets.
+ * The payload is not copied: the padding is appended as a share of a
+ * memory with zeroes and only the header bytes up to the padding length
+ * field are replaced by a patched copy.
  */
 static GstBuffer *
 gst_rtp_asf_depay_update_padding (GstRtpAsfDepay * depayload, GstBuffer * buf)
 {
   GstBuffer *result;
-  GstMapInfo map;
-  guint8 *data;
-  gint offset = 0;
+  /* longest header up to and including the padding length field */
+  guint8 data[1 + 15 + 1 + 1 + 4 + 4 + 4] = { 0, };
+  guint8 *header;
+  gsize offset = 0, hdr_len, pad_len;
   guint8 aux;
   guint8 seq_type;
   guint8 pad_type;
@@ -259,20 +283,23 @@ gst_rtp_asf_depay_update_padding (GstRtpAsfDepay * depayload, GstBuffer * buf)
   if (plen == depayload->packet_size)
     return buf;
 
+  if (plen > depayload->packet_size) {
+    GST_WARNING_OBJECT (depayload, "buffer size %" G_GSIZE_FORMAT
+        " exceeds packet size %d, not padding", plen, depayload->packet_size);
+    return buf;
+  }
+
   padding = depayload->packet_size - plen;
 
   GST_LOG_OBJECT (depayload,
       "padding buffer size %" G_GSIZE_FORMAT " to packet size %d", plen,
       depayload->packet_size);
 
-  result = gst_buffer_new_and_alloc (depayload->packet_size);
-
-  gst_buffer_map (result, &map, GST_MAP_READ);
-  data = map.data;
-  memset (data + plen, 0, padding);
+  hdr_len = gst_buffer_extract (buf, 0, data, sizeof (data));
 
-  gst_buffer_extract (buf, 0, data, plen);
-  gst_buffer_unref (buf);
+  result = gst_buffer_make_writable (buf);
+  gst_buffer_append_memory (result,
+      gst_memory_share (depayload->padding, 0, padding));
 
   aux = data[offset++];
   if (aux & 0x80) {
@@ -281,7 +308,6 @@ gst_rtp_asf_depay_update_padding (GstRtpAsfDepay * depayload, GstBuffer * buf)
       GST_WARNING_OBJECT (depayload, "Error correction length type should be "
           "set to 0");
       /* this packet doesn't follow the spec */
-      gst_buffer_unmap (result, &map);
       return result;
     }
     err_len = aux & 0x0F;
@@ -297,6 +323,15 @@ gst_rtp_asf_depay_update_padding (GstRtpAsfDepay * depayload, GstBuffer * buf)
   offset += field_size (pkt_type);      /* skip packet length */
   offset += field_size (seq_type);      /* skip sequence field */
 
+  pad_len = field_size (pad_type);
+  if (pad_len == 0)
+    return result;
+
+  if (offset + pad_len > hdr_len) {
+    GST_WARNING_OBJECT (depayload, "packet too short for its header");
+    return result;
+  }
+
   /* write padding */
   switch (pad_type) {
       /* DWORD */
@@ -319,9 +354,17 @@ gst_rtp_asf_depay_update_padding (GstRtpAsfDepay * depayload, GstBuffer * buf)
     default:
       break;
   }
-  gst_buffer_unmap (result, &map);
 
-  return result;
+  /* replace the header up to the patched field */
+  hdr_len = offset + pad_len;
+  buf = gst_buffer_copy_region (result, GST_BUFFER_COPY_ALL, hdr_len,
+      gst_buffer_get_size (result) - hdr_len);
+  gst_buffer_unref (result);
+  header = g_memdup (data, hdr_len);
+  gst_buffer_prepend_memory (buf,
+      gst_memory_new_wrapped (0, header, hdr_len, 0, hdr_len, header, g_free));
+
+  return buf;
 }
 
 /* Docs: 'RTSP Protocol PDF' document from http://sdp.ppona.com/ (page 8) */
@@ -343,7 +386,7 @@ gst_rtp_asf_depay_process (GstRTPBaseDepayload * depayload, GstBuffer * buf)
   /* flush remaining data on discont */
   if (GST_BUFFER_IS_DISCONT (buf)) {
     GST_LOG_OBJECT (depay, "got DISCONT");
-    gst_adapter_clear (depay->adapter);
+    gst_buffer_replace (&depay->fragments, NULL);
     depay->discont = TRUE;
   }
 
@@ -441,26 +484,33 @@ gst_rtp_asf_depay_process (GstRTPBaseDepayload * depayload, GstBuffer * buf)
       guint available;
       GstBuffer *sub;
 
-      /* Fragmented packet handling */
+      /* Fragmented packet handling. The fragments are appended to a buffer
+       * as payload sub-buffers so that the packet is reassembled from the
+       * RTP memory without copying it. */
       outbuf = NULL;
 
-      if (len_offs == (available = gst_adapter_available (depay->adapter))) {
+      available = depay->fragments ? gst_buffer_get_size (depay->fragments) : 0;
+
+      if (len_offs == available) {
         /* fragment aligns with what we have, add it */
         GST_LOG_OBJECT (depay, "collecting fragment");
         sub =
             gst_rtp_buffer_get_payload_subbuffer (&rtpbuf, offset, packet_len);
-        gst_adapter_push (depay->adapter, sub);
+        if (depay->fragments)
+          depay->fragments = gst_buffer_append (depay->fragments, sub);
+        else
+          depay->fragments = sub;
         /* RTP marker bit M is set if this is last fragment */
         if (gst_rtp_buffer_get_marker (&rtpbuf)) {
           GST_LOG_OBJECT (depay, "last fragment, assembling packet");
-          outbuf =
-              gst_adapter_take_buffer (depay->adapter, available + packet_len);
+          outbuf = depay->fragments;
+          depay->fragments = NULL;
         }
       } else {
         if (available) {
           GST_WARNING_OBJECT (depay, "Offset doesn't match previous data?!");
           GST_DEBUG_OBJECT (depay, "clearing for re-sync");
-          gst_adapter_clear (depay->adapter);
+          gst_buffer_replace (&depay->fragments, NULL);
         } else
           GST_DEBUG_OBJECT (depay, "waiting for start of packet");
       }
@@ -522,7 +572,7 @@ gst_rtp_asf_depay_change_state (GstElement * element, GstStateChange trans)
 
   switch (trans) {
     case GST_STATE_CHANGE_READY_TO_PAUSED:
-      gst_adapter_clear (depay->adapter);
+      gst_buffer_replace (&depay->fragments, NULL);
       depay->discont = TRUE;
       break;
     default:
@@ -533,7 +583,9 @@ gst_rtp_asf_depay_change_state (GstElement * element, GstStateChange trans)
 
   switch (trans) {
     case GST_STATE_CHANGE_PAUSED_TO_READY:
-      gst_adapter_clear (depay->adapter);
+      gst_buffer_replace (&depay->fragments, NULL);
+      /* the next stream may use another packet size */
+      depay->packet_size = 0;
       break;
     default:
       break;
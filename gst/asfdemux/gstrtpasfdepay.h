@@ -22,7 +22,6 @@
 #define __GST_RTP_ASF_DEPAY_H__
 
 #include <gst/gst.h>
-#include <gst/base/gstadapter.h>
 
 #include <gst/rtp/gstrtpbasedepayload.h>
 
@@ -47,8 +46,11 @@ struct _GstRtpAsfDepay
   GstRTPBaseDepayload depayload;
 
   guint packet_size;
+  /* zeroes that short packets are padded with */
+  GstMemory *padding;
 
-  GstAdapter *adapter;
+  /* fragments of the packet being reassembled */
+  GstBuffer  *fragments;
   gboolean    discont;
 };
 
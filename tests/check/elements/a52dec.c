@@ -0,0 +1,442 @@
+/* GStreamer
+ *
+ * unit test for a52dec
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Library General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Library General Public License for more details.
+ *
+ * You should have received a copy of the GNU Library General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 51 Franklin St, Fifth Floor,
+ * Boston, MA 02110-1301, USA.
+ */
+
+#include <gst/check/gstcheck.h>
+#include <gst/check/gstharness.h>
+#include <gst/audio/audio.h>
+
+#define AC3_CAPS "audio/x-ac3"
+#define FLOAT_CAPS "audio/x-raw"
+#define S16_CAPS "audio/x-raw, format = (string) " GST_AUDIO_NE (S16)
+
+/* 3/2 frames without LFE, 64 kbit/s at 48 kHz */
+#define FRAME_SIZE 256
+#define FRAME_SAMPLES 1536
+#define NUM_FRAMES 8
+#define NUM_CHANNELS 5
+
+/* the mix levels of the element, and the bandwidth and exponent of all the
+ * channels in the stream */
+#define MIX_LEVEL 0.70710678
+#define BANDWIDTH_CODE 0
+#define EXPONENT 3
+
+typedef struct
+{
+  guint8 *data;
+  guint pos;
+} BitWriter;
+
+static void
+put_bits (BitWriter * bw, guint nbits, guint value)
+{
+  while (nbits--) {
+    if ((value >> nbits) & 1)
+      bw->data[bw->pos >> 3] |= 0x80 >> (bw->pos & 7);
+    bw->pos++;
+  }
+}
+
+/* Writes a frame without any mantissa bits: the zero SNR offsets give all
+ * coefficients a bit allocation of 0, which liba52 fills with its dither
+ * noise, so every channel carries a different signal of a known level */
+static void
+write_frame (guint8 * data)
+{
+  BitWriter bw = { data, 0 };
+  gint blk, ch, grp, ngrps;
+
+  /* syncinfo: syncword, crc1, 48 kHz, 64 kbit/s */
+  put_bits (&bw, 16, 0x0b77);
+  put_bits (&bw, 16, 0);
+  put_bits (&bw, 2, 0);
+  put_bits (&bw, 6, 8);
+
+  /* bsi: bsid, bsmod, acmod 3/2, cmixlev, surmixlev, no LFE, dialnorm,
+   * then none of the optional fields */
+  put_bits (&bw, 5, 8);
+  put_bits (&bw, 3, 0);
+  put_bits (&bw, 3, 7);
+  put_bits (&bw, 2, 0);
+  put_bits (&bw, 2, 0);
+  put_bits (&bw, 1, 0);
+  put_bits (&bw, 5, 27);
+  put_bits (&bw, 8, 0);
+
+  /* D15 exponent groups up to the end mantissa of the bandwidth code */
+  ngrps = (BANDWIDTH_CODE * 3 + 73 - 1) / 3;
+
+  for (blk = 0; blk < 6; blk++) {
+    /* blksw, dithflag, dynrnge */
+    put_bits (&bw, NUM_CHANNELS, 0);
+    put_bits (&bw, NUM_CHANNELS, 0x1f);
+    put_bits (&bw, 1, 0);
+
+    if (blk == 0) {
+      /* cplstre without coupling, D15 exponents */
+      put_bits (&bw, 2, 2);
+      for (ch = 0; ch < NUM_CHANNELS; ch++)
+        put_bits (&bw, 2, 1);
+      for (ch = 0; ch < NUM_CHANNELS; ch++)
+        put_bits (&bw, 6, BANDWIDTH_CODE);
+      /* a constant exponent: every group holds three zero deltas */
+      for (ch = 0; ch < NUM_CHANNELS; ch++) {
+        put_bits (&bw, 4, EXPONENT);
+        for (grp = 0; grp < ngrps; grp++)
+          put_bits (&bw, 7, 62);
+        put_bits (&bw, 2, 0);
+      }
+      /* baie with the usual parameters, snroffste with zero offsets */
+      put_bits (&bw, 1, 1);
+      put_bits (&bw, 11, (2 << 9) | (1 << 7) | (1 << 5) | (2 << 3) | 7);
+      put_bits (&bw, 1, 1);
+      put_bits (&bw, 6, 0);
+      for (ch = 0; ch < NUM_CHANNELS; ch++)
+        put_bits (&bw, 7, 4);
+    } else {
+      /* no cplstre, reused exponents, no baie or snroffste */
+      put_bits (&bw, 1, 0);
+      put_bits (&bw, 2 * NUM_CHANNELS, 0);
+      put_bits (&bw, 2, 0);
+    }
+
+    /* deltbaie, skiple */
+    put_bits (&bw, 2, 0);
+  }
+
+  /* the rest is auxiliary data and a crc2 liba52 doesn't check */
+  fail_unless (bw.pos <= FRAME_SIZE * 8 - 16);
+}
+
+static GstBuffer *
+make_stream (void)
+{
+  GstBuffer *buffer;
+  GstMapInfo map;
+  gint i;
+
+  buffer = gst_buffer_new_allocate (NULL, NUM_FRAMES * FRAME_SIZE, NULL);
+  gst_buffer_map (buffer, &map, GST_MAP_WRITE);
+  memset (map.data, 0, map.size);
+  for (i = 0; i < NUM_FRAMES; i++)
+    write_frame (map.data + i * FRAME_SIZE);
+  gst_buffer_unmap (buffer, &map);
+
+  GST_BUFFER_PTS (buffer) = 0;
+
+  return buffer;
+}
+
+typedef struct
+{
+  GstAudioInfo info;
+  GByteArray *data;
+} Decoded;
+
+/* decodes the stream with the element configured in @h and collects the
+ * output in @out */
+static void
+decode (GstHarness * h, Decoded * out)
+{
+  GstBuffer *buffer;
+  GstCaps *caps;
+  GstMapInfo map;
+
+  fail_unless_equals_int (gst_harness_push (h, make_stream ()), GST_FLOW_OK);
+  fail_unless (gst_harness_push_event (h, gst_event_new_eos ()));
+
+  out->data = g_byte_array_new ();
+  while ((buffer = gst_harness_try_pull (h)) != NULL) {
+    gst_buffer_map (buffer, &map, GST_MAP_READ);
+    g_byte_array_append (out->data, map.data, map.size);
+    gst_buffer_unmap (buffer, &map);
+    gst_buffer_unref (buffer);
+  }
+
+  caps = gst_pad_get_current_caps (h->sinkpad);
+  fail_unless (caps != NULL);
+  fail_unless (gst_audio_info_from_caps (&out->info, caps));
+  gst_caps_unref (caps);
+
+  fail_unless_equals_int (out->data->len,
+      NUM_FRAMES * FRAME_SAMPLES * GST_AUDIO_INFO_BPF (&out->info));
+
+  gst_harness_teardown (h);
+}
+
+static GstHarness *
+setup_a52dec (const gchar * caps_str, gboolean downmix)
+{
+  GstHarness *h;
+
+  h = gst_harness_new ("a52dec");
+  gst_harness_set_caps_str (h, AC3_CAPS, caps_str);
+  gst_util_set_object_arg (G_OBJECT (h->element), "mode",
+      downmix ? "stereo" : "3f2r");
+  g_object_set (h->element, "lfe", FALSE, "custom-downmix", downmix, NULL);
+
+  return h;
+}
+
+static gdouble
+get_sample (Decoded * d, gint n, gint c)
+{
+  gint i = n * GST_AUDIO_INFO_CHANNELS (&d->info) + c;
+
+  switch (GST_AUDIO_INFO_FORMAT (&d->info)) {
+    case GST_AUDIO_FORMAT_F32:
+      return ((gfloat *) d->data->data)[i];
+    case GST_AUDIO_FORMAT_F64:
+      return ((gdouble *) d->data->data)[i];
+    case GST_AUDIO_FORMAT_S16:
+      return ((gint16 *) d->data->data)[i];
+    default:
+      g_assert_not_reached ();
+      return 0;
+  }
+}
+
+/* rounds like the element, in the precision of its float samples */
+static gint16
+to_s16 (Decoded * d, gint n, gint c)
+{
+  gdouble v;
+
+  if (GST_AUDIO_INFO_FORMAT (&d->info) == GST_AUDIO_FORMAT_F32) {
+    gfloat f = (gfloat) get_sample (d, n, c) * (gfloat) 32767;
+
+    v = f < 0 ? f - (gfloat) 0.5 : f + (gfloat) 0.5;
+  } else {
+    v = get_sample (d, n, c) * 32767;
+    v = v < 0 ? v - 0.5 : v + 0.5;
+  }
+
+  return (gint16) CLAMP (v, -32768, 32767);
+}
+
+/* mixes the decoded 3/2 @all channels down with the default mix levels */
+static void
+check_downmix (Decoded * all, Decoded * stereo, gboolean normalize)
+{
+  gdouble left, right, scale, peak = 0;
+  gint n, c;
+
+  fail_unless_equals_int (GST_AUDIO_INFO_CHANNELS (&all->info), NUM_CHANNELS);
+  fail_unless_equals_int (GST_AUDIO_INFO_CHANNELS (&stereo->info), 2);
+
+  scale = normalize ? 1 / (1 + 2 * MIX_LEVEL) : 1;
+
+  for (n = 0; n < NUM_FRAMES * FRAME_SAMPLES; n++) {
+    left = right = 0;
+    for (c = 0; c < NUM_CHANNELS; c++) {
+      gdouble v = get_sample (all, n, c);
+
+      switch (all->info.position[c]) {
+        case GST_AUDIO_CHANNEL_POSITION_FRONT_LEFT:
+          left += v;
+          break;
+        case GST_AUDIO_CHANNEL_POSITION_FRONT_RIGHT:
+          right += v;
+          break;
+        case GST_AUDIO_CHANNEL_POSITION_FRONT_CENTER:
+          left += MIX_LEVEL * v;
+          right += MIX_LEVEL * v;
+          break;
+        case GST_AUDIO_CHANNEL_POSITION_REAR_LEFT:
+          left += MIX_LEVEL * v;
+          break;
+        case GST_AUDIO_CHANNEL_POSITION_REAR_RIGHT:
+          right += MIX_LEVEL * v;
+          break;
+        default:
+          fail ("unexpected channel position %d", all->info.position[c]);
+          break;
+      }
+      peak = MAX (peak, ABS (v));
+    }
+
+    fail_unless (ABS (get_sample (stereo, n, 0) - left * scale) < 1e-5,
+        "left sample %d is %f instead of %f", n, get_sample (stereo, n, 0),
+        left * scale);
+    fail_unless (ABS (get_sample (stereo, n, 1) - right * scale) < 1e-5,
+        "right sample %d is %f instead of %f", n, get_sample (stereo, n, 1),
+        right * scale);
+  }
+
+  /* the stream must not be silent for any of this to mean something */
+  fail_unless (peak > 0.01, "peak is only %f", peak);
+}
+
+GST_START_TEST (test_downmix)
+{
+  Decoded all, stereo;
+
+  decode (setup_a52dec (FLOAT_CAPS, FALSE), &all);
+  decode (setup_a52dec (FLOAT_CAPS, TRUE), &stereo);
+  check_downmix (&all, &stereo, TRUE);
+
+  g_byte_array_unref (all.data);
+  g_byte_array_unref (stereo.data);
+}
+
+GST_END_TEST;
+
+GST_START_TEST (test_downmix_no_normalize)
+{
+  GstHarness *h;
+  Decoded all, stereo;
+
+  decode (setup_a52dec (FLOAT_CAPS, FALSE), &all);
+  h = setup_a52dec (FLOAT_CAPS, TRUE);
+  g_object_set (h->element, "normalize", FALSE, NULL);
+  decode (h, &stereo);
+  check_downmix (&all, &stereo, FALSE);
+
+  g_byte_array_unref (all.data);
+  g_byte_array_unref (stereo.data);
+}
+
+GST_END_TEST;
+
+GST_START_TEST (test_downmix_s16)
+{
+  GstHarness *h;
+  Decoded mix, s16;
+  gint n, c;
+
+  decode (setup_a52dec (FLOAT_CAPS, TRUE), &mix);
+  h = setup_a52dec (S16_CAPS, TRUE);
+  g_object_set (h->element, "dither", FALSE, NULL);
+  decode (h, &s16);
+
+  fail_unless_equals_int (GST_AUDIO_INFO_FORMAT (&s16.info),
+      GST_AUDIO_FORMAT_S16);
+  fail_unless_equals_int (GST_AUDIO_INFO_CHANNELS (&s16.info), 2);
+
+  /* without dither, the samples are just rounded */
+  for (n = 0; n < NUM_FRAMES * FRAME_SAMPLES; n++) {
+    for (c = 0; c < 2; c++)
+      fail_unless_equals_int ((gint) get_sample (&s16, n, c),
+          to_s16 (&mix, n, c));
+  }
+
+  g_byte_array_unref (mix.data);
+  g_byte_array_unref (s16.data);
+}
+
+GST_END_TEST;
+
+GST_START_TEST (test_downmix_dither)
+{
+  GstHarness *h;
+  Decoded plain, dithered;
+  gint n, c, diff, changed = 0, sum = 0;
+  const gint total = NUM_FRAMES * FRAME_SAMPLES * 2;
+
+  h = setup_a52dec (S16_CAPS, TRUE);
+  g_object_set (h->element, "dither", FALSE, NULL);
+  decode (h, &plain);
+  decode (setup_a52dec (S16_CAPS, TRUE), &dithered);
+
+  /* the triangular dither moves a sample by at most one step, a third of
+   * them on average, without a bias */
+  for (n = 0; n < NUM_FRAMES * FRAME_SAMPLES; n++) {
+    for (c = 0; c < 2; c++) {
+      diff = (gint) get_sample (&dithered, n, c) -
+          (gint) get_sample (&plain, n, c);
+      fail_unless (ABS (diff) <= 1, "sample %d moved by %d", n, diff);
+      changed += diff != 0;
+      sum += diff;
+    }
+  }
+
+  fail_unless (changed > total / 5, "only %d of %d samples dithered",
+      changed, total);
+  fail_unless (ABS (sum) < total / 50, "dither biased by %d", sum);
+
+  g_byte_array_unref (plain.data);
+  g_byte_array_unref (dithered.data);
+}
+
+GST_END_TEST;
+
+/* the size of an IEC 61937 burst of AC-3: 1536 stereo 16-bit samples */
+#define BURST_SIZE (FRAME_SAMPLES * 4)
+
+GST_START_TEST (test_passthrough)
+{
+  GstHarness *h;
+  Decoded bursts;
+  guint8 frame[FRAME_SIZE] = { 0, };
+  const guint16 *words;
+  const guint8 *burst;
+  gint i, j;
+
+  /* passthrough is picked up when the element starts */
+  h = gst_harness_new_parse ("a52dec passthrough=true");
+  gst_harness_set_caps_str (h, AC3_CAPS, FLOAT_CAPS);
+  decode (h, &bursts);
+
+  fail_unless_equals_int (GST_AUDIO_INFO_FORMAT (&bursts.info),
+      GST_AUDIO_FORMAT_S16);
+  fail_unless_equals_int (GST_AUDIO_INFO_CHANNELS (&bursts.info), 2);
+  fail_unless_equals_int (GST_AUDIO_INFO_RATE (&bursts.info), 48000);
+
+  write_frame (frame);
+  for (i = 0; i < NUM_FRAMES; i++) {
+    burst = bursts.data->data + i * BURST_SIZE;
+    words = (const guint16 *) burst;
+
+    /* the sync words Pa and Pb, Pc with the AC-3 data type and the bsmod
+     * of the frame, and Pd with the length of the frame in bits */
+    fail_unless_equals_int (words[0], 0xf872);
+    fail_unless_equals_int (words[1], 0x4e1f);
+    fail_unless_equals_int (words[2], 0x0001);
+    fail_unless_equals_int (words[3], FRAME_SIZE * 8);
+
+    /* then the frame as 16-bit words, and zeroes up to the burst size */
+    for (j = 0; j < FRAME_SIZE / 2; j++)
+      fail_unless_equals_int (words[4 + j],
+          GST_READ_UINT16_BE (frame + 2 * j));
+    for (j = 8 + FRAME_SIZE; j < BURST_SIZE; j++)
+      fail_unless_equals_int (burst[j], 0);
+  }
+
+  g_byte_array_unref (bursts.data);
+}
+
+GST_END_TEST;
+
+static Suite *
+a52dec_suite (void)
+{
+  Suite *s = suite_create ("a52dec");
+  TCase *tc_chain = tcase_create ("general");
+
+  suite_add_tcase (s, tc_chain);
+  tcase_add_test (tc_chain, test_downmix);
+  tcase_add_test (tc_chain, test_downmix_no_normalize);
+  tcase_add_test (tc_chain, test_downmix_s16);
+  tcase_add_test (tc_chain, test_downmix_dither);
+  tcase_add_test (tc_chain, test_passthrough);
+  return s;
+}
+
+GST_CHECK_MAIN (a52dec);
@@ -0,0 +1,161 @@
+/* GStreamer
+ *
+ * shared unit test code for amrnbdec and amrwbdec
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Library General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Library General Public License for more details.
+ *
+ * You should have received a copy of the GNU Library General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 51 Franklin St, Fifth Floor,
+ * Boston, MA 02110-1301, USA.
+ */
+
+#include <gst/check/gstcheck.h>
+#include <gst/check/gstharness.h>
+
+/* the decoder under test, its input caps and a single frame mode: the frame
+ * type in the header, the frame size including the header and the samples
+ * it decodes to */
+typedef struct
+{
+  const gchar *element;
+  const gchar *caps;
+  guint8 frame_type;
+  gsize frame_size;
+  guint frame_samples;
+} AmrDecFormat;
+
+#define FRAME_DURATION (20 * GST_MSECOND)
+
+#define NUM_FRAMES 10
+#define MAX_FRAMES 4
+
+static const AmrDecFormat *format;
+
+static GstHarness *
+setup_amrdec (guint max_frames)
+{
+  GstHarness *h;
+
+  h = gst_harness_new (format->element);
+  g_object_set (h->element, "max-frames", max_frames, NULL);
+  gst_harness_set_src_caps_str (h, format->caps);
+
+  return h;
+}
+
+static guint8 *
+make_stream (void)
+{
+  guint8 *data;
+  gint i;
+
+  data = g_malloc0 (NUM_FRAMES * format->frame_size);
+  for (i = 0; i < NUM_FRAMES; i++)
+    data[i * format->frame_size] = (format->frame_type << 3) | 0x04;
+
+  return data;
+}
+
+/* all frames must come out in batches of max-frames, the last one holding
+ * the rest, timestamped by the samples before them */
+static void
+check_batches (GstHarness * h)
+{
+  GstBuffer *buffer;
+  guint frames, total = 0;
+
+  fail_unless (gst_harness_push_event (h, gst_event_new_eos ()));
+
+  while ((buffer = gst_harness_try_pull (h)) != NULL) {
+    frames = MIN (MAX_FRAMES, NUM_FRAMES - total);
+
+    fail_unless_equals_int (gst_buffer_get_size (buffer),
+        frames * format->frame_samples * 2);
+    fail_unless_equals_uint64 (GST_BUFFER_PTS (buffer),
+        total * FRAME_DURATION);
+    fail_unless_equals_uint64 (GST_BUFFER_DURATION (buffer),
+        frames * FRAME_DURATION);
+
+    total += frames;
+    gst_buffer_unref (buffer);
+  }
+
+  fail_unless_equals_int (total, NUM_FRAMES);
+}
+
+GST_START_TEST (test_max_frames)
+{
+  GstHarness *h;
+  GstBuffer *buffer;
+  guint8 *data;
+  gsize frame_size = format->frame_size;
+  gint i;
+
+  h = setup_amrdec (MAX_FRAMES);
+  data = make_stream ();
+
+  for (i = 0; i < NUM_FRAMES; i++) {
+    buffer = gst_buffer_new_allocate (NULL, frame_size, NULL);
+    gst_buffer_fill (buffer, 0, data + i * frame_size, frame_size);
+    GST_BUFFER_PTS (buffer) = i * FRAME_DURATION;
+    GST_BUFFER_DURATION (buffer) = FRAME_DURATION;
+    fail_unless_equals_int (gst_harness_push (h, buffer), GST_FLOW_OK);
+  }
+  check_batches (h);
+
+  g_free (data);
+  gst_harness_teardown (h);
+}
+
+GST_END_TEST;
+
+GST_START_TEST (test_max_frames_split)
+{
+  GstHarness *h;
+  GstBuffer *buffer;
+  guint8 *data;
+  gsize offset, size, total = NUM_FRAMES * format->frame_size;
+
+  h = setup_amrdec (MAX_FRAMES);
+  data = make_stream ();
+
+  /* frames split at arbitrary points across buffers */
+  for (offset = 0; offset < total; offset += size) {
+    size = MIN (7, total - offset);
+    buffer = gst_buffer_new_allocate (NULL, size, NULL);
+    gst_buffer_fill (buffer, 0, data + offset, size);
+    if (offset == 0)
+      GST_BUFFER_PTS (buffer) = 0;
+    fail_unless_equals_int (gst_harness_push (h, buffer), GST_FLOW_OK);
+  }
+  check_batches (h);
+
+  g_free (data);
+  gst_harness_teardown (h);
+}
+
+GST_END_TEST;
+
+/* a suite named after the decoder running the tests above on @fmt */
+static Suite *
+amrdec_suite_new (const AmrDecFormat * fmt)
+{
+  Suite *s = suite_create (fmt->element);
+  TCase *tc_chain = tcase_create ("general");
+
+  format = fmt;
+
+  suite_add_tcase (s, tc_chain);
+  tcase_add_test (tc_chain, test_max_frames);
+  tcase_add_test (tc_chain, test_max_frames_split);
+  return s;
+}
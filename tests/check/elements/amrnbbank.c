@@ -0,0 +1,280 @@
+/* GStreamer
+ *
+ * unit test for amrnbbankenc and amrnbbankdec
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Library General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Library General Public License for more details.
+ *
+ * You should have received a copy of the GNU Library General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 51 Franklin St, Fifth Floor,
+ * Boston, MA 02110-1301, USA.
+ */
+
+#include <gst/check/gstcheck.h>
+#include <gst/check/gstharness.h>
+#include <gst/audio/audio.h>
+
+#define RAW_CAPS "audio/x-raw, format = (string)" GST_AUDIO_NE (S16) ", " \
+    "channels = (int) 4, channel-mask = (bitmask) 0, rate = (int) 8000"
+#define AMR_CAPS "audio/AMR, channels = (int) 4, rate = (int) 8000"
+
+/* size of an MR122 frame including its header */
+#define FRAME_SIZE 32
+
+GstPad *srcpad, *sinkpad;
+
+static GstStaticPadTemplate sinktemplate = GST_STATIC_PAD_TEMPLATE ("sink",
+    GST_PAD_SINK,
+    GST_PAD_ALWAYS,
+    GST_STATIC_CAPS_ANY);
+
+static GstStaticPadTemplate srctemplate = GST_STATIC_PAD_TEMPLATE ("src",
+    GST_PAD_SRC,
+    GST_PAD_ALWAYS,
+    GST_STATIC_CAPS_ANY);
+
+static GstElement *
+setup_bank (const gchar * factory, const gchar * caps_str)
+{
+  GstElement *bank;
+  GstCaps *caps;
+
+  GST_DEBUG ("setup_bank");
+
+  bank = gst_check_setup_element (factory);
+  srcpad = gst_check_setup_src_pad (bank, &srctemplate);
+  sinkpad = gst_check_setup_sink_pad (bank, &sinktemplate);
+  gst_pad_set_active (srcpad, TRUE);
+  gst_pad_set_active (sinkpad, TRUE);
+
+  fail_unless (gst_element_set_state (bank,
+          GST_STATE_PLAYING) != GST_STATE_CHANGE_FAILURE,
+      "could not set to playing");
+
+  caps = gst_caps_from_string (caps_str);
+  gst_check_setup_events (srcpad, bank, caps, GST_FORMAT_TIME);
+  gst_caps_unref (caps);
+
+  return bank;
+}
+
+static void
+cleanup_bank (GstElement * bank)
+{
+  GST_DEBUG ("cleanup_bank");
+
+  gst_check_drop_buffers ();
+  gst_pad_set_active (srcpad, FALSE);
+  gst_pad_set_active (sinkpad, FALSE);
+  gst_check_teardown_src_pad (bank);
+  gst_check_teardown_sink_pad (bank);
+  gst_check_teardown_element (bank);
+}
+
+/* push a silent block of audio of the given size */
+static void
+push_data (gint size)
+{
+  GstBuffer *buffer;
+
+  buffer = gst_buffer_new_and_alloc (size);
+  gst_buffer_memset (buffer, 0, 0, size);
+
+  fail_unless_equals_int (gst_pad_push (srcpad, buffer), GST_FLOW_OK);
+}
+
+static void
+check_buffers (guint count, gsize size)
+{
+  GList *l;
+
+  fail_unless_equals_int (g_list_length (buffers), count);
+  for (l = buffers; l; l = l->next)
+    fail_unless_equals_int (gst_buffer_get_size (l->data), size);
+}
+
+GST_START_TEST (test_enc_interleaved)
+{
+  GstElement *bank;
+
+  bank = setup_bank ("amrnbbankenc", RAW_CAPS
+      ", layout = (string) interleaved");
+
+  /* one frame block per tick, split across input buffers */
+  push_data (100 * 4 * 2);
+  push_data (380 * 4 * 2);
+  check_buffers (3, 4 * FRAME_SIZE);
+
+  cleanup_bank (bank);
+}
+
+GST_END_TEST;
+
+GST_START_TEST (test_enc_non_interleaved)
+{
+  GstElement *bank;
+
+  bank = setup_bank ("amrnbbankenc", RAW_CAPS
+      ", layout = (string) non-interleaved");
+
+  push_data (160 * 4 * 2);
+  push_data (160 * 4 * 2);
+  check_buffers (2, 4 * FRAME_SIZE);
+
+  cleanup_bank (bank);
+}
+
+GST_END_TEST;
+
+GST_START_TEST (test_dec)
+{
+  GstElement *bank;
+  GstBuffer *buffer;
+  guint8 *data;
+  gint i;
+
+  bank = setup_bank ("amrnbbankdec", AMR_CAPS);
+
+  /* four NO_DATA frames and then four MR122 frames make two blocks */
+  data = g_malloc0 (4 + 4 * FRAME_SIZE);
+  for (i = 0; i < 4; i++) {
+    data[i] = 15 << 3;
+    data[4 + i * FRAME_SIZE] = (7 << 3) | 0x04;
+  }
+  buffer = gst_buffer_new_wrapped (data, 4 + 4 * FRAME_SIZE);
+
+  fail_unless_equals_int (gst_pad_push (srcpad, buffer), GST_FLOW_OK);
+  check_buffers (2, 4 * 160 * 2);
+
+  cleanup_bank (bank);
+}
+
+GST_END_TEST;
+
+/* enough channels for the bank to split them across several threads */
+#define MANY_CHANNELS 32
+#define MANY_BLOCKS 10
+
+/* runs data through a bank element with the given number of threads and
+ * returns everything it outputs */
+static GByteArray *
+run_bank (const gchar * factory, const gchar * caps, gint threads,
+    GBytes * data)
+{
+  GstElement *bank;
+  GstHarness *h;
+  GstBuffer *buffer;
+  GstMapInfo map;
+  GByteArray *out;
+
+  bank = gst_element_factory_make (factory, NULL);
+  fail_unless (bank != NULL);
+  g_object_set (bank, "threads", threads, NULL);
+
+  h = gst_harness_new_with_element (bank, "sink", "src");
+  gst_harness_set_src_caps_str (h, caps);
+
+  buffer = gst_buffer_new_wrapped_bytes (data);
+  fail_unless_equals_int (gst_harness_push (h, buffer), GST_FLOW_OK);
+  fail_unless (gst_harness_push_event (h, gst_event_new_eos ()));
+
+  out = g_byte_array_new ();
+  while ((buffer = gst_harness_try_pull (h)) != NULL) {
+    gst_buffer_map (buffer, &map, GST_MAP_READ);
+    g_byte_array_append (out, map.data, map.size);
+    gst_buffer_unmap (buffer, &map);
+    gst_buffer_unref (buffer);
+  }
+
+  gst_harness_teardown (h);
+  gst_object_unref (bank);
+
+  return out;
+}
+
+static void
+assert_same_output (GByteArray * serial, GByteArray * parallel)
+{
+  fail_unless (serial->len > 0);
+  fail_unless_equals_int (parallel->len, serial->len);
+  fail_unless (memcmp (parallel->data, serial->data, serial->len) == 0);
+}
+
+GST_START_TEST (test_threads)
+{
+  GByteArray *serial, *parallel, *decoded_serial, *decoded_parallel;
+  GBytes *raw, *amr;
+  gint16 *samples;
+  gchar *raw_caps, *amr_caps;
+  guint i, channel, n_samples;
+
+  raw_caps = g_strdup_printf ("audio/x-raw, format = (string) "
+      GST_AUDIO_NE (S16) ", layout = (string) interleaved, "
+      "channels = (int) %d, channel-mask = (bitmask) 0, rate = (int) 8000",
+      MANY_CHANNELS);
+  amr_caps = g_strdup_printf ("audio/AMR, channels = (int) %d, "
+      "rate = (int) 8000", MANY_CHANNELS);
+
+  /* a triangle wave of a different period on every channel */
+  n_samples = MANY_BLOCKS * 160;
+  samples = g_new (gint16, n_samples * MANY_CHANNELS);
+  for (i = 0; i < n_samples; i++) {
+    for (channel = 0; channel < MANY_CHANNELS; channel++) {
+      guint period = 20 + channel * 3;
+      gint pos = (i % period) * 16000 / period;
+
+      samples[i * MANY_CHANNELS + channel] =
+          pos < 8000 ? pos - 4000 : 12000 - pos;
+    }
+  }
+  raw = g_bytes_new_take (samples, n_samples * MANY_CHANNELS * 2);
+
+  /* the channels encoded on the pool must give the same frames as when
+   * encoded one after the other */
+  serial = run_bank ("amrnbbankenc", raw_caps, 1, g_bytes_ref (raw));
+  parallel = run_bank ("amrnbbankenc", raw_caps, 4, g_bytes_ref (raw));
+  assert_same_output (serial, parallel);
+  fail_unless_equals_int (serial->len, MANY_BLOCKS * MANY_CHANNELS *
+      FRAME_SIZE);
+
+  /* and the same for decoding them again */
+  amr = g_byte_array_free_to_bytes (serial);
+  decoded_serial = run_bank ("amrnbbankdec", amr_caps, 1, g_bytes_ref (amr));
+  decoded_parallel = run_bank ("amrnbbankdec", amr_caps, 4, g_bytes_ref (amr));
+  assert_same_output (decoded_serial, decoded_parallel);
+  fail_unless_equals_int (decoded_serial->len, n_samples * MANY_CHANNELS * 2);
+
+  g_byte_array_unref (parallel);
+  g_byte_array_unref (decoded_serial);
+  g_byte_array_unref (decoded_parallel);
+  g_bytes_unref (amr);
+  g_bytes_unref (raw);
+  g_free (raw_caps);
+  g_free (amr_caps);
+}
+
+GST_END_TEST;
+
+static Suite *
+amrnbbank_suite (void)
+{
+  Suite *s = suite_create ("amrnbbank");
+  TCase *tc_chain = tcase_create ("general");
+
+  suite_add_tcase (s, tc_chain);
+  tcase_add_test (tc_chain, test_enc_interleaved);
+  tcase_add_test (tc_chain, test_enc_non_interleaved);
+  tcase_add_test (tc_chain, test_dec);
+  tcase_add_test (tc_chain, test_threads);
+  return s;
+}
+
+GST_CHECK_MAIN (amrnbbank);
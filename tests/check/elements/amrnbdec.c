@@ -0,0 +1,36 @@
+/* GStreamer
+ *
+ * unit test for amrnbdec
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Library General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Library General Public License for more details.
+ *
+ * You should have received a copy of the GNU Library General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 51 Franklin St, Fifth Floor,
+ * Boston, MA 02110-1301, USA.
+ */
+
+#include "amrdec_common.h"
+
+/* IF1 MR122 frames of 32 bytes including the header, 160 samples each */
+static const AmrDecFormat amrnb_format = {
+  "amrnbdec",
+  "audio/AMR, rate = (int) 8000, channels = (int) 1",
+  7, 32, 160
+};
+
+static Suite *
+amrnbdec_suite (void)
+{
+  return amrdec_suite_new (&amrnb_format);
+}
+
+GST_CHECK_MAIN (amrnbdec);
@@ -0,0 +1,36 @@
+/* GStreamer
+ *
+ * unit test for amrwbdec
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Library General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Library General Public License for more details.
+ *
+ * You should have received a copy of the GNU Library General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 51 Franklin St, Fifth Floor,
+ * Boston, MA 02110-1301, USA.
+ */
+
+#include "amrdec_common.h"
+
+/* 23.85 kbit/s frames of 61 bytes including the header, 320 samples each */
+static const AmrDecFormat amrwb_format = {
+  "amrwbdec",
+  "audio/AMR-WB, rate = (int) 16000, channels = (int) 1",
+  8, 61, 320
+};
+
+static Suite *
+amrwbdec_suite (void)
+{
+  return amrdec_suite_new (&amrwb_format);
+}
+
+GST_CHECK_MAIN (amrwbdec);
@@ -0,0 +1,714 @@
+/* GStreamer
+ *
+ * unit test for asfdemux
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Library General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Library General Public License for more details.
+ *
+ * You should have received a copy of the GNU Library General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 51 Franklin St, Fifth Floor,
+ * Boston, MA 02110-1301, USA.
+ */
+
+#include <gst/check/gstcheck.h>
+
+#define PACKET_SIZE 256
+#define STREAM_ID 1
+
+/* the indexed file has one frame per packet */
+#define NUM_FRAMES 40
+#define FRAME_SIZE 64
+#define FRAME_MS 100
+#define KEYFRAME_DISTANCE 10
+#define INDEX_INTERVAL_MS 500
+
+static const guint32 header_guid[] =
+    { 0x75B22630, 0x11CF668E, 0xAA00D9A6, 0x6CCE6200 };
+static const guint32 data_guid[] =
+    { 0x75B22636, 0x11CF668E, 0xAA00D9A6, 0x6CCE6200 };
+static const guint32 file_guid[] =
+    { 0x8CABDCA1, 0x11CFA947, 0xC000E48E, 0x6553200C };
+static const guint32 stream_guid[] =
+    { 0xB7DC0791, 0x11CFA9B7, 0xC000E68E, 0x6553200C };
+static const guint32 video_guid[] =
+    { 0xBC19EFC0, 0x11CF5B4D, 0x8000FDA8, 0x2B445C5F };
+static const guint32 correction_off_guid[] =
+    { 0x20FB5700, 0x11CF5B55, 0x8000FDA8, 0x2B445C5F };
+static const guint32 simple_index_guid[] =
+    { 0x33000890, 0x11CFE5B1, 0xA000F489, 0xCB4903C9 };
+
+static GstStaticPadTemplate srctemplate = GST_STATIC_PAD_TEMPLATE ("src",
+    GST_PAD_SRC,
+    GST_PAD_ALWAYS,
+    GST_STATIC_CAPS ("video/x-ms-asf"));
+
+static GstPad *mysrcpad;
+static GList *mysinkpads;
+static GBytes *file_data;
+static gsize chunk_size;
+static gboolean have_eos;
+
+static void
+put_uint8 (GByteArray * a, guint8 val)
+{
+  g_byte_array_append (a, &val, 1);
+}
+
+static void
+put_uint16 (GByteArray * a, guint16 val)
+{
+  guint8 b[2];
+
+  GST_WRITE_UINT16_LE (b, val);
+  g_byte_array_append (a, b, 2);
+}
+
+static void
+put_uint32 (GByteArray * a, guint32 val)
+{
+  guint8 b[4];
+
+  GST_WRITE_UINT32_LE (b, val);
+  g_byte_array_append (a, b, 4);
+}
+
+static void
+put_uint64 (GByteArray * a, guint64 val)
+{
+  guint8 b[8];
+
+  GST_WRITE_UINT64_LE (b, val);
+  g_byte_array_append (a, b, 8);
+}
+
+static void
+put_zeros (GByteArray * a, guint len)
+{
+  while (len--)
+    put_uint8 (a, 0);
+}
+
+static void
+put_guid (GByteArray * a, const guint32 guid[4])
+{
+  guint i;
+
+  for (i = 0; i < 4; i++)
+    put_uint32 (a, guid[i]);
+}
+
+/* starts an object, its size is filled in by end_object() */
+static guint
+begin_object (GByteArray * a, const guint32 guid[4])
+{
+  guint start = a->len;
+
+  put_guid (a, guid);
+  put_uint64 (a, 0);
+
+  return start;
+}
+
+static void
+end_object (GByteArray * a, guint start)
+{
+  GST_WRITE_UINT64_LE (a->data + start + 16, a->len - start);
+}
+
+/* the header object of a seekable file with one WMV2 video stream and the
+ * start of the data object for @num_packets packets; returns the offset
+ * of the data object */
+static guint
+put_file_start (GByteArray * a, guint num_packets, guint duration_ms)
+{
+  guint header, obj, data;
+
+  header = begin_object (a, header_guid);
+  put_uint32 (a, 2);
+  put_uint8 (a, 0x01);
+  put_uint8 (a, 0x02);
+
+  obj = begin_object (a, file_guid);
+  put_zeros (a, 16);            /* file id */
+  put_uint64 (a, 0);            /* file size */
+  put_uint64 (a, 0);            /* creation date */
+  put_uint64 (a, num_packets);
+  put_uint64 (a, duration_ms * G_GUINT64_CONSTANT (10000));     /* play */
+  put_uint64 (a, duration_ms * G_GUINT64_CONSTANT (10000));     /* send */
+  put_uint64 (a, 0);            /* preroll */
+  put_uint32 (a, 0x02);         /* seekable */
+  put_uint32 (a, PACKET_SIZE);
+  put_uint32 (a, PACKET_SIZE);
+  put_uint32 (a, 1000000);
+  end_object (a, obj);
+
+  obj = begin_object (a, stream_guid);
+  put_guid (a, video_guid);
+  put_guid (a, correction_off_guid);
+  put_uint64 (a, 0);            /* time offset */
+  put_uint32 (a, 11 + 40);      /* type specific data length */
+  put_uint32 (a, 0);            /* error correction data length */
+  put_uint16 (a, STREAM_ID);
+  put_uint32 (a, 0);
+  /* video media type, a BITMAPINFOHEADER without extradata follows */
+  put_uint32 (a, 320);
+  put_uint32 (a, 240);
+  put_uint8 (a, 0x02);
+  put_uint16 (a, 40);
+  put_uint32 (a, 40);
+  put_uint32 (a, 320);
+  put_uint32 (a, 240);
+  put_uint16 (a, 1);
+  put_uint16 (a, 24);
+  put_uint32 (a, GST_MAKE_FOURCC ('W', 'M', 'V', '2'));
+  put_uint32 (a, 320 * 240 * 3);
+  put_zeros (a, 4 * 4);
+  end_object (a, obj);
+
+  end_object (a, header);
+
+  data = begin_object (a, data_guid);
+  put_zeros (a, 16);            /* file id */
+  put_uint64 (a, num_packets);
+  put_uint16 (a, 0x0101);
+
+  return data;
+}
+
+typedef struct
+{
+  guint start;
+  guint padding_pos;
+  guint flags_pos;
+  gboolean multiple;
+  guint n_payloads;
+} Packet;
+
+/* a packet with error correction data, a WORD padding length and BYTE
+ * replicated data length, DWORD media object offset, BYTE media object
+ * number and BYTE stream number fields */
+static void
+begin_packet (GByteArray * a, Packet * p, guint send_time, gboolean multiple)
+{
+  p->start = a->len;
+  p->multiple = multiple;
+  p->n_payloads = 0;
+
+  put_uint8 (a, 0x82);
+  put_uint16 (a, 0);
+  put_uint8 (a, 0x10 | (multiple ? 0x01 : 0x00));
+  put_uint8 (a, 0x5d);
+  p->padding_pos = a->len;
+  put_uint16 (a, 0);
+  put_uint32 (a, send_time);
+  put_uint16 (a, 0);            /* duration */
+
+  /* the payload count, with WORD payload lengths */
+  if (multiple) {
+    p->flags_pos = a->len;
+    put_uint8 (a, 0x80);
+  }
+}
+
+static void
+end_packet (GByteArray * a, Packet * p)
+{
+  guint len = a->len - p->start;
+
+  fail_unless (len <= PACKET_SIZE);
+
+  GST_WRITE_UINT16_LE (a->data + p->padding_pos, PACKET_SIZE - len);
+  if (p->multiple)
+    a->data[p->flags_pos] |= p->n_payloads;
+
+  put_zeros (a, PACKET_SIZE - len);
+}
+
+static guint8
+object_byte (guint mo_number, guint offset)
+{
+  return (mo_number * 37 + offset) & 0xff;
+}
+
+/* @len bytes of media object @mo_number from @mo_offset */
+static void
+put_payload (GByteArray * a, Packet * p, gboolean keyframe, guint mo_number,
+    guint mo_offset, guint mo_size, guint pts, guint len)
+{
+  guint i;
+
+  put_uint8 (a, (keyframe ? 0x80 : 0x00) | STREAM_ID);
+  put_uint8 (a, mo_number);
+  put_uint32 (a, mo_offset);
+  put_uint8 (a, 8);
+  put_uint32 (a, mo_size);
+  put_uint32 (a, pts);
+  if (p->multiple)
+    put_uint16 (a, len);
+
+  for (i = 0; i < len; i++)
+    put_uint8 (a, object_byte (mo_number, mo_offset + i));
+
+  p->n_payloads++;
+}
+
+/* @n_sub media objects of @sub_len bytes from @mo_number on, @delta ms
+ * apart; the media object offset field carries the pts */
+static void
+put_compressed_payload (GByteArray * a, Packet * p, guint mo_number,
+    guint pts, guint delta, guint n_sub, guint sub_len)
+{
+  guint n, i;
+
+  put_uint8 (a, 0x80 | STREAM_ID);
+  put_uint8 (a, mo_number);
+  put_uint32 (a, pts);
+  put_uint8 (a, 1);
+  put_uint8 (a, delta);
+  if (p->multiple)
+    put_uint16 (a, n_sub * (1 + sub_len));
+
+  for (n = 0; n < n_sub; n++) {
+    put_uint8 (a, sub_len);
+    for (i = 0; i < sub_len; i++)
+      put_uint8 (a, object_byte (mo_number + n, i));
+  }
+
+  p->n_payloads++;
+}
+
+static GstFlowReturn
+src_getrange (GstPad * pad, GstObject * parent, guint64 offset, guint length,
+    GstBuffer ** buffer)
+{
+  gsize size;
+  gconstpointer data;
+  GstBuffer *buf;
+  guint64 end, split;
+
+  data = g_bytes_get_data (file_data, &size);
+  if (offset >= size)
+    return GST_FLOW_EOS;
+
+  /* hand out the file in memories of chunk_size bytes, if set */
+  end = MIN (offset + length, size);
+  buf = gst_buffer_new ();
+  while (offset < end) {
+    if (chunk_size > 0)
+      split = MIN (end, (offset / chunk_size + 1) * chunk_size);
+    else
+      split = end;
+
+    gst_buffer_append_memory (buf,
+        gst_memory_new_wrapped (GST_MEMORY_FLAG_READONLY, (gpointer) data,
+            size, offset, split - offset, g_bytes_ref (file_data),
+            (GDestroyNotify) g_bytes_unref));
+    offset = split;
+  }
+
+  *buffer = buf;
+  return GST_FLOW_OK;
+}
+
+static gboolean
+src_query (GstPad * pad, GstObject * parent, GstQuery * query)
+{
+  if (GST_QUERY_TYPE (query) == GST_QUERY_SCHEDULING) {
+    gst_query_set_scheduling (query, GST_SCHEDULING_FLAG_SEEKABLE, 1, -1, 0);
+    gst_query_add_scheduling_mode (query, GST_PAD_MODE_PULL);
+    return TRUE;
+  }
+
+  return gst_pad_query_default (pad, parent, query);
+}
+
+/* make asfdemux handle seeks itself */
+static gboolean
+src_event (GstPad * pad, GstObject * parent, GstEvent * event)
+{
+  gboolean res = GST_EVENT_TYPE (event) != GST_EVENT_SEEK;
+
+  gst_event_unref (event);
+  return res;
+}
+
+static gboolean
+sink_event (GstPad * pad, GstObject * parent, GstEvent * event)
+{
+  if (GST_EVENT_TYPE (event) == GST_EVENT_EOS) {
+    g_mutex_lock (&check_mutex);
+    have_eos = TRUE;
+    g_cond_broadcast (&check_cond);
+    g_mutex_unlock (&check_mutex);
+  }
+
+  gst_event_unref (event);
+  return TRUE;
+}
+
+static void
+pad_added_cb (GstElement * demux, GstPad * pad, gpointer user_data)
+{
+  GstPad *sinkpad;
+
+  sinkpad = gst_pad_new ("sink", GST_PAD_SINK);
+  gst_pad_set_chain_function (sinkpad, gst_check_chain_func);
+  gst_pad_set_event_function (sinkpad, sink_event);
+  gst_pad_set_active (sinkpad, TRUE);
+  g_assert (gst_pad_link (pad, sinkpad) == GST_PAD_LINK_OK);
+
+  mysinkpads = g_list_append (mysinkpads, sinkpad);
+}
+
+/* asfdemux pulling @file from a source that splits it into memories of
+ * @chunk bytes, or not at all if 0; takes ownership of @file */
+static GstElement *
+setup_asfdemux (GBytes * file, gsize chunk)
+{
+  GstElement *demux;
+  GstPad *sinkpad;
+
+  file_data = file;
+  chunk_size = chunk;
+  have_eos = FALSE;
+
+  demux = gst_check_setup_element ("asfdemux");
+  g_signal_connect (demux, "pad-added", G_CALLBACK (pad_added_cb), NULL);
+
+  mysrcpad = gst_pad_new_from_static_template (&srctemplate, "src");
+  gst_pad_set_getrange_function (mysrcpad, src_getrange);
+  gst_pad_set_query_function (mysrcpad, src_query);
+  gst_pad_set_event_function (mysrcpad, src_event);
+
+  sinkpad = gst_element_get_static_pad (demux, "sink");
+  fail_unless_equals_int (gst_pad_link (mysrcpad, sinkpad), GST_PAD_LINK_OK);
+  gst_object_unref (sinkpad);
+
+  return demux;
+}
+
+static void
+cleanup_asfdemux (GstElement * demux)
+{
+  GstPad *sinkpad;
+
+  fail_unless_equals_int (gst_element_set_state (demux, GST_STATE_NULL),
+      GST_STATE_CHANGE_SUCCESS);
+
+  sinkpad = gst_element_get_static_pad (demux, "sink");
+  gst_pad_unlink (mysrcpad, sinkpad);
+  gst_object_unref (sinkpad);
+  gst_object_unref (mysrcpad);
+  mysrcpad = NULL;
+
+  g_list_free_full (mysinkpads, (GDestroyNotify) gst_object_unref);
+  mysinkpads = NULL;
+
+  gst_check_drop_buffers ();
+  gst_check_teardown_element (demux);
+
+  g_bytes_unref (file_data);
+  file_data = NULL;
+}
+
+static void
+wait_for_eos (void)
+{
+  g_mutex_lock (&check_mutex);
+  while (!have_eos)
+    g_cond_wait (&check_cond, &check_mutex);
+  g_mutex_unlock (&check_mutex);
+}
+
+/* plays @file to the end and returns the pushed buffers */
+static GList *
+demux_file (GBytes * file, gsize chunk)
+{
+  GstElement *demux;
+  GList *result;
+
+  demux = setup_asfdemux (file, chunk);
+  fail_unless (gst_element_set_state (demux, GST_STATE_PLAYING) !=
+      GST_STATE_CHANGE_FAILURE);
+  wait_for_eos ();
+
+  result = buffers;
+  buffers = NULL;
+  cleanup_asfdemux (demux);
+
+  return result;
+}
+
+/* a fragmented media object, a compressed payload and plain payloads */
+static GBytes *
+make_payloads_file (void)
+{
+  GByteArray *a = g_byte_array_new ();
+  Packet p;
+  guint data;
+
+  data = put_file_start (a, 3, 600);
+
+  begin_packet (a, &p, 0, TRUE);
+  put_payload (a, &p, TRUE, 0, 0, 100, 0, 100);
+  put_payload (a, &p, FALSE, 1, 0, 250, 100, 100);
+  end_packet (a, &p);
+
+  begin_packet (a, &p, 100, TRUE);
+  put_payload (a, &p, FALSE, 1, 100, 250, 100, 150);
+  put_compressed_payload (a, &p, 2, 200, 100, 3, 15);
+  end_packet (a, &p);
+
+  begin_packet (a, &p, 500, FALSE);
+  put_payload (a, &p, TRUE, 5, 0, 120, 500, 120);
+  end_packet (a, &p);
+
+  end_object (a, data);
+
+  return g_byte_array_free_to_bytes (a);
+}
+
+static void
+check_media_object (GstBuffer * buf, guint mo_number, guint size,
+    GstClockTime pts, gboolean keyframe)
+{
+  GstMapInfo map;
+  guint i;
+
+  fail_unless_equals_int (gst_buffer_get_size (buf), size);
+  fail_unless_equals_uint64 (GST_BUFFER_PTS (buf), pts);
+  fail_unless_equals_int (GST_BUFFER_FLAG_IS_SET (buf,
+          GST_BUFFER_FLAG_DELTA_UNIT), !keyframe);
+
+  gst_buffer_map (buf, &map, GST_MAP_READ);
+  for (i = 0; i < size; i++)
+    fail_unless_equals_int (map.data[i], object_byte (mo_number, i));
+  gst_buffer_unmap (buf, &map);
+}
+
+GST_START_TEST (test_payloads_multiple_memories)
+{
+  static const gsize chunks[] = { 23, 61 };
+  GList *expected, *l, *m;
+  guint i;
+
+  /* every media object in one memory */
+  expected = demux_file (make_payloads_file (), 0);
+  fail_unless_equals_int (g_list_length (expected), 6);
+
+  check_media_object (expected->data, 0, 100, 0, TRUE);
+  check_media_object (g_list_nth_data (expected, 1), 1, 250,
+      100 * GST_MSECOND, FALSE);
+  check_media_object (g_list_nth_data (expected, 2), 2, 15,
+      200 * GST_MSECOND, TRUE);
+  check_media_object (g_list_nth_data (expected, 3), 3, 15,
+      300 * GST_MSECOND, TRUE);
+  check_media_object (g_list_nth_data (expected, 4), 4, 15,
+      400 * GST_MSECOND, TRUE);
+  check_media_object (g_list_nth_data (expected, 5), 5, 120,
+      500 * GST_MSECOND, TRUE);
+
+  /* packets split across memories must give the same payloads */
+  for (i = 0; i < G_N_ELEMENTS (chunks); i++) {
+    GList *result;
+
+    result = demux_file (make_payloads_file (), chunks[i]);
+    fail_unless_equals_int (g_list_length (result),
+        g_list_length (expected));
+
+    /* unfragmented media objects are sub-buffers of the packet */
+    fail_unless (gst_buffer_n_memory (result->data) > 1);
+
+    for (l = result, m = expected; l != NULL; l = l->next, m = m->next) {
+      GstBuffer *buf = l->data, *ref = m->data;
+      GstMapInfo map;
+
+      fail_unless_equals_uint64 (GST_BUFFER_PTS (buf), GST_BUFFER_PTS (ref));
+      fail_unless_equals_int (GST_BUFFER_FLAG_IS_SET (buf,
+              GST_BUFFER_FLAG_DELTA_UNIT),
+          GST_BUFFER_FLAG_IS_SET (ref, GST_BUFFER_FLAG_DELTA_UNIT));
+
+      gst_buffer_map (ref, &map, GST_MAP_READ);
+      fail_unless_equals_int (gst_buffer_get_size (buf), map.size);
+      fail_unless (gst_buffer_memcmp (buf, 0, map.data, map.size) == 0);
+      gst_buffer_unmap (ref, &map);
+    }
+
+    g_list_free_full (result, (GDestroyNotify) gst_buffer_unref);
+  }
+
+  g_list_free_full (expected, (GDestroyNotify) gst_buffer_unref);
+}
+
+GST_END_TEST;
+
+/* a payload without a duration, followed by media objects of 100 ms */
+static GBytes *
+make_durations_file (void)
+{
+  GByteArray *a = g_byte_array_new ();
+  Packet p;
+  guint data;
+
+  data = put_file_start (a, 1, 400);
+
+  begin_packet (a, &p, 0, TRUE);
+  put_payload (a, &p, TRUE, 0, 0, 100, 0, 100);
+  put_compressed_payload (a, &p, 1, 100, 100, 3, 15);
+  end_packet (a, &p);
+
+  end_object (a, data);
+
+  return g_byte_array_free_to_bytes (a);
+}
+
+GST_START_TEST (test_position_forward)
+{
+  GstElement *demux;
+  gint64 pos;
+
+  demux = setup_asfdemux (make_durations_file (), 0);
+  fail_unless (gst_element_set_state (demux, GST_STATE_PLAYING) !=
+      GST_STATE_CHANGE_FAILURE);
+  wait_for_eos ();
+  fail_unless_equals_int (g_list_length (buffers), 4);
+
+  /* the end of the last media object, which starts at 300 ms */
+  fail_unless (gst_pad_peer_query_position (mysinkpads->data,
+          GST_FORMAT_TIME, &pos));
+  fail_unless_equals_uint64 (pos, 400 * GST_MSECOND);
+
+  cleanup_asfdemux (demux);
+}
+
+GST_END_TEST;
+
+/* keyframes every KEYFRAME_DISTANCE frames and a simple index pointing at
+ * the packet of the last keyframe for each interval */
+static GBytes *
+make_indexed_file (void)
+{
+  GByteArray *a = g_byte_array_new ();
+  Packet p;
+  guint data, obj, i, n_entries;
+
+  data = put_file_start (a, NUM_FRAMES, NUM_FRAMES * FRAME_MS);
+
+  for (i = 0; i < NUM_FRAMES; i++) {
+    begin_packet (a, &p, i * FRAME_MS, FALSE);
+    put_payload (a, &p, i % KEYFRAME_DISTANCE == 0, i, 0, FRAME_SIZE,
+        i * FRAME_MS, FRAME_SIZE);
+    end_packet (a, &p);
+  }
+
+  end_object (a, data);
+
+  n_entries = NUM_FRAMES * FRAME_MS / INDEX_INTERVAL_MS;
+  obj = begin_object (a, simple_index_guid);
+  put_zeros (a, 16);            /* file id */
+  put_uint64 (a, INDEX_INTERVAL_MS * G_GUINT64_CONSTANT (10000));
+  put_uint32 (a, 1);            /* maximum packet count */
+  put_uint32 (a, n_entries);
+  for (i = 0; i < n_entries; i++) {
+    guint frame = i * INDEX_INTERVAL_MS / FRAME_MS;
+
+    put_uint32 (a, frame - frame % KEYFRAME_DISTANCE);
+    put_uint16 (a, 1);
+  }
+  end_object (a, obj);
+
+  return g_byte_array_free_to_bytes (a);
+}
+
+/* plays the indexed file, then does a key unit trick mode seek and checks
+ * that only the keyframes at @expected ms are pushed, in that order, and
+ * where the position ends up */
+static void
+check_key_unit_trickmode (gdouble rate, GstClockTime start,
+    GstClockTime stop, const guint * expected, guint n_expected,
+    GstClockTime position)
+{
+  GstElement *demux;
+  GstEvent *seek;
+  GList *l;
+  gint64 pos;
+  guint i;
+
+  demux = setup_asfdemux (make_indexed_file (), 0);
+  fail_unless (gst_element_set_state (demux, GST_STATE_PLAYING) !=
+      GST_STATE_CHANGE_FAILURE);
+  wait_for_eos ();
+  fail_unless_equals_int (g_list_length (buffers), NUM_FRAMES);
+
+  gst_check_drop_buffers ();
+  g_mutex_lock (&check_mutex);
+  have_eos = FALSE;
+  g_mutex_unlock (&check_mutex);
+
+  seek = gst_event_new_seek (rate, GST_FORMAT_TIME,
+      GST_SEEK_FLAG_FLUSH | GST_SEEK_FLAG_TRICKMODE |
+      GST_SEEK_FLAG_TRICKMODE_KEY_UNITS, GST_SEEK_TYPE_SET, start,
+      GST_SEEK_TYPE_SET, stop);
+  fail_unless (gst_element_send_event (demux, seek));
+  wait_for_eos ();
+
+  fail_unless_equals_int (g_list_length (buffers), n_expected);
+  for (l = buffers, i = 0; l != NULL; l = l->next, i++) {
+    GstBuffer *buf = l->data;
+
+    check_media_object (buf, expected[i] / FRAME_MS, FRAME_SIZE,
+        expected[i] * GST_MSECOND, TRUE);
+    fail_unless (GST_BUFFER_FLAG_IS_SET (buf, GST_BUFFER_FLAG_DISCONT));
+  }
+
+  fail_unless (gst_pad_peer_query_position (mysinkpads->data,
+          GST_FORMAT_TIME, &pos));
+  fail_unless_equals_uint64 (pos, position);
+
+  cleanup_asfdemux (demux);
+}
+
+GST_START_TEST (test_key_unit_trickmode_forward)
+{
+  static const guint expected[] = { 1000, 2000 };
+
+  check_key_unit_trickmode (2.0, 1 * GST_SECOND, 2500 * GST_MSECOND,
+      expected, G_N_ELEMENTS (expected), 2 * GST_SECOND);
+}
+
+GST_END_TEST;
+
+GST_START_TEST (test_key_unit_trickmode_reverse)
+{
+  static const guint expected[] = { 3000, 2000, 1000 };
+
+  check_key_unit_trickmode (-2.0, 1 * GST_SECOND, 3200 * GST_MSECOND,
+      expected, G_N_ELEMENTS (expected), 1 * GST_SECOND);
+}
+
+GST_END_TEST;
+
+static Suite *
+asfdemux_suite (void)
+{
+  Suite *s = suite_create ("asfdemux");
+  TCase *tc_chain = tcase_create ("general");
+
+  suite_add_tcase (s, tc_chain);
+  tcase_add_test (tc_chain, test_payloads_multiple_memories);
+  tcase_add_test (tc_chain, test_position_forward);
+  tcase_add_test (tc_chain, test_key_unit_trickmode_forward);
+  tcase_add_test (tc_chain, test_key_unit_trickmode_reverse);
+
+  return s;
+}
+
+GST_CHECK_MAIN (asfdemux);
@@ -0,0 +1,252 @@
+/* GStreamer
+ *
+ * unit test for the cdio track checksums
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Library General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Library General Public License for more details.
+ *
+ * You should have received a copy of the GNU Library General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 51 Franklin St, Fifth Floor,
+ * Boston, MA 02110-1301, USA.
+ */
+
+#include <gst/check/gstcheck.h>
+#include <glib/gstdio.h>
+#include <math.h>
+
+#include "gstcdiochecksum.h"
+
+#define NUM_SAMPLES 6000
+
+/* interleaved stereo samples in host endianness */
+static gint16 *
+create_samples (void)
+{
+  gint16 *samples;
+  guint i;
+
+  samples = g_new (gint16, 2 * NUM_SAMPLES);
+  for (i = 0; i < NUM_SAMPLES; i++) {
+    samples[2 * i] = (gint16) ((i * 7919) & 0xffff);
+    samples[2 * i + 1] = (gint16) ((i * 104729 + 3) & 0xffff);
+  }
+
+  return samples;
+}
+
+/* feed the samples in uneven blocks to check that state carries over */
+static void
+update_in_blocks (GstCdioChecksum * csum, const gint16 * samples,
+    guint num_samples)
+{
+  const guint8 *data = (const guint8 *) samples;
+  gsize size = 4 * num_samples, block = 4 * 7;
+
+  while (size > 0) {
+    gsize len = MIN (block, size);
+
+    gst_cdio_checksum_update (csum, data, len);
+    data += len;
+    size -= len;
+    block = (block * 3) % (4 * 1000) + 4;
+  }
+}
+
+GST_START_TEST (test_crc32)
+{
+  GstCdioChecksum csum;
+  gint16 samples[2];
+
+  /* the samples "12" and "34", "56", "78" as little endian byte stream */
+  samples[0] = GINT16_FROM_LE (0x3231);
+  samples[1] = GINT16_FROM_LE (0x3433);
+  gst_cdio_checksum_init (&csum, 2, FALSE, FALSE);
+  gst_cdio_checksum_update (&csum, (const guint8 *) samples, 4);
+  samples[0] = GINT16_FROM_LE (0x3635);
+  samples[1] = GINT16_FROM_LE (0x3837);
+  gst_cdio_checksum_update (&csum, (const guint8 *) samples, 4);
+
+  /* CRC32 of "12345678" */
+  fail_unless_equals_uint64 (gst_cdio_checksum_get_crc32 (&csum), 0x9ae0daaf);
+}
+
+GST_END_TEST;
+
+/* reference values computed with a straightforward implementation of the
+ * AccurateRip algorithm and zlib's crc32() over the little endian data */
+GST_START_TEST (test_middle_track)
+{
+  GstCdioChecksum csum;
+  gint16 *samples = create_samples ();
+
+  gst_cdio_checksum_init (&csum, NUM_SAMPLES, FALSE, FALSE);
+  update_in_blocks (&csum, samples, NUM_SAMPLES);
+
+  fail_unless_equals_uint64 (gst_cdio_checksum_get_crc32 (&csum), 0x62d14c4f);
+  fail_unless_equals_uint64 (csum.ar_v1, 0xaf9084d0);
+  fail_unless_equals_uint64 (csum.ar_v2, 0xb01982b6);
+
+  g_free (samples);
+}
+
+GST_END_TEST;
+
+GST_START_TEST (test_only_track)
+{
+  GstCdioChecksum csum;
+  gint16 *samples = create_samples ();
+
+  /* first and last track: 5 sectors at either end are left out */
+  gst_cdio_checksum_init (&csum, NUM_SAMPLES, TRUE, TRUE);
+  update_in_blocks (&csum, samples, NUM_SAMPLES);
+
+  fail_unless_equals_uint64 (gst_cdio_checksum_get_crc32 (&csum), 0x62d14c4f);
+  fail_unless_equals_uint64 (csum.ar_v1, 0xcadf7c54);
+  fail_unless_equals_uint64 (csum.ar_v2, 0xcae23302);
+
+  g_free (samples);
+}
+
+GST_END_TEST;
+
+#define NUM_SECTORS 20
+#define SAMPLES_PER_SECTOR (2352 / 4)
+
+/* a smooth tone, so that the element's drive endianness detection keeps
+ * the samples as they are */
+static gint16 *
+create_tone (void)
+{
+  gint16 *samples;
+  guint i;
+
+  samples = g_new (gint16, 2 * NUM_SECTORS * SAMPLES_PER_SECTOR);
+  for (i = 0; i < NUM_SECTORS * SAMPLES_PER_SECTOR; i++) {
+    samples[2 * i] = (gint16) (8000 * sin (i * 2 * G_PI * 441 / 44100));
+    samples[2 * i + 1] = (gint16) (6000 * sin (i * 2 * G_PI * 662 / 44100));
+  }
+
+  return samples;
+}
+
+/* writes a disc image of one audio track with the samples as a cue sheet
+ * and its bin file, and returns the path of the cue sheet */
+static gchar *
+write_image (const gchar * dir, const gint16 * samples)
+{
+  gchar *bin, *cue;
+  gint16 *le;
+  guint i;
+
+  le = g_new (gint16, 2 * NUM_SECTORS * SAMPLES_PER_SECTOR);
+  for (i = 0; i < 2 * NUM_SECTORS * SAMPLES_PER_SECTOR; i++)
+    le[i] = GINT16_TO_LE (samples[i]);
+
+  bin = g_build_filename (dir, "track.bin", NULL);
+  fail_unless (g_file_set_contents (bin, (const gchar *) le,
+          NUM_SECTORS * 2352, NULL));
+  g_free (bin);
+  g_free (le);
+
+  cue = g_build_filename (dir, "disc.cue", NULL);
+  fail_unless (g_file_set_contents (cue,
+          "FILE \"track.bin\" BINARY\n"
+          "  TRACK 01 AUDIO\n" "    INDEX 01 00:00:00\n", -1, NULL));
+
+  return cue;
+}
+
+GST_START_TEST (test_element_message)
+{
+  GstElement *pipeline, *src;
+  GstMessage *msg;
+  GstBus *bus;
+  GstCdioChecksum csum;
+  const GstStructure *s = NULL;
+  gint16 *samples;
+  gchar *dir, *cue, *path;
+  guint track, crc32, v1, v2;
+
+  samples = create_tone ();
+  dir = g_dir_make_tmp ("cdiochecksum-XXXXXX", NULL);
+  fail_unless (dir != NULL);
+  cue = write_image (dir, samples);
+
+  pipeline = gst_parse_launch ("cdiocddasrc name=src track=1 checksums=true "
+      "! fakesink", NULL);
+  fail_unless (pipeline != NULL);
+  src = gst_bin_get_by_name (GST_BIN (pipeline), "src");
+  g_object_set (src, "device", cue, NULL);
+  gst_object_unref (src);
+
+  bus = gst_element_get_bus (pipeline);
+  fail_unless_equals_int (gst_element_set_state (pipeline, GST_STATE_PLAYING),
+      GST_STATE_CHANGE_ASYNC);
+
+  /* the checksums are posted once the last sector of the track is read */
+  msg = NULL;
+  do {
+    if (msg)
+      gst_message_unref (msg);
+    msg = gst_bus_timed_pop_filtered (bus, GST_CLOCK_TIME_NONE,
+        GST_MESSAGE_ELEMENT | GST_MESSAGE_EOS | GST_MESSAGE_ERROR);
+    fail_unless (msg != NULL);
+    fail_if (GST_MESSAGE_TYPE (msg) == GST_MESSAGE_ERROR);
+    fail_if (GST_MESSAGE_TYPE (msg) == GST_MESSAGE_EOS);
+    s = gst_message_get_structure (msg);
+  } while (!gst_structure_has_name (s, "cdio-track-checksums"));
+
+  fail_unless (gst_structure_get_uint (s, "track", &track));
+  fail_unless (gst_structure_get_uint (s, "crc32", &crc32));
+  fail_unless (gst_structure_get_uint (s, "accuraterip-v1", &v1));
+  fail_unless (gst_structure_get_uint (s, "accuraterip-v2", &v2));
+  gst_message_unref (msg);
+
+  /* the only track on the disc, so it is both the first and the last one */
+  gst_cdio_checksum_init (&csum, NUM_SECTORS * SAMPLES_PER_SECTOR, TRUE, TRUE);
+  update_in_blocks (&csum, samples, NUM_SECTORS * SAMPLES_PER_SECTOR);
+  fail_unless_equals_int (track, 1);
+  fail_unless_equals_uint64 (crc32, gst_cdio_checksum_get_crc32 (&csum));
+  fail_unless_equals_uint64 (v1, csum.ar_v1);
+  fail_unless_equals_uint64 (v2, csum.ar_v2);
+
+  gst_element_set_state (pipeline, GST_STATE_NULL);
+  gst_object_unref (bus);
+  gst_object_unref (pipeline);
+
+  g_unlink (cue);
+  path = g_build_filename (dir, "track.bin", NULL);
+  g_unlink (path);
+  g_free (path);
+  g_rmdir (dir);
+  g_free (cue);
+  g_free (dir);
+  g_free (samples);
+}
+
+GST_END_TEST;
+
+static Suite *
+cdiochecksum_suite (void)
+{
+  Suite *s = suite_create ("cdiochecksum");
+  TCase *tc_chain = tcase_create ("general");
+
+  suite_add_tcase (s, tc_chain);
+  tcase_add_test (tc_chain, test_crc32);
+  tcase_add_test (tc_chain, test_middle_track);
+  tcase_add_test (tc_chain, test_only_track);
+  tcase_add_test (tc_chain, test_element_message);
+
+  return s;
+}
+
+GST_CHECK_MAIN (cdiochecksum);
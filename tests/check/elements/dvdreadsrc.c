@@ -0,0 +1,129 @@
+/* GStreamer
+ *
+ * unit test for dvdreadsrc
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Library General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Library General Public License for more details.
+ *
+ * You should have received a copy of the GNU Library General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 51 Franklin St, Fifth Floor,
+ * Boston, MA 02110-1301, USA.
+ */
+
+#include <gst/check/gstcheck.h>
+
+#include <dvdread/dvd_reader.h>
+
+/* there is no disc, the sectors are read from here instead */
+static gint read_pos;
+
+static ssize_t
+fake_read_blocks (dvd_file_t * file, int offset, size_t block_count,
+    unsigned char *data)
+{
+  size_t i;
+
+  /* every sector has to be read once, in order */
+  fail_unless_equals_int (offset, read_pos);
+  for (i = 0; i < block_count; i++)
+    GST_WRITE_UINT32_BE (data + i * DVD_VIDEO_LB_LEN, offset + i);
+  read_pos += block_count;
+
+  return block_count;
+}
+
+#define DVDReadBlocks fake_read_blocks
+#include "dvdreadsrc.c"
+#undef DVDReadBlocks
+
+#define FIRST_SECTOR 100
+
+/* reads a cell of n_sectors in linear read mode and checks that each
+ * sector comes out once */
+static void
+read_linear_cell (guint n_sectors)
+{
+  GstDvdReadSrc *src;
+  GstDvdReadReturn res;
+  GstBuffer *buf;
+  pgc_t pgc = { 0, };
+  cell_playback_t cell = { 0, };
+  guint sectors = 0, i;
+
+  cell.first_sector = FIRST_SECTOR;
+  cell.last_sector = FIRST_SECTOR + n_sectors - 1;
+  pgc.nr_of_cells = 1;
+  pgc.cell_playback = &cell;
+
+  src = g_object_new (GST_TYPE_DVD_READ_SRC, "linear-read", TRUE, NULL);
+  src->cur_pgc = &pgc;
+  src->start_cell = src->cur_cell = 0;
+  src->last_cell = src->next_cell = 1;
+  src->num_chapters = 1;
+  src->chapter = 0;
+  src->cur_pack = FIRST_SECTOR;
+  src->new_cell = FALSE;
+  read_pos = FIRST_SECTOR;
+
+  do {
+    buf = NULL;
+    res = gst_dvd_read_src_read (src, 0, FALSE, &buf);
+    fail_if (res == GST_DVD_READ_ERROR);
+    if (res != GST_DVD_READ_OK)
+      continue;
+
+    for (i = 0; i < gst_buffer_get_size (buf) / DVD_VIDEO_LB_LEN; i++) {
+      guint32 sector;
+
+      gst_buffer_extract (buf, i * DVD_VIDEO_LB_LEN, &sector, 4);
+      fail_unless_equals_int (GUINT32_FROM_BE (sector),
+          FIRST_SECTOR + sectors);
+      sectors++;
+    }
+    gst_buffer_unref (buf);
+  } while (res != GST_DVD_READ_EOS);
+
+  fail_unless_equals_int (sectors, n_sectors);
+  fail_unless_equals_int (read_pos, FIRST_SECTOR + n_sectors);
+
+  src->cur_pgc = NULL;
+  gst_object_unref (src);
+}
+
+GST_START_TEST (test_linear_read_cell_end)
+{
+  /* the last sector is read whether it starts a batch of its own or ends
+   * one */
+  read_linear_cell (1);
+  read_linear_cell (2);
+  read_linear_cell (LINEAR_READ_MAX_BLOCKS);
+  read_linear_cell (LINEAR_READ_MAX_BLOCKS + 1);
+  read_linear_cell (2 * LINEAR_READ_MAX_BLOCKS + 1);
+}
+
+GST_END_TEST;
+
+static Suite *
+dvdreadsrc_suite (void)
+{
+  Suite *s = suite_create ("dvdreadsrc");
+  TCase *tc_chain = tcase_create ("general");
+
+  GST_DEBUG_CATEGORY_INIT (gstgst_dvd_read_src_debug, "dvdreadsrc", 0,
+      "DVD reader element based on dvdreadsrc");
+
+  suite_add_tcase (s, tc_chain);
+  tcase_add_test (tc_chain, test_linear_read_cell_end);
+
+  return s;
+}
+
+GST_CHECK_MAIN (dvdreadsrc);
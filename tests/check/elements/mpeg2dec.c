@@ -21,6 +21,7 @@
  */
 
 #include <unistd.h>
+#include <string.h>
 
 #include <gst/check/gstcheck.h>
 
@@ -1941,6 +1942,236 @@ GST_START_TEST (test_decode_garbage)
 }
 
 GST_END_TEST;
+
+GST_START_TEST (test_decode_skip_non_key)
+{
+  GstElement *mpeg2dec;
+  GstBuffer *inbuffer;
+  int i, num_buffers;
+  guint offset = 0;
+
+  mpeg2dec = setup_mpeg2dec ();
+  gst_util_set_object_arg (G_OBJECT (mpeg2dec), "skip-frames", "non-key");
+
+  fail_unless (gst_element_set_state (mpeg2dec,
+          GST_STATE_PLAYING) == GST_STATE_CHANGE_SUCCESS,
+      "could not set to playing");
+
+  for (i = 0; i < G_N_ELEMENTS (test_stream2_sizes); i++) {
+    inbuffer =
+        gst_buffer_new_wrapped_full (GST_MEMORY_FLAG_READONLY,
+        (guint8 *) test_stream2 + offset, test_stream2_sizes[i], 0,
+        test_stream2_sizes[i], NULL, NULL);
+    offset += test_stream2_sizes[i];
+    fail_unless_equals_int (gst_pad_push (mysrcpad, inbuffer), GST_FLOW_OK);
+  }
+
+  /* only the I-frames at 0, 15 and 30 are decoded, the last one may still
+   * be held back by the decoder */
+  num_buffers = g_list_length (buffers);
+  fail_unless (num_buffers >= 2 && num_buffers <= 3);
+  for (i = 0; i < num_buffers; i++)
+    fail_unless_equals_int (gst_buffer_get_size (g_list_nth_data (buffers,
+                i)), 60168);
+
+  gst_check_drop_buffers ();
+  cleanup_mpeg2dec (mpeg2dec);
+}
+
+GST_END_TEST;
+
+static void
+push_stream (const guint8 * data, const guint * sizes, guint n_sizes)
+{
+  GstBuffer *inbuffer;
+  guint i, offset = 0;
+
+  for (i = 0; i < n_sizes; i++) {
+    inbuffer =
+        gst_buffer_new_wrapped_full (GST_MEMORY_FLAG_READONLY,
+        (guint8 *) data + offset, sizes[i], 0, sizes[i], NULL, NULL);
+    offset += sizes[i];
+    fail_unless_equals_int (gst_pad_push (mysrcpad, inbuffer), GST_FLOW_OK);
+  }
+}
+
+/* decodes test_stream2 repeated a few times, optionally followed by
+ * test_stream1 at a different size, and returns the output buffers */
+static GList *
+decode_gop_jobs (guint gop_jobs, guint repeat, gboolean resize)
+{
+  GstElement *mpeg2dec;
+  GList *outbuffers;
+  gint64 start, elapsed;
+  guint r;
+
+  mpeg2dec = setup_mpeg2dec ();
+  g_object_set (mpeg2dec, "gop-jobs", gop_jobs, NULL);
+
+  fail_unless (gst_element_set_state (mpeg2dec,
+          GST_STATE_PLAYING) == GST_STATE_CHANGE_SUCCESS,
+      "could not set to playing");
+
+  start = g_get_monotonic_time ();
+  for (r = 0; r < repeat; r++)
+    push_stream (test_stream2, test_stream2_sizes,
+        G_N_ELEMENTS (test_stream2_sizes));
+  if (resize)
+    push_stream (test_stream1, test_stream_sizes,
+        G_N_ELEMENTS (test_stream_sizes));
+  fail_unless (gst_pad_push_event (mysrcpad, gst_event_new_eos ()));
+  elapsed = MAX (g_get_monotonic_time () - start, 1);
+
+  GST_INFO ("gop-jobs %u: %u frames in %" G_GINT64_FORMAT " us, %.1f fps",
+      gop_jobs, g_list_length (buffers), elapsed,
+      g_list_length (buffers) * 1e6 / elapsed);
+
+  outbuffers = buffers;
+  buffers = NULL;
+  cleanup_mpeg2dec (mpeg2dec);
+
+  return outbuffers;
+}
+
+/* every picture the sequential decoder outputs must come out of the GOP
+ * decoders byte for byte and in the same order; the GOP decoders also
+ * output the few pictures libmpeg2 holds back at the end of a sequence */
+static void
+compare_decoded (GList * sequential, GList * parallel, guint max_missing)
+{
+  GList *l0, *l1 = parallel;
+  guint i = 0;
+
+  fail_unless (g_list_length (sequential) > 0);
+  fail_unless (g_list_length (sequential) + max_missing >=
+      g_list_length (parallel));
+
+  for (l0 = sequential; l0; l0 = l0->next, i++) {
+    GstMapInfo map0;
+
+    fail_unless (gst_buffer_map (l0->data, &map0, GST_MAP_READ));
+    for (; l1; l1 = l1->next) {
+      if (gst_buffer_get_size (l1->data) == map0.size
+          && gst_buffer_memcmp (l1->data, 0, map0.data, map0.size) == 0)
+        break;
+    }
+    fail_unless (l1 != NULL, "picture %u not decoded the same in parallel", i);
+    l1 = l1->next;
+    gst_buffer_unmap (l0->data, &map0);
+  }
+}
+
+GST_START_TEST (test_decode_gop_parallel)
+{
+  GList *sequential, *single, *parallel, *l0, *l1;
+  guint repeat = 8;
+
+  sequential = decode_gop_jobs (0, repeat, FALSE);
+  single = decode_gop_jobs (1, repeat, FALSE);
+  parallel = decode_gop_jobs (4, repeat, FALSE);
+
+  /* the GOP decoders output the last pictures too */
+  fail_unless_equals_int (g_list_length (single),
+      G_N_ELEMENTS (test_stream2_sizes) * repeat);
+  fail_unless_equals_int (g_list_length (parallel), g_list_length (single));
+
+  /* and the same pictures, however many GOPs are decoded at once */
+  for (l0 = single, l1 = parallel; l0; l0 = l0->next, l1 = l1->next) {
+    GstMapInfo map0, map1;
+
+    fail_unless (gst_buffer_map (l0->data, &map0, GST_MAP_READ));
+    fail_unless (gst_buffer_map (l1->data, &map1, GST_MAP_READ));
+    fail_unless_equals_int (map0.size, 60168);
+    fail_unless_equals_int (map1.size, map0.size);
+    fail_unless (memcmp (map0.data, map1.data, map0.size) == 0);
+
+    gst_buffer_unmap (l0->data, &map0);
+    gst_buffer_unmap (l1->data, &map1);
+  }
+
+  /* as the sequential decoder does */
+  compare_decoded (sequential, parallel, 2);
+
+  g_list_free_full (sequential, (GDestroyNotify) gst_buffer_unref);
+  g_list_free_full (single, (GDestroyNotify) gst_buffer_unref);
+  g_list_free_full (parallel, (GDestroyNotify) gst_buffer_unref);
+}
+
+GST_END_TEST;
+
+GST_START_TEST (test_decode_gop_parallel_resize)
+{
+  GList *sequential, *parallel, *l;
+  guint i, n_first;
+
+  sequential = decode_gop_jobs (0, 2, TRUE);
+  parallel = decode_gop_jobs (4, 2, TRUE);
+
+  /* the GOPs queued before the new sequence come out at the old size, all
+   * of them, and only then the pictures at the new size */
+  n_first = G_N_ELEMENTS (test_stream2_sizes) * 2;
+  fail_unless_equals_int (g_list_length (parallel),
+      n_first + G_N_ELEMENTS (test_stream_sizes));
+  for (l = parallel, i = 0; l; l = l->next, i++) {
+    fail_unless_equals_int (gst_buffer_get_size (l->data),
+        i < n_first ? 60168 : 38016);
+  }
+
+  compare_decoded (sequential, parallel, 4);
+
+  g_list_free_full (sequential, (GDestroyNotify) gst_buffer_unref);
+  g_list_free_full (parallel, (GDestroyNotify) gst_buffer_unref);
+}
+
+GST_END_TEST;
+
+/* switching skip-frames back to none in the middle of a GOP must not
+ * output the P-pictures predicted from the skipped ones */
+GST_START_TEST (test_decode_skip_non_key_switch)
+{
+  GstElement *mpeg2dec;
+  GList *reference, *skipped;
+  guint gop_size = 15, n_skipped = 5, i, offset = 0;
+
+  mpeg2dec = setup_mpeg2dec ();
+  fail_unless (gst_element_set_state (mpeg2dec,
+          GST_STATE_PLAYING) == GST_STATE_CHANGE_SUCCESS,
+      "could not set to playing");
+  push_stream (test_stream2, test_stream2_sizes,
+      G_N_ELEMENTS (test_stream2_sizes));
+  reference = buffers;
+  buffers = NULL;
+  cleanup_mpeg2dec (mpeg2dec);
+
+  mpeg2dec = setup_mpeg2dec ();
+  gst_util_set_object_arg (G_OBJECT (mpeg2dec), "skip-frames", "non-key");
+  fail_unless (gst_element_set_state (mpeg2dec,
+          GST_STATE_PLAYING) == GST_STATE_CHANGE_SUCCESS,
+      "could not set to playing");
+  push_stream (test_stream2, test_stream2_sizes, n_skipped);
+  gst_util_set_object_arg (G_OBJECT (mpeg2dec), "skip-frames", "none");
+  for (i = 0; i < n_skipped; i++)
+    offset += test_stream2_sizes[i];
+  push_stream (test_stream2 + offset, test_stream2_sizes + n_skipped,
+      G_N_ELEMENTS (test_stream2_sizes) - n_skipped);
+  skipped = buffers;
+  buffers = NULL;
+  cleanup_mpeg2dec (mpeg2dec);
+
+  /* the first I-picture, then everything from the next GOP on */
+  fail_unless (g_list_length (reference) > gop_size);
+  fail_unless_equals_int (g_list_length (skipped),
+      1 + g_list_length (reference) - gop_size);
+
+  /* and decoded the same as without skipping */
+  compare_decoded (skipped, reference, g_list_length (reference));
+
+  g_list_free_full (reference, (GDestroyNotify) gst_buffer_unref);
+  g_list_free_full (skipped, (GDestroyNotify) gst_buffer_unref);
+}
+
+GST_END_TEST;
+
 Suite *
 mpeg2dec_suite (void)
 {
@@ -1951,6 +2182,10 @@ mpeg2dec_suite (void)
   tcase_add_test (tc_chain, test_decode_stream1);
   tcase_add_test (tc_chain, test_decode_stream2);
   tcase_add_test (tc_chain, test_decode_garbage);
+  tcase_add_test (tc_chain, test_decode_skip_non_key);
+  tcase_add_test (tc_chain, test_decode_skip_non_key_switch);
+  tcase_add_test (tc_chain, test_decode_gop_parallel);
+  tcase_add_test (tc_chain, test_decode_gop_parallel_resize);
 
   return s;
 }
@@ -0,0 +1,307 @@
+/* GStreamer
+ *
+ * unit test for rtpasfdepay
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Library General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Library General Public License for more details.
+ *
+ * You should have received a copy of the GNU Library General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 51 Franklin St, Fifth Floor,
+ * Boston, MA 02110-1301, USA.
+ */
+
+#include <string.h>
+
+#include <gst/check/gstcheck.h>
+#include <gst/check/gstharness.h>
+#include <gst/rtp/gstrtpbuffer.h>
+
+#define PACKET_SIZE 200
+#define PACKET_LEN 100
+
+/* the ASF header object GUID is all the depayloader checks of the config */
+#define RTP_CAPS_MAXPS(maxps) "application/x-rtp, " \
+    "media = (string) application, payload = (int) 96, " \
+    "clock-rate = (int) 1000, encoding-name = (string) X-ASF-PF, " \
+    "config = (string) MCaydY5mzxGm2QCqAGLObA==, maxps = (string) " maxps
+#define RTP_CAPS RTP_CAPS_MAXPS ("200")
+
+/* an RTP packet with one ASF data packet of @len bytes with a WORD padding
+ * length */
+static GstBuffer *
+create_rtp_packet (guint seqnum, guint len)
+{
+  GstRTPBuffer rtp = GST_RTP_BUFFER_INIT;
+  GstBuffer *buffer;
+  guint8 *payload;
+  guint i;
+
+  buffer = gst_rtp_buffer_new_allocate (4 + len, 0, 0);
+  gst_rtp_buffer_map (buffer, GST_MAP_WRITE, &rtp);
+  gst_rtp_buffer_set_payload_type (&rtp, 96);
+  gst_rtp_buffer_set_seq (&rtp, seqnum);
+  gst_rtp_buffer_set_marker (&rtp, TRUE);
+  payload = gst_rtp_buffer_get_payload (&rtp);
+
+  /* keyframe, length present */
+  payload[0] = 0xc0;
+  payload[1] = 0;
+  payload[2] = (len >> 8) & 0xff;
+  payload[3] = len & 0xff;
+
+  /* error correction data, then length type flags with a WORD padding
+   * length and property flags */
+  payload[4] = 0x82;
+  payload[5] = 0;
+  payload[6] = 0;
+  payload[7] = 0x10;
+  payload[8] = 0x5d;
+  for (i = 9; i < 4 + len; i++)
+    payload[i] = i;
+
+  gst_rtp_buffer_unmap (&rtp);
+
+  return buffer;
+}
+
+/* an RTP packet with the fragment of a full-size ASF data packet at the
+ * given offset; the fragment bytes are numbered by their packet offset */
+static GstBuffer *
+create_rtp_fragment (guint seqnum, guint offset, guint len, gboolean last)
+{
+  GstRTPBuffer rtp = GST_RTP_BUFFER_INIT;
+  GstBuffer *buffer;
+  guint8 *payload;
+  guint i;
+
+  buffer = gst_rtp_buffer_new_allocate (4 + len, 0, 0);
+  gst_rtp_buffer_map (buffer, GST_MAP_WRITE, &rtp);
+  gst_rtp_buffer_set_payload_type (&rtp, 96);
+  gst_rtp_buffer_set_seq (&rtp, seqnum);
+  gst_rtp_buffer_set_marker (&rtp, last);
+  payload = gst_rtp_buffer_get_payload (&rtp);
+
+  /* keyframe, offset present */
+  payload[0] = 0x80;
+  payload[1] = (offset >> 16) & 0xff;
+  payload[2] = (offset >> 8) & 0xff;
+  payload[3] = offset & 0xff;
+  for (i = 0; i < len; i++)
+    payload[4 + i] = offset + i;
+
+  gst_rtp_buffer_unmap (&rtp);
+
+  return buffer;
+}
+
+GST_START_TEST (test_padding)
+{
+  GstHarness *h = gst_harness_new ("rtpasfdepay");
+  GstBuffer *buffer;
+  GstMapInfo map;
+  guint i;
+
+  gst_harness_set_src_caps_str (h, RTP_CAPS);
+  fail_unless_equals_int (gst_harness_push (h,
+          create_rtp_packet (0, PACKET_LEN)), GST_FLOW_OK);
+
+  /* the ASF headers from the caps */
+  buffer = gst_harness_pull (h);
+  fail_unless_equals_int (gst_buffer_get_size (buffer), 16);
+  gst_buffer_unref (buffer);
+
+  buffer = gst_harness_pull (h);
+  fail_unless_equals_int (gst_buffer_get_size (buffer), PACKET_SIZE);
+
+  /* patched header, the payload and the shared padding */
+  fail_unless_equals_int (gst_buffer_n_memory (buffer), 3);
+
+  fail_unless (gst_buffer_map (buffer, &map, GST_MAP_READ));
+  fail_unless_equals_int (map.data[0], 0x82);
+  fail_unless_equals_int (map.data[3], 0x10);
+  fail_unless_equals_int (GST_READ_UINT16_LE (map.data + 5),
+      PACKET_SIZE - PACKET_LEN);
+  for (i = 7; i < PACKET_LEN; i++)
+    fail_unless_equals_int (map.data[i], (i + 4) & 0xff);
+  for (; i < PACKET_SIZE; i++)
+    fail_unless_equals_int (map.data[i], 0);
+  gst_buffer_unmap (buffer, &map);
+  gst_buffer_unref (buffer);
+
+  gst_harness_teardown (h);
+}
+
+GST_END_TEST;
+
+GST_START_TEST (test_fragments)
+{
+  GstHarness *h = gst_harness_new ("rtpasfdepay");
+  GstBuffer *buffer;
+  GstMapInfo map;
+  guint i;
+
+  gst_harness_set_src_caps_str (h, RTP_CAPS);
+  fail_unless_equals_int (gst_harness_push (h, create_rtp_fragment (0, 0,
+              80, FALSE)), GST_FLOW_OK);
+  fail_unless_equals_int (gst_harness_push (h, create_rtp_fragment (1, 80,
+              60, FALSE)), GST_FLOW_OK);
+
+  /* the ASF headers from the caps, no packet before the last fragment */
+  buffer = gst_harness_pull (h);
+  fail_unless_equals_int (gst_buffer_get_size (buffer), 16);
+  gst_buffer_unref (buffer);
+  fail_unless (gst_harness_try_pull (h) == NULL);
+
+  fail_unless_equals_int (gst_harness_push (h, create_rtp_fragment (2, 140,
+              PACKET_SIZE - 140, TRUE)), GST_FLOW_OK);
+
+  /* the fragments are not merged into one memory */
+  buffer = gst_harness_pull (h);
+  fail_unless_equals_int (gst_buffer_get_size (buffer), PACKET_SIZE);
+  fail_unless_equals_int (gst_buffer_n_memory (buffer), 3);
+
+  fail_unless (gst_buffer_map (buffer, &map, GST_MAP_READ));
+  for (i = 0; i < PACKET_SIZE; i++)
+    fail_unless_equals_int (map.data[i], i & 0xff);
+  gst_buffer_unmap (buffer, &map);
+  gst_buffer_unref (buffer);
+
+  /* a fragment that doesn't continue the packet makes it start over */
+  fail_unless_equals_int (gst_harness_push (h, create_rtp_fragment (3, 0,
+              80, FALSE)), GST_FLOW_OK);
+  fail_unless_equals_int (gst_harness_push (h, create_rtp_fragment (4, 100,
+              PACKET_SIZE - 100, TRUE)), GST_FLOW_OK);
+  fail_unless (gst_harness_try_pull (h) == NULL);
+
+  gst_harness_teardown (h);
+}
+
+GST_END_TEST;
+
+/* a packet longer than the advertised packet size is passed on as is */
+GST_START_TEST (test_oversized)
+{
+  GstHarness *h = gst_harness_new ("rtpasfdepay");
+  GstBuffer *buffer;
+
+  gst_harness_set_src_caps_str (h, RTP_CAPS);
+  fail_unless_equals_int (gst_harness_push (h,
+          create_rtp_packet (0, PACKET_SIZE + 50)), GST_FLOW_OK);
+  gst_buffer_unref (gst_harness_pull (h));
+
+  buffer = gst_harness_pull (h);
+  fail_unless_equals_int (gst_buffer_get_size (buffer), PACKET_SIZE + 50);
+  fail_unless_equals_int (gst_buffer_n_memory (buffer), 1);
+  gst_buffer_unref (buffer);
+
+  gst_harness_teardown (h);
+}
+
+GST_END_TEST;
+
+/* a new stream with a bigger packet size gets padding for the full size */
+GST_START_TEST (test_renegotiate_packet_size)
+{
+  GstHarness *h = gst_harness_new ("rtpasfdepay");
+  GstBuffer *buffer;
+  GstMapInfo map;
+  guint i;
+
+  gst_harness_set_src_caps_str (h, RTP_CAPS);
+  fail_unless_equals_int (gst_harness_push (h, create_rtp_packet (0,
+              PACKET_LEN)), GST_FLOW_OK);
+  gst_buffer_unref (gst_harness_pull (h));
+  buffer = gst_harness_pull (h);
+  fail_unless_equals_int (gst_buffer_get_size (buffer), PACKET_SIZE);
+  gst_buffer_unref (buffer);
+
+  fail_unless_equals_int (gst_element_set_state (h->element,
+          GST_STATE_READY), GST_STATE_CHANGE_SUCCESS);
+  fail_unless_equals_int (gst_element_set_state (h->element,
+          GST_STATE_PLAYING), GST_STATE_CHANGE_SUCCESS);
+
+  fail_unless (gst_harness_push_event (h,
+          gst_event_new_stream_start ("asf")));
+  gst_harness_set_src_caps_str (h, RTP_CAPS_MAXPS ("1000"));
+  fail_unless_equals_int (gst_harness_push (h, create_rtp_packet (1,
+              PACKET_LEN)), GST_FLOW_OK);
+
+  buffer = gst_harness_pull (h);
+  fail_unless_equals_int (gst_buffer_get_size (buffer), 16);
+  gst_buffer_unref (buffer);
+
+  buffer = gst_harness_pull (h);
+  fail_unless_equals_int (gst_buffer_get_size (buffer), 1000);
+  fail_unless (gst_buffer_map (buffer, &map, GST_MAP_READ));
+  fail_unless_equals_int (GST_READ_UINT16_LE (map.data + 5),
+      1000 - PACKET_LEN);
+  for (i = PACKET_LEN; i < 1000; i++)
+    fail_unless_equals_int (map.data[i], 0);
+  gst_buffer_unmap (buffer, &map);
+  gst_buffer_unref (buffer);
+
+  gst_harness_teardown (h);
+}
+
+GST_END_TEST;
+
+/* only run when GST_CHECK_BENCHMARK is set, to keep make check fast */
+GST_START_TEST (test_padding_benchmark)
+{
+  GstHarness *h = gst_harness_new ("rtpasfdepay");
+  GstClockTime start, elapsed;
+  guint i, n_packets = 1000000;
+
+  gst_harness_set_src_caps_str (h, RTP_CAPS);
+  fail_unless_equals_int (gst_harness_push (h,
+          create_rtp_packet (0, PACKET_LEN)), GST_FLOW_OK);
+  gst_buffer_unref (gst_harness_pull (h));
+  gst_buffer_unref (gst_harness_pull (h));
+
+  start = gst_util_get_timestamp ();
+  for (i = 1; i <= n_packets; i++) {
+    gst_harness_push (h, create_rtp_packet (i, PACKET_LEN));
+    gst_buffer_unref (gst_harness_pull (h));
+  }
+  elapsed = MAX (gst_util_get_timestamp () - start, 1);
+
+  GST_INFO ("%u packets in %" GST_TIME_FORMAT ", %.0f packets/s", n_packets,
+      GST_TIME_ARGS (elapsed), n_packets * (gdouble) GST_SECOND / elapsed);
+
+  gst_harness_teardown (h);
+}
+
+GST_END_TEST;
+
+static Suite *
+rtpasfdepay_suite (void)
+{
+  Suite *s = suite_create ("rtpasfdepay");
+  TCase *tc_chain = tcase_create ("general");
+
+  suite_add_tcase (s, tc_chain);
+  tcase_add_test (tc_chain, test_padding);
+  tcase_add_test (tc_chain, test_fragments);
+  tcase_add_test (tc_chain, test_oversized);
+  tcase_add_test (tc_chain, test_renegotiate_packet_size);
+
+  if (g_getenv ("GST_CHECK_BENCHMARK")) {
+    TCase *tc_benchmark = tcase_create ("benchmark");
+
+    suite_add_tcase (s, tc_benchmark);
+    tcase_set_timeout (tc_benchmark, 120);
+    tcase_add_test (tc_benchmark, test_padding_benchmark);
+  }
+
+  return s;
+}
+
+GST_CHECK_MAIN (rtpasfdepay);
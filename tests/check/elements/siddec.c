@@ -0,0 +1,252 @@
+/* GStreamer
+ *
+ * unit test for siddec
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Library General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Library General Public License for more details.
+ *
+ * You should have received a copy of the GNU Library General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 51 Franklin St, Fifth Floor,
+ * Boston, MA 02110-1301, USA.
+ */
+
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+#include <gst/check/gstcheck.h>
+#include <gst/check/gstharness.h>
+#include <gst/audio/audio.h>
+#include <glib/gstdio.h>
+
+#define RAW_CAPS "audio/x-raw, format = (string) " GST_AUDIO_NE (S16) ", " \
+    "layout = (string) interleaved, rate = (int) 44100, channels = (int) 1"
+#define BYTERATE (44100 * 2)
+
+#define PSID_HEADER_SIZE 0x76
+#define LOAD_ADDRESS 0x1000
+
+/* init: full volume, a sawtooth tone held on voice 1; play: nothing */
+static const guint8 tune_code[] = {
+  0xa9, 0x0f, 0x8d, 0x18, 0xd4,
+  0xa9, 0x00, 0x8d, 0x05, 0xd4,
+  0xa9, 0xf0, 0x8d, 0x06, 0xd4,
+  0xa9, 0x00, 0x8d, 0x00, 0xd4,
+  0xa9, 0x1c, 0x8d, 0x01, 0xd4,
+  0xa9, 0x21, 0x8d, 0x04, 0xd4,
+  0x60,
+  0x60
+};
+
+/* a PSID v1 file with one song */
+static GstBuffer *
+create_tune (void)
+{
+  GstBuffer *buf;
+  GstMapInfo map;
+  guint8 *data;
+
+  buf = gst_buffer_new_and_alloc (PSID_HEADER_SIZE + 2 + sizeof (tune_code));
+  gst_buffer_map (buf, &map, GST_MAP_WRITE);
+  data = map.data;
+  memset (data, 0, map.size);
+
+  memcpy (data, "PSID", 4);
+  GST_WRITE_UINT16_BE (data + 0x04, 1);
+  GST_WRITE_UINT16_BE (data + 0x06, PSID_HEADER_SIZE);
+  /* the load address comes with the data */
+  GST_WRITE_UINT16_BE (data + 0x0a, LOAD_ADDRESS);
+  GST_WRITE_UINT16_BE (data + 0x0c, LOAD_ADDRESS + sizeof (tune_code) - 1);
+  GST_WRITE_UINT16_BE (data + 0x0e, 1);
+  GST_WRITE_UINT16_BE (data + 0x10, 1);
+  strcpy ((gchar *) data + 0x16, "Test tone");
+
+  GST_WRITE_UINT16_LE (data + PSID_HEADER_SIZE, LOAD_ADDRESS);
+  memcpy (data + PSID_HEADER_SIZE + 2, tune_code, sizeof (tune_code));
+  gst_buffer_unmap (buf, &map);
+
+  return buf;
+}
+
+static GstHarness *
+setup_siddec (gboolean offline)
+{
+  GstHarness *h;
+
+  h = gst_harness_new ("siddec");
+  g_object_set (h->element, "offline", offline, NULL);
+  gst_harness_set_caps_str (h, "audio/x-sid", RAW_CAPS);
+
+  /* the tune is played once it is complete */
+  fail_unless_equals_int (gst_harness_push (h, create_tune ()), GST_FLOW_OK);
+  fail_unless (gst_harness_push_event (h, gst_event_new_eos ()));
+
+  return h;
+}
+
+static void
+check_blocks (gboolean offline, gsize blocksize)
+{
+  GstHarness *h;
+  GstBuffer *buf;
+  guint64 offset = 0;
+  gint i;
+
+  h = setup_siddec (offline);
+
+  for (i = 0; i < 3; i++) {
+    buf = gst_harness_pull (h);
+    fail_unless (buf != NULL);
+    fail_unless_equals_int (gst_buffer_get_size (buf), blocksize);
+    fail_unless_equals_uint64 (GST_BUFFER_OFFSET (buf), offset);
+    fail_unless_equals_uint64 (GST_BUFFER_PTS (buf),
+        gst_util_uint64_scale (offset, GST_SECOND, 44100));
+    offset += blocksize / 2;
+    fail_unless_equals_uint64 (GST_BUFFER_OFFSET_END (buf), offset);
+    gst_buffer_unref (buf);
+  }
+
+  gst_harness_teardown (h);
+}
+
+GST_START_TEST (test_blocksize)
+{
+  check_blocks (FALSE, 4096);
+}
+
+GST_END_TEST;
+
+GST_START_TEST (test_offline)
+{
+  /* a second of audio per buffer */
+  check_blocks (TRUE, BYTERATE);
+}
+
+GST_END_TEST;
+
+GST_START_TEST (test_restart)
+{
+  GstHarness *h;
+  GstBuffer *buf;
+
+  h = setup_siddec (FALSE);
+  buf = gst_harness_pull (h);
+  fail_unless (buf->pool != NULL);
+
+  /* the pool goes with the stream, and the next one starts over */
+  gst_element_set_state (h->element, GST_STATE_READY);
+  fail_if (gst_buffer_pool_is_active (buf->pool));
+  gst_buffer_unref (buf);
+  gst_element_set_state (h->element, GST_STATE_PLAYING);
+
+  fail_unless (gst_harness_push_event (h,
+          gst_event_new_stream_start ("restart")));
+  fail_unless_equals_int (gst_harness_push (h, create_tune ()), GST_FLOW_OK);
+  fail_unless (gst_harness_push_event (h, gst_event_new_eos ()));
+
+  buf = gst_harness_pull (h);
+  fail_unless_equals_uint64 (GST_BUFFER_OFFSET (buf), 0);
+  gst_buffer_unref (buf);
+
+  gst_harness_teardown (h);
+}
+
+GST_END_TEST;
+
+/* renders a number of seconds of audio and returns the CPU seconds it
+ * took */
+static gdouble
+render (gboolean offline, guint seconds)
+{
+  GstElement *pipeline;
+  GstMessage *msg;
+  GstBuffer *tune;
+  GstMapInfo map;
+  GstBus *bus;
+  clock_t start;
+  gchar *file, *desc;
+  guint num_buffers;
+  gint fd;
+
+  fd = g_file_open_tmp ("siddec-test-XXXXXX.sid", &file, NULL);
+  fail_unless (fd >= 0);
+  close (fd);
+  tune = create_tune ();
+  gst_buffer_map (tune, &map, GST_MAP_READ);
+  fail_unless (g_file_set_contents (file, (const gchar *) map.data, map.size,
+          NULL));
+  gst_buffer_unmap (tune, &map);
+  gst_buffer_unref (tune);
+
+  num_buffers = offline ? seconds : seconds * BYTERATE / 4096;
+  desc = g_strdup_printf ("filesrc location=%s ! siddec offline=%s ! "
+      RAW_CAPS " ! fakesink num-buffers=%u", file,
+      offline ? "true" : "false", num_buffers);
+  pipeline = gst_parse_launch (desc, NULL);
+  fail_unless (pipeline != NULL);
+  g_free (desc);
+
+  start = clock ();
+  bus = gst_element_get_bus (pipeline);
+  gst_element_set_state (pipeline, GST_STATE_PLAYING);
+  msg = gst_bus_timed_pop_filtered (bus, GST_CLOCK_TIME_NONE,
+      (GstMessageType) (GST_MESSAGE_EOS | GST_MESSAGE_ERROR));
+  fail_unless_equals_int (GST_MESSAGE_TYPE (msg), GST_MESSAGE_EOS);
+  gst_message_unref (msg);
+  gst_element_set_state (pipeline, GST_STATE_NULL);
+
+  gst_object_unref (bus);
+  gst_object_unref (pipeline);
+  g_unlink (file);
+  g_free (file);
+
+  return MAX ((gdouble) (clock () - start) / CLOCKS_PER_SEC, 1e-6);
+}
+
+/* only run when GST_CHECK_BENCHMARK is set, to keep make check fast */
+GST_START_TEST (test_render_benchmark)
+{
+  const guint seconds = 600;
+  gdouble playback, offline;
+
+  playback = render (FALSE, seconds);
+  offline = render (TRUE, seconds);
+
+  GST_INFO ("%u s of audio: %.1f s per CPU second with %u byte blocks, "
+      "%.1f s per CPU second offline", seconds, seconds / playback, 4096,
+      seconds / offline);
+}
+
+GST_END_TEST;
+
+static Suite *
+siddec_suite (void)
+{
+  Suite *s = suite_create ("siddec");
+  TCase *tc_chain = tcase_create ("general");
+
+  suite_add_tcase (s, tc_chain);
+  tcase_add_test (tc_chain, test_blocksize);
+  tcase_add_test (tc_chain, test_offline);
+  tcase_add_test (tc_chain, test_restart);
+
+  if (g_getenv ("GST_CHECK_BENCHMARK")) {
+    TCase *tc_benchmark = tcase_create ("benchmark");
+
+    suite_add_tcase (s, tc_benchmark);
+    tcase_set_timeout (tc_benchmark, 300);
+    tcase_add_test (tc_benchmark, test_render_benchmark);
+  }
+
+  return s;
+}
+
+GST_CHECK_MAIN (siddec);
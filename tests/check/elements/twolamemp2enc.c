@@ -0,0 +1,176 @@
+/* GStreamer
+ *
+ * unit test for twolamemp2enc
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Library General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Library General Public License for more details.
+ *
+ * You should have received a copy of the GNU Library General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 51 Franklin St, Fifth Floor,
+ * Boston, MA 02110-1301, USA.
+ */
+
+#include <gst/check/gstcheck.h>
+#include <gst/check/gstharness.h>
+#include <gst/audio/audio.h>
+#include <gst/base/gstadapter.h>
+
+#define RATE 48000
+#define CHANNELS 2
+#define FRAME_SAMPLES 1152
+#define CHUNK_FRAMES 4
+
+#define RAW_CAPS "audio/x-raw, format = (string) " GST_AUDIO_NE (S16) ", " \
+    "layout = (string) interleaved, rate = (int) 48000, channels = (int) 2"
+
+/* ten and a half chunks, so the last chunk and frame are partial */
+#define NUM_SAMPLES (FRAME_SAMPLES * CHUNK_FRAMES * 21 / 2 + 100)
+#define BUFFER_SAMPLES 1000
+
+typedef struct
+{
+  guint frames;
+  guint buffers;
+  GstClockTime start, end;
+} EncodeResult;
+
+/* returns the number of MPEG-1 layer II frames in data */
+static guint
+count_frames (const guint8 * data, gsize size)
+{
+  static const guint bitrates[16] =
+      { 0, 32, 48, 56, 64, 80, 96, 112, 128, 160, 192, 224, 256, 320, 384 };
+  static const guint rates[4] = { 44100, 48000, 32000, 0 };
+  guint frames = 0;
+
+  while (size >= 4) {
+    guint32 header = GST_READ_UINT32_BE (data);
+    guint bitrate, rate, len;
+
+    fail_unless ((header & 0xfffe0000) == 0xfffc0000,
+        "no layer II frame header at frame %u", frames);
+
+    bitrate = bitrates[(header >> 12) & 0xf];
+    rate = rates[(header >> 10) & 0x3];
+    fail_unless (bitrate != 0 && rate != 0);
+
+    len = 144 * 1000 * bitrate / rate + ((header >> 9) & 0x1);
+    fail_unless (len <= size);
+
+    data += len;
+    size -= len;
+    frames++;
+  }
+  fail_unless_equals_int (size, 0);
+
+  return frames;
+}
+
+static void
+encode (gint threads, EncodeResult * result)
+{
+  GstHarness *h = gst_harness_new ("twolamemp2enc");
+  GstAdapter *adapter = gst_adapter_new ();
+  GstClockTime expected_ts = GST_CLOCK_TIME_NONE;
+  GstBuffer *buffer;
+  guint32 seed = 1;
+  guint i, offset;
+
+  g_object_set (h->element, "threads", threads, "chunk-frames", CHUNK_FRAMES,
+      "bitrate", 192, NULL);
+  gst_harness_set_src_caps_str (h, RAW_CAPS);
+
+  for (offset = 0; offset < NUM_SAMPLES; offset += BUFFER_SAMPLES) {
+    guint samples = MIN (BUFFER_SAMPLES, NUM_SAMPLES - offset);
+    GstMapInfo map;
+    gint16 *data;
+
+    buffer = gst_buffer_new_and_alloc (samples * CHANNELS * 2);
+    gst_buffer_map (buffer, &map, GST_MAP_WRITE);
+    data = (gint16 *) map.data;
+    /* a ramp on the left and quiet noise on the right channel */
+    for (i = 0; i < samples; i++) {
+      seed = seed * 1664525 + 1013904223;
+      data[2 * i] = (gint16) (((offset + i) * 64) & 0xffff) / 4;
+      data[2 * i + 1] = (gint16) (seed >> 16) / 8;
+    }
+    gst_buffer_unmap (buffer, &map);
+
+    GST_BUFFER_PTS (buffer) = gst_util_uint64_scale_int (offset, GST_SECOND,
+        RATE);
+    GST_BUFFER_DURATION (buffer) = gst_util_uint64_scale_int (samples,
+        GST_SECOND, RATE);
+    fail_unless_equals_int (gst_harness_push (h, buffer), GST_FLOW_OK);
+  }
+  fail_unless (gst_harness_push_event (h, gst_event_new_eos ()));
+
+  memset (result, 0, sizeof (EncodeResult));
+  while ((buffer = gst_harness_try_pull (h))) {
+    /* output comes in input order without gaps */
+    fail_unless (GST_BUFFER_PTS_IS_VALID (buffer));
+    fail_unless (GST_BUFFER_DURATION_IS_VALID (buffer));
+    if (result->buffers == 0)
+      result->start = GST_BUFFER_PTS (buffer);
+    else
+      fail_unless_equals_uint64 (GST_BUFFER_PTS (buffer), expected_ts);
+    expected_ts = GST_BUFFER_PTS (buffer) + GST_BUFFER_DURATION (buffer);
+
+    result->buffers++;
+    gst_adapter_push (adapter, buffer);
+  }
+  result->end = expected_ts;
+
+  i = gst_adapter_available (adapter);
+  result->frames = count_frames (gst_adapter_map (adapter, i), i);
+  gst_adapter_unmap (adapter);
+
+  g_object_unref (adapter);
+  gst_harness_teardown (h);
+}
+
+GST_START_TEST (test_parallel)
+{
+  EncodeResult serial, parallel;
+
+  encode (1, &serial);
+  encode (4, &parallel);
+
+  /* one buffer per chunk, the last one partial */
+  fail_unless_equals_int (parallel.buffers,
+      (NUM_SAMPLES + FRAME_SAMPLES * CHUNK_FRAMES - 1) /
+      (FRAME_SAMPLES * CHUNK_FRAMES));
+
+  /* the chunks are not byte-identical to serial encoding, but must make
+   * the same frames with the same timing */
+  fail_unless_equals_int (serial.frames,
+      (NUM_SAMPLES + FRAME_SAMPLES - 1) / FRAME_SAMPLES);
+  fail_unless_equals_int (parallel.frames, serial.frames);
+  fail_unless_equals_uint64 (parallel.start, serial.start);
+  fail_unless_equals_uint64 (parallel.end, serial.end);
+  fail_unless_equals_uint64 (parallel.end - parallel.start,
+      gst_util_uint64_scale_int (NUM_SAMPLES, GST_SECOND, RATE));
+}
+
+GST_END_TEST;
+
+static Suite *
+twolamemp2enc_suite (void)
+{
+  Suite *s = suite_create ("twolamemp2enc");
+  TCase *tc_chain = tcase_create ("general");
+
+  suite_add_tcase (s, tc_chain);
+  tcase_add_test (tc_chain, test_parallel);
+
+  return s;
+}
+
+GST_CHECK_MAIN (twolamemp2enc);
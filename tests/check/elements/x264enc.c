@@ -23,6 +23,8 @@
 #include <unistd.h>
 
 #include <gst/check/gstcheck.h>
+#include <glib/gstdio.h>
+#include <gst/video/gstvideometa.h>
 
 /* For ease of programming we use globals to keep refs for our floating
  * src and sink pads we create; otherwise we always have to do get_pad,
@@ -41,7 +43,7 @@ static GstPad *mysrcpad, *mysinkpad;
                            "framerate = (fraction) 25/1"
 static GstElement *
 setup_x264enc (const gchar * profile, const gchar * stream_format,
-    const gchar * input_format)
+    const gchar * input_format, const gchar * props)
 {
   GstStaticPadTemplate sinktemplate = GST_STATIC_PAD_TEMPLATE ("sink",
       GST_PAD_SINK,
@@ -63,6 +65,18 @@ setup_x264enc (const gchar * profile, const gchar * stream_format,
   sinktemplate.static_caps.string = caps_str;
 
   x264enc = gst_check_setup_element ("x264enc");
+  if (props) {
+    gchar **pairs = g_strsplit (props, " ", -1);
+    gint i;
+
+    for (i = 0; pairs[i]; i++) {
+      gchar **kv = g_strsplit (pairs[i], "=", 2);
+
+      gst_util_set_object_arg (G_OBJECT (x264enc), kv[0], kv[1]);
+      g_strfreev (kv);
+    }
+    g_strfreev (pairs);
+  }
   mysrcpad = gst_check_setup_src_pad (x264enc, &srctemplate);
   mysinkpad = gst_check_setup_sink_pad (x264enc, &sinktemplate);
   gst_pad_set_active (mysrcpad, TRUE);
@@ -145,7 +159,7 @@ test_video_profile (const gchar * profile, gint profile_id,
   GstBuffer *inbuffer, *outbuffer;
   int i, num_buffers;
 
-  x264enc = setup_x264enc (profile, "avc", input_format);
+  x264enc = setup_x264enc (profile, "avc", input_format, NULL);
   fail_unless (gst_element_set_state (x264enc,
           GST_STATE_PLAYING) == GST_STATE_CHANGE_SUCCESS,
       "could not set to playing");
@@ -286,6 +300,526 @@ GST_START_TEST (test_video_high444)
 GST_END_TEST;
 
 
+static GArray *arrivals;
+
+static GstPadProbeReturn
+record_arrival (GstPad * pad, GstPadProbeInfo * info, gpointer user_data)
+{
+  gint64 now = g_get_monotonic_time ();
+
+  g_array_append_val (arrivals, now);
+
+  return GST_PAD_PROBE_OK;
+}
+
+GST_START_TEST (test_slice_output)
+{
+  GstElement *x264enc;
+  GstBuffer *inbuffer;
+  GstCaps *outcaps;
+  GList *l;
+  gint i, parts, frames = 0;
+  GstClockTime pts = GST_CLOCK_TIME_NONE;
+
+  x264enc = setup_x264enc ("high", "byte-stream", "I420",
+      "slice-output=true tune=zerolatency option-string=slices=4");
+  arrivals = g_array_new (FALSE, FALSE, sizeof (gint64));
+  gst_pad_add_probe (mysinkpad, GST_PAD_PROBE_TYPE_BUFFER, record_arrival,
+      NULL, NULL);
+  fail_unless (gst_element_set_state (x264enc,
+          GST_STATE_PLAYING) == GST_STATE_CHANGE_SUCCESS,
+      "could not set to playing");
+
+  for (i = 0; i < 3; i++) {
+    inbuffer = gst_buffer_new_and_alloc (384 * 288 * 3 / 2);
+    gst_buffer_memset (inbuffer, 0, i * 40, -1);
+    GST_BUFFER_TIMESTAMP (inbuffer) = i * GST_SECOND / 25;
+    fail_unless (gst_pad_push (mysrcpad, inbuffer) == GST_FLOW_OK);
+  }
+  fail_unless (gst_pad_push_event (mysrcpad, gst_event_new_eos ()) == TRUE);
+
+  outcaps = gst_pad_get_current_caps (mysinkpad);
+  fail_unless (outcaps != NULL);
+  fail_unless_equals_string (gst_structure_get_string (gst_caps_get_structure
+          (outcaps, 0), "alignment"), "nal");
+  gst_caps_unref (outcaps);
+
+  /* every buffer holds one NAL unit, the first frame goes out after it is
+   * encoded, the next ones slice by slice, and only the last part of a
+   * frame carries the marker */
+  fail_unless_equals_int (g_list_length (buffers), arrivals->len);
+  for (l = buffers, i = 0, parts = 0; l; l = l->next, i++) {
+    GstBuffer *buf = l->data;
+    GstMapInfo map;
+    const guint8 *data, *end;
+
+    fail_unless (gst_buffer_map (buf, &map, GST_MAP_READ));
+    fail_unless (map.size > 4);
+    fail_unless (map.data[0] == 0 && map.data[1] == 0);
+    fail_unless (map.data[2] == 1 || (map.data[2] == 0 && map.data[3] == 1));
+    end = map.data + map.size - 3;
+    for (data = map.data + 3; data <= end; data++)
+      fail_if (data[0] == 0 && data[1] == 0 && data[2] == 1);
+    gst_buffer_unmap (buf, &map);
+
+    if (GST_BUFFER_PTS (buf) != pts) {
+      pts = GST_BUFFER_PTS (buf);
+      parts = 0;
+    }
+    parts++;
+
+    if (!GST_BUFFER_FLAG_IS_SET (buf, GST_BUFFER_FLAG_MARKER))
+      continue;
+
+    fail_unless (parts > 1);
+    if (frames > 0) {
+      GST_INFO ("frame %d: first slice out %" G_GINT64_FORMAT " us before "
+          "the whole frame", frames,
+          g_array_index (arrivals, gint64, i) -
+          g_array_index (arrivals, gint64, i - parts + 1));
+      fail_unless (g_array_index (arrivals, gint64, i - parts + 1) <=
+          g_array_index (arrivals, gint64, i));
+    }
+    frames++;
+  }
+  fail_unless_equals_int (frames, 3);
+
+  g_array_free (arrivals, TRUE);
+  gst_check_drop_buffers ();
+  cleanup_x264enc (x264enc);
+}
+
+GST_END_TEST;
+
+/* reads an unsigned Exp-Golomb code, enough for the start of a slice
+ * header, which never contains an emulation prevention byte */
+static guint
+read_ue (const guint8 * data, guint * bit)
+{
+  guint zeros = 0, value = 1;
+
+  while (!(data[*bit / 8] & (0x80 >> (*bit % 8)))) {
+    zeros++;
+    (*bit)++;
+  }
+  (*bit)++;
+  while (zeros--) {
+    value = (value << 1) | !!(data[*bit / 8] & (0x80 >> (*bit % 8)));
+    (*bit)++;
+  }
+
+  return value - 1;
+}
+
+/* encodes frames with x264 writing the NAL units straight into the output
+ * memory, which happens without frame threads, and checks that every frame
+ * holds one memory per NAL unit with the slices in order */
+static void
+check_direct_nals (const gchar * props, gint slices, gboolean contiguous)
+{
+  GstElement *x264enc;
+  GstBuffer *inbuffer;
+  GList *l;
+  gint i;
+
+  x264enc = setup_x264enc ("high", "byte-stream", "I420", props);
+  fail_unless (gst_element_set_state (x264enc,
+          GST_STATE_PLAYING) == GST_STATE_CHANGE_SUCCESS,
+      "could not set to playing");
+
+  for (i = 0; i < 5; i++) {
+    inbuffer = gst_buffer_new_and_alloc (384 * 288 * 3 / 2);
+    gst_buffer_memset (inbuffer, 0, i * 40, -1);
+    GST_BUFFER_TIMESTAMP (inbuffer) = i * GST_SECOND / 25;
+    fail_unless (gst_pad_push (mysrcpad, inbuffer) == GST_FLOW_OK);
+  }
+  fail_unless (gst_pad_push_event (mysrcpad, gst_event_new_eos ()) == TRUE);
+
+  fail_unless_equals_int (g_list_length (buffers), 5);
+  for (l = buffers; l; l = l->next) {
+    GstBuffer *buf = l->data;
+    GstMemory *mem, *prev = NULL;
+    GstMapInfo map;
+    guint n, j, bit, first_mb;
+    gint next_mb = 0, n_slices = 0;
+    gsize offset;
+
+    n = gst_buffer_n_memory (buf);
+    for (j = 0; j < n; j++) {
+      mem = gst_buffer_peek_memory (buf, j);
+
+      /* the NAL units of a frame follow each other in one memory, so
+       * mapping the whole buffer does not copy */
+      if (contiguous && prev)
+        fail_unless (gst_memory_is_span (prev, mem, &offset));
+      prev = mem;
+
+      fail_unless (gst_memory_map (mem, &map, GST_MAP_READ));
+      fail_unless (map.size > 5);
+      fail_unless (map.data[0] == 0 && map.data[1] == 0);
+      bit = map.data[2] == 1 ? 3 * 8 : 4 * 8;
+      fail_unless (map.data[bit / 8 - 1] == 1);
+
+      /* slices come sorted by their first macroblock */
+      if ((map.data[bit / 8] & 0x1f) == 1 || (map.data[bit / 8] & 0x1f) == 5) {
+        bit += 8;
+        first_mb = read_ue (map.data, &bit);
+        fail_unless (next_mb == 0 || (gint) first_mb >= next_mb);
+        next_mb = first_mb + 1;
+        n_slices++;
+      }
+      gst_memory_unmap (mem, &map);
+    }
+    fail_unless_equals_int (n_slices, slices);
+  }
+
+  gst_check_drop_buffers ();
+  cleanup_x264enc (x264enc);
+}
+
+GST_START_TEST (test_direct_nals)
+{
+  check_direct_nals ("threads=1", 1, TRUE);
+  check_direct_nals ("threads=4 sliced-threads=true", 4, FALSE);
+}
+
+GST_END_TEST;
+
+#define CHUNK_FRAMES 5
+
+/* encodes some frames in chunks and returns the output buffers */
+static GList *
+encode_chunked (guint jobs)
+{
+  GstElement *x264enc;
+  GstBuffer *inbuffer;
+  GList *result;
+  gchar *props;
+  gint64 start;
+  gint i;
+
+  props = g_strdup_printf ("chunk-frames=%d chunk-jobs=%u", CHUNK_FRAMES,
+      jobs);
+  x264enc = setup_x264enc ("high", "byte-stream", "I420", props);
+  g_free (props);
+  fail_unless (gst_element_set_state (x264enc,
+          GST_STATE_PLAYING) == GST_STATE_CHANGE_SUCCESS,
+      "could not set to playing");
+
+  start = g_get_monotonic_time ();
+  for (i = 0; i < 4 * CHUNK_FRAMES; i++) {
+    inbuffer = gst_buffer_new_and_alloc (384 * 288 * 3 / 2);
+    gst_buffer_memset (inbuffer, 0, i * 10, -1);
+    GST_BUFFER_TIMESTAMP (inbuffer) = i * GST_SECOND / 25;
+    fail_unless (gst_pad_push (mysrcpad, inbuffer) == GST_FLOW_OK);
+  }
+  fail_unless (gst_pad_push_event (mysrcpad, gst_event_new_eos ()) == TRUE);
+  GST_INFO ("%u jobs: encoded in %" G_GINT64_FORMAT " us", jobs,
+      g_get_monotonic_time () - start);
+
+  result = buffers;
+  buffers = NULL;
+  cleanup_x264enc (x264enc);
+
+  return result;
+}
+
+GST_START_TEST (test_chunked)
+{
+  GList *serial, *parallel, *l1, *l2;
+  gint keyframes = 0;
+
+  serial = encode_chunked (1);
+  parallel = encode_chunked (4);
+
+  /* the same stream comes out however many chunks are encoded at once */
+  fail_unless_equals_int (g_list_length (serial), 4 * CHUNK_FRAMES);
+  fail_unless_equals_int (g_list_length (parallel), 4 * CHUNK_FRAMES);
+  for (l1 = serial, l2 = parallel; l1; l1 = l1->next, l2 = l2->next) {
+    GstBuffer *b1 = l1->data, *b2 = l2->data;
+    GstMapInfo map;
+
+    fail_unless_equals_uint64 (GST_BUFFER_PTS (b1), GST_BUFFER_PTS (b2));
+    fail_unless_equals_uint64 (GST_BUFFER_DTS (b1), GST_BUFFER_DTS (b2));
+    fail_unless_equals_int (gst_buffer_get_size (b1),
+        gst_buffer_get_size (b2));
+    gst_buffer_map (b1, &map, GST_MAP_READ);
+    fail_unless (gst_buffer_memcmp (b2, 0, map.data, map.size) == 0);
+    gst_buffer_unmap (b1, &map);
+
+    /* and every chunk starts with a keyframe */
+    if ((GST_BUFFER_PTS (b1) / (GST_SECOND / 25)) % CHUNK_FRAMES == 0) {
+      fail_if (GST_BUFFER_FLAG_IS_SET (b1, GST_BUFFER_FLAG_DELTA_UNIT));
+      keyframes++;
+    }
+  }
+  fail_unless_equals_int (keyframes, 4);
+
+  g_list_free_full (serial, (GDestroyNotify) gst_buffer_unref);
+  g_list_free_full (parallel, (GDestroyNotify) gst_buffer_unref);
+}
+
+GST_END_TEST;
+
+GST_START_TEST (test_chunked_slice_output)
+{
+  GstElement *x264enc;
+  GstBuffer *inbuffer;
+  GstCaps *outcaps;
+  gint i;
+
+  /* slices can't be output while the chunks are encoded in parallel, so
+   * whole access units come out */
+  x264enc = setup_x264enc ("high", "byte-stream", "I420",
+      "slice-output=true chunk-frames=5 option-string=slices=4");
+  fail_unless (gst_element_set_state (x264enc,
+          GST_STATE_PLAYING) == GST_STATE_CHANGE_SUCCESS,
+      "could not set to playing");
+
+  for (i = 0; i < CHUNK_FRAMES; i++) {
+    inbuffer = gst_buffer_new_and_alloc (384 * 288 * 3 / 2);
+    gst_buffer_memset (inbuffer, 0, i * 10, -1);
+    GST_BUFFER_TIMESTAMP (inbuffer) = i * GST_SECOND / 25;
+    fail_unless (gst_pad_push (mysrcpad, inbuffer) == GST_FLOW_OK);
+  }
+  fail_unless (gst_pad_push_event (mysrcpad, gst_event_new_eos ()) == TRUE);
+
+  outcaps = gst_pad_get_current_caps (mysinkpad);
+  fail_unless (outcaps != NULL);
+  fail_unless_equals_string (gst_structure_get_string (gst_caps_get_structure
+          (outcaps, 0), "alignment"), "au");
+  gst_caps_unref (outcaps);
+  fail_unless_equals_int (g_list_length (buffers), CHUNK_FRAMES);
+
+  gst_check_drop_buffers ();
+  cleanup_x264enc (x264enc);
+}
+
+GST_END_TEST;
+
+/* encodes textured frames, optionally with a region of interest, and
+ * returns the size of the output */
+static gsize
+encode_roi (gboolean with_roi)
+{
+  GstElement *x264enc;
+  GstBuffer *inbuffer;
+  GstMapInfo map;
+  GList *l;
+  gsize size = 0, j;
+  gint i;
+
+  x264enc = setup_x264enc ("high", "byte-stream", "I420",
+      "pass=qual quantizer=30 roi-quant-offsets=offsets,face=-10.0");
+  fail_unless (gst_element_set_state (x264enc,
+          GST_STATE_PLAYING) == GST_STATE_CHANGE_SUCCESS,
+      "could not set to playing");
+
+  for (i = 0; i < 3; i++) {
+    inbuffer = gst_buffer_new_and_alloc (384 * 288 * 3 / 2);
+    gst_buffer_map (inbuffer, &map, GST_MAP_WRITE);
+    for (j = 0; j < map.size; j++)
+      map.data[j] = (j * 7 + (j / 384) * 13 + i * 5) & 0xff;
+    gst_buffer_unmap (inbuffer, &map);
+    if (with_roi)
+      gst_buffer_add_video_region_of_interest_meta (inbuffer, "face", 64, 64,
+          128, 96);
+    GST_BUFFER_TIMESTAMP (inbuffer) = i * GST_SECOND / 25;
+    fail_unless (gst_pad_push (mysrcpad, inbuffer) == GST_FLOW_OK);
+  }
+  fail_unless (gst_pad_push_event (mysrcpad, gst_event_new_eos ()) == TRUE);
+
+  fail_unless_equals_int (g_list_length (buffers), 3);
+  for (l = buffers; l; l = l->next)
+    size += gst_buffer_get_size (l->data);
+
+  gst_check_drop_buffers ();
+  cleanup_x264enc (x264enc);
+
+  return size;
+}
+
+GST_START_TEST (test_roi_quant_offsets)
+{
+  gsize plain, roi;
+
+  plain = encode_roi (FALSE);
+  roi = encode_roi (TRUE);
+
+  /* the region is coded at a lower quantizer, so with more bits */
+  GST_INFO ("without ROI %" G_GSIZE_FORMAT " bytes, with %" G_GSIZE_FORMAT,
+      plain, roi);
+  fail_unless (roi > plain);
+}
+
+GST_END_TEST;
+
+#define TWO_PASS_FRAMES 20
+
+/* counts the directories two-pass encoding keeps its statistics in */
+static guint
+count_stats_dirs (void)
+{
+  const gchar *name;
+  GDir *dir;
+  guint n = 0;
+
+  dir = g_dir_open (g_get_tmp_dir (), 0, NULL);
+  fail_unless (dir != NULL);
+  while ((name = g_dir_read_name (dir))) {
+    gchar *path = g_build_filename (g_get_tmp_dir (), name, NULL);
+
+    if (g_str_has_prefix (name, "x264enc-")
+        && g_file_test (path, G_FILE_TEST_IS_DIR))
+      n++;
+    g_free (path);
+  }
+  g_dir_close (dir);
+
+  return n;
+}
+
+/* encodes frames of varying complexity and returns the output size */
+static gsize
+encode_pass (const gchar * props)
+{
+  GstElement *x264enc;
+  GstBuffer *inbuffer;
+  GstMapInfo map;
+  GList *l;
+  gsize size = 0, j;
+  guint stats_dirs;
+  gint i;
+
+  stats_dirs = count_stats_dirs ();
+  x264enc = setup_x264enc ("high", "byte-stream", "I420", props);
+  fail_unless (gst_element_set_state (x264enc,
+          GST_STATE_PLAYING) == GST_STATE_CHANGE_SUCCESS,
+      "could not set to playing");
+
+  for (i = 0; i < TWO_PASS_FRAMES; i++) {
+    inbuffer = gst_buffer_new_and_alloc (384 * 288 * 3 / 2);
+    gst_buffer_map (inbuffer, &map, GST_MAP_WRITE);
+    for (j = 0; j < map.size; j++)
+      map.data[j] = i < TWO_PASS_FRAMES / 2 ? i * 10 : (j * (i + 3)) & 0xff;
+    gst_buffer_unmap (inbuffer, &map);
+    GST_BUFFER_TIMESTAMP (inbuffer) = i * GST_SECOND / 25;
+    fail_unless (gst_pad_push (mysrcpad, inbuffer) == GST_FLOW_OK);
+  }
+  fail_unless (gst_pad_push_event (mysrcpad, gst_event_new_eos ()) == TRUE);
+
+  /* the statistics are gone with the stream */
+  fail_unless_equals_int (count_stats_dirs (), stats_dirs);
+
+  fail_unless_equals_int (g_list_length (buffers), TWO_PASS_FRAMES);
+  for (l = buffers; l; l = l->next)
+    size += gst_buffer_get_size (l->data);
+
+  gst_check_drop_buffers ();
+  cleanup_x264enc (x264enc);
+
+  return size;
+}
+
+GST_START_TEST (test_two_pass)
+{
+  gchar *stats, *props;
+  gsize file_size, memory_size;
+  gint fd;
+
+  fd = g_file_open_tmp ("x264enc-test-XXXXXX", &stats, NULL);
+  fail_unless (fd >= 0);
+  close (fd);
+
+  /* the file based passes, one run each */
+  props = g_strdup_printf ("bitrate=300 pass=pass1 multipass-cache-file=%s",
+      stats);
+  encode_pass (props);
+  g_free (props);
+  props = g_strdup_printf ("bitrate=300 pass=pass2 multipass-cache-file=%s",
+      stats);
+  file_size = encode_pass (props);
+  g_free (props);
+
+  /* and both passes in one run */
+  memory_size = encode_pass ("bitrate=300 pass=two-pass");
+
+  GST_INFO ("file based: %" G_GSIZE_FORMAT " bytes, buffered: %"
+      G_GSIZE_FORMAT " bytes", file_size, memory_size);
+  fail_unless (memory_size >= file_size * 95 / 100);
+  fail_unless (memory_size <= file_size * 105 / 100);
+
+  g_unlink (stats);
+  props = g_strdup_printf ("%s.mbtree", stats);
+  g_unlink (props);
+  g_free (props);
+  g_free (stats);
+}
+
+GST_END_TEST;
+
+GST_START_TEST (test_frame_stats)
+{
+  GstElement *x264enc;
+  GstBuffer *inbuffer;
+  GstMessage *msg;
+  GstBus *bus;
+  GType api;
+  GList *l;
+  gint i, messages = 0;
+
+  x264enc = setup_x264enc ("high", "byte-stream", "I420",
+      "frame-stats=true stats-interval=5 option-string=psnr=1:ssim=1");
+  bus = gst_bus_new ();
+  gst_element_set_bus (x264enc, bus);
+  fail_unless (gst_element_set_state (x264enc,
+          GST_STATE_PLAYING) == GST_STATE_CHANGE_SUCCESS,
+      "could not set to playing");
+
+  for (i = 0; i < 10; i++) {
+    inbuffer = gst_buffer_new_and_alloc (384 * 288 * 3 / 2);
+    gst_buffer_memset (inbuffer, 0, i * 20, -1);
+    GST_BUFFER_TIMESTAMP (inbuffer) = i * GST_SECOND / 25;
+    fail_unless (gst_pad_push (mysrcpad, inbuffer) == GST_FLOW_OK);
+  }
+  fail_unless (gst_pad_push_event (mysrcpad, gst_event_new_eos ()) == TRUE);
+
+  /* every buffer carries its statistics */
+  api = g_type_from_name ("GstX264EncFrameStatsMetaAPI");
+  fail_unless (api != 0);
+  fail_unless_equals_int (g_list_length (buffers), 10);
+  for (l = buffers; l; l = l->next)
+    fail_unless (gst_buffer_get_meta (l->data, api) != NULL);
+
+  /* and there is a summary every five frames */
+  while ((msg = gst_bus_pop_filtered (bus, GST_MESSAGE_ELEMENT))) {
+    const GstStructure *s = gst_message_get_structure (msg);
+    guint frames;
+    guint64 bytes;
+    gdouble qp, psnr;
+
+    fail_unless (gst_structure_has_name (s, "x264enc-stats"));
+    fail_unless (gst_structure_get_uint (s, "frames", &frames));
+    fail_unless_equals_int (frames, 5);
+    fail_unless (gst_structure_get_uint64 (s, "bytes", &bytes));
+    fail_unless (bytes > 0);
+    fail_unless (gst_structure_get_double (s, "average-qp", &qp));
+    fail_unless (qp >= 0 && qp <= 51);
+    fail_unless (gst_structure_get_double (s, "average-psnr", &psnr));
+    fail_unless (psnr > 0);
+    fail_unless (gst_structure_has_field (s, "average-ssim"));
+    gst_message_unref (msg);
+    messages++;
+  }
+  fail_unless_equals_int (messages, 2);
+
+  gst_check_drop_buffers ();
+  gst_element_set_bus (x264enc, NULL);
+  gst_object_unref (bus);
+  cleanup_x264enc (x264enc);
+}
+
+GST_END_TEST;
 
 Suite *
 x264enc_suite (void)
@@ -299,6 +833,13 @@ x264enc_suite (void)
   tcase_add_test (tc_chain, test_video_high);
   tcase_add_test (tc_chain, test_video_high422);
   tcase_add_test (tc_chain, test_video_high444);
+  tcase_add_test (tc_chain, test_slice_output);
+  tcase_add_test (tc_chain, test_direct_nals);
+  tcase_add_test (tc_chain, test_chunked);
+  tcase_add_test (tc_chain, test_chunked_slice_output);
+  tcase_add_test (tc_chain, test_roi_quant_offsets);
+  tcase_add_test (tc_chain, test_two_pass);
+  tcase_add_test (tc_chain, test_frame_stats);
 
   return s;
 }
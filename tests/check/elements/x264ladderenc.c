@@ -0,0 +1,261 @@
+/* GStreamer
+ *
+ * unit test for x264ladderenc
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Library General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Library General Public License for more details.
+ *
+ * You should have received a copy of the GNU Library General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 51 Franklin St, Fifth Floor,
+ * Boston, MA 02110-1301, USA.
+ */
+
+#include <gst/check/gstcheck.h>
+#include <gst/video/video.h>
+
+#define VIDEO_CAPS_STRING "video/x-raw, " \
+                           "format = (string) I420, " \
+                           "width = (int) 128, " \
+                           "height = (int) 96, " \
+                           "framerate = (fraction) 25/1"
+
+#define N_RENDITIONS 2
+#define N_FRAMES 10
+
+static GstPad *mysrcpad, *mysinkpads[N_RENDITIONS];
+/* the buffers and force-key-unit events of each rendition */
+static GList *outputs[N_RENDITIONS];
+static GstFlowReturn chain_ret;
+
+static GstStaticPadTemplate srctemplate = GST_STATIC_PAD_TEMPLATE ("src",
+    GST_PAD_SRC,
+    GST_PAD_ALWAYS,
+    GST_STATIC_CAPS (VIDEO_CAPS_STRING));
+
+static GstStaticPadTemplate sinktemplate = GST_STATIC_PAD_TEMPLATE ("sink",
+    GST_PAD_SINK,
+    GST_PAD_ALWAYS,
+    GST_STATIC_CAPS ("video/x-h264"));
+
+static GstFlowReturn
+rendition_chain (GstPad * pad, GstObject * parent, GstBuffer * buffer)
+{
+  guint index = GPOINTER_TO_UINT (g_object_get_data (G_OBJECT (pad), "index"));
+
+  if (chain_ret != GST_FLOW_OK) {
+    gst_buffer_unref (buffer);
+    return chain_ret;
+  }
+  outputs[index] = g_list_append (outputs[index], buffer);
+
+  return GST_FLOW_OK;
+}
+
+static gboolean
+rendition_event (GstPad * pad, GstObject * parent, GstEvent * event)
+{
+  guint index = GPOINTER_TO_UINT (g_object_get_data (G_OBJECT (pad), "index"));
+
+  if (gst_video_event_is_force_key_unit (event)) {
+    outputs[index] = g_list_append (outputs[index], event);
+    return TRUE;
+  }
+
+  return gst_pad_event_default (pad, parent, event);
+}
+
+static GstElement *
+setup_x264ladderenc (void)
+{
+  GstElement *ladder;
+  GstCaps *caps;
+  guint i;
+
+  chain_ret = GST_FLOW_OK;
+  ladder = gst_check_setup_element ("x264ladderenc");
+  g_object_set (ladder, "renditions", "128x96:200,64x48:100",
+      "key-int-max", 5, NULL);
+
+  mysrcpad = gst_check_setup_src_pad (ladder, &srctemplate);
+  for (i = 0; i < N_RENDITIONS; i++) {
+    gchar *name = g_strdup_printf ("src_%u", i);
+    GstPad *srcpad = gst_element_get_static_pad (ladder, name);
+
+    fail_unless (srcpad != NULL);
+    mysinkpads[i] = gst_pad_new_from_static_template (&sinktemplate, "sink");
+    g_object_set_data (G_OBJECT (mysinkpads[i]), "index",
+        GUINT_TO_POINTER (i));
+    gst_pad_set_chain_function (mysinkpads[i], rendition_chain);
+    gst_pad_set_event_function (mysinkpads[i], rendition_event);
+    fail_unless (gst_pad_link (srcpad, mysinkpads[i]) == GST_PAD_LINK_OK);
+    gst_pad_set_active (mysinkpads[i], TRUE);
+    gst_object_unref (srcpad);
+    g_free (name);
+  }
+  gst_pad_set_active (mysrcpad, TRUE);
+
+  fail_unless (gst_element_set_state (ladder,
+          GST_STATE_PLAYING) == GST_STATE_CHANGE_SUCCESS,
+      "could not set to playing");
+
+  caps = gst_caps_from_string (VIDEO_CAPS_STRING);
+  gst_check_setup_events (mysrcpad, ladder, caps, GST_FORMAT_TIME);
+  gst_caps_unref (caps);
+
+  return ladder;
+}
+
+static void
+cleanup_x264ladderenc (GstElement * ladder)
+{
+  guint i;
+
+  gst_element_set_state (ladder, GST_STATE_NULL);
+
+  gst_pad_set_active (mysrcpad, FALSE);
+  gst_check_teardown_src_pad (ladder);
+  for (i = 0; i < N_RENDITIONS; i++) {
+    gst_pad_set_active (mysinkpads[i], FALSE);
+    gst_object_unref (mysinkpads[i]);
+    g_list_free_full (outputs[i], (GDestroyNotify) gst_mini_object_unref);
+    outputs[i] = NULL;
+  }
+  gst_check_teardown_element (ladder);
+}
+
+GST_START_TEST (test_aligned_keyframes)
+{
+  GstElement *ladder;
+  GstBuffer *inbuffer;
+  GList *l0, *l1;
+  gint i, keyframes = 0;
+
+  ladder = setup_x264ladderenc ();
+
+  for (i = 0; i < N_FRAMES; i++) {
+    inbuffer = gst_buffer_new_and_alloc (128 * 96 * 3 / 2);
+    gst_buffer_memset (inbuffer, 0, i * 20, -1);
+    GST_BUFFER_PTS (inbuffer) = i * GST_SECOND / 25;
+    GST_BUFFER_DURATION (inbuffer) = GST_SECOND / 25;
+    fail_unless (gst_pad_push (mysrcpad, inbuffer) == GST_FLOW_OK);
+  }
+  fail_unless (gst_pad_push_event (mysrcpad, gst_event_new_eos ()));
+
+  for (i = 0; i < N_RENDITIONS; i++) {
+    GstCaps *caps = gst_pad_get_current_caps (mysinkpads[i]);
+    GstStructure *s;
+    gint width;
+
+    fail_unless (caps != NULL);
+    s = gst_caps_get_structure (caps, 0);
+    fail_unless (gst_structure_get_int (s, "width", &width));
+    fail_unless_equals_int (width, 128 >> i);
+    gst_caps_unref (caps);
+
+    fail_unless_equals_int (g_list_length (outputs[i]), N_FRAMES);
+  }
+
+  /* keyframes carry the same timestamps on both renditions */
+  for (l0 = outputs[0], l1 = outputs[1]; l0; l0 = l0->next, l1 = l1->next) {
+    GstBuffer *b0 = l0->data, *b1 = l1->data;
+
+    fail_unless_equals_int (GST_BUFFER_FLAG_IS_SET (b0,
+            GST_BUFFER_FLAG_DELTA_UNIT), GST_BUFFER_FLAG_IS_SET (b1,
+            GST_BUFFER_FLAG_DELTA_UNIT));
+    if (!GST_BUFFER_FLAG_IS_SET (b0, GST_BUFFER_FLAG_DELTA_UNIT)) {
+      fail_unless_equals_uint64 (GST_BUFFER_PTS (b0), GST_BUFFER_PTS (b1));
+      keyframes++;
+    }
+  }
+  fail_unless_equals_int (keyframes, N_FRAMES / 5);
+
+  cleanup_x264ladderenc (ladder);
+}
+
+GST_END_TEST;
+
+static void
+push_frames (gint start, gint end)
+{
+  GstBuffer *inbuffer;
+  gint i;
+
+  for (i = start; i < end; i++) {
+    inbuffer = gst_buffer_new_and_alloc (128 * 96 * 3 / 2);
+    gst_buffer_memset (inbuffer, 0, i * 20, -1);
+    GST_BUFFER_PTS (inbuffer) = i * GST_SECOND / 25;
+    GST_BUFFER_DURATION (inbuffer) = GST_SECOND / 25;
+    fail_unless (gst_pad_push (mysrcpad, inbuffer) == GST_FLOW_OK);
+  }
+}
+
+GST_START_TEST (test_force_key_unit)
+{
+  GstElement *ladder;
+  GList *l;
+  gint i, n;
+
+  ladder = setup_x264ladderenc ();
+
+  push_frames (0, 2);
+  fail_unless (gst_pad_push_event (mysrcpad,
+          gst_video_event_new_downstream_force_key_unit (GST_CLOCK_TIME_NONE,
+              GST_CLOCK_TIME_NONE, GST_CLOCK_TIME_NONE, TRUE, 1)));
+  push_frames (2, N_FRAMES);
+  fail_unless (gst_pad_push_event (mysrcpad, gst_event_new_eos ()));
+
+  /* the event comes right before the keyframe of the third frame */
+  for (i = 0; i < N_RENDITIONS; i++) {
+    fail_unless_equals_int (g_list_length (outputs[i]), N_FRAMES + 1);
+    for (l = outputs[i], n = 0; !GST_IS_EVENT (l->data); l = l->next)
+      n++;
+    fail_unless_equals_int (n, 2);
+    fail_unless (GST_IS_BUFFER (l->next->data));
+    fail_if (GST_BUFFER_FLAG_IS_SET (l->next->data,
+            GST_BUFFER_FLAG_DELTA_UNIT));
+  }
+
+  cleanup_x264ladderenc (ladder);
+}
+
+GST_END_TEST;
+
+GST_START_TEST (test_eos_flow)
+{
+  GstElement *ladder;
+
+  ladder = setup_x264ladderenc ();
+
+  /* the delayed frames can't be pushed when draining */
+  push_frames (0, 3);
+  chain_ret = GST_FLOW_ERROR;
+  fail_if (gst_pad_push_event (mysrcpad, gst_event_new_eos ()));
+
+  cleanup_x264ladderenc (ladder);
+}
+
+GST_END_TEST;
+
+static Suite *
+x264ladderenc_suite (void)
+{
+  Suite *s = suite_create ("x264ladderenc");
+  TCase *tc_chain = tcase_create ("general");
+
+  suite_add_tcase (s, tc_chain);
+  tcase_add_test (tc_chain, test_aligned_keyframes);
+  tcase_add_test (tc_chain, test_force_key_unit);
+  tcase_add_test (tc_chain, test_eos_flow);
+
+  return s;
+}
+
+GST_CHECK_MAIN (x264ladderenc);
@@ -22,6 +22,8 @@
 
 #include <gst/check/gstcheck.h>
 #include <gst/check/gstbufferstraw.h>
+#include <gst/check/gstharness.h>
+#include <gst/audio/audio.h>
 
 #ifndef GST_DISABLE_PARSE
 
@@ -106,8 +108,285 @@ GST_START_TEST (test_caps_proxy)
 
 GST_END_TEST;
 
+typedef struct
+{
+  guint frames;
+  guint64 samples;
+  GstClockTime next_ts;
+} EncodeResult;
+
+/* every buffer must hold exactly one frame, starting with a frame sync, and
+ * be timestamped contiguously according to the samples it holds */
+static void
+count_frame (GstElement * sink, GstBuffer * buffer, GstPad * pad,
+    EncodeResult * result)
+{
+  guint8 data[4];
+  guint samples;
+
+  fail_unless_equals_int (gst_buffer_extract (buffer, 0, data, 4), 4);
+  fail_unless (data[0] == 0xff && (data[1] & 0xe0) == 0xe0);
+
+  /* layer III frames hold 1152 samples for MPEG-1, 576 for MPEG-2 and 2.5 */
+  samples = (data[1] & 0x18) == 0x18 ? 1152 : 576;
+
+  fail_unless (GST_BUFFER_PTS_IS_VALID (buffer));
+  if (GST_CLOCK_TIME_IS_VALID (result->next_ts))
+    fail_unless_equals_uint64 (GST_BUFFER_PTS (buffer), result->next_ts);
+  result->next_ts = GST_BUFFER_PTS (buffer) + GST_BUFFER_DURATION (buffer);
+
+  result->frames++;
+  result->samples += samples;
+}
+
+#define NUM_SAMPLES (100 * 4410)
+
+/* encodes 10 seconds of audio in the given format and returns the number of
+ * mp3 frames, the number of samples they hold is stored in @samples */
+static guint
+encode_frames (const gchar * format, gint channels, const gchar * props,
+    guint64 * samples)
+{
+  GstElement *bin, *sink;
+  GstMessage *msg;
+  GstBus *bus;
+  gchar *pipe_str;
+  GError *error = NULL;
+  EncodeResult result = { 0, 0, GST_CLOCK_TIME_NONE };
+  gint64 start;
+
+  pipe_str = g_strdup_printf ("audiotestsrc num-buffers=100 "
+      "samplesperbuffer=4410 ! audio/x-raw,format=%s,rate=44100,channels=%d "
+      "! lamemp3enc target=bitrate cbr=true %s "
+      "! fakesink name=sink signal-handoffs=true", format, channels, props);
+
+  bin = gst_parse_launch (pipe_str, &error);
+  fail_unless (bin != NULL, "Error parsing pipeline: %s",
+      error ? error->message : "(invalid error)");
+
+  sink = gst_bin_get_by_name (GST_BIN (bin), "sink");
+  fail_unless (sink != NULL, "Could not get fakesink out of bin");
+  g_signal_connect (sink, "handoff", G_CALLBACK (count_frame), &result);
+  gst_object_unref (sink);
+
+  start = g_get_monotonic_time ();
+  fail_unless_equals_int (gst_element_set_state (bin, GST_STATE_PLAYING),
+      GST_STATE_CHANGE_ASYNC);
+
+  bus = gst_element_get_bus (bin);
+  msg = gst_bus_timed_pop_filtered (bus, GST_CLOCK_TIME_NONE,
+      GST_MESSAGE_EOS | GST_MESSAGE_ERROR);
+  fail_unless_equals_int (GST_MESSAGE_TYPE (msg), GST_MESSAGE_EOS);
+  gst_message_unref (msg);
+  gst_object_unref (bus);
+
+  GST_INFO ("%s: %u frames in %" G_GINT64_FORMAT " us", pipe_str,
+      result.frames, g_get_monotonic_time () - start);
+  g_free (pipe_str);
+
+  gst_element_set_state (bin, GST_STATE_NULL);
+  gst_object_unref (bin);
+
+  /* the timestamps must add up to the samples in the stream */
+  fail_unless_equals_uint64 (result.next_ts,
+      gst_util_uint64_scale_int (result.samples, GST_SECOND, 44100));
+
+  if (samples)
+    *samples = result.samples;
+
+  return result.frames;
+}
+
+GST_START_TEST (test_parallel_gapless)
+{
+  guint serial, parallel;
+  guint64 serial_samples, parallel_samples;
+
+  serial = encode_frames (GST_AUDIO_NE (S16), 2, "threads=1",
+      &serial_samples);
+  fail_unless (serial > 0);
+
+  /* all input plus the encoder delay and the post-roll LAME appends, padded
+   * to whole frames */
+  fail_unless (serial_samples >= NUM_SAMPLES + 576);
+  fail_unless (serial_samples < NUM_SAMPLES + 576 + 3 * 1152);
+
+  /* segments must neither drop nor duplicate frames at their edges */
+  parallel = encode_frames (GST_AUDIO_NE (S16), 2,
+      "threads=4 segment-frames=8", &parallel_samples);
+  fail_unless_equals_int (parallel, serial);
+  fail_unless_equals_uint64 (parallel_samples, serial_samples);
+
+  /* a partial last segment */
+  parallel = encode_frames (GST_AUDIO_NE (S16), 2,
+      "threads=2 segment-frames=100", &parallel_samples);
+  fail_unless_equals_int (parallel, serial);
+  fail_unless_equals_uint64 (parallel_samples, serial_samples);
+}
+
+GST_END_TEST;
+
+static gboolean
+lame_accepts_format (const gchar * format)
+{
+  GstElement *enc;
+  GstPad *pad;
+  GstCaps *caps, *sink_caps;
+  gboolean ret;
+
+  enc = gst_element_factory_make ("lamemp3enc", NULL);
+  fail_unless (enc != NULL);
+  pad = gst_element_get_static_pad (enc, "sink");
+  sink_caps = gst_pad_get_pad_template_caps (pad);
+  caps = gst_caps_new_simple ("audio/x-raw", "format", G_TYPE_STRING, format,
+      NULL);
+  ret = gst_caps_can_intersect (caps, sink_caps);
+  gst_caps_unref (caps);
+  gst_caps_unref (sink_caps);
+  gst_object_unref (pad);
+  gst_object_unref (enc);
+
+  return ret;
+}
+
+GST_START_TEST (test_native_formats)
+{
+  const gchar *formats[] = { GST_AUDIO_NE (S32), GST_AUDIO_NE (F32) };
+  guint s16_mono, s16_stereo, i;
+
+  /* every format should be taken as is and give the same stream layout */
+  s16_mono = encode_frames (GST_AUDIO_NE (S16), 1, "", NULL);
+  s16_stereo = encode_frames (GST_AUDIO_NE (S16), 2, "", NULL);
+
+  for (i = 0; i < G_N_ELEMENTS (formats); i++) {
+    if (!lame_accepts_format (formats[i])) {
+      GST_INFO ("LAME too old for %s input", formats[i]);
+      continue;
+    }
+    fail_unless_equals_int (encode_frames (formats[i], 1, "", NULL), s16_mono);
+    fail_unless_equals_int (encode_frames (formats[i], 2, "", NULL),
+        s16_stereo);
+  }
+}
+
+GST_END_TEST;
+
 #endif /* #ifndef GST_DISABLE_PARSE */
 
+#define PLANAR_SAMPLES 4410
+#define PLANAR_BUFFERS 20
+
+/* a triangle wave, with a different period on each channel */
+static gint16
+sample_value (guint i, guint channel)
+{
+  guint period = channel ? 200 : 314;
+  gint pos = (i % period) * 2 * 16000 / period;
+
+  return pos < 16000 ? pos - 8000 : 24000 - pos;
+}
+
+static GstBuffer *
+make_stereo_buffer (guint offset, gboolean interleaved)
+{
+  GstBuffer *buf;
+  GstMapInfo map;
+  gint16 *data;
+  guint i;
+
+  buf = gst_buffer_new_allocate (NULL, PLANAR_SAMPLES * 2 * sizeof (gint16),
+      NULL);
+  gst_buffer_map (buf, &map, GST_MAP_WRITE);
+  data = (gint16 *) map.data;
+  for (i = 0; i < PLANAR_SAMPLES; i++) {
+    if (interleaved) {
+      data[2 * i] = sample_value (offset + i, 0);
+      data[2 * i + 1] = sample_value (offset + i, 1);
+    } else {
+      data[i] = sample_value (offset + i, 0);
+      data[PLANAR_SAMPLES + i] = sample_value (offset + i, 1);
+    }
+  }
+  gst_buffer_unmap (buf, &map);
+
+#if GST_CHECK_VERSION (1, 16, 0)
+  if (!interleaved) {
+    GstAudioInfo info;
+
+    gst_audio_info_init (&info);
+    gst_audio_info_set_format (&info, GST_AUDIO_FORMAT_S16, 44100, 2, NULL);
+    info.layout = GST_AUDIO_LAYOUT_NON_INTERLEAVED;
+    gst_buffer_add_audio_meta (buf, &info, PLANAR_SAMPLES, NULL);
+  }
+#endif
+
+  GST_BUFFER_PTS (buf) = gst_util_uint64_scale_int (offset, GST_SECOND, 44100);
+  GST_BUFFER_DURATION (buf) = gst_util_uint64_scale_int (PLANAR_SAMPLES,
+      GST_SECOND, 44100);
+
+  return buf;
+}
+
+/* encodes a stereo stream serially and returns all mp3 output */
+static GByteArray *
+encode_stereo (gboolean interleaved)
+{
+  GstHarness *h;
+  GstBuffer *buf;
+  GstMapInfo map;
+  GByteArray *out;
+  gchar *caps;
+  guint i;
+
+  h = gst_harness_new ("lamemp3enc");
+  gst_util_set_object_arg (G_OBJECT (h->element), "target", "bitrate");
+  g_object_set (h->element, "cbr", TRUE, "threads", 1, NULL);
+
+  caps = g_strdup_printf ("audio/x-raw, format=" GST_AUDIO_NE (S16) ", "
+      "layout=%s, rate=44100, channels=2, channel-mask=(bitmask)0x3",
+      interleaved ? "interleaved" : "non-interleaved");
+  gst_harness_set_src_caps_str (h, caps);
+  g_free (caps);
+
+  for (i = 0; i < PLANAR_BUFFERS; i++) {
+    fail_unless_equals_int (gst_harness_push (h,
+            make_stereo_buffer (i * PLANAR_SAMPLES, interleaved)),
+        GST_FLOW_OK);
+  }
+  fail_unless (gst_harness_push_event (h, gst_event_new_eos ()));
+
+  out = g_byte_array_new ();
+  while ((buf = gst_harness_try_pull (h)) != NULL) {
+    gst_buffer_map (buf, &map, GST_MAP_READ);
+    g_byte_array_append (out, map.data, map.size);
+    gst_buffer_unmap (buf, &map);
+    gst_buffer_unref (buf);
+  }
+
+  gst_harness_teardown (h);
+
+  return out;
+}
+
+GST_START_TEST (test_non_interleaved)
+{
+  GByteArray *interleaved, *planar;
+
+  interleaved = encode_stereo (TRUE);
+  planar = encode_stereo (FALSE);
+
+  /* both layouts hold the same samples, so they must encode the same */
+  fail_unless (interleaved->len > 0);
+  fail_unless_equals_int (planar->len, interleaved->len);
+  fail_unless (memcmp (planar->data, interleaved->data, planar->len) == 0);
+
+  g_byte_array_unref (interleaved);
+  g_byte_array_unref (planar);
+}
+
+GST_END_TEST;
+
+
 Suite *
 lame_suite (void)
 {
@@ -119,7 +398,10 @@ lame_suite (void)
 #ifndef GST_DISABLE_PARSE
   tcase_add_test (tc_chain, test_format);
   tcase_add_test (tc_chain, test_caps_proxy);
+  tcase_add_test (tc_chain, test_parallel_gapless);
+  tcase_add_test (tc_chain, test_native_formats);
 #endif
+  tcase_add_test (tc_chain, test_non_interleaved);
 
   return s;
 }